@@ -18,6 +18,29 @@ constexpr bool OUT_OF_CORE_DISABLE_FILE_CACHING = false;
 constexpr size_t OUT_OF_CORE_MEMORY_LIMIT = 1024llu * 1024llu * 1000llu;
 constexpr size_t OUT_OF_CORE_SVDAG_RESOLUTION = 64;
 
+// Trace the rays of a batching point through Embree as 16-wide SOA packets instead of one at a time
+constexpr bool ENABLE_EMBREE_PACKET_TRAVERSAL = true;
+// Packets with fewer active rays than this are traced with the scalar (rtcIntersect1) path instead
+constexpr int EMBREE_PACKET_MIN_ACTIVE_RAYS = 4;
+// Collect rays that reach a batching point in a separate task and cull them against its SVDAG 8 at a time (AVX2)
+// instead of traversing the SVDAG with a single ray during top-level traversal
+constexpr bool ENABLE_BATCHED_SVDAG_CULLING = true;
+// Store evicted TriangleShapes with quantized positions, octahedral normals and delta coded indices (lossy)
+// to reduce the amount of data that has to be read from disk when they are made resident again
+constexpr bool ENABLE_COMPRESSED_GEOMETRY = false;
+// Let resident TriangleShapes (and their Embree geometry) point directly into the mapped serialized data instead of
+// copying it into vectors. The data stays mapped until the shape is evicted. Not used for compressed geometry.
+constexpr bool ENABLE_ZERO_COPY_GEOMETRY = true;
+// Store the child bounds of WiVeBVH8 inner nodes as 8-bit offsets relative to the bounds of the node itself
+// (128 instead of 256 bytes per node). Changing this invalidates serialized BVHs.
+constexpr bool ENABLE_QUANTIZED_BVH_NODES = false;
+// Use the 16-wide WiVeBVH16 instead of WiVeBVH8 for the (cached) bottom-level BVHs. Only fast when compiled with
+// PANDORA_ISA_AVX512; check that the WiVeBVH16 tests pass on the target CPU before enabling it.
+constexpr bool ENABLE_WIVE_BVH16 = false;
+// Build the (cached) bottom-level WiVeBVH8s with the parallel binned SAH builder (WiVeBVH8BuildSAH) instead of going
+// through the Embree BVH builder callbacks. Only affects WiVeBVH8 (see ENABLE_WIVE_BVH16).
+constexpr bool ENABLE_SAH_BVH8_BUILDER = false;
+
 // Subdivide the scene to make it artificially more complex
 constexpr int SUBDIVIDE_LEVEL = 1;
 
@@ -22,12 +22,20 @@ struct RenderStats : public metrics::Stats {
         std::string integrator;
         int spp;
         unsigned concurrency;
+        size_t rayMemoryBudget { 0 };
+        size_t raySpillThreshold { 0 };
         unsigned schedulers;
+        unsigned prefetchTasks { 0 };
+        std::string schedulingPolicy;
+        std::string executionMode;
+        unsigned numaNodes { 1 };
 
         size_t geomCacheSize;
         size_t bvhCacheSize;
         unsigned primGroupSize;
         unsigned svdagRes;
+        bool sortRays { false };
+        bool ioUring { false };
     } config;
 
     struct {
@@ -45,6 +53,7 @@ struct RenderStats : public metrics::Stats {
         metrics::Stopwatch<std::chrono::nanoseconds> botLevelTraversalTime;
         metrics::Stopwatch<std::chrono::nanoseconds> topLevelTraversalTime;
         metrics::Stopwatch<std::chrono::nanoseconds> svdagTraversalTime;
+        metrics::Stopwatch<std::chrono::nanoseconds> raySortTime;
     } timings;
 
     struct {
@@ -84,6 +93,11 @@ struct RenderStats : public metrics::Stats {
         metrics::Counter<size_t> numRaysCulled { "rays" };
     } svdag;
 
+    struct {
+        metrics::Counter<size_t> numBatchesSorted { "batches" };
+        metrics::Counter<size_t> numRaysSorted { "rays" };
+    } raySorting;
+
 	~RenderStats();
 
 protected:
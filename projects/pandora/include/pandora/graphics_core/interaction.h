@@ -1,5 +1,6 @@
 #pragma once
 #include "glm/glm.hpp"
+#include <glm/gtc/type_precision.hpp>
 #include "pandora/graphics_core/bxdf.h"
 #include "pandora/graphics_core/pandora.h"
 #include "pandora/graphics_core/ray.h"
@@ -57,6 +58,25 @@ public:
     glm::vec3 Le(const glm::vec3& w) const;
 };
 
+// Compact representation of a SurfaceInteraction that is stored with queued rays during traversal (less than half
+// the size). Normals are stored using octahedral encoding and the outgoing direction is taken from the ray.
+struct CompactSurfaceInteraction {
+public:
+    CompactSurfaceInteraction() = default;
+    explicit CompactSurfaceInteraction(const SurfaceInteraction& si);
+
+    SurfaceInteraction decompress(const Ray& ray) const;
+
+public:
+    const SceneObject* pSceneObject { nullptr };
+    glm::vec3 position;
+    glm::vec2 uv;
+    glm::i16vec2 normal;
+    glm::i16vec2 shadingNormal;
+    // Debug color of the batching point that was hit (fits in the padding at the end of the struct)
+    glm::u8vec3 batchingPointColor { 255 };
+};
+
 Ray computeRayWithEpsilon(const Interaction& i1, const Interaction& i22);
 Ray computeRayWithEpsilon(const Interaction& i1, const glm::vec3& dir);
 
@@ -46,6 +46,8 @@ public:
 
 protected:
     void spawnNewPaths(int numPaths);
+    // Spawn the paths that were deferred because the ray queues exceeded the memory budget of the task graph.
+    bool resumeDeferredPaths();
 
     void uniformSampleAllLights(const SurfaceInteraction& si, const BounceRayState& bounceRayState, PcgRng& rng);
     void uniformSampleOneLight(const SurfaceInteraction& si, const BounceRayState& bounceRayState, PcgRng& rng);
@@ -73,6 +75,7 @@ protected:
         const PerspectiveCamera* pCamera;
         Sensor* pSensor;
         std::atomic_int currentRayIndex;
+        std::atomic_int numDeferredPaths;
         size_t seed;
         glm::ivec2 resolution;
         glm::vec2 fResolution;
@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <memory>
 #include <optional>
+#include <span>
 #include <vector>
 
 struct aiScene;
@@ -24,6 +25,11 @@ public:
         std::vector<glm::vec3>&& normals,
         std::vector<glm::vec2>&& texCoords,
         const glm::mat4& transform);
+    TriangleShape(const TriangleShape& other);
+    TriangleShape(TriangleShape&& other);
+    ~TriangleShape();
+
+    TriangleShape& operator=(TriangleShape&& other);
 
     // Evictable
     size_t sizeBytes() const final;
@@ -67,10 +73,16 @@ private:
     // Evictable
     void doEvict() final;
     void doMakeResident(tasking::Deserializer& deserializer) final;
+    void doSubmitLoad(tasking::Deserializer& deserializer) final;
+    void doCancelLoad(tasking::Deserializer& deserializer) final;
 
     static std::optional<TriangleShape> loadFromFileSingleShape(const aiScene* scene, glm::mat4 objTransform, bool ignoreVertexNormals);
     static TriangleShape createAssimpMesh(const aiScene* scene, const unsigned meshIndex, const glm::mat4& transform, bool ignoreVertexNormals);
 
+    void updateViews();
+    void makeStorageOwned();
+    void unmapSerializedData();
+
     void getTexCoords(unsigned primitiveID, std::span<glm::vec2, 3> st) const;
     void getPositions(unsigned primitiveID, std::span<glm::vec3, 3> p) const;
     void getShadingNormals(unsigned primitiveID, std::span<glm::vec3, 3> p) const;
@@ -79,12 +91,22 @@ private:
     Bounds m_bounds;
     unsigned m_numPrimitives;
 
-    std::vector<glm::uvec3> m_indices;
-    std::vector<glm::vec3> m_positions;
-    std::vector<glm::vec3> m_normals;
-    std::vector<glm::vec2> m_texCoords;
+    // Vertex data owned by the shape. Empty if the shape was made resident without copying (ENABLE_ZERO_COPY_GEOMETRY).
+    std::vector<glm::uvec3> m_indicesStorage;
+    std::vector<glm::vec3> m_positionsStorage;
+    std::vector<glm::vec3> m_normalsStorage;
+    std::vector<glm::vec2> m_texCoordsStorage;
+
+    // Used for all accesses; point either into the storage above or directly into the mapped serialized data.
+    std::span<const glm::uvec3> m_indices;
+    std::span<const glm::vec3> m_positions;
+    std::span<const glm::vec3> m_normals;
+    std::span<const glm::vec2> m_texCoords;
 
     tasking::Allocation m_serializedStateHandle;
+    // Serialized data that the spans point into (only when made resident without copying).
+    tasking::Deserializer* m_pDeserializer { nullptr };
+    const void* m_pMappedData { nullptr };
 };
 
 }
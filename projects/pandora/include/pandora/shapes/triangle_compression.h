@@ -0,0 +1,27 @@
+#pragma once
+#include "pandora/flatbuffers/triangle_mesh_generated.h"
+#include "pandora/graphics_core/bounds.h"
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace pandora {
+
+namespace detail {
+    // Lossy mesh codec: positions are quantized to 16 bits per axis relative to bounds, normals are
+    // stored as 16-bit octahedral vectors and indices are delta + LEB128 encoded (lossless).
+    flatbuffers::Offset<serialization::CompressedTriangleMesh> compressTriangleMesh(
+        flatbuffers::FlatBufferBuilder& builder,
+        const Bounds& bounds,
+        std::span<const glm::uvec3> indices,
+        std::span<const glm::vec3> positions,
+        std::span<const glm::vec3> normals);
+    void decompressTriangleMesh(
+        const serialization::CompressedTriangleMesh* pCompressed,
+        const Bounds& bounds,
+        std::vector<glm::uvec3>& indices,
+        std::vector<glm::vec3>& positions,
+        std::vector<glm::vec3>& normals);
+}
+
+}
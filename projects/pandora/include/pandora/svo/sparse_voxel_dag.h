@@ -1,4 +1,5 @@
 #pragma once
+#include "pandora/flatbuffers/sparse_voxel_dag_generated.h"
 #include "pandora/graphics_core/pandora.h"
 #include "pandora/svo/sparse_voxel_octree.h"
 #include "pandora/utility/contiguous_allocator_ts.h"
@@ -26,10 +27,17 @@ public:
 
     static void compressDAGs(std::span<SparseVoxelDAG*> svos);
 
+    // Store/load a group of SVDAGs that share their nodes after compressDAGs. The first loaded SVDAG owns the nodes.
+    // Loading returns an empty optional if the serialized SVDAGs are inconsistent (e.g. a corrupt file).
+    static flatbuffers::Offset<serialization::SparseVoxelDAGs> serializeDAGs(flatbuffers::FlatBufferBuilder& builder, std::span<const SparseVoxelDAG* const> svdags);
+    static std::optional<std::vector<SparseVoxelDAG>> loadSerializedDAGs(const serialization::SparseVoxelDAGs* pSerializedDAGs);
+
 #ifdef PANDORA_ISPC_SUPPORT
     void intersectSIMD(ispc::RaySOA rays, ispc::HitSOA hits, int N) const;
 #endif
     std::optional<float> intersectScalar(Ray ray) const;
+    // Intersects up to 8 rays at once using AVX2. Bit i of the result is set if rays[i] hit the SVDAG.
+    uint32_t intersect8(std::span<const Ray> rays) const;
     void testSVDAG() const;
 
     std::pair<std::vector<glm::vec3>, std::vector<glm::ivec3>> generateSurfaceMesh() const;
@@ -61,6 +69,8 @@ private:
     };
     static_assert(sizeof(Descriptor) == sizeof(uint16_t));
 
+    SparseVoxelDAG(const serialization::SparseVoxelDAG& serializedDAG, const NodeOffset* pData);
+
     NodeOffset constructSVOBreadthFirst(const VoxelGrid& grid);
     static Descriptor createStagingDescriptor(std::span<bool, 8> validMask, std::span<bool, 8> leafMask);
 
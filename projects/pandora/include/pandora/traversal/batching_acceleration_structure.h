@@ -1,4 +1,5 @@
 #pragma once
+#include "pandora/config.h"
 #include "pandora/core/stats.h"
 #include "pandora/graphics_core/bounds.h"
 #include "pandora/graphics_core/pandora.h"
@@ -10,10 +11,16 @@
 #include "pandora/traversal/acceleration_structure.h"
 #include "pandora/traversal/batching.h"
 #include "pandora/traversal/embree_cache.h"
+#include "pandora/traversal/embree_packets.h"
 #include "pandora/traversal/pauseable_bvh/pauseable_bvh4.h"
+#include "pandora/traversal/ray_sorting.h"
+#include "pandora/traversal/scene_bundle.h"
+#include "pandora/traversal/svdag_culling.h"
 #include "pandora/utility/enumerate.h"
+#include <array>
 #include <embree3/rtcore.h>
 #include <execution>
+#include <filesystem>
 #include <glm/gtc/type_ptr.hpp>
 #include <span>
 #include <optional>
@@ -23,7 +30,9 @@
 #include <stream/task_graph.h>
 #include <tbb/parallel_for_each.h>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace pandora {
@@ -48,7 +57,7 @@ private:
         PauseableBVH4<BatchingPoint, HitRayState, AnyHitRayState>&& topLevelBVH,
         tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>> hitTask, tasking::TaskHandle<std::tuple<Ray, HitRayState>> missTask,
         tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyHitTask, tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyMissTask,
-        tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, size_t embreeSceneCacheSize);
+        tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, size_t embreeSceneCacheSize, bool sortRays);
 
     using TopLevelBVH = PauseableBVH4<BatchingPoint, HitRayState, AnyHitRayState>;
     using OnHitTask = tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>>;
@@ -56,20 +65,59 @@ private:
     using OnAnyHitTask = tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>>;
     using OnAnyMissTask = tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>>;
 
+    // Queued rays store a compact surface interaction which is expanded when the ray exits the top-level BVH.
+    using IntersectItem = std::tuple<Ray, CompactSurfaceInteraction, HitRayState, PauseableBVHInsertHandle>;
+    using IntersectAnyItem = std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>;
+
+    // Continue top-level traversal of a batch of rays that were processed or culled by a batching point
+    void resumeTraversal(std::span<IntersectItem> items, std::pmr::memory_resource* pMemoryResource) const;
+    void resumeTraversalAny(std::span<IntersectAnyItem> items, std::pmr::memory_resource* pMemoryResource) const;
+
+    // Rays that are forwarded to other batching points while a batch resumes top-level traversal. They are collected
+    // per destination task and pushed to the task queues in bulk at the end of the kernel.
+    template <typename T>
+    class ForwardedRays {
+    public:
+        ForwardedRays(std::pmr::memory_resource* pMemoryResource);
+
+        void push(tasking::TaskHandle<T> task, const T& item);
+        void flush(tasking::TaskGraph* pTaskGraph);
+
+    private:
+        std::pmr::unordered_map<uint32_t, std::pmr::vector<T>> m_itemsPerTask;
+    };
+    struct ForwardBuffers {
+        ForwardedRays<IntersectItem> intersect;
+        ForwardedRays<IntersectAnyItem> intersectAny;
+    };
+    // Set by resumeTraversal(Any) for the duration of the top-level traversal of a batch.
+    static inline thread_local ForwardBuffers* s_pForwardBuffers { nullptr };
+
     class BatchingPoint {
     public:
         BatchingPoint(std::vector<const SceneObject*>&& sceneObjects, SparseVoxelDAG&& svdag, tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph);
         BatchingPoint(std::vector<const SceneObject*>&& sceneObjects, tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph);
 
         std::optional<bool> intersect(Ray&, SurfaceInteraction&, const HitRayState&, const PauseableBVHInsertHandle&) const;
+        std::optional<bool> intersect(Ray&, const CompactSurfaceInteraction&, const HitRayState&, const PauseableBVHInsertHandle&) const;
         std::optional<bool> intersectAny(Ray&, const AnyHitRayState&, const PauseableBVHInsertHandle&) const;
 
         Bounds getBounds() const;
 
     private:
-        bool intersectInternal(RTCScene scene, Ray&, SurfaceInteraction&) const;
+        // Enqueue a ray to one of this batching point's tasks (buffered when called from resumeTraversal(Any))
+        template <typename T>
+        void forward(tasking::TaskHandle<T> task, const T& item) const;
+
+        bool intersectInternal(RTCScene scene, Ray&, CompactSurfaceInteraction&) const;
         bool intersectAnyInternal(RTCScene scene, Ray&) const;
 
+        // Trace a whole batch through Embree in 16-wide SOA packets, falling back to the scalar path for sparse packets.
+        void intersectPacketInternal(RTCScene scene, std::span<IntersectItem> data) const;
+        void intersectAnyPacketInternal(RTCScene scene, std::span<IntersectAnyItem> data, std::span<uint32_t> hits) const;
+
+        bool processEmbreeHit(RTCScene scene, const RTCRayHit& embreeRayHit, Ray&, CompactSurfaceInteraction&) const;
+
         friend class BatchingAccelerationStructure<HitRayState, AnyHitRayState>;
         void setParent(BatchingAccelerationStructure<HitRayState, AnyHitRayState>* pParent, EmbreeSceneCache* pEmbreeCache);
 
@@ -90,8 +138,12 @@ private:
         EmbreeSceneCache* m_pEmbreeCache;
         tasking::TaskGraph* m_pTaskGraph;
 
-        tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> m_intersectTask;
-        tasking::TaskHandle<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> m_intersectAnyTask;
+        tasking::TaskHandle<IntersectItem> m_intersectTask;
+        tasking::TaskHandle<IntersectAnyItem> m_intersectAnyTask;
+
+        // Rays are first culled against the SVDAG in batches before being forwarded to m_intersect(Any)Task
+        tasking::TaskHandle<IntersectItem> m_cullTask;
+        tasking::TaskHandle<IntersectAnyItem> m_cullAnyTask;
     };
 
 private:
@@ -102,6 +154,7 @@ private:
     LRUEmbreeSceneCache m_embreeSceneCache;
 
     bool m_enableOcclusionCulling;
+    bool m_sortRays;
     tasking::TaskGraph* m_pTaskGraph;
 
     tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>> m_onHitTask;
@@ -113,7 +166,8 @@ private:
 class BatchingAccelerationStructureBuilder {
 public:
     BatchingAccelerationStructureBuilder(
-        const Scene* pScene, tasking::LRUCacheTS* pCache, tasking::TaskGraph* pTaskGraph, unsigned primitivesPerBatchingPoint, size_t botLevelBVHCacheSize, unsigned svdagRes);
+        const Scene* pScene, tasking::LRUCacheTS* pCache, tasking::TaskGraph* pTaskGraph, unsigned primitivesPerBatchingPoint, size_t botLevelBVHCacheSize, unsigned svdagRes, bool sortRays = false,
+        std::filesystem::path sceneBundleFile = {}, std::filesystem::path sceneFile = {});
 
     static void preprocessScene(Scene& scene, tasking::LRUCacheTS& oldCache, tasking::CacheBuilder& newCacheBuilder, unsigned primitivesPerBatchingPoint);
 
@@ -133,6 +187,11 @@ private:
     const unsigned m_primitivesPerBatchingPoint;
     const size_t m_botLevelBVHCacheSize;
     const unsigned m_svdagRes;
+    const bool m_sortRays;
+
+    // Load/store the batching points & SVDAGs from/to this file (disabled if empty)
+    const std::filesystem::path m_sceneBundleFile;
+    const std::filesystem::path m_sceneFile; // File from which the scene was loaded (part of the scene bundle key)
 };
 
 inline glm::vec3 randomVec3()
@@ -169,7 +228,7 @@ void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
     BatchingAccelerationStructure<HitRayState, AnyHitRayState>* pParent, EmbreeSceneCache* pEmbreeCache)
 {
     //m_pParent = pParent;
-    m_intersectTask = m_pTaskGraph->addTask<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>, StaticData>(
+    m_intersectTask = m_pTaskGraph->addTask<std::tuple<Ray, CompactSurfaceInteraction, HitRayState, PauseableBVHInsertHandle>, StaticData>(
         "BatchingAccelerationStructure::leafIntersect",
         [=]() -> StaticData {
             //g_stats.memory.batches = m_pTaskGraph->approxMemoryUsage();
@@ -178,6 +237,9 @@ void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
             {
                 OPTICK_EVENT("MakeShapesResident");
                 staticData.shapeOwners.resize(m_sceneObjects.size());
+                // Have the reads of all shapes in flight at once (when the deserializer supports it)
+                for (const auto& pSceneObject : m_sceneObjects)
+                    m_pGeometryCache->prefetch(pSceneObject->pShape.get());
                 tbb::blocked_range<size_t> shapeRange { 0, m_sceneObjects.size() };
                 tbb::parallel_for(shapeRange,
                     [&](tbb::blocked_range<size_t> localRange) {
@@ -195,34 +257,27 @@ void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
 
             return staticData;
         },
-        [=](std::span<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> data,
+        [=](std::span<std::tuple<Ray, CompactSurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> data,
             const StaticData* pStaticData, std::pmr::memory_resource* pMemoryResource) {
+            if (pParent->m_sortRays)
+                detail::sortRayBatch(data, m_bounds, pMemoryResource);
+
             {
                 auto stopWatch = g_stats.timings.botLevelTraversalTime.getScopedStopwatch();
 
                 RTCScene embreeScene = pStaticData->scene->scene;
-                for (auto& [ray, si, state, insertHandle] : data) {
-                    intersectInternal(embreeScene, ray, si);
+                if constexpr (ENABLE_EMBREE_PACKET_TRAVERSAL) {
+                    intersectPacketInternal(embreeScene, data);
+                } else {
+                    for (auto& [ray, si, state, insertHandle] : data) {
+                        intersectInternal(embreeScene, ray, si);
+                    }
                 }
             }
 
             {
                 auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
-
-                for (auto& [ray, si, state, insertHandle] : data) {
-                    auto optHit = pParent->m_topLevelBVH.intersect(ray, si, state, insertHandle);
-                    if (optHit) { // Ray exited BVH
-                        assert(!optHit.value());
-
-                        if (si.pSceneObject) {
-                            // Ray hit something
-                            assert(si.pSceneObject);
-                            m_pTaskGraph->enqueue(pParent->m_onHitTask, std::tuple { ray, si, state });
-                        } else {
-                            m_pTaskGraph->enqueue(pParent->m_onMissTask, std::tuple { ray, state });
-                        }
-                    }
-                }
+                pParent->resumeTraversal(data, pMemoryResource);
             }
         });
     m_intersectAnyTask = m_pTaskGraph->addTask<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>, StaticData>(
@@ -233,6 +288,9 @@ void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
             {
                 OPTICK_EVENT("MakeShapesResident");
                 staticData.shapeOwners.resize(m_sceneObjects.size());
+                // Have the reads of all shapes in flight at once (when the deserializer supports it)
+                for (const auto& pSceneObject : m_sceneObjects)
+                    m_pGeometryCache->prefetch(pSceneObject->pShape.get());
                 tbb::blocked_range<size_t> shapeRange { 0, m_sceneObjects.size() };
                 tbb::parallel_for(shapeRange,
                     [&](tbb::blocked_range<size_t> localRange) {
@@ -251,41 +309,176 @@ void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
             return staticData;
         },
         [=](std::span<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> data, const StaticData* pStaticData, std::pmr::memory_resource* pMemoryResource) {
-            std::vector<uint32_t> hits;
-            hits.resize(data.size());
-            std::fill(std::begin(hits), std::end(hits), false);
+            if (pParent->m_sortRays)
+                detail::sortRayBatch(data, m_bounds, pMemoryResource);
+
+            std::pmr::vector<uint32_t> hits(data.size(), false, pMemoryResource);
 
             {
                 auto stopWatch = g_stats.timings.botLevelTraversalTime.getScopedStopwatch();
 
                 RTCScene embreeScene = pStaticData->scene->scene;
-                for (auto&& [i, data] : enumerate(data)) {
-                    auto& [ray, state, insertHandle] = data;
-                    hits[i] = intersectAnyInternal(embreeScene, ray);
+                if constexpr (ENABLE_EMBREE_PACKET_TRAVERSAL) {
+                    intersectAnyPacketInternal(embreeScene, data, hits);
+                } else {
+                    for (auto&& [i, data] : enumerate(data)) {
+                        auto& [ray, state, insertHandle] = data;
+                        hits[i] = intersectAnyInternal(embreeScene, ray);
+                    }
                 }
             }
 
             {
                 auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
 
-                for (auto&& [i, data] : enumerate(data)) {
-                    auto& [ray, state, insertHandle] = data;
-
-                    if (hits[i]) {
-                        m_pTaskGraph->enqueue(pParent->m_onAnyHitTask, std::tuple { ray, state });
-                    } else {
-                        auto optHit = pParent->m_topLevelBVH.intersectAny(ray, state, insertHandle);
-                        if (optHit) {
-                            assert(!optHit.value());
-                            if (optHit.value())
-                                m_pTaskGraph->enqueue(pParent->m_onAnyHitTask, std::tuple { ray, state });
-                            else
-                                m_pTaskGraph->enqueue(pParent->m_onAnyMissTask, std::tuple { ray, state });
-                        }
-                    }
+                // Rays that did not find a hit resume top-level traversal together
+                std::pmr::vector<std::tuple<Ray, AnyHitRayState>> anyHits(pMemoryResource);
+                size_t numResumed = 0;
+                for (auto&& [i, item] : enumerate(data)) {
+                    if (hits[i])
+                        anyHits.push_back({ std::get<0>(item), std::get<1>(item) });
+                    else
+                        data[numResumed++] = item;
                 }
+                if (!anyHits.empty())
+                    m_pTaskGraph->enqueue(pParent->m_onAnyHitTask, std::span<const std::tuple<Ray, AnyHitRayState>>(anyHits));
+                pParent->resumeTraversalAny(data.subspan(0, numResumed), pMemoryResource);
             }
         });
+
+    // Let the scheduling policy know how much geometry has to be read from disk (and how large the bottom level
+    // BVH is that has to be rebuilt) before the leaf can be intersected
+    auto bytesToLoad = [=]() {
+        size_t bytes = 0;
+        for (const auto* pSceneObject : m_sceneObjects)
+            bytes += m_pGeometryCache->bytesToLoad(pSceneObject->pShape.get());
+        bytes += pEmbreeCache->bytesToBuild(reinterpret_cast<const void*>(this), m_sceneObjects);
+        return bytes;
+    };
+    m_pTaskGraph->setStaticDataLoadCost(m_intersectTask, bytesToLoad);
+    m_pTaskGraph->setStaticDataLoadCost(m_intersectAnyTask, bytesToLoad);
+
+    if (m_svdag) {
+        m_cullTask = m_pTaskGraph->addTask<IntersectItem>(
+            "BatchingAccelerationStructure::svdagCull",
+            [=](std::span<IntersectItem> data, std::pmr::memory_resource* pMemoryResource) {
+                const size_t numHits = detail::cullRayBatch(*m_svdag, data);
+
+                // Rays that (potentially) hit geometry are traced against the bottom level BVH
+                auto hitItems = data.subspan(0, numHits);
+                for (auto& [ray, si, state, insertHandle] : hitItems)
+                    ray.numTopLevelIntersections += 1;
+                m_pTaskGraph->enqueue(m_intersectTask, std::span<const IntersectItem>(hitItems));
+
+                // Culled rays continue top-level traversal
+                auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
+                pParent->resumeTraversal(data.subspan(numHits), pMemoryResource);
+            });
+        m_cullAnyTask = m_pTaskGraph->addTask<IntersectAnyItem>(
+            "BatchingAccelerationStructure::svdagCullAny",
+            [=](std::span<IntersectAnyItem> data, std::pmr::memory_resource* pMemoryResource) {
+                const size_t numHits = detail::cullRayBatch(*m_svdag, data);
+
+                auto hitItems = data.subspan(0, numHits);
+                for (auto& [ray, state, insertHandle] : hitItems)
+                    ray.numTopLevelIntersections += 1;
+                m_pTaskGraph->enqueue(m_intersectAnyTask, std::span<const IntersectAnyItem>(hitItems));
+
+                auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
+                pParent->resumeTraversalAny(data.subspan(numHits), pMemoryResource);
+            });
+    }
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+template <typename T>
+BatchingAccelerationStructure<HitRayState, AnyHitRayState>::ForwardedRays<T>::ForwardedRays(std::pmr::memory_resource* pMemoryResource)
+    : m_itemsPerTask(pMemoryResource)
+{
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+template <typename T>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::ForwardedRays<T>::push(tasking::TaskHandle<T> task, const T& item)
+{
+    m_itemsPerTask[task.index].push_back(item);
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+template <typename T>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::ForwardedRays<T>::flush(tasking::TaskGraph* pTaskGraph)
+{
+    for (const auto& [taskIndex, items] : m_itemsPerTask)
+        pTaskGraph->enqueue(tasking::TaskHandle<T> { taskIndex }, std::span<const T>(items));
+    m_itemsPerTask.clear();
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::resumeTraversal(
+    std::span<IntersectItem> items, std::pmr::memory_resource* pMemoryResource) const
+{
+    std::pmr::vector<std::optional<bool>> results(items.size(), pMemoryResource);
+    {
+        // Rays that enter other batching points are buffered and enqueued in bulk below
+        ForwardBuffers forwardBuffers { ForwardedRays<IntersectItem>(pMemoryResource), ForwardedRays<IntersectAnyItem>(pMemoryResource) };
+        ForwardBuffers* pPrevForwardBuffers = std::exchange(s_pForwardBuffers, &forwardBuffers);
+        m_topLevelBVH.intersectBatch(items, results, pMemoryResource);
+        s_pForwardBuffers = pPrevForwardBuffers;
+        forwardBuffers.intersect.flush(m_pTaskGraph);
+        forwardBuffers.intersectAny.flush(m_pTaskGraph);
+    }
+
+    // Collect the rays that exit the BVH per destination so that they can be pushed to the queues in bulk
+    std::pmr::vector<std::tuple<Ray, SurfaceInteraction, HitRayState>> hits(pMemoryResource);
+    std::pmr::vector<std::tuple<Ray, HitRayState>> misses(pMemoryResource);
+    for (auto&& [i, item] : enumerate(items)) {
+        if (results[i]) { // Ray exited BVH
+            auto& [ray, si, state, insertHandle] = item;
+            if (si.pSceneObject) {
+                // Ray hit something
+                hits.push_back({ ray, si.decompress(ray), state });
+            } else {
+                misses.push_back({ ray, state });
+            }
+        }
+    }
+
+    if (!hits.empty())
+        m_pTaskGraph->enqueue(m_onHitTask, std::span<const std::tuple<Ray, SurfaceInteraction, HitRayState>>(hits));
+    if (!misses.empty())
+        m_pTaskGraph->enqueue(m_onMissTask, std::span<const std::tuple<Ray, HitRayState>>(misses));
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::resumeTraversalAny(
+    std::span<IntersectAnyItem> items, std::pmr::memory_resource* pMemoryResource) const
+{
+    std::pmr::vector<std::optional<bool>> results(items.size(), pMemoryResource);
+    {
+        ForwardBuffers forwardBuffers { ForwardedRays<IntersectItem>(pMemoryResource), ForwardedRays<IntersectAnyItem>(pMemoryResource) };
+        ForwardBuffers* pPrevForwardBuffers = std::exchange(s_pForwardBuffers, &forwardBuffers);
+        m_topLevelBVH.intersectAnyBatch(items, results, pMemoryResource);
+        s_pForwardBuffers = pPrevForwardBuffers;
+        forwardBuffers.intersect.flush(m_pTaskGraph);
+        forwardBuffers.intersectAny.flush(m_pTaskGraph);
+    }
+
+    std::pmr::vector<std::tuple<Ray, AnyHitRayState>> hits(pMemoryResource);
+    std::pmr::vector<std::tuple<Ray, AnyHitRayState>> misses(pMemoryResource);
+    for (auto&& [i, item] : enumerate(items)) {
+        if (results[i]) {
+            auto& [ray, state, insertHandle] = item;
+            if (results[i].value())
+                hits.push_back({ ray, state });
+            else
+                misses.push_back({ ray, state });
+        }
+    }
+
+    if (!hits.empty())
+        m_pTaskGraph->enqueue(m_onAnyHitTask, std::span<const std::tuple<Ray, AnyHitRayState>>(hits));
+    if (!misses.empty())
+        m_pTaskGraph->enqueue(m_onAnyMissTask, std::span<const std::tuple<Ray, AnyHitRayState>>(misses));
 }
 
 template <typename HitRayState, typename AnyHitRayState>
@@ -304,10 +497,39 @@ inline std::optional<SurfaceInteraction> BatchingAccelerationStructure<HitRaySta
         return {};
 }
 
+template <typename HitRayState, typename AnyHitRayState>
+template <typename T>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::forward(tasking::TaskHandle<T> task, const T& item) const
+{
+    if (!s_pForwardBuffers) {
+        // Single ray traversal (not called from a kernel)
+        m_pTaskGraph->enqueue(task, item);
+    } else if constexpr (std::is_same_v<T, IntersectItem>) {
+        s_pForwardBuffers->intersect.push(task, item);
+    } else {
+        s_pForwardBuffers->intersectAny.push(task, item);
+    }
+}
+
 template <typename HitRayState, typename AnyHitRayState>
 std::optional<bool> BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersect(
     Ray& ray, SurfaceInteraction& si, const HitRayState& userState, const PauseableBVHInsertHandle& bvhInsertHandle) const
 {
+    // Single ray traversal (before the ray was queued for the first time)
+    return intersect(ray, CompactSurfaceInteraction(si), userState, bvhInsertHandle);
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+std::optional<bool> BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersect(
+    Ray& ray, const CompactSurfaceInteraction& si, const HitRayState& userState, const PauseableBVHInsertHandle& bvhInsertHandle) const
+{
+    if constexpr (ENABLE_BATCHED_SVDAG_CULLING) {
+        if (m_svdag) {
+            forward(m_cullTask, IntersectItem { ray, si, userState, bvhInsertHandle });
+            return {};
+        }
+    }
+
     if (m_svdag) {
         // auto stopWatch = g_stats.timings.svdagTraversalTime.getScopedStopwatch();
         //g_stats.svdag.numIntersectionTests++;
@@ -319,7 +541,7 @@ std::optional<bool> BatchingAccelerationStructure<HitRayState, AnyHitRayState>::
     }
 
     ray.numTopLevelIntersections += 1;
-    m_pTaskGraph->enqueue(m_intersectTask, std::tuple { ray, si, userState, bvhInsertHandle });
+    forward(m_intersectTask, IntersectItem { ray, si, userState, bvhInsertHandle });
     return {};
 }
 
@@ -327,6 +549,13 @@ template <typename HitRayState, typename AnyHitRayState>
 std::optional<bool> BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersectAny(
     Ray& ray, const AnyHitRayState& userState, const PauseableBVHInsertHandle& bvhInsertHandle) const
 {
+    if constexpr (ENABLE_BATCHED_SVDAG_CULLING) {
+        if (m_svdag) {
+            forward(m_cullAnyTask, IntersectAnyItem { ray, userState, bvhInsertHandle });
+            return {};
+        }
+    }
+
     if (m_svdag) {
         //auto stopWatch = g_stats.timings.svdagTraversalTime.getScopedStopwatch();
         //g_stats.svdag.numIntersectionTests++;
@@ -338,36 +567,22 @@ std::optional<bool> BatchingAccelerationStructure<HitRayState, AnyHitRayState>::
     }
 
     ray.numTopLevelIntersections += 1;
-    m_pTaskGraph->enqueue(m_intersectAnyTask, std::tuple { ray, userState, bvhInsertHandle });
+    forward(m_intersectAnyTask, IntersectAnyItem { ray, userState, bvhInsertHandle });
     return {};
 }
 
 template <typename HitRayState, typename AnyHitRayState>
 bool BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersectInternal(
-    RTCScene scene, Ray& ray, SurfaceInteraction& si) const
+    RTCScene scene, Ray& ray, CompactSurfaceInteraction& si) const
 {
-    RTCRayHit embreeRayHit;
-    embreeRayHit.ray.org_x = ray.origin.x;
-    embreeRayHit.ray.org_y = ray.origin.y;
-    embreeRayHit.ray.org_z = ray.origin.z;
-    embreeRayHit.ray.dir_x = ray.direction.x;
-    embreeRayHit.ray.dir_y = ray.direction.y;
-    embreeRayHit.ray.dir_z = ray.direction.z;
-
-    embreeRayHit.ray.tnear = ray.tnear;
-    embreeRayHit.ray.tfar = ray.tfar;
-
-    embreeRayHit.ray.time = 0.0f;
-    embreeRayHit.ray.mask = 0xFFFFFFFF;
-    embreeRayHit.ray.id = 0;
-    embreeRayHit.ray.flags = 0;
-    embreeRayHit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
-    for (int i = 0; i < RTC_MAX_INSTANCE_LEVEL_COUNT; i++)
-        embreeRayHit.hit.instID[i] = RTC_INVALID_GEOMETRY_ID;
-    RTCIntersectContext context;
-    rtcInitIntersectContext(&context);
-    rtcIntersect1(scene, &context, &embreeRayHit);
+    const RTCRayHit embreeRayHit = detail::intersectEmbreeRay(scene, ray);
+    return processEmbreeHit(scene, embreeRayHit, ray, si);
+}
 
+template <typename HitRayState, typename AnyHitRayState>
+bool BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::processEmbreeHit(
+    RTCScene scene, const RTCRayHit& embreeRayHit, Ray& ray, CompactSurfaceInteraction& compactSI) const
+{
     static constexpr float minInf = -std::numeric_limits<float>::infinity();
     if (embreeRayHit.ray.tfar == minInf || embreeRayHit.ray.tfar == ray.tfar)
         return false;
@@ -408,6 +623,7 @@ bool BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
         hit.primitiveID = embreeRayHit.hit.primID;
 
         const auto* pShape = pSceneObject->pShape.get();
+        SurfaceInteraction si;
         if (optLocalToWorldMatrix) {
             // Transform from world space to shape local space.
             Transform transform { *optLocalToWorldMatrix };
@@ -434,6 +650,7 @@ bool BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::
         si.pSceneObject = pSceneObject;
         //si.localToWorld = optLocalToWorldMatrix;
         si.shading.batchingPointColor = m_debugColor;
+        compactSI = CompactSurfaceInteraction(si);
         ray.tfar = embreeRayHit.ray.tfar;
         return true;
     } else {
@@ -445,30 +662,68 @@ template <typename HitRayState, typename AnyHitRayState>
 bool BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersectAnyInternal(
     RTCScene scene, Ray& ray) const
 {
-    RTCRay embreeRay;
-    embreeRay.org_x = ray.origin.x;
-    embreeRay.org_y = ray.origin.y;
-    embreeRay.org_z = ray.origin.z;
-    embreeRay.dir_x = ray.direction.x;
-    embreeRay.dir_y = ray.direction.y;
-    embreeRay.dir_z = ray.direction.z;
+    ray.tfar = detail::occludedEmbreeRay(scene, ray);
 
-    embreeRay.tnear = ray.tnear;
-    embreeRay.tfar = ray.tfar;
+    static constexpr float minInf = -std::numeric_limits<float>::infinity();
+    return ray.tfar == minInf;
+}
 
-    embreeRay.time = 0.0f;
-    embreeRay.mask = 0xFFFFFFFF;
-    embreeRay.id = 0;
-    embreeRay.flags = 0;
+template <typename HitRayState, typename AnyHitRayState>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersectPacketInternal(
+    RTCScene scene, std::span<IntersectItem> data) const
+{
+    std::array<Ray, detail::embreePacketSize> rays;
+    std::array<RTCRayHit, detail::embreePacketSize> embreeRayHits;
+    for (size_t packetStart = 0; packetStart < data.size(); packetStart += rays.size()) {
+        const size_t numActive = std::min(rays.size(), data.size() - packetStart);
+        if (numActive < EMBREE_PACKET_MIN_ACTIVE_RAYS) {
+            for (size_t i = packetStart; i < packetStart + numActive; i++) {
+                auto& [ray, si, state, insertHandle] = data[i];
+                intersectInternal(scene, ray, si);
+            }
+            continue;
+        }
 
-    RTCIntersectContext context;
-    rtcInitIntersectContext(&context);
-    rtcOccluded1(scene, &context, &embreeRay);
+        for (size_t lane = 0; lane < numActive; lane++)
+            rays[lane] = std::get<0>(data[packetStart + lane]);
+        detail::intersectEmbreePacket(scene, std::span(rays.data(), numActive), std::span(embreeRayHits.data(), numActive));
 
-    ray.tfar = embreeRay.tfar;
+        for (size_t lane = 0; lane < numActive; lane++) {
+            auto& [ray, si, state, insertHandle] = data[packetStart + lane];
+            processEmbreeHit(scene, embreeRayHits[lane], ray, si);
+        }
+    }
+}
 
-    static constexpr float minInf = -std::numeric_limits<float>::infinity();
-    return embreeRay.tfar == minInf;
+template <typename HitRayState, typename AnyHitRayState>
+void BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersectAnyPacketInternal(
+    RTCScene scene, std::span<IntersectAnyItem> data, std::span<uint32_t> hits) const
+{
+    assert(hits.size() == data.size());
+
+    std::array<Ray, detail::embreePacketSize> rays;
+    std::array<float, detail::embreePacketSize> tfars;
+    for (size_t packetStart = 0; packetStart < data.size(); packetStart += rays.size()) {
+        const size_t numActive = std::min(rays.size(), data.size() - packetStart);
+        if (numActive < EMBREE_PACKET_MIN_ACTIVE_RAYS) {
+            for (size_t i = packetStart; i < packetStart + numActive; i++) {
+                auto& [ray, state, insertHandle] = data[i];
+                hits[i] = intersectAnyInternal(scene, ray);
+            }
+            continue;
+        }
+
+        for (size_t lane = 0; lane < numActive; lane++)
+            rays[lane] = std::get<0>(data[packetStart + lane]);
+        detail::occludedEmbreePacket(scene, std::span(rays.data(), numActive), std::span(tfars.data(), numActive));
+
+        static constexpr float minInf = -std::numeric_limits<float>::infinity();
+        for (size_t lane = 0; lane < numActive; lane++) {
+            Ray& ray = std::get<0>(data[packetStart + lane]);
+            ray.tfar = tfars[lane];
+            hits[packetStart + lane] = (tfars[lane] == minInf);
+        }
+    }
 }
 
 template <typename HitRayState, typename AnyHitRayState>
@@ -495,8 +750,24 @@ inline BatchingAccelerationStructure<HitRayState, AnyHitRayState> BatchingAccele
     spdlog::info("Creating BVH for instanced geometry");
     auto embreeInstanceScene = detail::buildInstanceEmbreeScene(*m_pScene, embreeDevice);
 
-    spdlog::info("Splitting unique SceneObjects into (roughly) equally sized groups");
-    auto sceneObjectGroups = detail::createSceneObjectGroups(*m_pScene, m_primitivesPerBatchingPoint, embreeDevice);
+    // Reuse the batching points & SVDAGs of an earlier run if the scene bundle matches the (preprocessed) scene
+    std::optional<SceneBundle> sceneBundle;
+    SceneBundle::Key sceneBundleKey = 0;
+    std::optional<SceneBundle::Contents> sceneBundleContents;
+    if (!m_sceneBundleFile.empty()) {
+        sceneBundle.emplace(m_sceneBundleFile);
+        sceneBundleKey = SceneBundle::computeKey(*m_pScene, m_sceneFile, m_primitivesPerBatchingPoint, m_svdagRes);
+        sceneBundleContents = sceneBundle->load(sceneBundleKey, *m_pScene);
+    }
+    const bool storeSceneBundle = sceneBundle && !sceneBundleContents;
+
+    std::vector<std::vector<const SceneObject*>> sceneObjectGroups;
+    if (sceneBundleContents) {
+        sceneObjectGroups = std::move(sceneBundleContents->sceneObjectGroups);
+    } else {
+        spdlog::info("Splitting unique SceneObjects into (roughly) equally sized groups");
+        sceneObjectGroups = detail::createSceneObjectGroups(*m_pScene, m_primitivesPerBatchingPoint, embreeDevice);
+    }
 
     std::for_each(std::execution::par, std::begin(sceneObjectGroups), std::end(sceneObjectGroups),
         [&](const std::vector<const SceneObject*>& sceneObjects) {
@@ -509,50 +780,65 @@ inline BatchingAccelerationStructure<HitRayState, AnyHitRayState> BatchingAccele
     using BatchingPointT = typename BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint;
     std::vector<BatchingPointT> batchingPoints;
     if (m_svdagRes > 0) {
-        spdlog::info("Loading shapes and creating SVOs");
         std::vector<std::optional<SparseVoxelDAG>> svdags { sceneObjectGroups.size() };
+        if (sceneBundleContents) {
+            ALWAYS_ASSERT(sceneBundleContents->svdags.size() == sceneObjectGroups.size());
+            std::move(std::begin(sceneBundleContents->svdags), std::end(sceneBundleContents->svdags), std::begin(svdags));
+        } else {
+            spdlog::info("Loading shapes and creating SVOs");
 
-        using clock = std::chrono::high_resolution_clock;
-        {
-            auto start = clock::now();
-            std::transform(std::execution::par, std::begin(sceneObjectGroups), std::end(sceneObjectGroups), std::begin(svdags),
-                [&](const std::vector<const SceneObject*>& sceneObjects) {
-                    // Disable for benchmarking
-                    std::vector<tasking::CachedPtr<Shape>> shapeOwners { sceneObjects.size() };
-                    std::transform(std::begin(sceneObjects), std::end(sceneObjects), std::begin(shapeOwners), [&](const SceneObject* pSceneObject) {
-                        return m_pGeometryCache->makeResident(pSceneObject->pShape.get());
+            using clock = std::chrono::high_resolution_clock;
+            {
+                auto start = clock::now();
+                std::transform(std::execution::par, std::begin(sceneObjectGroups), std::end(sceneObjectGroups), std::begin(svdags),
+                    [&](const std::vector<const SceneObject*>& sceneObjects) {
+                        // Disable for benchmarking
+                        std::vector<tasking::CachedPtr<Shape>> shapeOwners { sceneObjects.size() };
+                        std::transform(std::begin(sceneObjects), std::end(sceneObjects), std::begin(shapeOwners), [&](const SceneObject* pSceneObject) {
+                            return m_pGeometryCache->makeResident(pSceneObject->pShape.get());
+                        });
+
+                        // Voxelize and create SVO in parallel
+                        return detail::createSVDAGfromSceneObjects(sceneObjects, m_svdagRes);
                     });
+                auto end = clock::now();
+                auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+                spdlog::info("Wall clock time to create voxelize and create SVOs: {} microseconds", diff.count());
+            }
 
-                    // Voxelize and create SVO in parallel
-                    return detail::createSVDAGfromSceneObjects(sceneObjects, m_svdagRes);
-                });
-            auto end = clock::now();
-            auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-            spdlog::info("Wall clock time to create voxelize and create SVOs: {} microseconds", diff.count());
-        }
+            for (const auto& svdag : svdags)
+                g_stats.memory.svdagsBeforeCompression += svdag->sizeBytes();
 
-        for (const auto& svdag : svdags)
-            g_stats.memory.svdagsBeforeCompression += svdag->sizeBytes();
-
-        spdlog::info("Compressing SVO to SVDAGs");
-        std::vector<SparseVoxelDAG*> pSvdags;
-        for (auto& svdag : svdags)
-            pSvdags.push_back(&svdag.value());
-        {
-            auto start = clock::now();
-            SparseVoxelDAG::compressDAGs(pSvdags);
-            auto end = clock::now();
-            auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-            spdlog::info("Wall clock time to compress SVOs into SVDAG: {} microseconds", diff.count());
+            spdlog::info("Compressing SVO to SVDAGs");
+            std::vector<SparseVoxelDAG*> pSvdags;
+            for (auto& svdag : svdags)
+                pSvdags.push_back(&svdag.value());
+            {
+                auto start = clock::now();
+                SparseVoxelDAG::compressDAGs(pSvdags);
+                auto end = clock::now();
+                auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+                spdlog::info("Wall clock time to compress SVOs into SVDAG: {} microseconds", diff.count());
+            }
         }
 
         for (const auto& svdag : svdags)
             g_stats.memory.svdagsAfterCompression += svdag->sizeBytes();
 
+        if (storeSceneBundle) {
+            std::vector<const SparseVoxelDAG*> pSvdags;
+            for (const auto& svdag : svdags)
+                pSvdags.push_back(&svdag.value());
+            sceneBundle->store(sceneBundleKey, *m_pScene, sceneObjectGroups, pSvdags);
+        }
+
         for (size_t i = 0; i < sceneObjectGroups.size(); i++) {
             batchingPoints.emplace_back(std::move(sceneObjectGroups[i]), std::move(*svdags[i]), m_pGeometryCache, m_pTaskGraph);
         }
     } else {
+        if (storeSceneBundle)
+            sceneBundle->store(sceneBundleKey, *m_pScene, sceneObjectGroups, {});
+
         for (auto& sceneObjects : sceneObjectGroups) {
             batchingPoints.emplace_back(std::move(sceneObjects), m_pGeometryCache, m_pTaskGraph);
         }
@@ -567,7 +853,7 @@ inline BatchingAccelerationStructure<HitRayState, AnyHitRayState> BatchingAccele
     g_stats.memory.topBVHLeafs = batchingPoints.size() * sizeof(BatchingPointT);
     spdlog::info("PausableBVH constructed");
     return BatchingAccelerationStructure<HitRayState, AnyHitRayState>(
-        embreeDevice, embreeInstanceScene, std::move(instancedShapeOwners), std::move(topLevelBVH), hitTask, missTask, anyHitTask, anyMissTask, m_pGeometryCache, m_pTaskGraph, m_botLevelBVHCacheSize);
+        embreeDevice, embreeInstanceScene, std::move(instancedShapeOwners), std::move(topLevelBVH), hitTask, missTask, anyHitTask, anyMissTask, m_pGeometryCache, m_pTaskGraph, m_botLevelBVHCacheSize, m_sortRays);
 }
 
 template <typename HitRayState, typename AnyHitRayState>
@@ -576,12 +862,13 @@ inline BatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingAccel
     PauseableBVH4<BatchingPoint, HitRayState, AnyHitRayState>&& topLevelBVH,
     tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>> hitTask, tasking::TaskHandle<std::tuple<Ray, HitRayState>> missTask,
     tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyHitTask, tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyMissTask,
-    tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, size_t embreeSceneCacheSize)
+    tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, size_t embreeSceneCacheSize, bool sortRays)
     : m_embreeDevice(embreeDevice)
     , m_instanceScene(instanceScene)
     , m_instancedShapeOwners(std::move(instancedShapeOwners))
     , m_topLevelBVH(std::move(topLevelBVH))
     , m_embreeSceneCache(embreeSceneCacheSize)
+    , m_sortRays(sortRays)
     , m_pTaskGraph(pTaskGraph)
     , m_onHitTask(hitTask)
     , m_onMissTask(missTask)
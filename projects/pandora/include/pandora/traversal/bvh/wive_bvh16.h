@@ -0,0 +1,132 @@
+#pragma once
+#include "pandora/flatbuffers/wive_bvh8_generated.h"
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/interaction.h"
+#include "pandora/traversal/bvh.h"
+#include "pandora/utility/contiguous_allocator_ts.h"
+#include "simd/simd16.h"
+#include <array>
+#include <embree3/rtcore.h>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace pandora {
+
+// 16-wide variant of WiVeBVH8 for CPUs with AVX512 (see simd/simd16.h). Halves the number of traversal steps compared to
+// WiVeBVH8 at the cost of larger nodes. Serialized using the same flatbuffers table as WiVeBVH8.
+template <typename LeafObj>
+class WiVeBVH16 {
+public:
+    WiVeBVH16(const serialization::WiVeBVH8* serialized, std::span<const LeafObj> objects);
+    WiVeBVH16(WiVeBVH16&&) = default;
+    virtual ~WiVeBVH16() = default;
+
+    flatbuffers::Offset<serialization::WiVeBVH8> serialize(flatbuffers::FlatBufferBuilder& builder) const;
+
+    size_t sizeBytes() const;
+
+    bool intersect(Ray& ray, SurfaceInteraction& si) const;
+    bool intersectAny(Ray& rays) const;
+
+    // Ray stream traversal: each node is tested against all rays of the batch that reached it so that the
+    // node is only fetched once per batch instead of once per ray.
+    void intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const;
+    void intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const;
+
+    std::span<const LeafObj> leafs() const;
+
+    // Format of the serialized BVH. The version must match WiVeBVH8 because both are stored in the same flatbuffers table.
+    constexpr static uint32_t serializationVersion = 1;
+    constexpr static uint32_t branchingFactor = 16;
+    constexpr static bool quantizedNodes = false;
+
+protected:
+    WiVeBVH16(uint32_t numPrims);
+
+protected:
+    virtual void commit(std::span<RTCBuildPrimitive> embreePrims, std::span<LeafObj> objects) = 0;
+
+    // Same handle encoding as WiVeBVH8:
+    // [flags+prim count (3 bits) - handle (29 bits)]
+    static uint32_t compressHandleInner(uint32_t handle);
+    static uint32_t compressHandleLeaf(uint32_t handle, uint32_t primCount);
+    static uint32_t compressHandleEmpty();
+    static bool isLeafNode(uint32_t compressedHandle);
+    static bool isInnerNode(uint32_t compressedHandle);
+    static bool isEmptyNode(uint32_t compressedHandle);
+    static uint32_t decompressNodeHandle(uint32_t compressedHandle);
+    static uint32_t leafNodePrimitiveCount(uint32_t compressedHandle);
+
+    // 4 bits per child index (instead of 3 in WiVeBVH8) so that the permutations of all 8 octants fill 32 bits
+    static uint32_t signShiftAmount(bool posX, bool posY, bool posZ);
+
+protected:
+    struct BVHNode;
+
+private:
+    struct SIMDRay;
+    void intersectChildBounds(const BVHNode* n, const SIMDRay& ray, simd::vec16_f32& outTMin, simd::vec16_f32& outTMax) const;
+    uint32_t intersectInnerNode(const BVHNode* n, const SIMDRay& ray, simd::vec16_u32& outChildren, simd::vec16_f32& outDistances) const;
+    uint32_t intersectInnerNodeMask(const BVHNode* n, const SIMDRay& ray) const;
+    template <typename LeafFunc>
+    void traverseStream(std::span<const Ray> rays, LeafFunc&& leafFunc) const;
+
+    struct StreamRay {
+        glm::vec3 invDirection;
+        uint32_t signShiftAmount;
+    };
+    struct StackItem {
+        uint32_t compressedNodeHandle;
+        uint32_t firstActiveRay; // Offset into activeRayIDs
+        uint32_t numActiveRays;
+    };
+    // Reused (per thread) by traverseStream so that traversing a batch does not allocate once the buffers are large enough
+    struct StreamTraversalBuffers {
+        std::vector<StreamRay> streamRays;
+        std::vector<uint32_t> activeRayIDs;
+        std::vector<StackItem> stack;
+        std::vector<uint16_t> childMasks;
+        bool inUse { false }; // Guards against a nested stream traversal on the same thread
+    };
+    bool intersectLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray, SurfaceInteraction& si) const;
+    bool intersectAnyLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray) const;
+
+protected:
+    struct alignas(64) BVHNode { // 512 bytes (8 cache lines)
+        simd::vec16_f32 minX; // 64 bytes
+        simd::vec16_f32 maxX; // 64 bytes
+        simd::vec16_f32 minY; // 64 bytes
+        simd::vec16_f32 maxY; // 64 bytes
+        simd::vec16_f32 minZ; // 64 bytes
+        simd::vec16_f32 maxZ; // 64 bytes
+        simd::vec16_u32 children; // Child indices
+        simd::vec16_u32 permutationOffsets; // Per child: 8 octants * 4 bits
+    };
+
+    ContiguousAllocatorTS<BVHNode> m_innerNodeAllocator;
+    ContiguousAllocatorTS<uint32_t> m_leafIndexAllocator;
+    std::vector<LeafObj> m_leafObjects;
+
+    uint32_t m_compressedRootHandle = 0;
+
+private:
+    struct SIMDRay {
+        simd::vec16_f32 originX;
+        simd::vec16_f32 originY;
+        simd::vec16_f32 originZ;
+
+        simd::vec16_f32 invDirectionX;
+        simd::vec16_f32 invDirectionY;
+        simd::vec16_f32 invDirectionZ;
+
+        simd::vec16_f32 tnear;
+        simd::vec16_f32 tfar;
+        simd::vec16_u32 raySignShiftAmount;
+    };
+};
+
+}
+
+#include "wive_bvh16_impl.h"
@@ -0,0 +1,28 @@
+#pragma once
+#include "wive_bvh16.h"
+#include <variant>
+
+namespace pandora {
+
+template <typename LeafObj>
+class WiVeBVH16Build16 : public WiVeBVH16<LeafObj> {
+public:
+    using WiVeBVH16<LeafObj>::WiVeBVH16;
+    WiVeBVH16Build16(std::span<LeafObj> objects);
+    WiVeBVH16Build16(WiVeBVH16Build16<LeafObj>&&) = default;
+
+    WiVeBVH16Build16<LeafObj>& operator=(WiVeBVH16Build16<LeafObj>&&) = default;
+
+protected:
+    void commit(std::span<RTCBuildPrimitive> embreePrims, std::span<LeafObj> objects) override final;
+
+private:
+    static void* innerNodeCreate(RTCThreadLocalAllocator alloc, unsigned numChildren, void* userPtr);
+    static void innerNodeSetChildren(void* nodePtr, void** childPtr, unsigned numChildren, void* userPtr);
+    static void innerNodeSetBounds(void* nodePtr, const RTCBounds** bounds, unsigned numChildren, void* userPtr);
+    static void* leafCreate(RTCThreadLocalAllocator alloc, const RTCBuildPrimitive* prims, size_t numPrims, void* userPtr);
+};
+
+}
+
+#include "wive_bvh16_build16_impl.h"
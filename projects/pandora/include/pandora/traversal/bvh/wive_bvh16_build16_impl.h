@@ -0,0 +1,183 @@
+#include "pandora/utility/error_handling.h"
+#include "wive_bvh8_build8.h" // WiVeBVH8Build8_embreeBVH()
+#include <numeric>
+
+namespace pandora {
+
+template <typename LeafObj>
+inline WiVeBVH16Build16<LeafObj>::WiVeBVH16Build16(std::span<LeafObj> objects)
+    : WiVeBVH16<LeafObj>(static_cast<uint32_t>(objects.size()))
+{
+    // Move the leaf objects
+    this->m_leafObjects.reserve(objects.size());
+    for (auto& object : objects) {
+        this->m_leafObjects.emplace_back(std::move(object));
+    }
+    this->m_leafObjects.shrink_to_fit();
+
+    std::vector<RTCBuildPrimitive> embreePrimitives;
+    embreePrimitives.reserve(static_cast<size_t>(objects.size()));
+
+    ALWAYS_ASSERT(objects.size() < std::numeric_limits<unsigned>::max());
+
+    for (uint64_t leafID = 0; leafID < static_cast<uint64_t>(this->m_leafObjects.size()); leafID++) {
+        auto bounds = this->m_leafObjects[leafID].getBounds(); // NOTE: use the local objects and not the original "objects" array (because its contents has been moved)
+
+        RTCBuildPrimitive primitive;
+        primitive.lower_x = bounds.min.x;
+        primitive.lower_y = bounds.min.y;
+        primitive.lower_z = bounds.min.z;
+        primitive.upper_x = bounds.max.x;
+        primitive.upper_y = bounds.max.y;
+        primitive.upper_z = bounds.max.z;
+        primitive.primID = leafID;
+        primitive.geomID = 0;
+        embreePrimitives.push_back(primitive);
+    }
+
+    commit(embreePrimitives, objects);
+}
+
+template <typename LeafObj>
+inline void WiVeBVH16Build16<LeafObj>::commit(std::span<RTCBuildPrimitive> embreePrims, std::span<LeafObj> objects)
+{
+    RTCBVH bvh = WiVeBVH8Build8_embreeBVH(); // Shares the Embree device with the 8-wide builder
+
+    RTCBuildArguments arguments = rtcDefaultBuildArguments();
+    arguments.byteSize = sizeof(arguments);
+    arguments.buildFlags = RTC_BUILD_FLAG_NONE;
+    arguments.buildQuality = RTC_BUILD_QUALITY_MEDIUM;
+    arguments.maxBranchingFactor = 16; // Maximum supported by the Embree BVH builder
+    arguments.minLeafSize = 1;
+    arguments.maxLeafSize = 4;
+    arguments.bvh = bvh;
+    arguments.primitives = embreePrims.data();
+    arguments.primitiveCount = embreePrims.size();
+    arguments.primitiveArrayCapacity = embreePrims.size();
+    arguments.createNode = innerNodeCreate;
+    arguments.setNodeChildren = innerNodeSetChildren;
+    arguments.setNodeBounds = innerNodeSetBounds;
+    arguments.createLeaf = leafCreate;
+    arguments.userPtr = this;
+
+    this->m_compressedRootHandle = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(rtcBuildBVH(&arguments)));
+
+    // Releases Embree memory (including the temporary BVH)
+    rtcReleaseBVH(bvh);
+
+    // Shrink to fit BVH allocators
+    this->m_innerNodeAllocator.compact();
+    this->m_leafIndexAllocator.compact();
+}
+
+template <typename LeafObj>
+inline void* WiVeBVH16Build16<LeafObj>::innerNodeCreate(RTCThreadLocalAllocator alloc, unsigned numChildren, void* userPtr)
+{
+    assert(numChildren <= 16);
+
+    // Allocate node
+    auto* self = reinterpret_cast<WiVeBVH16Build16<LeafObj>*>(userPtr);
+    auto [nodeHandle, nodePtr] = self->m_innerNodeAllocator.allocate();
+    (void)nodePtr;
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(WiVeBVH16<LeafObj>::compressHandleInner(nodeHandle)));
+}
+
+template <typename LeafObj>
+inline void WiVeBVH16Build16<LeafObj>::innerNodeSetChildren(void* p, void** childPtr, unsigned numChildren, void* userPtr)
+{
+    assert(numChildren <= 16);
+
+    uint32_t nodeHandle = WiVeBVH16<LeafObj>::decompressNodeHandle(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(p)));
+    auto* self = reinterpret_cast<WiVeBVH16Build16<LeafObj>*>(userPtr);
+    typename WiVeBVH16<LeafObj>::BVHNode& node = self->m_innerNodeAllocator.get(nodeHandle);
+
+    std::array<uint32_t, 16> children;
+    for (unsigned childID = 0; childID < numChildren; childID++) {
+        children[childID] = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(childPtr[childID]));
+    }
+    for (unsigned childID = numChildren; childID < 16; childID++) {
+        children[childID] = WiVeBVH16<LeafObj>::compressHandleEmpty();
+    }
+    node.children.load(children);
+}
+
+template <typename LeafObj>
+inline void WiVeBVH16Build16<LeafObj>::innerNodeSetBounds(void* p, const RTCBounds** bounds, unsigned numChildren, void* userPtr)
+{
+    assert(numChildren <= 16);
+
+    uint32_t nodeHandle = WiVeBVH16<LeafObj>::decompressNodeHandle(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(p)));
+    auto* self = reinterpret_cast<WiVeBVH16Build16<LeafObj>*>(userPtr);
+    typename WiVeBVH16<LeafObj>::BVHNode& node = self->m_innerNodeAllocator.get(nodeHandle);
+
+    std::array<float, 16> minX, minY, minZ, maxX, maxY, maxZ;
+    std::array<uint32_t, 16> permutationOffsets;
+    for (unsigned childID = 0; childID < numChildren; childID++) {
+        const RTCBounds* childBounds = bounds[childID];
+        minX[childID] = childBounds->lower_x;
+        minY[childID] = childBounds->lower_y;
+        minZ[childID] = childBounds->lower_z;
+        maxX[childID] = childBounds->upper_x;
+        maxY[childID] = childBounds->upper_y;
+        maxZ[childID] = childBounds->upper_z;
+    }
+    for (unsigned i = numChildren; i < 16; i++) {
+        minX[i] = minY[i] = minZ[i] = maxX[i] = maxY[i] = maxZ[i] = 0.0f;
+    }
+
+    // Create permutations
+    std::fill(std::begin(permutationOffsets), std::end(permutationOffsets), 0);
+    for (int x = -1; x <= 1; x += 2) {
+        for (int y = -1; y <= 1; y += 2) {
+            for (int z = -1; z <= 1; z += 2) {
+                glm::vec3 direction(x, y, z);
+
+                std::array<uint32_t, 16> indices;
+                std::iota(std::begin(indices), std::end(indices), 0u);
+                std::array<float, 16> distances;
+                std::transform(std::begin(indices), std::end(indices), std::begin(distances), [&](uint32_t i) -> float {
+                    if (i >= numChildren)
+                        return std::numeric_limits<float>::max();
+
+                    // Calculate the bounding box corner opposite to the direction vector
+                    const RTCBounds* childBounds = bounds[i];
+                    glm::vec3 extremePoint(
+                        x == -1 ? childBounds->lower_x : childBounds->upper_x,
+                        y == -1 ? childBounds->lower_y : childBounds->upper_y,
+                        z == -1 ? childBounds->lower_z : childBounds->upper_z);
+                    return glm::dot(extremePoint, direction);
+                });
+                // Sort bounding boxes back-to-front as seen from the normal plane of the direction vector
+                std::sort(std::begin(indices), std::end(indices), [&](uint32_t a, uint32_t b) -> bool {
+                    return distances[a] > distances[b];
+                });
+
+                uint32_t shiftAmount = WiVeBVH16<LeafObj>::signShiftAmount(x > 0, y > 0, z > 0);
+                for (int i = 0; i < 16; i++)
+                    permutationOffsets[i] |= indices[i] << shiftAmount;
+            }
+        }
+    }
+
+    node.minX.load(minX);
+    node.minY.load(minY);
+    node.minZ.load(minZ);
+    node.maxX.load(maxX);
+    node.maxY.load(maxY);
+    node.maxZ.load(maxZ);
+    node.permutationOffsets.load(permutationOffsets);
+}
+
+template <typename LeafObj>
+inline void* WiVeBVH16Build16<LeafObj>::leafCreate(RTCThreadLocalAllocator alloc, const RTCBuildPrimitive* prims, size_t numPrims, void* userPtr)
+{
+    assert(numPrims > 0 && numPrims <= 4);
+
+    // Allocate node
+    auto* self = reinterpret_cast<WiVeBVH16Build16<LeafObj>*>(userPtr);
+    auto [nodeHandle, nodePtr] = self->m_leafIndexAllocator.allocateNInitF((unsigned)numPrims, [&](int i) {
+        return prims[i].primID;
+    });
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(WiVeBVH16<LeafObj>::compressHandleLeaf(nodeHandle, (uint32_t)numPrims)));
+}
+}
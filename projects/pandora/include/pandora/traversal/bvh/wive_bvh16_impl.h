@@ -0,0 +1,459 @@
+#include "pandora/flatbuffers/wive_bvh8_generated.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include "wive_bvh16.h"
+
+namespace pandora {
+
+template <typename LeafObj>
+inline WiVeBVH16<LeafObj>::WiVeBVH16(uint32_t numPrims)
+    : m_innerNodeAllocator(std::max(16u, numPrims / 2), 16)
+    , m_leafIndexAllocator(numPrims + numPrims / 2)
+{
+}
+
+template <typename LeafObj>
+inline WiVeBVH16<LeafObj>::WiVeBVH16(const serialization::WiVeBVH8* serialized, std::span<const LeafObj> leafs)
+    : m_innerNodeAllocator(serialized->innerNodeAllocator())
+    , m_leafIndexAllocator(serialized->leafIndexAllocator())
+{
+    ALWAYS_ASSERT(serialized->version() == serializationVersion, "Serialized BVH was created by a different version of WiVeBVH16");
+    ALWAYS_ASSERT(serialized->branchingFactor() == branchingFactor, "Serialized BVH is not a WiVeBVH16");
+    ALWAYS_ASSERT(serialized->quantizedNodes() == quantizedNodes, "WiVeBVH16 does not support quantized nodes");
+    m_compressedRootHandle = serialized->compressedRootHandle();
+
+    size_t numNodesGiven = leafs.size();
+    size_t numNodesSerialized = serialized->numLeafObjects();
+    assert(numNodesGiven > 0);
+    assert(m_leafObjects.empty());
+    ALWAYS_ASSERT(numNodesGiven == numNodesSerialized, "Number of leaf objects does not match that of the serialized BVH");
+
+    m_leafObjects.reserve(leafs.size());
+    std::copy(std::begin(leafs), std::end(leafs), std::back_inserter(m_leafObjects));
+}
+
+template <typename LeafObj>
+inline flatbuffers::Offset<serialization::WiVeBVH8> WiVeBVH16<LeafObj>::serialize(flatbuffers::FlatBufferBuilder& builder) const
+{
+    auto serializedInnerNodeAllocator = m_innerNodeAllocator.serialize(builder);
+    auto serializedLeafIndexAllocator = m_leafIndexAllocator.serialize(builder);
+    assert(!this->m_leafObjects.empty());
+    return serialization::CreateWiVeBVH8(
+        builder,
+        serializedInnerNodeAllocator,
+        serializedLeafIndexAllocator,
+        m_compressedRootHandle,
+        this->m_leafObjects.size(),
+        serializationVersion,
+        quantizedNodes,
+        branchingFactor);
+}
+
+template <typename LeafObj>
+inline size_t WiVeBVH16<LeafObj>::sizeBytes() const
+{
+    return sizeof(decltype(*this)) + m_innerNodeAllocator.sizeBytes() + m_leafIndexAllocator.sizeBytes();
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::intersect(Ray& ray, SurfaceInteraction& si) const
+{
+    bool hit = false;
+
+    SIMDRay simdRay;
+    simdRay.originX = simd::vec16_f32(ray.origin.x);
+    simdRay.originY = simd::vec16_f32(ray.origin.y);
+    simdRay.originZ = simd::vec16_f32(ray.origin.z);
+    simdRay.invDirectionX = simd::vec16_f32(1.0f / ray.direction.x);
+    simdRay.invDirectionY = simd::vec16_f32(1.0f / ray.direction.y);
+    simdRay.invDirectionZ = simd::vec16_f32(1.0f / ray.direction.z);
+    simdRay.tnear = simd::vec16_f32(ray.tnear);
+    simdRay.tfar = simd::vec16_f32(ray.tfar);
+    simdRay.raySignShiftAmount = simd::vec16_u32(signShiftAmount(ray.direction.x > 0, ray.direction.y > 0, ray.direction.z > 0));
+
+    // Stack (with room to store 16 children past the last entry)
+    alignas(64) std::array<uint32_t, 256> stackCompressedNodeHandles;
+    alignas(64) std::array<float, 256> stackDistances;
+    std::fill(std::begin(stackDistances), std::end(stackDistances), std::numeric_limits<float>::max());
+    size_t stackPtr = 0;
+
+    // Push root node onto the stack
+    stackCompressedNodeHandles[stackPtr] = m_compressedRootHandle;
+    stackDistances[stackPtr] = 0.0f;
+    stackPtr++;
+
+    while (stackPtr > 0) {
+        stackPtr--;
+        uint32_t compressedNodeHandle = stackCompressedNodeHandles[stackPtr];
+
+        uint32_t handle = decompressNodeHandle(compressedNodeHandle);
+        if (isInnerNode(compressedNodeHandle)) {
+            // Inner node
+            const auto* node = &m_innerNodeAllocator.get(handle);
+            simd::vec16_u32 childrenSIMD;
+            simd::vec16_f32 distancesSIMD;
+            uint32_t numChildren = intersectInnerNode(node, simdRay, childrenSIMD, distancesSIMD);
+
+            if (numChildren > 0) {
+                assert(stackPtr + 16 <= stackCompressedNodeHandles.size());
+                childrenSIMD.store(std::span(stackCompressedNodeHandles.data() + stackPtr, 16));
+                distancesSIMD.store(std::span(stackDistances.data() + stackPtr, 16));
+
+                stackPtr += numChildren;
+            }
+        } else {
+#ifndef NDEBUG
+            if (isEmptyNode(compressedNodeHandle))
+                THROW_ERROR("Empty node in traversal");
+            assert(isLeafNode(compressedNodeHandle));
+#endif
+            // Leaf node
+            if (intersectLeaf(&m_leafIndexAllocator.get(handle), leafNodePrimitiveCount(compressedNodeHandle), ray, si)) {
+                hit = true;
+                simdRay.tfar.broadcast(ray.tfar);
+
+                // Compress stack
+                size_t outStackPtr = 0;
+                for (size_t i = 0; i < stackPtr; i += 16) {
+                    simd::vec16_u32 nodesSIMD;
+                    simd::vec16_f32 distancesSIMD;
+                    distancesSIMD.loadAligned(std::span(stackDistances.data() + i, 16));
+                    nodesSIMD.loadAligned(std::span(stackCompressedNodeHandles.data() + i, 16));
+
+                    simd::mask16 distMask = distancesSIMD < simdRay.tfar;
+                    distancesSIMD = distancesSIMD.compress(distMask);
+                    nodesSIMD = nodesSIMD.compress(distMask);
+
+                    distancesSIMD.store(std::span(stackDistances.data() + outStackPtr, 16));
+                    nodesSIMD.store(std::span(stackCompressedNodeHandles.data() + outStackPtr, 16));
+
+                    size_t numItems = std::min((size_t)16, stackPtr - i);
+                    unsigned validMask = (1 << numItems) - 1;
+                    outStackPtr += distMask.count(validMask);
+                }
+                stackPtr = outStackPtr;
+            }
+        }
+    }
+
+    return hit;
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::intersectAny(Ray& ray) const
+{
+    SIMDRay simdRay;
+    simdRay.originX = simd::vec16_f32(ray.origin.x);
+    simdRay.originY = simd::vec16_f32(ray.origin.y);
+    simdRay.originZ = simd::vec16_f32(ray.origin.z);
+    simdRay.invDirectionX = simd::vec16_f32(1.0f / ray.direction.x);
+    simdRay.invDirectionY = simd::vec16_f32(1.0f / ray.direction.y);
+    simdRay.invDirectionZ = simd::vec16_f32(1.0f / ray.direction.z);
+    simdRay.tnear = simd::vec16_f32(ray.tnear);
+    simdRay.tfar = simd::vec16_f32(ray.tfar);
+    simdRay.raySignShiftAmount = simd::vec16_u32(signShiftAmount(ray.direction.x > 0, ray.direction.y > 0, ray.direction.z > 0));
+
+    // Stack (distances are not needed because traversal stops at the first hit)
+    alignas(64) std::array<uint32_t, 256> stackCompressedNodeHandles;
+    size_t stackPtr = 0;
+
+    // Push root node onto the stack
+    stackCompressedNodeHandles[stackPtr++] = m_compressedRootHandle;
+
+    while (stackPtr > 0) {
+        stackPtr--;
+        uint32_t compressedNodeHandle = stackCompressedNodeHandles[stackPtr];
+
+        uint32_t handle = decompressNodeHandle(compressedNodeHandle);
+        if (isInnerNode(compressedNodeHandle)) {
+            // Inner node. Sorting is disabled since any hit will do.
+            const auto* node = &m_innerNodeAllocator.get(handle);
+            simd::vec16_f32 tmin, tmax;
+            intersectChildBounds(node, simdRay, tmin, tmax);
+
+            simd::mask16 mask = tmin <= tmax;
+            if (mask.any()) {
+                assert(stackPtr + 16 <= stackCompressedNodeHandles.size());
+                node->children.compress(mask).store(std::span(stackCompressedNodeHandles.data() + stackPtr, 16));
+                stackPtr += mask.count();
+            }
+        } else {
+#ifndef NDEBUG
+            if (isEmptyNode(compressedNodeHandle))
+                THROW_ERROR("Empty node in traversal");
+            assert(isLeafNode(compressedNodeHandle));
+#endif
+            // Leaf node
+            if (intersectAnyLeaf(&m_leafIndexAllocator.get(handle), leafNodePrimitiveCount(compressedNodeHandle), ray)) {
+                ray.tfar = -std::numeric_limits<float>::infinity();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+template <typename LeafObj>
+inline void WiVeBVH16<LeafObj>::intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const
+{
+    assert(rays.size() == surfaceInteractions.size());
+    if (rays.size() == 1) {
+        intersect(rays[0], surfaceInteractions[0]);
+        return;
+    }
+
+    traverseStream(rays, [&](const uint32_t* leafObjectIndices, uint32_t objectCount, uint32_t rayID) {
+        intersectLeaf(leafObjectIndices, objectCount, rays[rayID], surfaceInteractions[rayID]);
+    });
+}
+
+template <typename LeafObj>
+inline void WiVeBVH16<LeafObj>::intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const
+{
+    assert(rays.size() == hits.size());
+    std::fill(std::begin(hits), std::end(hits), false);
+
+    // A ray that found a hit has its tfar set to -inf, which culls it from all nodes that are visited afterwards.
+    traverseStream(rays, [&](const uint32_t* leafObjectIndices, uint32_t objectCount, uint32_t rayID) {
+        Ray& ray = rays[rayID];
+        if (!hits[rayID] && intersectAnyLeaf(leafObjectIndices, objectCount, ray)) {
+            ray.tfar = -std::numeric_limits<float>::infinity();
+            hits[rayID] = true;
+        }
+    });
+}
+
+template <typename LeafObj>
+template <typename LeafFunc>
+inline void WiVeBVH16<LeafObj>::traverseStream(std::span<const Ray> rays, LeafFunc&& leafFunc) const
+{
+    // NOTE: leafFunc must not start another stream traversal on the same thread (it would reuse the same buffers)
+    thread_local StreamTraversalBuffers buffers;
+    assert(!buffers.inUse);
+    buffers.inUse = true;
+    auto& streamRays = buffers.streamRays;
+    auto& activeRayIDs = buffers.activeRayIDs;
+    auto& stack = buffers.stack;
+    auto& childMasks = buffers.childMasks;
+    streamRays.clear();
+    activeRayIDs.clear();
+    stack.clear();
+    streamRays.reserve(rays.size());
+    activeRayIDs.reserve(4 * rays.size());
+    for (uint32_t rayID = 0; rayID < static_cast<uint32_t>(rays.size()); rayID++) {
+        const glm::vec3 direction = rays[rayID].direction;
+        streamRays.push_back(StreamRay {
+            1.0f / direction,
+            signShiftAmount(direction.x > 0, direction.y > 0, direction.z > 0) });
+        activeRayIDs.push_back(rayID);
+    }
+
+    stack.push_back(StackItem { m_compressedRootHandle, 0, static_cast<uint32_t>(rays.size()) });
+
+    while (!stack.empty()) {
+        const StackItem item = stack.back();
+        stack.pop_back();
+
+        // The ray lists of items that were pushed after this one have been processed already (LIFO) so their space can be reused.
+        activeRayIDs.resize(item.firstActiveRay + item.numActiveRays);
+
+        const uint32_t handle = decompressNodeHandle(item.compressedNodeHandle);
+        if (isInnerNode(item.compressedNodeHandle)) {
+            const auto* node = &m_innerNodeAllocator.get(handle);
+
+            // Test all active rays against the children of this node (which stays in cache while doing so).
+            std::array<uint32_t, 16> childNumRays;
+            std::fill(std::begin(childNumRays), std::end(childNumRays), 0);
+            childMasks.resize(item.numActiveRays);
+            for (uint32_t i = 0; i < item.numActiveRays; i++) {
+                const uint32_t rayID = activeRayIDs[item.firstActiveRay + i];
+                const Ray& ray = rays[rayID];
+                const StreamRay& streamRay = streamRays[rayID];
+
+                SIMDRay simdRay;
+                simdRay.originX = simd::vec16_f32(ray.origin.x);
+                simdRay.originY = simd::vec16_f32(ray.origin.y);
+                simdRay.originZ = simd::vec16_f32(ray.origin.z);
+                simdRay.invDirectionX = simd::vec16_f32(streamRay.invDirection.x);
+                simdRay.invDirectionY = simd::vec16_f32(streamRay.invDirection.y);
+                simdRay.invDirectionZ = simd::vec16_f32(streamRay.invDirection.z);
+                simdRay.tnear = simd::vec16_f32(ray.tnear);
+                simdRay.tfar = simd::vec16_f32(ray.tfar);
+                simdRay.raySignShiftAmount = simd::vec16_u32(streamRay.signShiftAmount);
+
+                const uint32_t mask = intersectInnerNodeMask(node, simdRay);
+                childMasks[i] = static_cast<uint16_t>(mask);
+                for (uint32_t childIdx = 0; childIdx < 16; childIdx++)
+                    childNumRays[childIdx] += (mask >> childIdx) & 0x1;
+            }
+
+            // Visit children front-to-back as seen from the first ray; all rays in the batch should have a similar direction.
+            alignas(64) std::array<uint32_t, 16> children;
+            alignas(64) std::array<uint32_t, 16> permutationOffsets;
+            node->children.store(children);
+            node->permutationOffsets.store(permutationOffsets);
+            const uint32_t orderShiftAmount = streamRays[activeRayIDs[item.firstActiveRay]].signShiftAmount;
+
+            for (uint32_t i = 0; i < 16; i++) {
+                const uint32_t childIdx = (permutationOffsets[i] >> orderShiftAmount) & 0b1111;
+                if (childNumRays[childIdx] == 0)
+                    continue;
+
+                const auto firstActiveRay = static_cast<uint32_t>(activeRayIDs.size());
+                for (uint32_t j = 0; j < item.numActiveRays; j++) {
+                    if (childMasks[j] & (1u << childIdx)) {
+                        const uint32_t rayID = activeRayIDs[item.firstActiveRay + j];
+                        activeRayIDs.push_back(rayID);
+                    }
+                }
+                stack.push_back(StackItem { children[childIdx], firstActiveRay, childNumRays[childIdx] });
+            }
+        } else {
+#ifndef NDEBUG
+            if (isEmptyNode(item.compressedNodeHandle))
+                THROW_ERROR("Empty node in traversal");
+            assert(isLeafNode(item.compressedNodeHandle));
+#endif
+            const uint32_t* leafObjectIndices = &m_leafIndexAllocator.get(handle);
+            const uint32_t objectCount = leafNodePrimitiveCount(item.compressedNodeHandle);
+            for (uint32_t i = 0; i < item.numActiveRays; i++)
+                leafFunc(leafObjectIndices, objectCount, activeRayIDs[item.firstActiveRay + i]);
+        }
+    }
+
+    buffers.inUse = false;
+}
+
+template <typename LeafObj>
+inline std::span<const LeafObj> WiVeBVH16<LeafObj>::leafs() const
+{
+    return m_leafObjects;
+}
+
+template <typename LeafObj>
+inline void WiVeBVH16<LeafObj>::intersectChildBounds(const BVHNode* n, const SIMDRay& ray, simd::vec16_f32& outTMin, simd::vec16_f32& outTMax) const
+{
+    simd::vec16_f32 tx1 = (n->minX - ray.originX) * ray.invDirectionX;
+    simd::vec16_f32 tx2 = (n->maxX - ray.originX) * ray.invDirectionX;
+    simd::vec16_f32 ty1 = (n->minY - ray.originY) * ray.invDirectionY;
+    simd::vec16_f32 ty2 = (n->maxY - ray.originY) * ray.invDirectionY;
+    simd::vec16_f32 tz1 = (n->minZ - ray.originZ) * ray.invDirectionZ;
+    simd::vec16_f32 tz2 = (n->maxZ - ray.originZ) * ray.invDirectionZ;
+    simd::vec16_f32 txMin = simd::min(tx1, tx2);
+    simd::vec16_f32 tyMin = simd::min(ty1, ty2);
+    simd::vec16_f32 tzMin = simd::min(tz1, tz2);
+    simd::vec16_f32 txMax = simd::max(tx1, tx2);
+    simd::vec16_f32 tyMax = simd::max(ty1, ty2);
+    simd::vec16_f32 tzMax = simd::max(tz1, tz2);
+    outTMin = simd::max(ray.tnear, simd::max(txMin, simd::max(tyMin, tzMin)));
+    outTMax = simd::min(ray.tfar, simd::min(txMax, simd::min(tyMax, tzMax)));
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::intersectInnerNode(const BVHNode* n, const SIMDRay& ray, simd::vec16_u32& outChildren, simd::vec16_f32& outDistances) const
+{
+    simd::vec16_f32 tmin, tmax;
+    intersectChildBounds(n, ray, tmin, tmax);
+
+    const simd::vec16_u32 indexMask(0b1111);
+    simd::vec16_u32 index = (n->permutationOffsets >> ray.raySignShiftAmount) & indexMask;
+
+    tmin = tmin.permute(index);
+    tmax = tmax.permute(index);
+    simd::mask16 mask = tmin <= tmax;
+    outChildren = n->children.permute(index).compress(mask);
+    outDistances = tmin.compress(mask);
+    return mask.count();
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::intersectInnerNodeMask(const BVHNode* n, const SIMDRay& ray) const
+{
+    simd::vec16_f32 tmin, tmax;
+    intersectChildBounds(n, ray, tmin, tmax);
+
+    // Bit i is set if the ray intersects child i (in storage order, not permuted).
+    simd::mask16 mask = tmin <= tmax;
+    return static_cast<uint32_t>(mask.bitMask());
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::intersectLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray, SurfaceInteraction& si) const
+{
+    bool hit = false;
+    for (uint32_t i = 0; i < objectCount; i++) {
+        hit |= m_leafObjects[leafObjectIndices[i]].intersect(ray, si);
+    }
+    return hit;
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::intersectAnyLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray) const
+{
+    for (uint32_t i = 0; i < objectCount; i++) {
+        if (m_leafObjects[leafObjectIndices[i]].intersectAny(ray))
+            return true;
+    }
+    return false;
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::compressHandleInner(uint32_t handle)
+{
+    assert(handle < (1 << 29) - 1);
+    return (handle & ((1 << 29) - 1)) | (0b010 << 29);
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::compressHandleLeaf(uint32_t handle, uint32_t primCount)
+{
+    assert(primCount > 0 && primCount <= 4);
+    assert(handle < (1 << 29) - 1);
+    return (handle & ((1 << 29) - 1)) | ((0b100 | (primCount - 1)) << 29);
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::compressHandleEmpty()
+{
+    return 0u; // 0 | (0b000 << 29)
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::isLeafNode(uint32_t compressedHandle)
+{
+    return ((compressedHandle >> 29) & 0b100) == 0b100; // Other 2 bits are used to store the primitive count
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::isInnerNode(uint32_t compressedHandle)
+{
+    return ((compressedHandle >> 29) & 0b111) == 0b010;
+}
+
+template <typename LeafObj>
+inline bool WiVeBVH16<LeafObj>::isEmptyNode(uint32_t compressedHandle)
+{
+    return ((compressedHandle >> 29) & 0b111) == 0b000;
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::decompressNodeHandle(uint32_t compressedHandle)
+{
+    return compressedHandle & ((1u << 29) - 1);
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::leafNodePrimitiveCount(uint32_t compressedHandle)
+{
+    return ((compressedHandle >> 29) & 0b011) + 1;
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH16<LeafObj>::signShiftAmount(bool positiveX, bool positiveY, bool positiveZ)
+{
+    return ((positiveX ? 0b001 : 0u) | (positiveY ? 0b010 : 0u) | (positiveZ ? 0b100 : 0u)) * 4;
+}
+
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "pandora/config.h"
 #include "pandora/flatbuffers/wive_bvh8_generated.h"
 #include "pandora/graphics_core/bounds.h"
 #include "pandora/graphics_core/interaction.h"
@@ -11,6 +12,7 @@
 #include <memory>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace pandora {
@@ -29,8 +31,19 @@ public:
     bool intersect(Ray& ray, SurfaceInteraction& si) const;
     bool intersectAny(Ray& rays) const;
 
+    // Ray stream traversal: each node is tested against all rays of the batch that reached it so that the
+    // node is only fetched once per batch instead of once per ray.
+    void intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const;
+    void intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const;
+
     std::span<const LeafObj> leafs() const;
 
+    // Format of the serialized BVH. Increment serializationVersion whenever the layout of the serialized BVH
+    // (including the inner nodes) changes.
+    constexpr static uint32_t serializationVersion = 1;
+    constexpr static uint32_t branchingFactor = 8;
+    constexpr static bool quantizedNodes = ENABLE_QUANTIZED_BVH_NODES;
+
 protected:
     WiVeBVH8(uint32_t numPrims);
 
@@ -54,14 +67,48 @@ protected:
 
     static uint32_t signShiftAmount(bool posX, bool posY, bool posZ);
 
+    // Quantize the bounds of the children of a node along one axis (see QuantizedBVHNode). The quantized bounds are
+    // conservative: they always contain the original child bounds.
+    static void quantizeChildBounds(
+        std::span<const float, 8> childMin, std::span<const float, 8> childMax, unsigned numChildren,
+        float& outOrigin, uint8_t& outScaleExponent, std::array<uint8_t, 8>& outMin, std::array<uint8_t, 8>& outMax);
+    static float quantizationScale(uint8_t scaleExponent);
+
 protected:
     struct BVHNode;
+    struct QuantizedBVHNode;
     struct BVHLeaf;
+    using InnerNode = std::conditional_t<ENABLE_QUANTIZED_BVH_NODES, QuantizedBVHNode, BVHNode>;
+
+    // Write the bounds of the (at most 8) children of an inner node and compute its per-octant child orders
+    static void setInnerNodeBounds(InnerNode& node, std::span<const Bounds> childBounds);
 
 private:
     struct SIMDRay;
-    uint32_t intersectInnerNode(const BVHNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const;
-    uint32_t intersectAnyInnerNode(const BVHNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const;
+    void intersectChildBounds(const InnerNode* n, const SIMDRay& ray, simd::vec8_f32& outTMin, simd::vec8_f32& outTMax) const;
+    uint32_t intersectInnerNode(const InnerNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const;
+    uint32_t intersectAnyInnerNode(const InnerNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const;
+    uint32_t intersectInnerNodeMask(const InnerNode* n, const SIMDRay& ray) const;
+    template <typename LeafFunc>
+    void traverseStream(std::span<const Ray> rays, LeafFunc&& leafFunc) const;
+
+    struct StreamRay {
+        glm::vec3 invDirection;
+        uint32_t signShiftAmount;
+    };
+    struct StackItem {
+        uint32_t compressedNodeHandle;
+        uint32_t firstActiveRay; // Offset into activeRayIDs
+        uint32_t numActiveRays;
+    };
+    // Reused (per thread) by traverseStream so that traversing a batch does not allocate once the buffers are large enough
+    struct StreamTraversalBuffers {
+        std::vector<StreamRay> streamRays;
+        std::vector<uint32_t> activeRayIDs;
+        std::vector<StackItem> stack;
+        std::vector<uint8_t> childMasks;
+        bool inUse { false }; // Guards against a nested stream traversal on the same thread
+    };
     bool intersectLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray, SurfaceInteraction& si) const;
     bool intersectAnyLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray) const;
 
@@ -70,7 +117,7 @@ private:
         int maxDepth = 0;
         std::array<int, 9> numChildrenHistogram = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
     };
-    void testBVHRecurse(const BVHNode* node, int depth, TestBVHData& out) const;
+    void testBVHRecurse(const InnerNode* node, int depth, TestBVHData& out) const;
 
 protected:
     struct alignas(64) BVHNode { // 256 bytes (4 cache lines)
@@ -85,9 +132,26 @@ protected:
         simd::vec8_u32 permutationOffsets; // 3 bytes. Can use the other byte for flags but storing it on the stack during traversal is expensive.
     };
 
+    // Child bounds are stored as 8-bit integers relative to the bounds of the node (compressed wide BVH, Ylitie et al. 2017):
+    //  childMin = origin + qMin * 2^(scaleExponent - 127)
+    // The power-of-two scale makes decoding exact so the conservative rounding done when quantizing is preserved.
+    struct alignas(64) QuantizedBVHNode { // 128 bytes (2 cache lines)
+        simd::vec8_u32 children; // 32 bytes
+        simd::vec8_u32 permutationOffsets; // 32 bytes
+        std::array<uint8_t, 8> minX; // 8 bytes
+        std::array<uint8_t, 8> maxX; // 8 bytes
+        std::array<uint8_t, 8> minY; // 8 bytes
+        std::array<uint8_t, 8> maxY; // 8 bytes
+        std::array<uint8_t, 8> minZ; // 8 bytes
+        std::array<uint8_t, 8> maxZ; // 8 bytes
+        std::array<float, 3> origin; // 12 bytes
+        std::array<uint8_t, 3> scaleExponents; // 3 bytes (biased like the exponent of a float)
+    };
+    static_assert(sizeof(QuantizedBVHNode) == 128);
+
     constexpr static uint32_t emptyHandle = 0xFFFFFFFF;
 
-    ContiguousAllocatorTS<typename WiVeBVH8<LeafObj>::BVHNode> m_innerNodeAllocator;
+    ContiguousAllocatorTS<InnerNode> m_innerNodeAllocator;
     ContiguousAllocatorTS<uint32_t> m_leafIndexAllocator;
     std::vector<LeafObj> m_leafObjects;
 
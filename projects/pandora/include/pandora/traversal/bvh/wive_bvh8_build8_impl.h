@@ -133,7 +133,7 @@ inline void WiVeBVH8Build8<LeafObj>::innerNodeSetChildren(void* p, void** childP
 
     uint32_t nodeHandle = WiVeBVH8<LeafObj>::decompressNodeHandle(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(p)));
     auto* self = reinterpret_cast<WiVeBVH8Build8<LeafObj>*>(userPtr);
-    typename WiVeBVH8<LeafObj>::BVHNode& node = self->m_innerNodeAllocator.get(nodeHandle);
+    typename WiVeBVH8<LeafObj>::InnerNode& node = self->m_innerNodeAllocator.get(nodeHandle);
 
     std::array<uint32_t, 8> children;
     for (unsigned childID = 0; childID < numChildren; childID++) {
@@ -152,63 +152,13 @@ inline void WiVeBVH8Build8<LeafObj>::innerNodeSetBounds(void* p, const RTCBounds
 
     uint32_t nodeHandle = WiVeBVH8<LeafObj>::decompressNodeHandle(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(p)));
     auto* self = reinterpret_cast<WiVeBVH8Build8<LeafObj>*>(userPtr);
-    typename WiVeBVH8<LeafObj>::BVHNode& node = self->m_innerNodeAllocator.get(nodeHandle);
+    typename WiVeBVH8<LeafObj>::InnerNode& node = self->m_innerNodeAllocator.get(nodeHandle);
 
-    std::array<float, 8> minX, minY, minZ, maxX, maxY, maxZ;
-    std::array<uint32_t, 8> permutationOffsets;
+    std::array<Bounds, 8> childBounds;
     for (unsigned childID = 0; childID < numChildren; childID++) {
-        const RTCBounds* childBounds = bounds[childID];
-        minX[childID] = childBounds->lower_x;
-        minY[childID] = childBounds->lower_y;
-        minZ[childID] = childBounds->lower_z;
-        maxX[childID] = childBounds->upper_x;
-        maxY[childID] = childBounds->upper_y;
-        maxZ[childID] = childBounds->upper_z;
+        childBounds[childID] = Bounds(*bounds[childID]);
     }
-    for (unsigned i = numChildren; i < 8; i++) {
-        minX[i] = minY[i] = minZ[i] = maxX[i] = maxY[i] = maxZ[i] = 0.0f;
-    }
-
-    // Create permutations
-    std::fill(std::begin(permutationOffsets), std::end(permutationOffsets), 0);
-    for (int x = -1; x <= 1; x += 2) {
-        for (int y = -1; y <= 1; y += 2) {
-            for (int z = -1; z <= 1; z += 2) {
-                glm::vec3 direction(x, y, z);
-
-                std::array<uint32_t, 8> indices = { 0, 1, 2, 3, 4, 5, 6, 7 };
-                std::array<float, 8> distances;
-                std::transform(std::begin(indices), std::end(indices), std::begin(distances), [&](uint32_t i) -> float {
-                    if (i >= numChildren)
-                        return std::numeric_limits<float>::max();
-
-                    // Calculate the bounding box corner opposite to the direction vector
-                    const RTCBounds* childBounds = bounds[i];
-                    glm::vec3 extremePoint(
-                        x == -1 ? childBounds->lower_x : childBounds->upper_x,
-                        y == -1 ? childBounds->lower_y : childBounds->upper_y,
-                        z == -1 ? childBounds->lower_z : childBounds->upper_z);
-                    return glm::dot(extremePoint, direction);
-                });
-                // Sort bounding boxes back-to-front as seen from the normal plane of the direction vector
-                std::sort(std::begin(indices), std::end(indices), [&](uint32_t a, uint32_t b) -> bool {
-                    return distances[a] > distances[b];
-                });
-
-                uint32_t shiftAmount = WiVeBVH8<LeafObj>::signShiftAmount(x > 0, y > 0, z > 0);
-                for (int i = 0; i < 8; i++)
-                    permutationOffsets[i] |= indices[i] << shiftAmount;
-            }
-        }
-    }
-
-    node.minX.load(minX);
-    node.minY.load(minY);
-    node.minZ.load(minZ);
-    node.maxX.load(maxX);
-    node.maxY.load(maxY);
-    node.maxZ.load(maxZ);
-    node.permutationOffsets.load(permutationOffsets);
+    WiVeBVH8<LeafObj>::setInnerNodeBounds(node, std::span(childBounds.data(), numChildren));
 }
 
 template <typename LeafObj>
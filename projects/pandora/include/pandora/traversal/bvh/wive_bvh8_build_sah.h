@@ -0,0 +1,60 @@
+#pragma once
+#include "wive_bvh8.h"
+#include <array>
+#include <utility>
+
+namespace pandora {
+
+// Builds WiVeBVH8 inner nodes directly (without Embree) using a top-down binned SAH builder. Each node is created by
+// repeatedly splitting the child with the largest surface area until it has 8 children, which gives similar trees
+// as collapsing a binary SAH BVH. Binning & partitioning of large ranges and the construction of sub trees are
+// parallelized with TBB.
+template <typename LeafObj>
+class WiVeBVH8BuildSAH : public WiVeBVH8<LeafObj> {
+public:
+    using WiVeBVH8<LeafObj>::WiVeBVH8;
+    WiVeBVH8BuildSAH(std::span<LeafObj> objects);
+    WiVeBVH8BuildSAH(WiVeBVH8BuildSAH<LeafObj>&&) = default;
+
+    WiVeBVH8BuildSAH<LeafObj>& operator=(WiVeBVH8BuildSAH<LeafObj>&&) = default;
+
+protected:
+    void commit(std::span<RTCBuildPrimitive> embreePrims, std::span<LeafObj> objects) override final;
+
+private:
+    constexpr static uint32_t maxLeafSize = 4;
+    constexpr static int numBins = 16;
+    // Ranges with fewer primitives are binned, partitioned and built by a single thread
+    constexpr static uint32_t parallelThreshold = 4096;
+
+    // Range of primitives [begin, end) in the primitive array
+    struct BuildRange {
+        uint32_t begin, end;
+        Bounds bounds;
+        Bounds centroidBounds;
+
+        uint32_t size() const { return end - begin; }
+    };
+    struct Bin {
+        Bounds bounds;
+        Bounds centroidBounds;
+        uint32_t count = 0;
+    };
+    using Bins = std::array<std::array<Bin, numBins>, 3>;
+
+    uint32_t buildRecurse(std::span<RTCBuildPrimitive> prims, std::span<RTCBuildPrimitive> tmpPrims, const BuildRange& range);
+    uint32_t createLeaf(std::span<const RTCBuildPrimitive> prims, const BuildRange& range);
+
+    static std::pair<BuildRange, BuildRange> split(std::span<RTCBuildPrimitive> prims, std::span<RTCBuildPrimitive> tmpPrims, const BuildRange& range);
+    static std::pair<BuildRange, BuildRange> splitMedian(std::span<RTCBuildPrimitive> prims, const BuildRange& range);
+    static BuildRange computeRange(std::span<const RTCBuildPrimitive> prims, uint32_t begin, uint32_t end);
+    template <typename F>
+    static uint32_t partition(std::span<RTCBuildPrimitive> prims, std::span<RTCBuildPrimitive> tmpPrims, const BuildRange& range, F&& isLeft);
+
+    static Bounds primBounds(const RTCBuildPrimitive& prim);
+    static glm::vec3 primCentroid(const RTCBuildPrimitive& prim);
+};
+
+}
+
+#include "wive_bvh8_build_sah_impl.h"
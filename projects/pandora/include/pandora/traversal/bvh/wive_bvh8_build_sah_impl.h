@@ -0,0 +1,341 @@
+#include "pandora/utility/error_handling.h"
+#include <algorithm>
+#include <numeric>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+
+namespace pandora {
+
+template <typename LeafObj>
+inline WiVeBVH8BuildSAH<LeafObj>::WiVeBVH8BuildSAH(std::span<LeafObj> objects)
+    : WiVeBVH8<LeafObj>(static_cast<uint32_t>(objects.size()))
+{
+    // Move the leaf objects
+    this->m_leafObjects.reserve(objects.size());
+    for (auto& object : objects) {
+        this->m_leafObjects.emplace_back(std::move(object));
+    }
+    this->m_leafObjects.shrink_to_fit();
+
+    ALWAYS_ASSERT(objects.size() < std::numeric_limits<unsigned>::max());
+
+    std::vector<RTCBuildPrimitive> primitives(this->m_leafObjects.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, primitives.size()), [&](tbb::blocked_range<size_t> localRange) {
+        for (size_t leafID = localRange.begin(); leafID < localRange.end(); leafID++) {
+            auto bounds = this->m_leafObjects[leafID].getBounds(); // NOTE: use the local objects and not the original "objects" array (because its contents has been moved)
+
+            RTCBuildPrimitive& primitive = primitives[leafID];
+            primitive.lower_x = bounds.min.x;
+            primitive.lower_y = bounds.min.y;
+            primitive.lower_z = bounds.min.z;
+            primitive.upper_x = bounds.max.x;
+            primitive.upper_y = bounds.max.y;
+            primitive.upper_z = bounds.max.z;
+            primitive.primID = static_cast<unsigned>(leafID);
+            primitive.geomID = 0;
+        }
+    });
+
+    commit(primitives, objects);
+}
+
+template <typename LeafObj>
+inline void WiVeBVH8BuildSAH<LeafObj>::commit(std::span<RTCBuildPrimitive> embreePrims, std::span<LeafObj> objects)
+{
+    if (embreePrims.empty()) {
+        this->m_compressedRootHandle = WiVeBVH8<LeafObj>::compressHandleEmpty();
+        return;
+    }
+
+    // Scratch space for the parallel partitioning
+    std::vector<RTCBuildPrimitive> tmpPrims(embreePrims.size());
+
+    const BuildRange rootRange = computeRange(embreePrims, 0, static_cast<uint32_t>(embreePrims.size()));
+    this->m_compressedRootHandle = buildRecurse(embreePrims, tmpPrims, rootRange);
+
+    // Shrink to fit BVH allocators
+    this->m_innerNodeAllocator.compact();
+    this->m_leafIndexAllocator.compact();
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH8BuildSAH<LeafObj>::buildRecurse(std::span<RTCBuildPrimitive> prims, std::span<RTCBuildPrimitive> tmpPrims, const BuildRange& range)
+{
+    if (range.size() <= maxLeafSize)
+        return createLeaf(prims, range);
+
+    // Keep splitting the child with the largest surface area until the node is full or all children can become leafs
+    std::array<BuildRange, 8> children;
+    children[0] = range;
+    unsigned numChildren = 1;
+    while (numChildren < 8) {
+        int largestChild = -1;
+        float largestArea = std::numeric_limits<float>::lowest();
+        for (unsigned childID = 0; childID < numChildren; childID++) {
+            if (children[childID].size() <= maxLeafSize)
+                continue;
+
+            const float area = children[childID].bounds.surfaceArea();
+            if (area > largestArea) {
+                largestArea = area;
+                largestChild = static_cast<int>(childID);
+            }
+        }
+        if (largestChild == -1)
+            break;
+
+        auto [left, right] = split(prims, tmpPrims, children[largestChild]);
+        children[largestChild] = left;
+        children[numChildren++] = right;
+    }
+
+    // Allocate the node before building its children so that parents are stored before their children
+    auto [nodeHandle, nodePtr] = this->m_innerNodeAllocator.allocate();
+    (void)nodePtr;
+
+    std::array<uint32_t, 8> childHandles;
+    const auto buildChild = [&](unsigned childID) {
+        childHandles[childID] = buildRecurse(prims, tmpPrims, children[childID]);
+    };
+    if (range.size() < parallelThreshold) {
+        for (unsigned childID = 0; childID < numChildren; childID++)
+            buildChild(childID);
+    } else {
+        tbb::parallel_for(0u, numChildren, buildChild);
+    }
+    for (unsigned childID = numChildren; childID < 8; childID++) {
+        childHandles[childID] = WiVeBVH8<LeafObj>::compressHandleEmpty();
+    }
+
+    std::array<Bounds, 8> childBounds;
+    for (unsigned childID = 0; childID < numChildren; childID++) {
+        childBounds[childID] = children[childID].bounds;
+    }
+
+    typename WiVeBVH8<LeafObj>::InnerNode& node = this->m_innerNodeAllocator.get(nodeHandle);
+    node.children.load(childHandles);
+    WiVeBVH8<LeafObj>::setInnerNodeBounds(node, std::span(childBounds.data(), numChildren));
+    return WiVeBVH8<LeafObj>::compressHandleInner(nodeHandle);
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH8BuildSAH<LeafObj>::createLeaf(std::span<const RTCBuildPrimitive> prims, const BuildRange& range)
+{
+    assert(range.size() > 0 && range.size() <= maxLeafSize);
+
+    auto [nodeHandle, nodePtr] = this->m_leafIndexAllocator.allocateNInitF(range.size(), [&](int i) {
+        return prims[range.begin + i].primID;
+    });
+    return WiVeBVH8<LeafObj>::compressHandleLeaf(nodeHandle, range.size());
+}
+
+template <typename LeafObj>
+inline std::pair<typename WiVeBVH8BuildSAH<LeafObj>::BuildRange, typename WiVeBVH8BuildSAH<LeafObj>::BuildRange> WiVeBVH8BuildSAH<LeafObj>::split(
+    std::span<RTCBuildPrimitive> prims, std::span<RTCBuildPrimitive> tmpPrims, const BuildRange& range)
+{
+    assert(range.size() > 1);
+
+    const glm::vec3 centroidExtent = range.centroidBounds.extent();
+    if (centroidExtent.x <= 0.0f && centroidExtent.y <= 0.0f && centroidExtent.z <= 0.0f)
+        return splitMedian(prims, range);
+
+    glm::vec3 binScale;
+    for (int axis = 0; axis < 3; axis++)
+        binScale[axis] = centroidExtent[axis] > 0.0f ? (numBins * 0.99999f) / centroidExtent[axis] : 0.0f;
+    const auto binID = [&](const glm::vec3& centroid, int axis) {
+        return std::clamp(static_cast<int>((centroid[axis] - range.centroidBounds.min[axis]) * binScale[axis]), 0, numBins - 1);
+    };
+
+    // Bin the primitives along all three axis (in parallel for large ranges)
+    const auto binPrimitives = [&](uint32_t begin, uint32_t end, Bins& bins) {
+        for (uint32_t i = begin; i < end; i++) {
+            const Bounds bounds = primBounds(prims[i]);
+            const glm::vec3 centroid = primCentroid(prims[i]);
+            for (int axis = 0; axis < 3; axis++) {
+                Bin& bin = bins[axis][binID(centroid, axis)];
+                bin.bounds.extend(bounds);
+                bin.centroidBounds.grow(centroid);
+                bin.count++;
+            }
+        }
+    };
+    Bins bins;
+    if (range.size() < parallelThreshold) {
+        binPrimitives(range.begin, range.end, bins);
+    } else {
+        bins = tbb::parallel_reduce(
+            tbb::blocked_range<uint32_t>(range.begin, range.end, 1024), Bins {},
+            [&](tbb::blocked_range<uint32_t> localRange, Bins localBins) {
+                binPrimitives(localRange.begin(), localRange.end(), localBins);
+                return localBins;
+            },
+            [](Bins lhs, const Bins& rhs) {
+                for (int axis = 0; axis < 3; axis++) {
+                    for (int binIdx = 0; binIdx < numBins; binIdx++) {
+                        lhs[axis][binIdx].bounds.extend(rhs[axis][binIdx].bounds);
+                        lhs[axis][binIdx].centroidBounds.extend(rhs[axis][binIdx].centroidBounds);
+                        lhs[axis][binIdx].count += rhs[axis][binIdx].count;
+                    }
+                }
+                return lhs;
+            });
+    }
+
+    // Find the split (primitives in bins [0, split) go left) with the lowest surface area heuristic cost
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestSplit = -1;
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroidExtent[axis] <= 0.0f)
+            continue;
+
+        std::array<float, numBins> rightCosts;
+        Bounds rightBounds;
+        uint32_t rightCount = 0;
+        for (int binIdx = numBins - 1; binIdx > 0; binIdx--) {
+            rightBounds.extend(bins[axis][binIdx].bounds);
+            rightCount += bins[axis][binIdx].count;
+            rightCosts[binIdx] = rightCount > 0 ? rightBounds.surfaceArea() * rightCount : 0.0f;
+        }
+
+        Bounds leftBounds;
+        uint32_t leftCount = 0;
+        for (int binIdx = 1; binIdx < numBins; binIdx++) {
+            leftBounds.extend(bins[axis][binIdx - 1].bounds);
+            leftCount += bins[axis][binIdx - 1].count;
+            if (leftCount == 0 || leftCount == range.size())
+                continue;
+
+            const float cost = leftBounds.surfaceArea() * leftCount + rightCosts[binIdx];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = binIdx;
+            }
+        }
+    }
+    if (bestAxis == -1)
+        return splitMedian(prims, range);
+
+    BuildRange left { range.begin, range.begin };
+    BuildRange right { range.begin, range.end };
+    for (int binIdx = 0; binIdx < numBins; binIdx++) {
+        const Bin& bin = bins[bestAxis][binIdx];
+        BuildRange& side = binIdx < bestSplit ? left : right;
+        side.bounds.extend(bin.bounds);
+        side.centroidBounds.extend(bin.centroidBounds);
+        if (binIdx < bestSplit)
+            left.end += bin.count;
+    }
+    right.begin = left.end;
+
+    [[maybe_unused]] const uint32_t mid = partition(prims, tmpPrims, range, [&](const RTCBuildPrimitive& prim) {
+        return binID(primCentroid(prim), bestAxis) < bestSplit;
+    });
+    assert(mid == left.end);
+    return { left, right };
+}
+
+template <typename LeafObj>
+inline std::pair<typename WiVeBVH8BuildSAH<LeafObj>::BuildRange, typename WiVeBVH8BuildSAH<LeafObj>::BuildRange> WiVeBVH8BuildSAH<LeafObj>::splitMedian(
+    std::span<RTCBuildPrimitive> prims, const BuildRange& range)
+{
+    // Fallback for when binning cannot separate the primitives (e.g. all centroids are the same): split by count
+    const uint32_t mid = range.begin + range.size() / 2;
+
+    const glm::vec3 centroidExtent = range.centroidBounds.extent();
+    const int axis = centroidExtent.x > centroidExtent.y ? (centroidExtent.x > centroidExtent.z ? 0 : 2) : (centroidExtent.y > centroidExtent.z ? 1 : 2);
+    if (centroidExtent[axis] > 0.0f) {
+        std::nth_element(std::begin(prims) + range.begin, std::begin(prims) + mid, std::begin(prims) + range.end,
+            [&](const RTCBuildPrimitive& a, const RTCBuildPrimitive& b) {
+                return primCentroid(a)[axis] < primCentroid(b)[axis];
+            });
+    }
+
+    return { computeRange(prims, range.begin, mid), computeRange(prims, mid, range.end) };
+}
+
+template <typename LeafObj>
+inline typename WiVeBVH8BuildSAH<LeafObj>::BuildRange WiVeBVH8BuildSAH<LeafObj>::computeRange(std::span<const RTCBuildPrimitive> prims, uint32_t begin, uint32_t end)
+{
+    const auto computeBounds = [&](uint32_t localBegin, uint32_t localEnd, BuildRange& range) {
+        for (uint32_t i = localBegin; i < localEnd; i++) {
+            range.bounds.extend(primBounds(prims[i]));
+            range.centroidBounds.grow(primCentroid(prims[i]));
+        }
+    };
+
+    BuildRange range { begin, end };
+    if (end - begin < parallelThreshold) {
+        computeBounds(begin, end, range);
+    } else {
+        range = tbb::parallel_reduce(
+            tbb::blocked_range<uint32_t>(begin, end, 1024), range,
+            [&](tbb::blocked_range<uint32_t> localRange, BuildRange localResult) {
+                computeBounds(localRange.begin(), localRange.end(), localResult);
+                return localResult;
+            },
+            [](BuildRange lhs, const BuildRange& rhs) {
+                lhs.bounds.extend(rhs.bounds);
+                lhs.centroidBounds.extend(rhs.centroidBounds);
+                return lhs;
+            });
+    }
+    return range;
+}
+
+template <typename LeafObj>
+template <typename F>
+inline uint32_t WiVeBVH8BuildSAH<LeafObj>::partition(std::span<RTCBuildPrimitive> prims, std::span<RTCBuildPrimitive> tmpPrims, const BuildRange& range, F&& isLeft)
+{
+    if (range.size() < parallelThreshold) {
+        auto mid = std::partition(std::begin(prims) + range.begin, std::begin(prims) + range.end, isLeft);
+        return static_cast<uint32_t>(mid - std::begin(prims));
+    }
+
+    // Parallel partition: count the primitives that go left in each block, compute the output offsets of each block
+    // (prefix sum) and then scatter the primitives into the temporary array before copying them back.
+    constexpr uint32_t blockSize = 1024;
+    const uint32_t numBlocks = (range.size() + blockSize - 1) / blockSize;
+    const auto blockRange = [&](uint32_t block) {
+        const uint32_t blockBegin = range.begin + block * blockSize;
+        return std::pair { blockBegin, std::min(blockBegin + blockSize, range.end) };
+    };
+
+    std::vector<uint32_t> leftOffsets(numBlocks + 1, 0);
+    tbb::parallel_for(0u, numBlocks, [&](uint32_t block) {
+        const auto [blockBegin, blockEnd] = blockRange(block);
+        leftOffsets[block + 1] = static_cast<uint32_t>(std::count_if(std::begin(prims) + blockBegin, std::begin(prims) + blockEnd, isLeft));
+    });
+    std::partial_sum(std::begin(leftOffsets), std::end(leftOffsets), std::begin(leftOffsets));
+    const uint32_t numLeft = leftOffsets.back();
+
+    tbb::parallel_for(0u, numBlocks, [&](uint32_t block) {
+        const auto [blockBegin, blockEnd] = blockRange(block);
+        uint32_t leftOut = range.begin + leftOffsets[block];
+        uint32_t rightOut = range.begin + numLeft + (blockBegin - range.begin - leftOffsets[block]);
+        for (uint32_t i = blockBegin; i < blockEnd; i++) {
+            if (isLeft(prims[i]))
+                tmpPrims[leftOut++] = prims[i];
+            else
+                tmpPrims[rightOut++] = prims[i];
+        }
+    });
+    tbb::parallel_for(tbb::blocked_range<uint32_t>(range.begin, range.end, blockSize), [&](tbb::blocked_range<uint32_t> localRange) {
+        std::copy(std::begin(tmpPrims) + localRange.begin(), std::begin(tmpPrims) + localRange.end(), std::begin(prims) + localRange.begin());
+    });
+    return range.begin + numLeft;
+}
+
+template <typename LeafObj>
+inline Bounds WiVeBVH8BuildSAH<LeafObj>::primBounds(const RTCBuildPrimitive& prim)
+{
+    return Bounds(glm::vec3(prim.lower_x, prim.lower_y, prim.lower_z), glm::vec3(prim.upper_x, prim.upper_y, prim.upper_z));
+}
+
+template <typename LeafObj>
+inline glm::vec3 WiVeBVH8BuildSAH<LeafObj>::primCentroid(const RTCBuildPrimitive& prim)
+{
+    return glm::vec3(prim.lower_x + prim.upper_x, prim.lower_y + prim.upper_y, prim.lower_z + prim.upper_z) * 0.5f;
+}
+}
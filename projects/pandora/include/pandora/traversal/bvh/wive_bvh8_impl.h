@@ -4,7 +4,9 @@
 #include <EASTL/fixed_vector.h>
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
+#include <cmath>
 #include <mio/mmap.hpp>
 #include "wive_bvh8.h"
 
@@ -22,6 +24,9 @@ inline WiVeBVH8<LeafObj>::WiVeBVH8(const serialization::WiVeBVH8* serialized, st
     : m_innerNodeAllocator(serialized->innerNodeAllocator())
     , m_leafIndexAllocator(serialized->leafIndexAllocator())
 {
+    ALWAYS_ASSERT(serialized->version() == serializationVersion, "Serialized BVH was created by a different version of WiVeBVH8");
+    ALWAYS_ASSERT(serialized->branchingFactor() == branchingFactor, "Serialized BVH is not a WiVeBVH8");
+    ALWAYS_ASSERT(serialized->quantizedNodes() == quantizedNodes, "Serialized BVH uses a different inner node format (ENABLE_QUANTIZED_BVH_NODES)");
     m_compressedRootHandle = serialized->compressedRootHandle();
 
     size_t numNodesGiven = leafs.size();
@@ -45,7 +50,10 @@ inline flatbuffers::Offset<serialization::WiVeBVH8> WiVeBVH8<LeafObj>::serialize
         serializedInnerNodeAllocator,
         serializedLeafIndexAllocator,
         m_compressedRootHandle,
-        this->m_leafObjects.size());
+        this->m_leafObjects.size(),
+        serializationVersion,
+        quantizedNodes,
+        branchingFactor);
 }
 
 template <typename LeafObj>
@@ -200,6 +208,136 @@ inline bool WiVeBVH8<LeafObj>::intersectAny(Ray& ray) const
     return false;
 }
 
+template <typename LeafObj>
+inline void WiVeBVH8<LeafObj>::intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const
+{
+    assert(rays.size() == surfaceInteractions.size());
+    if (rays.size() == 1) {
+        intersect(rays[0], surfaceInteractions[0]);
+        return;
+    }
+
+    traverseStream(rays, [&](const uint32_t* leafObjectIndices, uint32_t objectCount, uint32_t rayID) {
+        intersectLeaf(leafObjectIndices, objectCount, rays[rayID], surfaceInteractions[rayID]);
+    });
+}
+
+template <typename LeafObj>
+inline void WiVeBVH8<LeafObj>::intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const
+{
+    assert(rays.size() == hits.size());
+    std::fill(std::begin(hits), std::end(hits), false);
+
+    // A ray that found a hit has its tfar set to -inf, which culls it from all nodes that are visited afterwards.
+    traverseStream(rays, [&](const uint32_t* leafObjectIndices, uint32_t objectCount, uint32_t rayID) {
+        Ray& ray = rays[rayID];
+        if (!hits[rayID] && intersectAnyLeaf(leafObjectIndices, objectCount, ray)) {
+            ray.tfar = -std::numeric_limits<float>::infinity();
+            hits[rayID] = true;
+        }
+    });
+}
+
+template <typename LeafObj>
+template <typename LeafFunc>
+inline void WiVeBVH8<LeafObj>::traverseStream(std::span<const Ray> rays, LeafFunc&& leafFunc) const
+{
+    // NOTE: leafFunc must not start another stream traversal on the same thread (it would reuse the same buffers)
+    thread_local StreamTraversalBuffers buffers;
+    assert(!buffers.inUse);
+    buffers.inUse = true;
+    auto& streamRays = buffers.streamRays;
+    auto& activeRayIDs = buffers.activeRayIDs;
+    auto& stack = buffers.stack;
+    auto& childMasks = buffers.childMasks;
+    streamRays.clear();
+    activeRayIDs.clear();
+    stack.clear();
+    streamRays.reserve(rays.size());
+    activeRayIDs.reserve(4 * rays.size());
+    for (uint32_t rayID = 0; rayID < static_cast<uint32_t>(rays.size()); rayID++) {
+        const glm::vec3 direction = rays[rayID].direction;
+        streamRays.push_back(StreamRay {
+            1.0f / direction,
+            signShiftAmount(direction.x > 0, direction.y > 0, direction.z > 0) });
+        activeRayIDs.push_back(rayID);
+    }
+
+    stack.push_back(StackItem { m_compressedRootHandle, 0, static_cast<uint32_t>(rays.size()) });
+
+    while (!stack.empty()) {
+        const StackItem item = stack.back();
+        stack.pop_back();
+
+        // The ray lists of items that were pushed after this one have been processed already (LIFO) so their space can be reused.
+        activeRayIDs.resize(item.firstActiveRay + item.numActiveRays);
+
+        const uint32_t handle = decompressNodeHandle(item.compressedNodeHandle);
+        if (isInnerNode(item.compressedNodeHandle)) {
+            const auto* node = &m_innerNodeAllocator.get(handle);
+
+            // Test all active rays against the children of this node (which stays in cache while doing so).
+            std::array<uint32_t, 8> childNumRays { 0, 0, 0, 0, 0, 0, 0, 0 };
+            childMasks.resize(item.numActiveRays);
+            for (uint32_t i = 0; i < item.numActiveRays; i++) {
+                const uint32_t rayID = activeRayIDs[item.firstActiveRay + i];
+                const Ray& ray = rays[rayID];
+                const StreamRay& streamRay = streamRays[rayID];
+
+                SIMDRay simdRay;
+                simdRay.originX = simd::vec8_f32(ray.origin.x);
+                simdRay.originY = simd::vec8_f32(ray.origin.y);
+                simdRay.originZ = simd::vec8_f32(ray.origin.z);
+                simdRay.invDirectionX = simd::vec8_f32(streamRay.invDirection.x);
+                simdRay.invDirectionY = simd::vec8_f32(streamRay.invDirection.y);
+                simdRay.invDirectionZ = simd::vec8_f32(streamRay.invDirection.z);
+                simdRay.tnear = simd::vec8_f32(ray.tnear);
+                simdRay.tfar = simd::vec8_f32(ray.tfar);
+                simdRay.raySignShiftAmount = simd::vec8_u32(streamRay.signShiftAmount);
+
+                const uint32_t mask = intersectInnerNodeMask(node, simdRay);
+                childMasks[i] = static_cast<uint8_t>(mask);
+                for (uint32_t childIdx = 0; childIdx < 8; childIdx++)
+                    childNumRays[childIdx] += (mask >> childIdx) & 0x1;
+            }
+
+            // Visit children front-to-back as seen from the first ray; all rays in the batch should have a similar direction.
+            alignas(32) std::array<uint32_t, 8> children;
+            alignas(32) std::array<uint32_t, 8> permutationOffsets;
+            node->children.store(children);
+            node->permutationOffsets.store(permutationOffsets);
+            const uint32_t orderShiftAmount = streamRays[activeRayIDs[item.firstActiveRay]].signShiftAmount;
+
+            for (uint32_t i = 0; i < 8; i++) {
+                const uint32_t childIdx = (permutationOffsets[i] >> orderShiftAmount) & 0b111;
+                if (childNumRays[childIdx] == 0)
+                    continue;
+
+                const auto firstActiveRay = static_cast<uint32_t>(activeRayIDs.size());
+                for (uint32_t j = 0; j < item.numActiveRays; j++) {
+                    if (childMasks[j] & (1u << childIdx)) {
+                        const uint32_t rayID = activeRayIDs[item.firstActiveRay + j];
+                        activeRayIDs.push_back(rayID);
+                    }
+                }
+                stack.push_back(StackItem { children[childIdx], firstActiveRay, childNumRays[childIdx] });
+            }
+        } else {
+#ifndef NDEBUG
+            if (isEmptyNode(item.compressedNodeHandle))
+                THROW_ERROR("Empty node in traversal");
+            assert(isLeafNode(item.compressedNodeHandle));
+#endif
+            const uint32_t* leafObjectIndices = &m_leafIndexAllocator.get(handle);
+            const uint32_t objectCount = leafNodePrimitiveCount(item.compressedNodeHandle);
+            for (uint32_t i = 0; i < item.numActiveRays; i++)
+                leafFunc(leafObjectIndices, objectCount, activeRayIDs[item.firstActiveRay + i]);
+        }
+    }
+
+    buffers.inUse = false;
+}
+
 template <typename LeafObj>
 inline std::span<const LeafObj> WiVeBVH8<LeafObj>::leafs() const
 {
@@ -207,22 +345,57 @@ inline std::span<const LeafObj> WiVeBVH8<LeafObj>::leafs() const
 }
 
 template <typename LeafObj>
-inline uint32_t WiVeBVH8<LeafObj>::intersectInnerNode(const BVHNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const
+inline void WiVeBVH8<LeafObj>::intersectChildBounds(const InnerNode* n, const SIMDRay& ray, simd::vec8_f32& outTMin, simd::vec8_f32& outTMax) const
 {
-    simd::vec8_f32 tx1 = (n->minX - ray.originX) * ray.invDirectionX;
-    simd::vec8_f32 tx2 = (n->maxX - ray.originX) * ray.invDirectionX;
-    simd::vec8_f32 ty1 = (n->minY - ray.originY) * ray.invDirectionY;
-    simd::vec8_f32 ty2 = (n->maxY - ray.originY) * ray.invDirectionY;
-    simd::vec8_f32 tz1 = (n->minZ - ray.originZ) * ray.invDirectionZ;
-    simd::vec8_f32 tz2 = (n->maxZ - ray.originZ) * ray.invDirectionZ;
+    simd::vec8_f32 minX, maxX, minY, maxY, minZ, maxZ;
+    if constexpr (ENABLE_QUANTIZED_BVH_NODES) {
+        // Decode the 8-bit child bounds (zero extend + int to float conversion of 8 children at once)
+        const simd::vec8_f32 originX(n->origin[0]), originY(n->origin[1]), originZ(n->origin[2]);
+        const simd::vec8_f32 scaleX(quantizationScale(n->scaleExponents[0]));
+        const simd::vec8_f32 scaleY(quantizationScale(n->scaleExponents[1]));
+        const simd::vec8_f32 scaleZ(quantizationScale(n->scaleExponents[2]));
+        minX.loadUint8(n->minX);
+        maxX.loadUint8(n->maxX);
+        minY.loadUint8(n->minY);
+        maxY.loadUint8(n->maxY);
+        minZ.loadUint8(n->minZ);
+        maxZ.loadUint8(n->maxZ);
+        minX = minX * scaleX + originX;
+        maxX = maxX * scaleX + originX;
+        minY = minY * scaleY + originY;
+        maxY = maxY * scaleY + originY;
+        minZ = minZ * scaleZ + originZ;
+        maxZ = maxZ * scaleZ + originZ;
+    } else {
+        minX = n->minX;
+        maxX = n->maxX;
+        minY = n->minY;
+        maxY = n->maxY;
+        minZ = n->minZ;
+        maxZ = n->maxZ;
+    }
+
+    simd::vec8_f32 tx1 = (minX - ray.originX) * ray.invDirectionX;
+    simd::vec8_f32 tx2 = (maxX - ray.originX) * ray.invDirectionX;
+    simd::vec8_f32 ty1 = (minY - ray.originY) * ray.invDirectionY;
+    simd::vec8_f32 ty2 = (maxY - ray.originY) * ray.invDirectionY;
+    simd::vec8_f32 tz1 = (minZ - ray.originZ) * ray.invDirectionZ;
+    simd::vec8_f32 tz2 = (maxZ - ray.originZ) * ray.invDirectionZ;
     simd::vec8_f32 txMin = simd::min(tx1, tx2);
     simd::vec8_f32 tyMin = simd::min(ty1, ty2);
     simd::vec8_f32 tzMin = simd::min(tz1, tz2);
     simd::vec8_f32 txMax = simd::max(tx1, tx2);
     simd::vec8_f32 tyMax = simd::max(ty1, ty2);
     simd::vec8_f32 tzMax = simd::max(tz1, tz2);
-    simd::vec8_f32 tmin = simd::max(ray.tnear, simd::max(txMin, simd::max(tyMin, tzMin)));
-    simd::vec8_f32 tmax = simd::min(ray.tfar, simd::min(txMax, simd::min(tyMax, tzMax)));
+    outTMin = simd::max(ray.tnear, simd::max(txMin, simd::max(tyMin, tzMin)));
+    outTMax = simd::min(ray.tfar, simd::min(txMax, simd::min(tyMax, tzMax)));
+}
+
+template <typename LeafObj>
+inline uint32_t WiVeBVH8<LeafObj>::intersectInnerNode(const InnerNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const
+{
+    simd::vec8_f32 tmin, tmax;
+    intersectChildBounds(n, ray, tmin, tmax);
 
     const simd::vec8_u32 indexMask(0b111);
     const simd::vec8_u32 simd24(24);
@@ -238,22 +411,10 @@ inline uint32_t WiVeBVH8<LeafObj>::intersectInnerNode(const BVHNode* n, const SI
 }
 
 template <typename LeafObj>
-inline uint32_t WiVeBVH8<LeafObj>::intersectAnyInnerNode(const BVHNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const
+inline uint32_t WiVeBVH8<LeafObj>::intersectAnyInnerNode(const InnerNode* n, const SIMDRay& ray, simd::vec8_u32& outChildren, simd::vec8_f32& outDistances) const
 {
-    simd::vec8_f32 tx1 = (n->minX - ray.originX) * ray.invDirectionX;
-    simd::vec8_f32 tx2 = (n->maxX - ray.originX) * ray.invDirectionX;
-    simd::vec8_f32 ty1 = (n->minY - ray.originY) * ray.invDirectionY;
-    simd::vec8_f32 ty2 = (n->maxY - ray.originY) * ray.invDirectionY;
-    simd::vec8_f32 tz1 = (n->minZ - ray.originZ) * ray.invDirectionZ;
-    simd::vec8_f32 tz2 = (n->maxZ - ray.originZ) * ray.invDirectionZ;
-    simd::vec8_f32 txMin = simd::min(tx1, tx2);
-    simd::vec8_f32 tyMin = simd::min(ty1, ty2);
-    simd::vec8_f32 tzMin = simd::min(tz1, tz2);
-    simd::vec8_f32 txMax = simd::max(tx1, tx2);
-    simd::vec8_f32 tyMax = simd::max(ty1, ty2);
-    simd::vec8_f32 tzMax = simd::max(tz1, tz2);
-    simd::vec8_f32 tmin = simd::max(ray.tnear, simd::max(txMin, simd::max(tyMin, tzMin)));
-    simd::vec8_f32 tmax = simd::min(ray.tfar, simd::min(txMax, simd::min(tyMax, tzMax)));
+    simd::vec8_f32 tmin, tmax;
+    intersectChildBounds(n, ray, tmin, tmax);
 
     // Disable sorting since any hit will do
     //const simd::vec8_u32 indexMask(0b111);
@@ -269,6 +430,17 @@ inline uint32_t WiVeBVH8<LeafObj>::intersectAnyInnerNode(const BVHNode* n, const
     return mask.count();
 }
 
+template <typename LeafObj>
+inline uint32_t WiVeBVH8<LeafObj>::intersectInnerNodeMask(const InnerNode* n, const SIMDRay& ray) const
+{
+    simd::vec8_f32 tmin, tmax;
+    intersectChildBounds(n, ray, tmin, tmax);
+
+    // Bit i is set if the ray intersects child i (in storage order, not permuted).
+    simd::mask8 mask = tmin <= tmax;
+    return static_cast<uint32_t>(mask.bitMask());
+}
+
 template <typename LeafObj>
 inline bool WiVeBVH8<LeafObj>::intersectLeaf(const uint32_t* leafObjectIndices, uint32_t objectCount, Ray& ray, SurfaceInteraction& si) const
 {
@@ -310,7 +482,7 @@ inline void WiVeBVH8<LeafObj>::testBVH() const
 }
 
 template <typename LeafObj>
-inline void WiVeBVH8<LeafObj>::testBVHRecurse(const BVHNode* node, int depth, TestBVHData& out) const
+inline void WiVeBVH8<LeafObj>::testBVHRecurse(const InnerNode* node, int depth, TestBVHData& out) const
 {
     std::array<uint32_t, 8> children;
     node->children.store(children);
@@ -387,4 +559,119 @@ inline uint32_t WiVeBVH8<LeafObj>::signShiftAmount(bool positiveX, bool positive
     return ((positiveX ? 0b001 : 0u) | (positiveY ? 0b010 : 0u) | (positiveZ ? 0b100 : 0u)) * 3;
 }
 
+template <typename LeafObj>
+inline void WiVeBVH8<LeafObj>::quantizeChildBounds(
+    std::span<const float, 8> childMin, std::span<const float, 8> childMax, unsigned numChildren,
+    float& outOrigin, uint8_t& outScaleExponent, std::array<uint8_t, 8>& outMin, std::array<uint8_t, 8>& outMax)
+{
+    assert(numChildren > 0 && numChildren <= 8);
+
+    float nodeMin = std::numeric_limits<float>::max();
+    float nodeMax = std::numeric_limits<float>::lowest();
+    for (unsigned i = 0; i < numChildren; i++) {
+        nodeMin = std::min(nodeMin, childMin[i]);
+        nodeMax = std::max(nodeMax, childMax[i]);
+    }
+
+    // Smallest power of two for which 255 steps cover the extent of the node
+    int exponent;
+    std::frexp((nodeMax - nodeMin) / 255.0f, &exponent);
+    int biasedExponent = std::clamp(exponent + 127, 1, 254);
+    while (biasedExponent < 254 && nodeMin + 255.0f * quantizationScale(static_cast<uint8_t>(biasedExponent)) < nodeMax)
+        biasedExponent++;
+    const float scale = quantizationScale(static_cast<uint8_t>(biasedExponent));
+
+    outOrigin = nodeMin;
+    outScaleExponent = static_cast<uint8_t>(biasedExponent);
+    for (unsigned i = 0; i < numChildren; i++) {
+        // q * scale is exact so these checks match the decoding during traversal
+        int qMin = std::clamp(static_cast<int>(std::floor((childMin[i] - nodeMin) / scale)), 0, 255);
+        while (qMin > 0 && nodeMin + static_cast<float>(qMin) * scale > childMin[i])
+            qMin--;
+        int qMax = std::clamp(static_cast<int>(std::ceil((childMax[i] - nodeMin) / scale)), 0, 255);
+        while (qMax < 255 && nodeMin + static_cast<float>(qMax) * scale < childMax[i])
+            qMax++;
+        outMin[i] = static_cast<uint8_t>(qMin);
+        outMax[i] = static_cast<uint8_t>(qMax);
+    }
+    for (unsigned i = numChildren; i < 8; i++) {
+        outMin[i] = outMax[i] = 0;
+    }
+}
+
+template <typename LeafObj>
+inline float WiVeBVH8<LeafObj>::quantizationScale(uint8_t scaleExponent)
+{
+    return std::bit_cast<float>(static_cast<uint32_t>(scaleExponent) << 23);
+}
+
+template <typename LeafObj>
+inline void WiVeBVH8<LeafObj>::setInnerNodeBounds(InnerNode& node, std::span<const Bounds> childBounds)
+{
+    assert(childBounds.size() > 0 && childBounds.size() <= 8);
+    const unsigned numChildren = static_cast<unsigned>(childBounds.size());
+
+    std::array<float, 8> minX, minY, minZ, maxX, maxY, maxZ;
+    std::array<uint32_t, 8> permutationOffsets;
+    for (unsigned childID = 0; childID < numChildren; childID++) {
+        const Bounds& bounds = childBounds[childID];
+        minX[childID] = bounds.min.x;
+        minY[childID] = bounds.min.y;
+        minZ[childID] = bounds.min.z;
+        maxX[childID] = bounds.max.x;
+        maxY[childID] = bounds.max.y;
+        maxZ[childID] = bounds.max.z;
+    }
+    for (unsigned i = numChildren; i < 8; i++) {
+        minX[i] = minY[i] = minZ[i] = maxX[i] = maxY[i] = maxZ[i] = 0.0f;
+    }
+
+    // Create permutations
+    std::fill(std::begin(permutationOffsets), std::end(permutationOffsets), 0);
+    for (int x = -1; x <= 1; x += 2) {
+        for (int y = -1; y <= 1; y += 2) {
+            for (int z = -1; z <= 1; z += 2) {
+                glm::vec3 direction(x, y, z);
+
+                std::array<uint32_t, 8> indices = { 0, 1, 2, 3, 4, 5, 6, 7 };
+                std::array<float, 8> distances;
+                std::transform(std::begin(indices), std::end(indices), std::begin(distances), [&](uint32_t i) -> float {
+                    if (i >= numChildren)
+                        return std::numeric_limits<float>::max();
+
+                    // Calculate the bounding box corner opposite to the direction vector
+                    const Bounds& bounds = childBounds[i];
+                    glm::vec3 extremePoint(
+                        x == -1 ? bounds.min.x : bounds.max.x,
+                        y == -1 ? bounds.min.y : bounds.max.y,
+                        z == -1 ? bounds.min.z : bounds.max.z);
+                    return glm::dot(extremePoint, direction);
+                });
+                // Sort bounding boxes back-to-front as seen from the normal plane of the direction vector
+                std::sort(std::begin(indices), std::end(indices), [&](uint32_t a, uint32_t b) -> bool {
+                    return distances[a] > distances[b];
+                });
+
+                uint32_t shiftAmount = signShiftAmount(x > 0, y > 0, z > 0);
+                for (int i = 0; i < 8; i++)
+                    permutationOffsets[i] |= indices[i] << shiftAmount;
+            }
+        }
+    }
+
+    if constexpr (ENABLE_QUANTIZED_BVH_NODES) {
+        quantizeChildBounds(minX, maxX, numChildren, node.origin[0], node.scaleExponents[0], node.minX, node.maxX);
+        quantizeChildBounds(minY, maxY, numChildren, node.origin[1], node.scaleExponents[1], node.minY, node.maxY);
+        quantizeChildBounds(minZ, maxZ, numChildren, node.origin[2], node.scaleExponents[2], node.minZ, node.maxZ);
+    } else {
+        node.minX.load(minX);
+        node.minY.load(minY);
+        node.minZ.load(minZ);
+        node.maxX.load(maxX);
+        node.maxY.load(maxY);
+        node.maxZ.load(maxZ);
+    }
+    node.permutationOffsets.load(permutationOffsets);
+}
+
 }
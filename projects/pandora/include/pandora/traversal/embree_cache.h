@@ -27,6 +27,8 @@ public:
 struct EmbreeSceneCache {
 public:
     virtual std::shared_ptr<CachedEmbreeScene> fromSceneObjectGroup(const void* key, std::span<const SceneObject*> sceneObjects) = 0;
+    // Estimated size of the BVH that fromSceneObjectGroup would have to build (0 if it is cached).
+    virtual size_t bytesToBuild(const void* key, std::span<const SceneObject* const> sceneObjects) const = 0;
 };
 
 struct LRUEmbreeSceneCache : public EmbreeSceneCache {
@@ -35,6 +37,7 @@ public:
     ~LRUEmbreeSceneCache();
 
     std::shared_ptr<CachedEmbreeScene> fromSceneObjectGroup(const void* key, std::span<const SceneObject*> sceneObjects) override;
+    size_t bytesToBuild(const void* key, std::span<const SceneObject* const> sceneObjects) const override;
 
 private:
     void shareCommitScene(RTCScene);
@@ -61,6 +64,15 @@ private:
     std::list<CacheItem> m_scenes;
     std::unordered_map<const void*, std::list<CacheItem>::iterator> m_lookUp;
 
+    // Size of every BVH that has been built (also after it was evicted) so that the cost of rebuilding it is known.
+    // Protected by a separate lock because m_mutex is held for the duration of a BVH build.
+    struct BuiltScene {
+        size_t sizeBytes;
+        bool cached;
+    };
+    mutable std::mutex m_builtScenesLock;
+    std::unordered_map<const void*, BuiltScene> m_builtScenes;
+
     RTCDevice m_embreeDevice;
 };
 
@@ -0,0 +1,21 @@
+#pragma once
+#include "pandora/graphics_core/ray.h"
+#include <embree3/rtcore.h>
+#include <span>
+
+namespace pandora::detail {
+
+// Maximum number of rays traced by intersectEmbreePacket / occludedEmbreePacket
+constexpr size_t embreePacketSize = 16;
+
+// Trace a single ray through Embree. The returned hit has geomID == RTC_INVALID_GEOMETRY_ID if nothing was hit.
+RTCRayHit intersectEmbreeRay(RTCScene scene, const Ray& ray);
+// Returns the tfar of the ray after the occlusion test (-inf if it was occluded)
+float occludedEmbreeRay(RTCScene scene, const Ray& ray);
+
+// Trace up to embreePacketSize (coherent) rays through Embree as a single 16-wide packet. Lanes beyond rays.size()
+// are disabled. The hits are returned in the same format as intersectEmbreeRay / occludedEmbreeRay.
+void intersectEmbreePacket(RTCScene scene, std::span<const Ray> rays, std::span<RTCRayHit> outHits);
+void occludedEmbreePacket(RTCScene scene, std::span<const Ray> rays, std::span<float> outTfars);
+
+}
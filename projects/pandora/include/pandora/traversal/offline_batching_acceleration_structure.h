@@ -1,4 +1,5 @@
 #pragma once
+#include "pandora/config.h"
 #include "pandora/core/stats.h"
 #include "pandora/graphics_core/bounds.h"
 #include "pandora/graphics_core/pandora.h"
@@ -10,9 +11,13 @@
 #include "pandora/traversal/batching.h"
 #include "pandora/traversal/offline_bvh_cache.h"
 #include "pandora/traversal/pauseable_bvh/pauseable_bvh4.h"
+#include "pandora/traversal/ray_sorting.h"
+#include "pandora/traversal/svdag_culling.h"
 #include "pandora/traversal/sub_scene.h"
 #include "pandora/utility/enumerate.h"
+#include <filesystem>
 #include <glm/gtc/type_ptr.hpp>
+#include <memory_resource>
 #include <span>
 #include <optick.h>
 #include <optional>
@@ -40,7 +45,7 @@ private:
         PauseableBVH4<BatchingPoint, HitRayState, AnyHitRayState>&& topLevelBVH,
         tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>> hitTask, tasking::TaskHandle<std::tuple<Ray, HitRayState>> missTask,
         tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyHitTask, tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyMissTask,
-        tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, LRUBVHSceneCache&& bvhSceneCache);
+        tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, LRUBVHSceneCache&& bvhSceneCache, bool sortRays);
 
     using TopLevelBVH = PauseableBVH4<BatchingPoint, HitRayState, AnyHitRayState>;
     using OnHitTask = tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>>;
@@ -48,6 +53,10 @@ private:
     using OnAnyHitTask = tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>>;
     using OnAnyMissTask = tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>>;
 
+    // Continue top-level traversal of a batch of rays that were processed or culled by a batching point
+    void resumeTraversal(std::span<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> items, std::pmr::memory_resource* pMemoryResource) const;
+    void resumeTraversalAny(std::span<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> items, std::pmr::memory_resource* pMemoryResource) const;
+
     class BatchingPoint {
     public:
         BatchingPoint(std::unique_ptr<SubScene>&& pSubScene, std::vector<Shape*>&& shapes, SparseVoxelDAG&& svdag, tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph);
@@ -88,6 +97,10 @@ private:
 
         tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> m_intersectTask;
         tasking::TaskHandle<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> m_intersectAnyTask;
+
+        // Rays are first culled against the SVDAG in batches before being forwarded to m_intersect(Any)Task
+        tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> m_cullTask;
+        tasking::TaskHandle<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> m_cullAnyTask;
     };
 
 private:
@@ -95,6 +108,7 @@ private:
     LRUBVHSceneCache m_bvhSceneCache;
 
     bool m_enableOcclusionCulling;
+    bool m_sortRays;
     tasking::TaskGraph* m_pTaskGraph;
 
     tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>> m_onHitTask;
@@ -106,7 +120,8 @@ private:
 class OfflineBatchingAccelerationStructureBuilder {
 public:
     OfflineBatchingAccelerationStructureBuilder(
-        const Scene* pScene, tasking::LRUCacheTS* pCache, tasking::TaskGraph* pTaskGraph, unsigned primitivesPerBatchingPoint, size_t botLevelBVHCacheSize, unsigned svdagRes);
+        const Scene* pScene, tasking::LRUCacheTS* pCache, tasking::TaskGraph* pTaskGraph, unsigned primitivesPerBatchingPoint, size_t botLevelBVHCacheSize, unsigned svdagRes, bool sortRays = false,
+        std::filesystem::path persistentBVHStoreFolder = {});
 
     static void preprocessScene(Scene& scene, tasking::LRUCacheTS& oldCache, tasking::CacheBuilder& newCacheBuilder, unsigned primitivesPerBatchingPoint);
 
@@ -118,6 +133,8 @@ public:
 private:
     const size_t m_botLevelBVHCacheSize;
     const unsigned m_svdagRes;
+    const bool m_sortRays;
+    const std::filesystem::path m_persistentBVHStoreFolder; // Empty = bot level BVHs are rebuilt every run
 
     std::vector<std::unique_ptr<SubScene>> m_subScenes;
 
@@ -177,31 +194,31 @@ void OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::Batching
             return StaticData { std::move(shapeOwners), std::move(*optSubSceneBVH) };
         },
         [=](std::span<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> data, const StaticData* pStaticData, std::pmr::memory_resource* pMemoryResource) {
+            if (pParent->m_sortRays)
+                detail::sortRayBatch(data, m_bounds, pMemoryResource);
+
             {
                 auto stopWatch = g_stats.timings.botLevelTraversalTime.getScopedStopwatch();
 
-                for (auto& [ray, si, state, insertHandle] : data) {
-                    pStaticData->bvhSubScene.intersect(ray, si);
+                // Traverse the bottom level BVH with the whole batch at once.
+                std::pmr::vector<Ray> rays(data.size(), pMemoryResource);
+                std::pmr::vector<SurfaceInteraction> surfaceInteractions(data.size(), pMemoryResource);
+                for (auto&& [i, item] : enumerate(data)) {
+                    rays[i] = std::get<0>(item);
+                    surfaceInteractions[i] = std::get<1>(item);
+                }
+
+                pStaticData->bvhSubScene.intersect(rays, surfaceInteractions);
+
+                for (auto&& [i, item] : enumerate(data)) {
+                    std::get<0>(item) = rays[i];
+                    std::get<1>(item) = surfaceInteractions[i];
                 }
             }
 
             {
                 auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
-
-                for (auto& [ray, si, state, insertHandle] : data) {
-                    auto optHit = pParent->m_topLevelBVH.intersect(ray, si, state, insertHandle);
-                    if (optHit) { // Ray exited BVH
-                        assert(!optHit.value());
-
-                        if (si.pSceneObject) {
-                            // Ray hit something
-                            assert(si.pSceneObject);
-                            m_pTaskGraph->enqueue(pParent->m_onHitTask, std::tuple { ray, si, state });
-                        } else {
-                            m_pTaskGraph->enqueue(pParent->m_onMissTask, std::tuple { ray, state });
-                        }
-                    }
-                }
+                pParent->resumeTraversal(data, pMemoryResource);
             }
         });
     m_intersectAnyTask = m_pTaskGraph->addTask<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>, StaticData>(
@@ -224,40 +241,138 @@ void OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::Batching
             return StaticData { std::move(shapeOwners), std::move(*optSubSceneBVH) };
         },
         [=](std::span<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> data, const StaticData* pStaticData, std::pmr::memory_resource* pMemoryResource) {
-            std::vector<uint32_t> hits;
-            hits.resize(data.size());
-            std::fill(std::begin(hits), std::end(hits), false);
+            if (pParent->m_sortRays)
+                detail::sortRayBatch(data, m_bounds, pMemoryResource);
+
+            std::pmr::vector<uint32_t> hits(data.size(), false, pMemoryResource);
 
             {
                 auto stopWatch = g_stats.timings.botLevelTraversalTime.getScopedStopwatch();
 
-                for (auto&& [i, data] : enumerate(data)) {
-                    auto& [ray, state, insertHandle] = data;
-                    hits[i] = pStaticData->bvhSubScene.intersectAny(ray);
-                }
+                // Traverse the bottom level BVH with the whole batch at once.
+                std::pmr::vector<Ray> rays(data.size(), pMemoryResource);
+                for (auto&& [i, item] : enumerate(data))
+                    rays[i] = std::get<0>(item);
+
+                pStaticData->bvhSubScene.intersectAny(rays, hits);
+
+                for (auto&& [i, item] : enumerate(data))
+                    std::get<0>(item) = rays[i];
             }
 
             {
                 auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
 
-                for (auto&& [i, data] : enumerate(data)) {
-                    auto& [ray, state, insertHandle] = data;
-
-                    if (hits[i]) {
-                        m_pTaskGraph->enqueue(pParent->m_onAnyHitTask, std::tuple { ray, state });
-                    } else {
-                        auto optHit = pParent->m_topLevelBVH.intersectAny(ray, state, insertHandle);
-                        if (optHit) {
-                            assert(!optHit.value());
-                            if (optHit.value())
-                                m_pTaskGraph->enqueue(pParent->m_onAnyHitTask, std::tuple { ray, state });
-                            else
-                                m_pTaskGraph->enqueue(pParent->m_onAnyMissTask, std::tuple { ray, state });
-                        }
-                    }
+                // Rays that did not find a hit resume top-level traversal together
+                std::pmr::vector<std::tuple<Ray, AnyHitRayState>> anyHits(pMemoryResource);
+                size_t numResumed = 0;
+                for (auto&& [i, item] : enumerate(data)) {
+                    if (hits[i])
+                        anyHits.push_back({ std::get<0>(item), std::get<1>(item) });
+                    else
+                        data[numResumed++] = item;
                 }
+                if (!anyHits.empty())
+                    m_pTaskGraph->enqueue(pParent->m_onAnyHitTask, std::span<const std::tuple<Ray, AnyHitRayState>>(anyHits));
+                pParent->resumeTraversalAny(data.subspan(0, numResumed), pMemoryResource);
             }
         });
+
+    // Let the scheduling policy know how much geometry and bottom level BVH data has to be read from disk before the
+    // leaf can be intersected
+    auto bytesToLoad = [=]() {
+        size_t bytes = 0;
+        for (const Shape* pShape : m_shapes)
+            bytes += m_pGeometryCache->bytesToLoad(pShape);
+        bytes += pBVHCache->bytesToLoad(m_pSubScene.get());
+        return bytes;
+    };
+    m_pTaskGraph->setStaticDataLoadCost(m_intersectTask, bytesToLoad);
+    m_pTaskGraph->setStaticDataLoadCost(m_intersectAnyTask, bytesToLoad);
+
+    if (m_svdag) {
+        m_cullTask = m_pTaskGraph->addTask<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>>(
+            "OfflineBatchingAccelerationStructure::svdagCull",
+            [=](std::span<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> data, std::pmr::memory_resource* pMemoryResource) {
+                const size_t numHits = detail::cullRayBatch(*m_svdag, data);
+
+                // Rays that (potentially) hit geometry are traced against the bottom level BVH
+                auto hitItems = data.subspan(0, numHits);
+                for (auto& [ray, si, state, insertHandle] : hitItems)
+                    ray.numTopLevelIntersections += 1;
+                m_pTaskGraph->enqueue(m_intersectTask, std::span<const std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>>(hitItems));
+
+                // Culled rays continue top-level traversal
+                auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
+                pParent->resumeTraversal(data.subspan(numHits), pMemoryResource);
+            });
+        m_cullAnyTask = m_pTaskGraph->addTask<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>>(
+            "OfflineBatchingAccelerationStructure::svdagCullAny",
+            [=](std::span<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> data, std::pmr::memory_resource* pMemoryResource) {
+                const size_t numHits = detail::cullRayBatch(*m_svdag, data);
+
+                auto hitItems = data.subspan(0, numHits);
+                for (auto& [ray, state, insertHandle] : hitItems)
+                    ray.numTopLevelIntersections += 1;
+                m_pTaskGraph->enqueue(m_intersectAnyTask, std::span<const std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>>(hitItems));
+
+                auto stopWatch = g_stats.timings.topLevelTraversalTime.getScopedStopwatch();
+                pParent->resumeTraversalAny(data.subspan(numHits), pMemoryResource);
+            });
+    }
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+void OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::resumeTraversal(
+    std::span<std::tuple<Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle>> items, std::pmr::memory_resource* pMemoryResource) const
+{
+    std::pmr::vector<std::optional<bool>> results(items.size(), pMemoryResource);
+    m_topLevelBVH.intersectBatch(items, results, pMemoryResource);
+
+    // Collect the rays that exit the BVH per destination so that they can be pushed to the queues in bulk
+    std::pmr::vector<std::tuple<Ray, SurfaceInteraction, HitRayState>> hits(pMemoryResource);
+    std::pmr::vector<std::tuple<Ray, HitRayState>> misses(pMemoryResource);
+    for (auto&& [i, item] : enumerate(items)) {
+        if (results[i]) { // Ray exited BVH
+            auto& [ray, si, state, insertHandle] = item;
+            if (si.pSceneObject) {
+                // Ray hit something
+                hits.push_back({ ray, si, state });
+            } else {
+                misses.push_back({ ray, state });
+            }
+        }
+    }
+
+    if (!hits.empty())
+        m_pTaskGraph->enqueue(m_onHitTask, std::span<const std::tuple<Ray, SurfaceInteraction, HitRayState>>(hits));
+    if (!misses.empty())
+        m_pTaskGraph->enqueue(m_onMissTask, std::span<const std::tuple<Ray, HitRayState>>(misses));
+}
+
+template <typename HitRayState, typename AnyHitRayState>
+void OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::resumeTraversalAny(
+    std::span<std::tuple<Ray, AnyHitRayState, PauseableBVHInsertHandle>> items, std::pmr::memory_resource* pMemoryResource) const
+{
+    std::pmr::vector<std::optional<bool>> results(items.size(), pMemoryResource);
+    m_topLevelBVH.intersectAnyBatch(items, results, pMemoryResource);
+
+    std::pmr::vector<std::tuple<Ray, AnyHitRayState>> hits(pMemoryResource);
+    std::pmr::vector<std::tuple<Ray, AnyHitRayState>> misses(pMemoryResource);
+    for (auto&& [i, item] : enumerate(items)) {
+        if (results[i]) {
+            auto& [ray, state, insertHandle] = item;
+            if (results[i].value())
+                hits.push_back({ ray, state });
+            else
+                misses.push_back({ ray, state });
+        }
+    }
+
+    if (!hits.empty())
+        m_pTaskGraph->enqueue(m_onAnyHitTask, std::span<const std::tuple<Ray, AnyHitRayState>>(hits));
+    if (!misses.empty())
+        m_pTaskGraph->enqueue(m_onAnyMissTask, std::span<const std::tuple<Ray, AnyHitRayState>>(misses));
 }
 
 template <typename HitRayState, typename AnyHitRayState>
@@ -270,6 +385,13 @@ template <typename HitRayState, typename AnyHitRayState>
 std::optional<bool> OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersect(
     Ray& ray, SurfaceInteraction& si, const HitRayState& userState, const PauseableBVHInsertHandle& bvhInsertHandle) const
 {
+    if constexpr (ENABLE_BATCHED_SVDAG_CULLING) {
+        if (m_svdag) {
+            m_pTaskGraph->enqueue(m_cullTask, std::tuple { ray, si, userState, bvhInsertHandle });
+            return {};
+        }
+    }
+
     if (m_svdag) {
         // auto stopWatch = g_stats.timings.svdagTraversalTime.getScopedStopwatch();
         g_stats.svdag.numIntersectionTests++;
@@ -289,6 +411,13 @@ template <typename HitRayState, typename AnyHitRayState>
 std::optional<bool> OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint::intersectAny(
     Ray& ray, const AnyHitRayState& userState, const PauseableBVHInsertHandle& bvhInsertHandle) const
 {
+    if constexpr (ENABLE_BATCHED_SVDAG_CULLING) {
+        if (m_svdag) {
+            m_pTaskGraph->enqueue(m_cullAnyTask, std::tuple { ray, userState, bvhInsertHandle });
+            return {};
+        }
+    }
+
     if (m_svdag) {
         //auto stopWatch = g_stats.timings.svdagTraversalTime.getScopedStopwatch();
         g_stats.svdag.numIntersectionTests++;
@@ -315,7 +444,7 @@ inline OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState> Offline
     // From vector of unique pointers to vector of raw pointers
     std::vector<const SubScene*> subScenes;
     std::transform(std::begin(m_subScenes), std::end(m_subScenes), std::back_inserter(subScenes), [](const auto& subScene) { return subScene.get(); });
-    LRUBVHSceneCache sceneCache { subScenes, m_pGeometryCache, m_botLevelBVHCacheSize };
+    LRUBVHSceneCache sceneCache { subScenes, m_pGeometryCache, m_botLevelBVHCacheSize, m_persistentBVHStoreFolder };
 
     spdlog::info("Creating batching points");
     using BatchingPointT = typename OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::BatchingPoint;
@@ -382,7 +511,7 @@ inline OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState> Offline
     g_stats.memory.topBVHLeafs = batchingPoints.size() * sizeof(BatchingPointT);
     spdlog::info("PausableBVH constructed");
     return OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>(
-        std::move(topLevelBVH), hitTask, missTask, anyHitTask, anyMissTask, m_pGeometryCache, m_pTaskGraph, std::move(sceneCache));
+        std::move(topLevelBVH), hitTask, missTask, anyHitTask, anyMissTask, m_pGeometryCache, m_pTaskGraph, std::move(sceneCache), m_sortRays);
 }
 
 template <typename HitRayState, typename AnyHitRayState>
@@ -390,8 +519,9 @@ inline OfflineBatchingAccelerationStructure<HitRayState, AnyHitRayState>::Offlin
     PauseableBVH4<BatchingPoint, HitRayState, AnyHitRayState>&& topLevelBVH,
     tasking::TaskHandle<std::tuple<Ray, SurfaceInteraction, HitRayState>> hitTask, tasking::TaskHandle<std::tuple<Ray, HitRayState>> missTask,
     tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyHitTask, tasking::TaskHandle<std::tuple<Ray, AnyHitRayState>> anyMissTask,
-    tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, LRUBVHSceneCache&& bvhSceneCache)
+    tasking::LRUCacheTS* pGeometryCache, tasking::TaskGraph* pTaskGraph, LRUBVHSceneCache&& bvhSceneCache, bool sortRays)
     : m_topLevelBVH(std::move(topLevelBVH))
+    , m_sortRays(sortRays)
     , m_pTaskGraph(pTaskGraph)
     , m_onHitTask(hitTask)
     , m_onMissTask(missTask)
@@ -1,11 +1,17 @@
 #pragma once
+#include "pandora/config.h"
 #include "pandora/graphics_core/pandora.h"
+#include "pandora/traversal/bvh/wive_bvh16_build16.h"
 #include "pandora/traversal/bvh/wive_bvh8_build8.h"
+#include "pandora/traversal/bvh/wive_bvh8_build_sah.h"
+#include "pandora/traversal/persistent_bvh_store.h"
 #include "pandora/traversal/sub_scene.h"
+#include <filesystem>
 #include <glm/glm.hpp>
 #include <span>
 #include <memory>
 #include <optional>
+#include <type_traits>
 #include <stream/cache/cached_ptr.h>
 #include <stream/cache/lru_cache_ts.h>
 #include <unordered_map>
@@ -38,15 +44,21 @@ public:
     std::variant<Primitive, Instance> m_object;
 };
 
+// Bottom-level BVH of the cached sub-scenes (see ENABLE_WIVE_BVH16 and ENABLE_SAH_BVH8_BUILDER)
+using OfflineBVH = std::conditional_t<ENABLE_WIVE_BVH16, WiVeBVH16Build16<OfflineBVHLeaf>,
+    std::conditional_t<ENABLE_SAH_BVH8_BUILDER, WiVeBVH8BuildSAH<OfflineBVHLeaf>, WiVeBVH8Build8<OfflineBVHLeaf>>>;
+
 struct CachedBVH : public tasking::Evictable {
 public:
-    CachedBVH(WiVeBVH8Build8<OfflineBVHLeaf>&& bvh, const Bounds& bounds);
+    CachedBVH(OfflineBVH&& bvh, const Bounds& bounds);
     CachedBVH(CachedBVH&&) = default;
     ~CachedBVH() override = default;
 
     Bounds getBounds() const;
     bool intersect(Ray& ray, SurfaceInteraction& si) const;
     bool intersectAny(Ray& ray) const;
+    void intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const;
+    void intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const;
 
     size_t sizeBytes() const override;
     void serialize(tasking::Serializer& serializer) override;
@@ -54,9 +66,11 @@ public:
 private:
     void doEvict() override;
     void doMakeResident(tasking::Deserializer& deserializer) override;
+    void doSubmitLoad(tasking::Deserializer& deserializer) override;
+    void doCancelLoad(tasking::Deserializer& deserializer) override;
 
 private:
-    std::optional<WiVeBVH8Build8<OfflineBVHLeaf>> m_bvh;
+    std::optional<OfflineBVH> m_bvh;
     Bounds m_bounds;
 
     tasking::Allocation m_bvhSerializeAllocation;
@@ -69,6 +83,8 @@ class CachedBVHSubScene {
 public:
     bool intersect(Ray& ray, SurfaceInteraction& si) const;
     bool intersectAny(Ray& ray) const;
+    void intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const;
+    void intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const;
 
 private:
     friend class LRUBVHSceneCache;
@@ -81,19 +97,26 @@ private:
 
 class LRUBVHSceneCache {
 public:
-    LRUBVHSceneCache(std::span<const SubScene*> subScenes, tasking::LRUCacheTS* pSceneCache, size_t maxSize);
+    // BVHs are reused from / added to the persistent BVH store in persistentBVHStoreFolder (if not empty)
+    LRUBVHSceneCache(std::span<const SubScene*> subScenes, tasking::LRUCacheTS* pSceneCache, size_t maxSize, const std::filesystem::path& persistentBVHStoreFolder = {});
 
     CachedBVHSubScene fromSubScene(const SubScene* pSubScene);
+    // Bytes of the sub scene's BVH (and the BVHs it instances) that are not resident
+    size_t bytesToLoad(const SubScene* pSubScene) const;
 
 private:
     CachedBVH* createBVH(const SceneNode* pSceneNode, tasking::LRUCacheTS* pGeomCache, tasking::CacheBuilder* pCacheBuilder);
     CachedBVH* createBVH(const SubScene* pSubScene, tasking::LRUCacheTS* pGeomCache, tasking::CacheBuilder* pCacheBuilder);
+    OfflineBVH buildOrLoadBVH(std::span<OfflineBVHLeaf> leafs);
 
 private:
     std::unordered_map<const void*, std::unique_ptr<CachedBVH>> m_bvhSceneLUT;
     std::unordered_map<const SubScene*, std::vector<CachedBVH*>> m_childBVHs;
 
     std::optional<tasking::LRUCacheTS> m_lruCache;
+
+    std::optional<PersistentBVHStore> m_persistentBVHStore;
+    size_t m_numPersistentBVHsLoaded { 0 };
 };
 
 }
\ No newline at end of file
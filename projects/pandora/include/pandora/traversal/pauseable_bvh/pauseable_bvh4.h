@@ -5,11 +5,16 @@
 #include "pandora/utility/contiguous_allocator_ts.h"
 #include "simd/intrinsics.h"
 #include "simd/simd4.h"
+#include "simd/simd8.h"
+#include <algorithm>
+#include <array>
 #include <embree3/rtcore.h>
 #include <iostream>
 #include <limits>
+#include <memory_resource>
 #include <nmmintrin.h> // popcnt
 #include <optional>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <tbb/concurrent_vector.h>
 #include <tuple>
@@ -34,11 +39,21 @@ public:
     std::optional<bool> intersectAny(Ray& ray, const AnyHitRayState& userState) const override final;
     std::optional<bool> intersectAny(Ray& ray, const AnyHitRayState& userState, PauseableBVHInsertHandle handle) const override final;
 
+    // Resume traversal of a batch of paused rays. Items are tuples of (Ray, SurfaceInteraction, HitRayState, PauseableBVHInsertHandle)
+    // or (Ray, AnyHitRayState, PauseableBVHInsertHandle) respectively. Rays that are at the same node are tested against its
+    // children together. outResults[i] receives the value that intersect(Any) would have returned for the i'th item.
+    template <typename T>
+    void intersectBatch(std::span<T> items, std::span<std::optional<bool>> outResults, std::pmr::memory_resource* pMemoryResource) const;
+    template <typename T>
+    void intersectAnyBatch(std::span<T> items, std::span<std::optional<bool>> outResults, std::pmr::memory_resource* pMemoryResource) const;
+
     std::span<LeafObj> leafs() { return m_leafs; }
 
 private:
     template <bool AnyHit, typename UserState>
     std::optional<bool> intersectT(Ray& ray, SurfaceInteraction& hitInfo, const UserState& userState, PauseableBVHInsertHandle insertInfo) const;
+    template <bool AnyHit, typename T>
+    void intersectBatchT(std::span<T> items, std::span<std::optional<bool>> outResults, std::pmr::memory_resource* pMemoryResource) const;
 
     struct TestBVHData {
         int numPrimitives = 0;
@@ -354,6 +369,234 @@ inline std::optional<bool> PauseableBVH4<LeafObj, HitRayState, AnyHitRayState>::
     return hit;
 }
 
+template <typename LeafObj, typename HitRayState, typename AnyHitRayState>
+template <typename T>
+inline void PauseableBVH4<LeafObj, HitRayState, AnyHitRayState>::intersectBatch(std::span<T> items, std::span<std::optional<bool>> outResults, std::pmr::memory_resource* pMemoryResource) const
+{
+    intersectBatchT<false>(items, outResults, pMemoryResource);
+}
+
+template <typename LeafObj, typename HitRayState, typename AnyHitRayState>
+template <typename T>
+inline void PauseableBVH4<LeafObj, HitRayState, AnyHitRayState>::intersectAnyBatch(std::span<T> items, std::span<std::optional<bool>> outResults, std::pmr::memory_resource* pMemoryResource) const
+{
+    intersectBatchT<true>(items, outResults, pMemoryResource);
+}
+
+template <typename LeafObj, typename HitRayState, typename AnyHitRayState>
+template <bool AnyHit, typename T>
+inline void PauseableBVH4<LeafObj, HitRayState, AnyHitRayState>::intersectBatchT(std::span<T> items, std::span<std::optional<bool>> outResults, std::pmr::memory_resource* pMemoryResource) const
+{
+    assert(items.size() == outResults.size());
+    const uint32_t numRays = static_cast<uint32_t>(items.size());
+
+    // Per ray traversal state. The ray data is stored in SOA form so that 8 rays can be tested against a node at once.
+    std::pmr::vector<float> originX(numRays, pMemoryResource), originY(numRays, pMemoryResource), originZ(numRays, pMemoryResource);
+    std::pmr::vector<float> invDirectionX(numRays, pMemoryResource), invDirectionY(numRays, pMemoryResource), invDirectionZ(numRays, pMemoryResource);
+    std::pmr::vector<float> tnear(numRays, pMemoryResource), tfar(numRays, pMemoryResource);
+    std::pmr::vector<uint64_t> stacks(numRays, pMemoryResource);
+    std::pmr::vector<uint8_t> hits(numRays, pMemoryResource);
+
+    // Rays are grouped by the node they are currently at. A group refers to a range of rayIDs; groups are processed in
+    // LIFO order such that the memory of the group that is being processed can be reused by the groups that it creates.
+    struct RayGroup {
+        uint32_t nodeHandle;
+        uint32_t firstRay;
+        uint32_t numRays;
+    };
+    std::pmr::vector<RayGroup> groupStack { pMemoryResource };
+    std::pmr::vector<uint32_t> groupRayIDs { pMemoryResource };
+    {
+        std::pmr::vector<std::pair<uint32_t, uint32_t>> initialNodes { pMemoryResource };
+        initialNodes.reserve(numRays);
+        for (uint32_t rayID = 0; rayID < numRays; rayID++) {
+            const Ray& ray = std::get<0>(items[rayID]);
+            const glm::vec3 invDir = 1.0f / ray.direction;
+            originX[rayID] = ray.origin.x;
+            originY[rayID] = ray.origin.y;
+            originZ[rayID] = ray.origin.z;
+            invDirectionX[rayID] = invDir.x;
+            invDirectionY[rayID] = invDir.y;
+            invDirectionZ[rayID] = invDir.z;
+            tnear[rayID] = ray.tnear;
+            tfar[rayID] = ray.tfar;
+            hits[rayID] = false;
+
+            const auto [nodeHandle, stack] = std::get<std::tuple_size_v<T> - 1>(items[rayID]);
+            stacks[rayID] = stack;
+            initialNodes.push_back({ nodeHandle, rayID });
+        }
+
+        // Rays that were paused at the same batching point share most of their path back up the tree
+        std::sort(std::begin(initialNodes), std::end(initialNodes));
+        groupRayIDs.reserve(numRays);
+        for (const auto& [nodeHandle, rayID] : initialNodes) {
+            if (groupStack.empty() || groupStack.back().nodeHandle != nodeHandle)
+                groupStack.push_back({ nodeHandle, static_cast<uint32_t>(groupRayIDs.size()), 0 });
+            groupRayIDs.push_back(rayID);
+            groupStack.back().numRays++;
+        }
+    }
+
+    std::pmr::vector<uint32_t> currentRayIDs { pMemoryResource };
+    std::pmr::vector<uint32_t> parentRayIDs { pMemoryResource }, sameNodeRayIDs { pMemoryResource };
+    std::array<std::pmr::vector<uint32_t>, 4> childRayIDs { std::pmr::vector<uint32_t> { pMemoryResource }, std::pmr::vector<uint32_t> { pMemoryResource },
+        std::pmr::vector<uint32_t> { pMemoryResource }, std::pmr::vector<uint32_t> { pMemoryResource } };
+    const auto pushGroup = [&](uint32_t nodeHandle, const std::pmr::vector<uint32_t>& rayIDs) {
+        if (rayIDs.empty())
+            return;
+        groupStack.push_back({ nodeHandle, static_cast<uint32_t>(groupRayIDs.size()), static_cast<uint32_t>(rayIDs.size()) });
+        groupRayIDs.insert(std::end(groupRayIDs), std::begin(rayIDs), std::end(rayIDs));
+    };
+
+    while (!groupStack.empty()) {
+        const RayGroup group = groupStack.back();
+        groupStack.pop_back();
+        currentRayIDs.assign(std::begin(groupRayIDs) + group.firstRay, std::begin(groupRayIDs) + group.firstRay + group.numRays);
+        groupRayIDs.resize(group.firstRay);
+
+        parentRayIDs.clear();
+        sameNodeRayIDs.clear();
+        for (auto& rayIDs : childRayIDs)
+            rayIDs.clear();
+
+        const uint32_t nodeHandle = group.nodeHandle;
+        const BVHNode* node = &m_bvhNodes[nodeHandle];
+        const int bitPos = 4 * node->depth;
+
+        alignas(16) std::array<float, 4> childMinX, childMinY, childMinZ, childMaxX, childMaxY, childMaxZ;
+        node->minX.storeAligned(childMinX);
+        node->minY.storeAligned(childMinY);
+        node->minZ.storeAligned(childMinZ);
+        node->maxX.storeAligned(childMaxX);
+        node->maxY.storeAligned(childMaxY);
+        node->maxZ.storeAligned(childMaxZ);
+
+        for (size_t firstRay = 0; firstRay < currentRayIDs.size(); firstRay += 8) {
+            const uint32_t numRaysInPacket = static_cast<uint32_t>(std::min(currentRayIDs.size() - firstRay, size_t(8)));
+
+            // Gather the rays into a SIMD packet (unused lanes duplicate the first ray)
+            alignas(32) std::array<float, 8> packetOriginX, packetOriginY, packetOriginZ;
+            alignas(32) std::array<float, 8> packetInvDirectionX, packetInvDirectionY, packetInvDirectionZ;
+            alignas(32) std::array<float, 8> packetTNear, packetTFar;
+            for (uint32_t lane = 0; lane < 8; lane++) {
+                const uint32_t rayID = currentRayIDs[firstRay + (lane < numRaysInPacket ? lane : 0)];
+                packetOriginX[lane] = originX[rayID];
+                packetOriginY[lane] = originY[rayID];
+                packetOriginZ[lane] = originZ[rayID];
+                packetInvDirectionX[lane] = invDirectionX[rayID];
+                packetInvDirectionY[lane] = invDirectionY[rayID];
+                packetInvDirectionZ[lane] = invDirectionZ[rayID];
+                packetTNear[lane] = tnear[rayID];
+                packetTFar[lane] = tfar[rayID];
+            }
+            const simd::vec8_f32 rayOriginX { packetOriginX }, rayOriginY { packetOriginY }, rayOriginZ { packetOriginZ };
+            const simd::vec8_f32 rayInvDirectionX { packetInvDirectionX }, rayInvDirectionY { packetInvDirectionY }, rayInvDirectionZ { packetInvDirectionZ };
+            const simd::vec8_f32 rayTNear { packetTNear }, rayTFar { packetTFar };
+
+            // Test the packet against each of the children of the node
+            std::array<uint32_t, 4> childHitMasks { 0, 0, 0, 0 };
+            alignas(32) std::array<std::array<float, 8>, 4> childTMin;
+            for (unsigned childIdx = 0; childIdx < 4; childIdx++) {
+                if (!(node->validMask & (1 << childIdx)))
+                    continue;
+
+                const simd::vec8_f32 tx1 = (simd::vec8_f32(childMinX[childIdx]) - rayOriginX) * rayInvDirectionX;
+                const simd::vec8_f32 tx2 = (simd::vec8_f32(childMaxX[childIdx]) - rayOriginX) * rayInvDirectionX;
+                const simd::vec8_f32 ty1 = (simd::vec8_f32(childMinY[childIdx]) - rayOriginY) * rayInvDirectionY;
+                const simd::vec8_f32 ty2 = (simd::vec8_f32(childMaxY[childIdx]) - rayOriginY) * rayInvDirectionY;
+                const simd::vec8_f32 tz1 = (simd::vec8_f32(childMinZ[childIdx]) - rayOriginZ) * rayInvDirectionZ;
+                const simd::vec8_f32 tz2 = (simd::vec8_f32(childMaxZ[childIdx]) - rayOriginZ) * rayInvDirectionZ;
+                const simd::vec8_f32 tmin = simd::max(rayTNear, simd::max(simd::min(tx1, tx2), simd::max(simd::min(ty1, ty2), simd::min(tz1, tz2))));
+                const simd::vec8_f32 tmax = simd::min(rayTFar, simd::min(simd::max(tx1, tx2), simd::min(simd::max(ty1, ty2), simd::max(tz1, tz2))));
+                childHitMasks[childIdx] = static_cast<uint32_t>((tmin <= tmax).bitMask());
+                tmin.storeAligned(childTMin[childIdx]);
+            }
+
+            for (uint32_t lane = 0; lane < numRaysInPacket; lane++) {
+                const uint32_t rayID = currentRayIDs[firstRay + lane];
+                uint64_t& stack = stacks[rayID];
+
+                // Identical to the single ray traversal code (intersectT) from here on
+                const uint64_t interestBitMask = (stack >> bitPos) & 0b1111;
+                uint64_t toVisitBitMask = 0;
+                for (unsigned childIdx = 0; childIdx < 4; childIdx++) {
+                    if ((childHitMasks[childIdx] >> lane) & 0x1)
+                        toVisitBitMask |= 1llu << childIdx;
+                }
+                toVisitBitMask &= interestBitMask;
+
+                if (toVisitBitMask == 0) {
+                    // No children left to visit; find the first ancestor that has work left
+                    stack = stack | (0xFFFFFFFFFFFFFFFF << bitPos);
+                    if (stack == 0xFFFFFFFFFFFFFFFF)
+                        outResults[rayID] = static_cast<bool>(hits[rayID]);
+                    else
+                        parentRayIDs.push_back(rayID);
+                    continue;
+                }
+
+                // Find nearest active child for this ray
+                unsigned childIndex;
+                if constexpr (AnyHit) {
+                    childIndex = simd::bitScan4(static_cast<uint32_t>(toVisitBitMask));
+                } else {
+                    childIndex = 4;
+                    float minDistance = std::numeric_limits<float>::max();
+                    for (unsigned childIdx = 0; childIdx < 4; childIdx++) {
+                        if ((toVisitBitMask & (1llu << childIdx)) && (childIndex == 4 || childTMin[childIdx][lane] < minDistance)) {
+                            childIndex = childIdx;
+                            minDistance = childTMin[childIdx][lane];
+                        }
+                    }
+                }
+                assert(childIndex < 4);
+
+                toVisitBitMask ^= (1llu << childIndex);
+                stack = stack ^ (interestBitMask << bitPos);
+                stack = stack | (toVisitBitMask << bitPos);
+
+                if (node->isInnerNode(childIndex)) {
+                    childRayIDs[childIndex].push_back(rayID);
+                    continue;
+                }
+
+                // Reached leaf
+                const auto& leaf = m_leafs[node->getLeafChildHandle(childIndex)];
+                Ray& ray = std::get<0>(items[rayID]);
+                if constexpr (AnyHit) {
+                    auto optResult = leaf.intersectAny(ray, std::get<1>(items[rayID]), { nodeHandle, stack });
+                    if (!optResult || *optResult) {
+                        outResults[rayID] = optResult; // Ray was paused or found a hit
+                        continue;
+                    }
+                } else {
+                    auto& si = std::get<1>(items[rayID]);
+                    auto optResult = leaf.intersect(ray, si, std::get<2>(items[rayID]), { nodeHandle, stack });
+                    if (!optResult) {
+                        outResults[rayID] = {}; // Ray was paused
+                        continue;
+                    }
+
+                    if (*optResult) {
+                        hits[rayID] = true;
+                        tfar[rayID] = ray.tfar;
+                    }
+                }
+                sameNodeRayIDs.push_back(rayID);
+            }
+        }
+
+        // Push the children last so that they are processed first (depth first)
+        pushGroup(node->parentHandle, parentRayIDs);
+        pushGroup(nodeHandle, sameNodeRayIDs);
+        for (unsigned childIdx = 0; childIdx < 4; childIdx++) {
+            if (node->isInnerNode(childIdx))
+                pushGroup(node->getInnerChildHandle(childIdx), childRayIDs[childIdx]);
+        }
+    }
+}
+
 template <typename LeafObj, typename HitRayState, typename AnyHitRayState>
 inline void PauseableBVH4<LeafObj, HitRayState, AnyHitRayState>::testBVH() const
 {
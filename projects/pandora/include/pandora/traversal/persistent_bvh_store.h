@@ -0,0 +1,44 @@
+#pragma once
+#include "pandora/graphics_core/bounds.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mio/mmap.hpp>
+#include <optional>
+#include <span>
+
+namespace pandora {
+
+// Folder with serialized (WiVeBVH8 flatbuffers) bot level BVHs that is kept across runs. A BVH is identified by a
+// hash of the bounds of its leafs (which is all the BVH builder looks at) and the BVH configuration in config.h.
+// Any scene which produces the same leafs can reuse the BVH, regardless of the camera, integrator or sample count.
+class PersistentBVHStore {
+public:
+    PersistentBVHStore(std::filesystem::path folder);
+
+    using Key = uint64_t;
+    static Key computeKey(std::span<const Bounds> leafBounds);
+
+    // Format of the BVH that the caller expects (see WiVeBVH8::serializationVersion)
+    struct Format {
+        uint32_t version;
+        uint32_t branchingFactor;
+        bool quantizedNodes;
+    };
+
+    // Returns the serialized BVH if it was stored by an earlier run, it passes flatbuffer verification and it has the
+    // expected format. Anything else (including a BVH stored by a different version of Pandora) is a miss.
+    std::optional<mio::mmap_source> load(Key key, size_t numLeafs, const Format& format) const;
+    void store(Key key, std::span<const std::byte> serializedBVH) const;
+
+private:
+    std::filesystem::path filePath(Key key) const;
+
+private:
+    // Increment whenever the serialized BVH format changes (in addition to WiVeBVH8::serializationVersion)
+    constexpr static uint32_t storeVersion = 1;
+
+    std::filesystem::path m_folder;
+};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "pandora/core/stats.h"
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/ray.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace pandora::detail {
+
+// Sort key consisting of the ray direction octant (3 most significant bits) followed by a 27 bit Morton code
+// of the point at which the ray enters the batching point (quantized relative to its bounds).
+uint32_t computeRaySortKey(const Ray& ray, const Bounds& batchingPointBounds);
+
+// Reorder a batch of rays (stored as tuples with the ray as first element) such that rays with a similar
+// direction and entry point are traced after one another.
+template <typename T>
+void sortRayBatch(std::span<T> data, const Bounds& batchingPointBounds, std::pmr::memory_resource* pMemoryResource)
+{
+    auto stopWatch = g_stats.timings.raySortTime.getScopedStopwatch();
+
+    std::pmr::vector<std::pair<uint32_t, uint32_t>> keys { pMemoryResource };
+    keys.reserve(data.size());
+    for (uint32_t i = 0; i < static_cast<uint32_t>(data.size()); i++)
+        keys.push_back({ computeRaySortKey(std::get<0>(data[i]), batchingPointBounds), i });
+    std::sort(std::begin(keys), std::end(keys));
+
+    std::pmr::vector<T> sortedData { pMemoryResource };
+    sortedData.reserve(data.size());
+    for (const auto& [key, index] : keys)
+        sortedData.push_back(std::move(data[index]));
+    std::move(std::begin(sortedData), std::end(sortedData), std::begin(data));
+
+    g_stats.raySorting.numBatchesSorted++;
+    g_stats.raySorting.numRaysSorted += data.size();
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "pandora/graphics_core/pandora.h"
+#include "pandora/svo/sparse_voxel_dag.h"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace pandora {
+
+// Memory-mappable file with the results of the expensive, scene dependent steps of building a batching acceleration
+// structure: the assignment of (preprocessed) scene objects to batching points and the SVDAGs of those batching points.
+// A bundle is identified by the scene file (path & modification time), the bounds and primitive counts of the unique
+// scene objects and the builder settings, so it is only reused when the same scene is loaded & split exactly the same
+// way as when it was stored.
+class SceneBundle {
+public:
+    SceneBundle(std::filesystem::path filePath);
+
+    using Key = uint64_t;
+    static Key computeKey(const Scene& scene, const std::filesystem::path& sceneFile, unsigned primitivesPerBatchingPoint, unsigned svdagRes);
+
+    struct Contents {
+        std::vector<std::vector<const SceneObject*>> sceneObjectGroups;
+        std::vector<SparseVoxelDAG> svdags; // Empty if the bundle was stored without SVDAGs
+    };
+    // Returns an empty optional if there is no bundle, it does not match the key or its contents are invalid
+    std::optional<Contents> load(Key key, const Scene& scene) const;
+    void store(Key key, const Scene& scene, std::span<const std::vector<const SceneObject*>> sceneObjectGroups, std::span<const SparseVoxelDAG* const> svdags) const;
+
+private:
+    // Increment whenever the contents of the bundle change
+    constexpr static uint32_t bundleVersion = 1;
+
+    std::filesystem::path m_filePath;
+};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "pandora/core/stats.h"
+#include "pandora/graphics_core/ray.h"
+#include "pandora/svo/sparse_voxel_dag.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <utility>
+
+namespace pandora::detail {
+
+// Intersect a batch of rays (stored as tuples with the ray as first element) with the SVDAG, 8 rays at a time.
+// The batch is reordered such that the rays that hit the SVDAG come first (in their original order) followed by
+// the culled rays. Returns the number of rays that hit the SVDAG.
+template <typename T>
+size_t cullRayBatch(const SparseVoxelDAG& svdag, std::span<T> data)
+{
+    auto stopWatch = g_stats.timings.svdagTraversalTime.getScopedStopwatch();
+
+    size_t numHits = 0;
+    std::array<Ray, 8> rays;
+    for (size_t start = 0; start < data.size(); start += rays.size()) {
+        const size_t count = std::min(rays.size(), data.size() - start);
+        for (size_t i = 0; i < count; i++)
+            rays[i] = std::get<0>(data[start + i]);
+
+        const uint32_t hitMask = svdag.intersect8(std::span(rays.data(), count));
+        for (size_t i = 0; i < count; i++) {
+            // All items in the range [numHits, start + i) were culled so this keeps the hits in order
+            if (hitMask & (1u << i))
+                std::swap(data[numHits++], data[start + i]);
+        }
+    }
+
+    g_stats.svdag.numIntersectionTests += data.size();
+    g_stats.svdag.numRaysCulled += data.size() - numHits;
+    return numHits;
+}
+
+}
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/component_wise.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <cstring> // memcpy
 
 namespace pandora {
@@ -237,4 +238,30 @@ inline float intAsFloat(int v)
     return r;
 }
 
+// Octahedral normal encoding ("A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.)
+inline glm::i16vec2 encodeOctahedral(glm::vec3 n)
+{
+    const float l1Norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1Norm == 0.0f)
+        return glm::i16vec2(0);
+
+    n /= l1Norm;
+    glm::vec2 e { n.x, n.y };
+    if (n.z < 0.0f) {
+        e.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        e.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return glm::i16vec2(glm::round(glm::clamp(e, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline glm::vec3 decodeOctahedral(glm::i16vec2 encoded)
+{
+    const glm::vec2 e = glm::vec2(encoded) * (1.0f / 32767.0f);
+    glm::vec3 n { e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y) };
+    const float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
 }
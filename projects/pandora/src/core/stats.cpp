@@ -18,9 +18,17 @@ nlohmann::json RenderStats::getMetricsSnapshot() const
     ret["config"]["spp"] = config.spp;
     ret["config"]["concurrency"] = config.concurrency;
     ret["config"]["schedulers"] = config.schedulers;
+    ret["config"]["ray_memory_budget"] = config.rayMemoryBudget;
+    ret["config"]["ray_spill_threshold"] = config.raySpillThreshold;
+    ret["config"]["prefetch_tasks"] = config.prefetchTasks;
+    ret["config"]["scheduling_policy"] = config.schedulingPolicy;
+    ret["config"]["execution_mode"] = config.executionMode;
+    ret["config"]["numa_nodes"] = config.numaNodes;
     ret["config"]["concurrency"] = config.concurrency;
     ret["config"]["svdagres"] = config.svdagRes;
+    ret["config"]["sort_rays"] = config.sortRays;
 
+    ret["config"]["ooc"]["io_uring"] = config.ioUring;
     ret["config"]["ooc"]["geom_cache_size"] = config.geomCacheSize;
     ret["config"]["ooc"]["bvh_cache_size"] = config.bvhCacheSize;
     ret["config"]["ooc"]["prims_per_batching_point"] = config.primGroupSize;
@@ -40,6 +48,7 @@ nlohmann::json RenderStats::getMetricsSnapshot() const
     ret["timings"]["bot_level_traversal_time"] = timings.botLevelTraversalTime;
     ret["timings"]["top_level_traversal_time"] = timings.topLevelTraversalTime;
     ret["timings"]["svdag_traversal_time"] = timings.svdagTraversalTime;
+    ret["timings"]["ray_sort_time"] = timings.raySortTime;
 
     ret["memory"]["geometry_loaded"] = memory.geometryLoaded;
     ret["memory"]["geometry_evicted"] = memory.geometryEvicted;
@@ -72,6 +81,9 @@ nlohmann::json RenderStats::getMetricsSnapshot() const
 
     ret["svdag"]["num_intersection_tests"] = svdag.numIntersectionTests;
     ret["svdag"]["num_rays_culled"] = svdag.numRaysCulled;
+
+    ret["ray_sorting"]["num_batches_sorted"] = raySorting.numBatchesSorted;
+    ret["ray_sorting"]["num_rays_sorted"] = raySorting.numRaysSorted;
     return ret;
 }
 
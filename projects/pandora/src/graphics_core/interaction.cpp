@@ -6,6 +6,7 @@
 #include "pandora/lights/area_light.h"
 #include "pandora/utility/math.h"
 #include "pandora/utility/memory_arena.h"
+#include <cassert>
 
 namespace pandora {
 
@@ -20,6 +21,26 @@ SurfaceInteraction::SurfaceInteraction(
     // TODO: adjust normal based on orientation and handedness
 }
 
+CompactSurfaceInteraction::CompactSurfaceInteraction(const SurfaceInteraction& si)
+    : pSceneObject(si.pSceneObject)
+    , position(si.position)
+    , uv(si.uv)
+    , normal(encodeOctahedral(si.normal))
+    , shadingNormal(encodeOctahedral(si.shading.normal))
+    , batchingPointColor(glm::round(glm::clamp(si.shading.batchingPointColor, 0.0f, 1.0f) * 255.0f))
+{
+    assert(si.pBSDF == nullptr);
+}
+
+SurfaceInteraction CompactSurfaceInteraction::decompress(const Ray& ray) const
+{
+    SurfaceInteraction si { position, decodeOctahedral(normal), uv, -ray.direction };
+    si.shading.normal = decodeOctahedral(shadingNormal);
+    si.shading.batchingPointColor = glm::vec3(batchingPointColor) / 255.0f;
+    si.pSceneObject = pSceneObject;
+    return si;
+}
+
 // PBRTv3 page 232
 Ray Interaction::spawnRay(const glm::vec3& d) const
 {
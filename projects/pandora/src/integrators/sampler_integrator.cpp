@@ -34,6 +34,7 @@ void SamplerIntegrator::render(int concurrentPaths, const PerspectiveCamera& cam
     pRenderData->pCamera = &camera;
     pRenderData->pSensor = &sensor;
     pRenderData->currentRayIndex.store(0);
+    pRenderData->numDeferredPaths.store(0);
     pRenderData->seed = PcgRng(seed).uniformU64();
     pRenderData->resolution = resolution;
     pRenderData->fResolution = glm::vec2(resolution);
@@ -59,12 +60,14 @@ void SamplerIntegrator::render(int concurrentPaths, const PerspectiveCamera& cam
     collectLightShapes(scene.pRoot.get());
 
     // Spawn initial rays
+    m_pTaskGraph->setDeferredWorkCallback([this]() { return resumeDeferredPaths(); });
     tbb::blocked_range<int> pathsRange { 0, concurrentPaths };
     tbb::parallel_for(pathsRange, [&](tbb::blocked_range<int> localRange) {
         const int numPaths = localRange.end() - localRange.begin();
         spawnNewPaths(numPaths);
     });
     m_pTaskGraph->run();
+    m_pTaskGraph->setDeferredWorkCallback({});
 
     m_pCurrentRenderData->pAOVNumTopLevelIntersections->writeImage("num_top_level_intersections.exr");
 
@@ -128,9 +131,30 @@ void SamplerIntegrator::spawnShadowRay(const Ray& shadowRay, PcgRng& rng, const
     m_pCurrentRenderData->pAccelerationStructure->intersectAny(shadowRay, shadowRayState);
 }
 
+bool SamplerIntegrator::resumeDeferredPaths()
+{
+    const int numPaths = m_pCurrentRenderData->numDeferredPaths.exchange(0);
+    if (numPaths == 0)
+        return false;
+
+    tbb::blocked_range<int> pathsRange { 0, numPaths };
+    tbb::parallel_for(pathsRange, [&](tbb::blocked_range<int> localRange) {
+        spawnNewPaths(localRange.end() - localRange.begin());
+    });
+    return true;
+}
+
 void SamplerIntegrator::spawnNewPaths(int numPaths)
 {
     auto* pRenderData = m_pCurrentRenderData.get();
+
+    // Throttle the number of paths in flight when the ray queues are using too much memory. The paths are spawned
+    // once the task graph has drained the queues (see resumeDeferredPaths).
+    if (m_pTaskGraph->overMemoryBudget()) {
+        pRenderData->numDeferredPaths.fetch_add(numPaths, std::memory_order_relaxed);
+        return;
+    }
+
     const int startIndex = pRenderData->currentRayIndex.fetch_add(numPaths);
     const int maxSample = pRenderData->maxPixelIndex * m_maxSpp;
     const int endIndex = std::min(startIndex + numPaths, pRenderData->maxPixelIndex * m_maxSpp);
@@ -1,7 +1,9 @@
+#include "pandora/config.h"
 #include "pandora/core/stats.h"
 #include "pandora/flatbuffers/data_conversion.h"
 #include "pandora/graphics_core/transform.h"
 #include "pandora/shapes/triangle.h"
+#include "pandora/shapes/triangle_compression.h"
 #include "pandora/utility/error_handling.h"
 #include "pandora/utility/math.h"
 #include <assimp/Importer.hpp>
@@ -10,7 +12,9 @@
 #include <cassert>
 #include <fstream>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <optick.h>
+#include <span>
 #include <spdlog/spdlog.h>
 #include <stack>
 #include <string>
@@ -73,6 +77,110 @@ static std::vector<glm::vec3> transformNormals(std::vector<glm::vec3>&& normals,
 
 namespace pandora {
 
+flatbuffers::Offset<serialization::CompressedTriangleMesh> detail::compressTriangleMesh(
+    flatbuffers::FlatBufferBuilder& builder,
+    const Bounds& bounds,
+    std::span<const glm::uvec3> indices,
+    std::span<const glm::vec3> positions,
+    std::span<const glm::vec3> normals)
+{
+    const glm::vec3 extent = bounds.extent();
+    glm::vec3 scale;
+    for (int axis = 0; axis < 3; axis++)
+        scale[axis] = extent[axis] > 0.0f ? 65535.0f / extent[axis] : 0.0f;
+    std::vector<uint16_t> quantizedPositions;
+    quantizedPositions.reserve(positions.size() * 3);
+    for (const glm::vec3& p : positions) {
+        const glm::vec3 q = glm::clamp(glm::round((p - bounds.min) * scale), 0.0f, 65535.0f);
+        quantizedPositions.push_back(static_cast<uint16_t>(q.x));
+        quantizedPositions.push_back(static_cast<uint16_t>(q.y));
+        quantizedPositions.push_back(static_cast<uint16_t>(q.z));
+    }
+
+    std::vector<int16_t> octahedralNormals;
+    octahedralNormals.reserve(normals.size() * 2);
+    for (const glm::vec3& n : normals) {
+        const glm::i16vec2 e = encodeOctahedral(n);
+        octahedralNormals.push_back(e.x);
+        octahedralNormals.push_back(e.y);
+    }
+
+    // Neighbouring triangles tend to share (or have nearby) vertices so the differences between subsequent
+    // indices are small and mostly fit in a single byte.
+    std::vector<uint8_t> encodedIndices;
+    encodedIndices.reserve(indices.size() * 3);
+    uint32_t previousIndex = 0;
+    for (const glm::uvec3& triangle : indices) {
+        for (int i = 0; i < 3; i++) {
+            const int32_t delta = static_cast<int32_t>(triangle[i] - previousIndex);
+            uint32_t zigzag = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+            while (zigzag >= 0x80) {
+                encodedIndices.push_back(static_cast<uint8_t>(zigzag | 0x80));
+                zigzag >>= 7;
+            }
+            encodedIndices.push_back(static_cast<uint8_t>(zigzag));
+            previousIndex = triangle[i];
+        }
+    }
+
+    auto positionsOffset = builder.CreateVector(quantizedPositions);
+    flatbuffers::Offset<flatbuffers::Vector<int16_t>> normalsOffset = 0;
+    if (!normals.empty())
+        normalsOffset = builder.CreateVector(octahedralNormals);
+    auto indicesOffset = builder.CreateVector(encodedIndices);
+    return serialization::CreateCompressedTriangleMesh(
+        builder,
+        static_cast<uint32_t>(positions.size()),
+        static_cast<uint32_t>(indices.size()),
+        positionsOffset,
+        normalsOffset,
+        indicesOffset);
+}
+
+void detail::decompressTriangleMesh(
+    const serialization::CompressedTriangleMesh* pCompressed,
+    const Bounds& bounds,
+    std::vector<glm::uvec3>& indices,
+    std::vector<glm::vec3>& positions,
+    std::vector<glm::vec3>& normals)
+{
+    const uint32_t numVertices = pCompressed->numVertices();
+
+    // Simple loops over flat arrays so that the compiler can vectorize them.
+    const glm::vec3 scale = bounds.extent() / 65535.0f;
+    const uint16_t* pQuantizedPositions = pCompressed->positions()->data();
+    positions.resize(numVertices);
+    for (uint32_t i = 0; i < numVertices; i++) {
+        const glm::vec3 q { pQuantizedPositions[3 * i + 0], pQuantizedPositions[3 * i + 1], pQuantizedPositions[3 * i + 2] };
+        positions[i] = glm::min(bounds.min + q * scale, bounds.max);
+    }
+
+    if (pCompressed->normals()) {
+        const int16_t* pOctahedralNormals = pCompressed->normals()->data();
+        normals.resize(numVertices);
+        for (uint32_t i = 0; i < numVertices; i++)
+            normals[i] = decodeOctahedral(glm::i16vec2(pOctahedralNormals[2 * i + 0], pOctahedralNormals[2 * i + 1]));
+    }
+
+    const uint8_t* pEncodedIndices = pCompressed->indices()->data();
+    indices.resize(pCompressed->numTriangles());
+    uint32_t previousIndex = 0;
+    for (glm::uvec3& triangle : indices) {
+        for (int i = 0; i < 3; i++) {
+            uint32_t zigzag = 0;
+            uint32_t shift = 0;
+            uint8_t byte;
+            do {
+                byte = *pEncodedIndices++;
+                zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            previousIndex += (zigzag >> 1) ^ (0u - (zigzag & 1));
+            triangle[i] = previousIndex;
+        }
+    }
+}
+
 TriangleShape::TriangleShape(
     std::vector<glm::uvec3>&& indices,
     std::vector<glm::vec3>&& positions,
@@ -80,22 +188,23 @@ TriangleShape::TriangleShape(
     std::vector<glm::vec2>&& texCoords)
     : Shape(true)
     , m_numPrimitives(static_cast<unsigned>(indices.size()))
-    , m_indices(std::move(indices))
-    , m_positions(std::move(positions))
-    , m_normals(std::move(normals))
-    , m_texCoords(std::move(texCoords))
+    , m_indicesStorage(std::move(indices))
+    , m_positionsStorage(std::move(positions))
+    , m_normalsStorage(std::move(normals))
+    , m_texCoordsStorage(std::move(texCoords))
     , m_serializedStateHandle()
 {
+    m_indicesStorage.shrink_to_fit();
+    m_positionsStorage.shrink_to_fit();
+    m_normalsStorage.shrink_to_fit();
+    m_texCoordsStorage.shrink_to_fit();
+    updateViews();
+
     Bounds bounds;
     for (const glm::vec3& p : m_positions)
         bounds.grow(p);
     m_bounds = bounds;
 
-    m_indices.shrink_to_fit();
-    m_positions.shrink_to_fit();
-    m_normals.shrink_to_fit();
-    m_texCoords.shrink_to_fit();
-
     ALWAYS_ASSERT(m_indices.size() < std::numeric_limits<unsigned>::max());
     g_stats.memory.geometryLoaded += sizeBytes();
 }
@@ -108,54 +217,157 @@ TriangleShape::TriangleShape(
     const glm::mat4& transform)
     : Shape(true)
     , m_numPrimitives(static_cast<unsigned>(indices.size()))
-    , m_indices(std::move(indices))
-    , m_positions(transformPoints(std::move(positions), transform))
-    , m_normals(transformNormals(std::move(normals), transform))
-    , m_texCoords(std::move(texCoords))
+    , m_indicesStorage(std::move(indices))
+    , m_positionsStorage(transformPoints(std::move(positions), transform))
+    , m_normalsStorage(transformNormals(std::move(normals), transform))
+    , m_texCoordsStorage(std::move(texCoords))
 {
+    m_indicesStorage.shrink_to_fit();
+    m_positionsStorage.shrink_to_fit();
+    m_normalsStorage.shrink_to_fit();
+    m_texCoordsStorage.shrink_to_fit();
+    updateViews();
+
     Bounds bounds;
     for (const glm::vec3& p : m_positions)
         bounds.grow(p);
     m_bounds = bounds;
 
-    m_indices.shrink_to_fit();
-    m_positions.shrink_to_fit();
-    m_normals.shrink_to_fit();
-    m_texCoords.shrink_to_fit();
-
     ALWAYS_ASSERT(indices.size() < std::numeric_limits<unsigned>::max());
     g_stats.memory.geometryLoaded += sizeBytes();
 }
 
+TriangleShape::TriangleShape(const TriangleShape& other)
+    : Shape(other)
+    , m_bounds(other.m_bounds)
+    , m_numPrimitives(other.m_numPrimitives)
+    , m_indicesStorage(std::begin(other.m_indices), std::end(other.m_indices))
+    , m_positionsStorage(std::begin(other.m_positions), std::end(other.m_positions))
+    , m_normalsStorage(std::begin(other.m_normals), std::end(other.m_normals))
+    , m_texCoordsStorage(std::begin(other.m_texCoords), std::end(other.m_texCoords))
+    , m_serializedStateHandle(other.m_serializedStateHandle)
+{
+    // Always copies the data (even if other points into mapped memory) so that eviction of either is independent.
+    updateViews();
+}
+
+TriangleShape::TriangleShape(TriangleShape&& other)
+    : Shape(std::move(other))
+    , m_bounds(other.m_bounds)
+    , m_numPrimitives(other.m_numPrimitives)
+    , m_indicesStorage(std::move(other.m_indicesStorage))
+    , m_positionsStorage(std::move(other.m_positionsStorage))
+    , m_normalsStorage(std::move(other.m_normalsStorage))
+    , m_texCoordsStorage(std::move(other.m_texCoordsStorage))
+    , m_indices(other.m_indices)
+    , m_positions(other.m_positions)
+    , m_normals(other.m_normals)
+    , m_texCoords(other.m_texCoords)
+    , m_serializedStateHandle(other.m_serializedStateHandle)
+    , m_pDeserializer(other.m_pDeserializer)
+    , m_pMappedData(other.m_pMappedData)
+{
+    // The mapping (if any) is now owned by this shape; other must not unmap it again.
+    other.m_pDeserializer = nullptr;
+    other.m_pMappedData = nullptr;
+    other.updateViews();
+}
+
+TriangleShape::~TriangleShape()
+{
+    unmapSerializedData();
+}
+
+TriangleShape& TriangleShape::operator=(TriangleShape&& other)
+{
+    if (this == &other)
+        return *this;
+
+    unmapSerializedData();
+
+    Shape::operator=(std::move(other));
+    m_bounds = other.m_bounds;
+    m_numPrimitives = other.m_numPrimitives;
+    m_indicesStorage = std::move(other.m_indicesStorage);
+    m_positionsStorage = std::move(other.m_positionsStorage);
+    m_normalsStorage = std::move(other.m_normalsStorage);
+    m_texCoordsStorage = std::move(other.m_texCoordsStorage);
+    m_indices = other.m_indices;
+    m_positions = other.m_positions;
+    m_normals = other.m_normals;
+    m_texCoords = other.m_texCoords;
+    m_serializedStateHandle = other.m_serializedStateHandle;
+    m_pDeserializer = other.m_pDeserializer;
+    m_pMappedData = other.m_pMappedData;
+
+    other.m_pDeserializer = nullptr;
+    other.m_pMappedData = nullptr;
+    other.updateViews();
+    return *this;
+}
+
+void TriangleShape::updateViews()
+{
+    m_indices = m_indicesStorage;
+    m_positions = m_positionsStorage;
+    m_normals = m_normalsStorage;
+    m_texCoords = m_texCoordsStorage;
+}
+
+void TriangleShape::makeStorageOwned()
+{
+    if (!m_pMappedData)
+        return;
+
+    m_indicesStorage.assign(std::begin(m_indices), std::end(m_indices));
+    m_positionsStorage.assign(std::begin(m_positions), std::end(m_positions));
+    m_normalsStorage.assign(std::begin(m_normals), std::end(m_normals));
+    m_texCoordsStorage.assign(std::begin(m_texCoords), std::end(m_texCoords));
+    updateViews();
+
+    unmapSerializedData();
+}
+
+void TriangleShape::unmapSerializedData()
+{
+    if (!m_pMappedData)
+        return;
+
+    m_pDeserializer->unmap(m_pMappedData);
+    m_pDeserializer = nullptr;
+    m_pMappedData = nullptr;
+}
+
 void TriangleShape::subdivide()
 {
     ALWAYS_ASSERT(m_normals.empty() || m_normals.size() == m_positions.size());
     ALWAYS_ASSERT(m_texCoords.empty());
 
     size_t sizeBefore = sizeBytes();
+    makeStorageOwned();
 
-    const size_t initialVertexID = m_positions.size();
+    const size_t initialVertexID = m_positionsStorage.size();
     std::vector<glm::uvec3> outIndices;
-    outIndices.resize(m_indices.size() * 3);
-    m_positions.resize(m_positions.size() + m_indices.size());
-    if (!m_normals.empty()) {
-        m_normals.resize(m_normals.size() + m_indices.size());
-        assert(m_normals.size() == m_positions.size());
+    outIndices.resize(m_indicesStorage.size() * 3);
+    m_positionsStorage.resize(m_positionsStorage.size() + m_indicesStorage.size());
+    if (!m_normalsStorage.empty()) {
+        m_normalsStorage.resize(m_normalsStorage.size() + m_indicesStorage.size());
+        assert(m_normalsStorage.size() == m_positionsStorage.size());
     }
-    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_indices.size()),
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_indicesStorage.size()),
         [&, initialVertexID](tbb::blocked_range<size_t> localRange) {
             for (size_t i = std::begin(localRange); i < std::end(localRange); i++) {
-                const auto triangle = m_indices[i];
-                const glm::vec3 v0 = m_positions[triangle[0]];
-                const glm::vec3 v1 = m_positions[triangle[1]];
-                const glm::vec3 v2 = m_positions[triangle[2]];
+                const auto triangle = m_indicesStorage[i];
+                const glm::vec3 v0 = m_positionsStorage[triangle[0]];
+                const glm::vec3 v1 = m_positionsStorage[triangle[1]];
+                const glm::vec3 v2 = m_positionsStorage[triangle[2]];
                 const glm::vec3 v3 = (v0 + v1 + v2) / 3.0f;
 
-                //const unsigned newVertexID = static_cast<unsigned>(m_positions.size());
+                //const unsigned newVertexID = static_cast<unsigned>(m_positionsStorage.size());
                 const unsigned newVertexID = static_cast<unsigned>(initialVertexID + i);
-                m_positions[newVertexID] = v3;
-                if (!m_normals.empty()) {
-                    m_normals[newVertexID] = glm::normalize(m_normals[triangle[0]] + m_normals[triangle[1]] + m_normals[triangle[2]]);
+                m_positionsStorage[newVertexID] = v3;
+                if (!m_normalsStorage.empty()) {
+                    m_normalsStorage[newVertexID] = glm::normalize(m_normalsStorage[triangle[0]] + m_normalsStorage[triangle[1]] + m_normalsStorage[triangle[2]]);
                 }
 
                 const size_t firstTriangleID = i * 3;
@@ -181,10 +393,11 @@ void TriangleShape::subdivide()
         outIndices.push_back({ triangle[1], triangle[2], newVertexID });
         outIndices.push_back({ triangle[2], triangle[0], newVertexID });
     }*/
-    m_indices = std::move(outIndices);
-    m_indices.shrink_to_fit();
-    m_positions.shrink_to_fit();
-    m_normals.shrink_to_fit();
+    m_indicesStorage = std::move(outIndices);
+    m_indicesStorage.shrink_to_fit();
+    m_positionsStorage.shrink_to_fit();
+    m_normalsStorage.shrink_to_fit();
+    updateViews();
 
     ALWAYS_ASSERT(m_indices.size() < std::numeric_limits<unsigned>::max());
     m_numPrimitives = static_cast<unsigned>(m_indices.size());
@@ -198,15 +411,27 @@ void TriangleShape::doEvict()
 
     g_stats.memory.geometryEvicted += sizeBytes();
 
-    m_indices.clear();
-    m_positions.clear();
-    m_normals.clear();
-    m_texCoords.clear();
+    m_indicesStorage.clear();
+    m_positionsStorage.clear();
+    m_normalsStorage.clear();
+    m_texCoordsStorage.clear();
+
+    m_indicesStorage.shrink_to_fit();
+    m_positionsStorage.shrink_to_fit();
+    m_normalsStorage.shrink_to_fit();
+    m_texCoordsStorage.shrink_to_fit();
+    updateViews();
+    unmapSerializedData();
+}
+
+void TriangleShape::doSubmitLoad(tasking::Deserializer& deserializer)
+{
+    deserializer.submit(m_serializedStateHandle);
+}
 
-    m_indices.shrink_to_fit();
-    m_positions.shrink_to_fit();
-    m_normals.shrink_to_fit();
-    m_texCoords.shrink_to_fit();
+void TriangleShape::doCancelLoad(tasking::Deserializer& deserializer)
+{
+    deserializer.cancel(m_serializedStateHandle);
 }
 
 void TriangleShape::doMakeResident(tasking::Deserializer& deserializer)
@@ -217,52 +442,70 @@ void TriangleShape::doMakeResident(tasking::Deserializer& deserializer)
     const void* pData = deserializer.map(m_serializedStateHandle);
     const auto* pSerializedTriangleMesh = serialization::GetTriangleMesh(pData);
 
-    m_indices.resize(pSerializedTriangleMesh->indices()->size());
-    std::transform(
-        pSerializedTriangleMesh->indices()->begin(),
-        pSerializedTriangleMesh->indices()->end(),
-        std::begin(m_indices),
-        [](const serialization::Vec3u* t) {
-            return deserialize(*t);
-        });
-    m_indices.shrink_to_fit();
-
-    m_positions.resize(pSerializedTriangleMesh->positions()->size());
-    std::transform(
-        pSerializedTriangleMesh->positions()->begin(),
-        pSerializedTriangleMesh->positions()->end(),
-        std::begin(m_positions),
-        [](const serialization::Vec3* p) {
-            return deserialize(*p);
-        });
-    m_positions.shrink_to_fit();
+    const auto* pCompressed = pSerializedTriangleMesh->compressed();
+    if (ENABLE_ZERO_COPY_GEOMETRY && !pCompressed) {
+        // The flatbuffer structs have the same layout as their glm counterparts so we can point straight into the
+        // mapped data. It stays mapped until the shape is evicted.
+        const auto* pIndices = pSerializedTriangleMesh->indices();
+        m_indices = std::span(reinterpret_cast<const glm::uvec3*>(pIndices->data()), pIndices->size());
+        const auto* pPositions = pSerializedTriangleMesh->positions();
+        m_positions = std::span(reinterpret_cast<const glm::vec3*>(pPositions->data()), pPositions->size());
+        if (const auto* pNormals = pSerializedTriangleMesh->normals())
+            m_normals = std::span(reinterpret_cast<const glm::vec3*>(pNormals->data()), pNormals->size());
+        if (const auto* pTexCoords = pSerializedTriangleMesh->texCoords())
+            m_texCoords = std::span(reinterpret_cast<const glm::vec2*>(pTexCoords->data()), pTexCoords->size());
+
+        m_pDeserializer = &deserializer;
+        m_pMappedData = pData;
+    } else {
+        if (pCompressed) {
+            detail::decompressTriangleMesh(pCompressed, m_bounds, m_indicesStorage, m_positionsStorage, m_normalsStorage);
+        } else {
+            m_indicesStorage.resize(pSerializedTriangleMesh->indices()->size());
+            std::transform(
+                pSerializedTriangleMesh->indices()->begin(),
+                pSerializedTriangleMesh->indices()->end(),
+                std::begin(m_indicesStorage),
+                [](const serialization::Vec3u* t) {
+                    return deserialize(*t);
+                });
+
+            m_positionsStorage.resize(pSerializedTriangleMesh->positions()->size());
+            std::transform(
+                pSerializedTriangleMesh->positions()->begin(),
+                pSerializedTriangleMesh->positions()->end(),
+                std::begin(m_positionsStorage),
+                [](const serialization::Vec3* p) {
+                    return deserialize(*p);
+                });
+
+            if (pSerializedTriangleMesh->normals()) {
+                m_normalsStorage.resize(pSerializedTriangleMesh->normals()->size());
+                std::transform(
+                    pSerializedTriangleMesh->normals()->begin(),
+                    pSerializedTriangleMesh->normals()->end(),
+                    std::begin(m_normalsStorage),
+                    [](const serialization::Vec3* n) {
+                        return deserialize(*n);
+                    });
+            }
+        }
 
-    if (pSerializedTriangleMesh->normals()) {
-        m_normals.resize(pSerializedTriangleMesh->normals()->size());
-        std::transform(
-            pSerializedTriangleMesh->normals()->begin(),
-            pSerializedTriangleMesh->normals()->end(),
-            std::begin(m_normals),
-            [](const serialization::Vec3* n) {
-                return deserialize(*n);
-            });
-        m_normals.shrink_to_fit();
-    }
+        if (pSerializedTriangleMesh->texCoords()) {
+            m_texCoordsStorage.resize(pSerializedTriangleMesh->texCoords()->size());
+            std::transform(
+                pSerializedTriangleMesh->texCoords()->begin(),
+                pSerializedTriangleMesh->texCoords()->end(),
+                std::begin(m_texCoordsStorage),
+                [](const serialization::Vec2* uv) {
+                    return deserialize(*uv);
+                });
+        }
+        updateViews();
 
-    if (pSerializedTriangleMesh->texCoords()) {
-        m_texCoords.resize(pSerializedTriangleMesh->texCoords()->size());
-        std::transform(
-            pSerializedTriangleMesh->texCoords()->begin(),
-            pSerializedTriangleMesh->texCoords()->end(),
-            std::begin(m_texCoords),
-            [](const serialization::Vec2* uv) {
-                return deserialize(*uv);
-            });
-        m_texCoords.shrink_to_fit();
+        deserializer.unmap(pData);
     }
 
-    deserializer.unmap(pData);
-
     g_stats.memory.geometryLoaded += sizeBytes() - sizeBefore;
 }
 
@@ -521,14 +764,23 @@ std::vector<TriangleShape> TriangleShape::loadFromFile(std::filesystem::path fil
 void TriangleShape::serialize(tasking::Serializer& serializer)
 {
     flatbuffers::FlatBufferBuilder builder;
-    auto triangles = builder.CreateVectorOfStructs(
-        reinterpret_cast<const serialization::Vec3u*>(m_indices.data()), m_indices.size());
-    auto positions = builder.CreateVectorOfStructs(
-        reinterpret_cast<const serialization::Vec3*>(m_positions.data()), m_positions.size());
+    flatbuffers::Offset<flatbuffers::Vector<const serialization::Vec3u*>> triangles = 0;
+    flatbuffers::Offset<flatbuffers::Vector<const serialization::Vec3*>> positions = 0;
     flatbuffers::Offset<flatbuffers::Vector<const serialization::Vec3*>> normals = 0;
-    if (!m_normals.empty())
-        normals = builder.CreateVectorOfStructs(
-            reinterpret_cast<const serialization::Vec3*>(m_normals.data()), m_normals.size());
+    flatbuffers::Offset<serialization::CompressedTriangleMesh> compressed = 0;
+    if constexpr (ENABLE_COMPRESSED_GEOMETRY) {
+        compressed = detail::compressTriangleMesh(builder, m_bounds, m_indices, m_positions, m_normals);
+    } else {
+        // Flatbuffers are built back to front: creating the indices first places them after the positions, which
+        // provides the padding that Embree requires after the last vertex when sharing the mapped buffer (zero-copy).
+        triangles = builder.CreateVectorOfStructs(
+            reinterpret_cast<const serialization::Vec3u*>(m_indices.data()), m_indices.size());
+        positions = builder.CreateVectorOfStructs(
+            reinterpret_cast<const serialization::Vec3*>(m_positions.data()), m_positions.size());
+        if (!m_normals.empty())
+            normals = builder.CreateVectorOfStructs(
+                reinterpret_cast<const serialization::Vec3*>(m_normals.data()), m_normals.size());
+    }
     flatbuffers::Offset<flatbuffers::Vector<const serialization::Vec2*>> texCoords = 0;
     if (!m_texCoords.empty())
         texCoords = builder.CreateVectorOfStructs(
@@ -541,7 +793,8 @@ void TriangleShape::serialize(tasking::Serializer& serializer)
         positions,
         normals,
         texCoords,
-        &bounds);
+        &bounds,
+        compressed);
     builder.Finish(triangleMesh);
 
     const void* pSerializedBuffer = builder.GetBufferPointer();
@@ -559,39 +812,45 @@ TriangleShape TriangleShape::loadSerialized(const serialization::TriangleMesh* p
     Transform transform(transformMatrix);
 
     std::vector<glm::uvec3> indices;
-    indices.resize(pSerializedTriangleMesh->indices()->size());
-    std::transform(
-        pSerializedTriangleMesh->indices()->begin(),
-        pSerializedTriangleMesh->indices()->end(),
-        std::begin(indices),
-        [](const serialization::Vec3u* t) {
-            return deserialize(*t);
-        });
-    indices.shrink_to_fit();
-
     std::vector<glm::vec3> positions;
-    positions.resize(pSerializedTriangleMesh->positions()->size());
-    std::transform(
-        pSerializedTriangleMesh->positions()->begin(),
-        pSerializedTriangleMesh->positions()->end(),
-        std::begin(positions),
-        [&](const serialization::Vec3* p) {
-            return transform.transformPointToWorld(deserialize(*p));
-        });
-    positions.shrink_to_fit();
-
     std::vector<glm::vec3> normals;
-    if (pSerializedTriangleMesh->normals()) {
-        normals.resize(pSerializedTriangleMesh->normals()->size());
+    if (const auto* pCompressed = pSerializedTriangleMesh->compressed()) {
+        detail::decompressTriangleMesh(pCompressed, Bounds(*pSerializedTriangleMesh->bounds()), indices, positions, normals);
+        positions = transformPoints(std::move(positions), transformMatrix);
+        normals = transformNormals(std::move(normals), transformMatrix);
+    } else {
+        indices.resize(pSerializedTriangleMesh->indices()->size());
         std::transform(
-            pSerializedTriangleMesh->normals()->begin(),
-            pSerializedTriangleMesh->normals()->end(),
-            std::begin(normals),
-            [&](const serialization::Vec3* n) {
-                return transform.transformNormalToWorld(deserialize(*n));
+            pSerializedTriangleMesh->indices()->begin(),
+            pSerializedTriangleMesh->indices()->end(),
+            std::begin(indices),
+            [](const serialization::Vec3u* t) {
+                return deserialize(*t);
             });
+        indices.shrink_to_fit();
+
+        positions.resize(pSerializedTriangleMesh->positions()->size());
+        std::transform(
+            pSerializedTriangleMesh->positions()->begin(),
+            pSerializedTriangleMesh->positions()->end(),
+            std::begin(positions),
+            [&](const serialization::Vec3* p) {
+                return transform.transformPointToWorld(deserialize(*p));
+            });
+        positions.shrink_to_fit();
+
+        if (pSerializedTriangleMesh->normals()) {
+            normals.resize(pSerializedTriangleMesh->normals()->size());
+            std::transform(
+                pSerializedTriangleMesh->normals()->begin(),
+                pSerializedTriangleMesh->normals()->end(),
+                std::begin(normals),
+                [&](const serialization::Vec3* n) {
+                    return transform.transformNormalToWorld(deserialize(*n));
+                });
+        }
+        normals.shrink_to_fit();
     }
-    normals.shrink_to_fit();
 
     std::vector<glm::vec2> texCoords;
     if (pSerializedTriangleMesh->texCoords()) {
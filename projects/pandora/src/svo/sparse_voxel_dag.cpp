@@ -1,4 +1,5 @@
 #include "pandora/svo/sparse_voxel_dag.h"
+#include "pandora/flatbuffers/data_conversion.h"
 #include "pandora/graphics_core/ray.h"
 #include "pandora/svo/voxel_grid.h"
 #include "pandora/utility/error_handling.h"
@@ -15,6 +16,7 @@
 #include <limits>
 #include <optick.h>
 #include <simd/simd4.h>
+#include <simd/simd8.h>
 
 namespace pandora {
 
@@ -225,6 +227,58 @@ void SparseVoxelDAG::compressDAGs(std::span<SparseVoxelDAG*> svos)
     std::cout << "Combined SVDAG size after compression: " << svos[0]->sizeBytes() << " bytes" << std::endl;
 }
 
+SparseVoxelDAG::SparseVoxelDAG(const serialization::SparseVoxelDAG& serializedDAG, const NodeOffset* pData)
+    : m_resolution(serializedDAG.resolution())
+    , m_boundsMin(deserialize(serializedDAG.boundsMin()))
+    , m_boundsExtent(deserialize(serializedDAG.boundsExtent()))
+    , m_invBoundsExtent(1.0f / m_boundsExtent)
+    , m_rootNodeOffset(serializedDAG.rootNodeOffset())
+    , m_data(pData)
+{
+}
+
+flatbuffers::Offset<serialization::SparseVoxelDAGs> SparseVoxelDAG::serializeDAGs(flatbuffers::FlatBufferBuilder& builder, std::span<const SparseVoxelDAG* const> svdags)
+{
+    ALWAYS_ASSERT(!svdags.empty());
+
+    // After compressDAGs the first SVDAG owns the nodes of all SVDAGs
+    const auto& nodes = svdags[0]->m_nodeAllocator;
+    std::vector<serialization::SparseVoxelDAG> serializedDAGs;
+    serializedDAGs.reserve(svdags.size());
+    for (const SparseVoxelDAG* pSVDAG : svdags) {
+        ALWAYS_ASSERT(pSVDAG->m_data == nodes.data());
+        serializedDAGs.emplace_back(
+            serialize(pSVDAG->m_boundsMin), serialize(pSVDAG->m_boundsExtent), pSVDAG->m_resolution, pSVDAG->m_rootNodeOffset);
+    }
+
+    const auto serializedNodes = builder.CreateVector(nodes);
+    const auto serializedDAGsVector = builder.CreateVectorOfStructs(serializedDAGs);
+    return serialization::CreateSparseVoxelDAGs(builder, serializedNodes, serializedDAGsVector);
+}
+
+std::optional<std::vector<SparseVoxelDAG>> SparseVoxelDAG::loadSerializedDAGs(const serialization::SparseVoxelDAGs* pSerializedDAGs)
+{
+    const auto* pSerializedNodes = pSerializedDAGs->nodes();
+    const auto* pSerializedDAGsVector = pSerializedDAGs->dags();
+    if (!pSerializedNodes || !pSerializedDAGsVector || pSerializedDAGsVector->size() == 0)
+        return {};
+
+    // Copy the nodes out of the (possibly memory mapped) buffer so that the SVDAGs do not depend on its lifetime
+    std::vector<NodeOffset> nodes { pSerializedNodes->begin(), pSerializedNodes->end() };
+
+    std::vector<SparseVoxelDAG> svdags;
+    svdags.reserve(pSerializedDAGsVector->size());
+    for (const auto* pSerializedDAG : *pSerializedDAGsVector) {
+        if (pSerializedDAG->rootNodeOffset() >= nodes.size())
+            return {};
+        svdags.push_back(SparseVoxelDAG(*pSerializedDAG, nodes.data()));
+    }
+
+    // Moving the vector does not invalidate the data pointer stored in the SVDAGs
+    svdags[0].m_nodeAllocator = std::move(nodes);
+    return svdags;
+}
+
 void SparseVoxelDAG::testSVDAG() const
 {
     // Traverse voxels along the ray as long as the current voxel stays within the octree
@@ -565,6 +619,222 @@ std::optional<float> SparseVoxelDAG::intersectScalar(Ray ray) const
         return 0;
     }
 }
+
+// Convert a bit mask of SIMD lanes into a mask8
+static inline simd::mask8 laneMask(uint32_t lanes)
+{
+    return simd::mask8(lanes & 0x01, lanes & 0x02, lanes & 0x04, lanes & 0x08, lanes & 0x10, lanes & 0x20, lanes & 0x40, lanes & 0x80);
+}
+
+uint32_t SparseVoxelDAG::intersect8(std::span<const Ray> rays) const
+{
+    // 8-wide version of intersectScalar: every SIMD lane traverses the SVDAG for a different ray. Lanes that
+    // finished (hit or miss) are masked out until all rays are done. Accessing the SVDAG data and the traversal
+    // stack requires gathers which are performed per lane.
+    assert(rays.size() <= 8);
+    const uint32_t numRays = static_cast<uint32_t>(std::min(rays.size(), size_t(8)));
+
+    alignas(32) std::array<float, 8> tCoefX, tCoefY, tCoefZ, tBiasX, tBiasY, tBiasZ;
+    alignas(32) std::array<float, 8> initialPosX, initialPosY, initialPosZ, initialTMin;
+    alignas(32) std::array<uint32_t, 8> octantMaskBits, initialIdx;
+    uint32_t activeLanes = 0;
+    for (uint32_t lane = 0; lane < 8; lane++) {
+        // Unused lanes are filled with a copy of the first ray but are never marked as active
+        Ray ray = rays[lane < numRays ? lane : 0];
+        ray.origin = glm::vec3(1.0f) + (m_invBoundsExtent * (ray.origin - m_boundsMin));
+
+        constexpr float epsilon = 1.1920928955078125e-07f; // std::exp2f(-CAST_STACK_DEPTH);
+        if (std::abs(ray.direction.x) < epsilon)
+            ray.direction.x = std::copysign(epsilon, ray.direction.x);
+        if (std::abs(ray.direction.y) < epsilon)
+            ray.direction.y = std::copysign(epsilon, ray.direction.y);
+        if (std::abs(ray.direction.z) < epsilon)
+            ray.direction.z = std::copysign(epsilon, ray.direction.z);
+
+        glm::vec3 tCoef = 1.0f / -glm::abs(ray.direction);
+        glm::vec3 tBias = tCoef * ray.origin;
+
+        uint32_t octantMask = 7;
+        for (int axis = 0; axis < 3; axis++) {
+            if (ray.direction[axis] > 0.0f) {
+                octantMask ^= (1 << axis);
+                tBias[axis] = 3.0f * tCoef[axis] - tBias[axis];
+            }
+        }
+
+        const glm::vec3 tRootMin = 2.0f * tCoef - tBias;
+        const glm::vec3 tRootMax = tCoef - tBias;
+        const float tMin = std::max(0.0f, std::max(tRootMin.x, std::max(tRootMin.y, tRootMin.z)));
+        const float tMax = std::min(tRootMax.x, std::min(tRootMax.y, tRootMax.z));
+        if (lane < numRays && tMin < tMax)
+            activeLanes |= 1u << lane;
+
+        // Select the child of the root that the ray enters first
+        const glm::vec3 tRootCenter = 1.5f * tCoef - tBias;
+        uint32_t idx = 0;
+        glm::vec3 pos { 1.0f };
+        for (int axis = 0; axis < 3; axis++) {
+            if (tRootCenter[axis] > tMin) {
+                idx ^= (1 << axis);
+                pos[axis] = 1.5f;
+            }
+        }
+
+        tCoefX[lane] = tCoef.x;
+        tCoefY[lane] = tCoef.y;
+        tCoefZ[lane] = tCoef.z;
+        tBiasX[lane] = tBias.x;
+        tBiasY[lane] = tBias.y;
+        tBiasZ[lane] = tBias.z;
+        octantMaskBits[lane] = octantMask;
+        initialPosX[lane] = pos.x;
+        initialPosY[lane] = pos.y;
+        initialPosZ[lane] = pos.z;
+        initialTMin[lane] = tMin;
+        initialIdx[lane] = idx;
+    }
+
+    const simd::vec8_f32 tCoefXVec { tCoefX }, tCoefYVec { tCoefY }, tCoefZVec { tCoefZ };
+    const simd::vec8_f32 tBiasXVec { tBiasX }, tBiasYVec { tBiasY }, tBiasZVec { tBiasZ };
+    const simd::vec8_u32 octantMaskVec { octantMaskBits };
+    simd::vec8_f32 posX { initialPosX }, posY { initialPosY }, posZ { initialPosZ };
+    simd::vec8_f32 tMinVec { initialTMin };
+    simd::vec8_u32 idx { initialIdx };
+    simd::vec8_u32 scale { static_cast<uint32_t>(CAST_STACK_DEPTH - 1) };
+
+    const simd::vec8_u32 zero { 0u }, one { 1u }, two { 2u }, four { 4u }, seven { 7u };
+    const simd::vec8_u32 castStackDepth { static_cast<uint32_t>(CAST_STACK_DEPTH) };
+
+    // The parent node and traversal stack are only accessed through gathers/scatters so they are stored per lane.
+    std::array<const Descriptor*, 8> parents;
+    std::fill(std::begin(parents), std::end(parents), reinterpret_cast<const Descriptor*>(m_data + m_rootNodeOffset));
+    std::array<std::array<const Descriptor*, 8>, CAST_STACK_DEPTH + 1> stack;
+
+    uint32_t hitLanes = 0;
+    while (activeLanes) {
+        // === INTERSECT ===
+        const simd::vec8_f32 tCornerX = posX * tCoefXVec - tBiasXVec;
+        const simd::vec8_f32 tCornerY = posY * tCoefYVec - tBiasYVec;
+        const simd::vec8_f32 tCornerZ = posZ * tCoefZVec - tBiasZVec;
+
+        const simd::vec8_u32 childIndex = seven - ((idx & seven) ^ octantMaskVec);
+        alignas(32) std::array<uint32_t, 8> childIndices;
+        childIndex.storeAligned(childIndices);
+
+        // Gather the descriptors of the parent nodes
+        alignas(32) std::array<uint32_t, 8> validMasks { 0, 0, 0, 0, 0, 0, 0, 0 };
+        alignas(32) std::array<uint32_t, 8> leafMasks { 0, 0, 0, 0, 0, 0, 0, 0 };
+        for (uint32_t lanes = activeLanes; lanes; lanes &= lanes - 1) {
+            const int lane = simd::bitScan32(lanes);
+            validMasks[lane] = parents[lane]->validMask;
+            leafMasks[lane] = parents[lane]->leafMask & parents[lane]->validMask;
+        }
+        const simd::vec8_u32 isValid = (simd::vec8_u32(validMasks) >> childIndex) & one;
+        const simd::vec8_u32 isLeaf = (simd::vec8_u32(leafMasks) >> childIndex) & one;
+        const uint32_t validLanes = static_cast<uint32_t>((isValid > zero).bitMask()) & activeLanes;
+        const uint32_t leafLanes = static_cast<uint32_t>((isLeaf > zero).bitMask()) & validLanes;
+
+        // Rays that entered a filled leaf voxel are done
+        hitLanes |= leafLanes;
+        activeLanes &= ~leafLanes;
+        const uint32_t pushLanes = validLanes & ~leafLanes;
+        const uint32_t advanceLanes = activeLanes & ~validLanes;
+
+        if (pushLanes) {
+            // === PUSH ===
+            alignas(32) std::array<uint32_t, 8> scales;
+            scale.storeAligned(scales);
+            for (uint32_t lanes = pushLanes; lanes; lanes &= lanes - 1) {
+                const int lane = simd::bitScan32(lanes);
+                stack[scales[lane]][lane] = parents[lane];
+                parents[lane] = getChild(parents[lane], static_cast<int>(childIndices[lane]));
+            }
+
+            // half = exp2(scale - 1 - CAST_STACK_DEPTH), constructed directly from its exponent bits
+            const simd::vec8_f32 half = simd::intBitsToFloat((scale + simd::vec8_u32(126 - CAST_STACK_DEPTH)) << 23);
+            const simd::vec8_f32 tCenterX = half * tCoefXVec + tCornerX;
+            const simd::vec8_f32 tCenterY = half * tCoefYVec + tCornerY;
+            const simd::vec8_f32 tCenterZ = half * tCoefZVec + tCornerZ;
+
+            // Select the child voxel that the ray enters first
+            const simd::mask8 maskX = tCenterX > tMinVec;
+            const simd::mask8 maskY = tCenterY > tMinVec;
+            const simd::mask8 maskZ = tCenterZ > tMinVec;
+            const simd::vec8_u32 childIdx = simd::blend(zero, one, maskX) | simd::blend(zero, two, maskY) | simd::blend(zero, four, maskZ);
+
+            const simd::mask8 pushMask = laneMask(pushLanes);
+            idx = simd::blend(idx, childIdx, pushMask);
+            scale = simd::blend(scale, scale - one, pushMask);
+            posX = simd::blend(posX, simd::blend(posX, posX + half, maskX), pushMask);
+            posY = simd::blend(posY, simd::blend(posY, posY + half, maskY), pushMask);
+            posZ = simd::blend(posZ, simd::blend(posZ, posZ + half, maskZ), pushMask);
+        }
+
+        if (advanceLanes) {
+            // === ADVANCE ===
+            const simd::vec8_f32 scaleExp2 = simd::intBitsToFloat((scale + simd::vec8_u32(127 - CAST_STACK_DEPTH)) << 23);
+            const simd::vec8_f32 tcMax = simd::min(tCornerX, simd::min(tCornerY, tCornerZ));
+
+            // Step along the ray
+            const simd::mask8 stepX = tCornerX <= tcMax;
+            const simd::mask8 stepY = tCornerY <= tcMax;
+            const simd::mask8 stepZ = tCornerZ <= tcMax;
+            const simd::vec8_u32 stepMaskBits = simd::blend(zero, one, stepX) | simd::blend(zero, two, stepY) | simd::blend(zero, four, stepZ);
+            const simd::vec8_f32 steppedPosX = simd::blend(posX, posX - scaleExp2, stepX);
+            const simd::vec8_f32 steppedPosY = simd::blend(posY, posY - scaleExp2, stepY);
+            const simd::vec8_f32 steppedPosZ = simd::blend(posZ, posZ - scaleExp2, stepZ);
+
+            // Update active t-span and flip bits of the child slot index
+            const simd::vec8_u32 steppedIdx = idx ^ stepMaskBits;
+
+            // Proceed with pop if the bit flips disagree with the ray direction
+            const uint32_t popLanes = static_cast<uint32_t>(((steppedIdx & stepMaskBits) > zero).bitMask()) & advanceLanes;
+            simd::vec8_u32 newScale = scale;
+            if (popLanes) {
+                // === POP ===
+                // Find the highest differing bit between the two positions
+                const simd::vec8_u32 differingBitsVec = simd::blend(zero, simd::floatBitsToInt(steppedPosX) ^ simd::floatBitsToInt(steppedPosX + scaleExp2), stepX)
+                    | simd::blend(zero, simd::floatBitsToInt(steppedPosY) ^ simd::floatBitsToInt(steppedPosY + scaleExp2), stepY)
+                    | simd::blend(zero, simd::floatBitsToInt(steppedPosZ) ^ simd::floatBitsToInt(steppedPosZ + scaleExp2), stepZ);
+                alignas(32) std::array<uint32_t, 8> differingBits;
+                alignas(32) std::array<uint32_t, 8> scales;
+                differingBitsVec.storeAligned(differingBits);
+                scale.storeAligned(scales);
+
+                for (uint32_t lanes = popLanes; lanes; lanes &= lanes - 1) {
+                    const int lane = simd::bitScan32(lanes);
+                    scales[lane] = static_cast<uint32_t>(simd::bitScanReverse32(differingBits[lane]));
+
+                    // Restore parent voxel from the stack (unless the ray left the SVDAG)
+                    if (scales[lane] < static_cast<uint32_t>(CAST_STACK_DEPTH))
+                        parents[lane] = stack[scales[lane]][lane];
+                }
+                newScale = simd::vec8_u32(scales);
+            }
+
+            // Round cube position and extract child slot index
+            const simd::vec8_u32 shX = simd::floatBitsToInt(steppedPosX) >> newScale;
+            const simd::vec8_u32 shY = simd::floatBitsToInt(steppedPosY) >> newScale;
+            const simd::vec8_u32 shZ = simd::floatBitsToInt(steppedPosZ) >> newScale;
+            const simd::vec8_u32 roundedIdx = (shX & one) | ((shY & one) << 1) | ((shZ & one) << 2) | ((shX & two) << 2) | ((shY & two) << 3) | ((shZ & two) << 4);
+
+            const simd::mask8 advanceMask = laneMask(advanceLanes);
+            posX = simd::blend(posX, simd::intBitsToFloat(shX << newScale), advanceMask);
+            posY = simd::blend(posY, simd::intBitsToFloat(shY << newScale), advanceMask);
+            posZ = simd::blend(posZ, simd::intBitsToFloat(shZ << newScale), advanceMask);
+            tMinVec = simd::blend(tMinVec, tcMax, advanceMask);
+            idx = simd::blend(idx, roundedIdx, advanceMask);
+            scale = simd::blend(scale, newScale, advanceMask);
+
+            // Rays that left the octree missed
+            const uint32_t exitedLanes = static_cast<uint32_t>((scale >= castStackDepth).bitMask()) & advanceLanes;
+            activeLanes &= ~exitedLanes;
+        }
+    }
+
+    return hitLanes;
+}
+
 std::pair<std::vector<glm::vec3>, std::vector<glm::ivec3>> SparseVoxelDAG::generateSurfaceMesh() const
 {
     std::vector<glm::vec3> positions;
@@ -27,13 +27,19 @@ BatchingAccelerationStructureBuilder::BatchingAccelerationStructureBuilder(
     tasking::TaskGraph* pTaskGraph,
     unsigned primitivesPerBatchingPoint,
     size_t botLevelBVHCacheSize,
-    unsigned svdagRes)
+    unsigned svdagRes,
+    bool sortRays,
+    std::filesystem::path sceneBundleFile,
+    std::filesystem::path sceneFile)
     : m_pScene(pScene)
     , m_pGeometryCache(pCache)
     , m_pTaskGraph(pTaskGraph)
     , m_primitivesPerBatchingPoint(primitivesPerBatchingPoint)
     , m_botLevelBVHCacheSize(botLevelBVHCacheSize)
     , m_svdagRes(svdagRes)
+    , m_sortRays(sortRays)
+    , m_sceneBundleFile(std::move(sceneBundleFile))
+    , m_sceneFile(std::move(sceneFile))
 {
 }
 
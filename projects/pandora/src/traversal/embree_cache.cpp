@@ -101,10 +101,13 @@ std::shared_ptr<CachedEmbreeScene> LRUEmbreeSceneCache::fromSceneObjectGroup(
 
             return listIter->scene;
         } else {
-            //auto sizeBefore = m_size.load();
+            const size_t sizeBefore = m_size.load();
             auto embreeScene = createEmbreeScene(sceneObjects);
-            //auto sizeAfter = m_size.load();
-            //spdlog::info("Created Embree BVH of {} bytes", sizeAfter - sizeBefore);
+            const size_t sizeAfter = m_size.load();
+            {
+                std::lock_guard l2 { m_builtScenesLock };
+                m_builtScenes[pKey] = BuiltScene { sizeAfter > sizeBefore ? sizeAfter - sizeBefore : 0, true };
+            }
 
             if (m_size.load() > m_maxSize)
                 evict();
@@ -118,6 +121,22 @@ std::shared_ptr<CachedEmbreeScene> LRUEmbreeSceneCache::fromSceneObjectGroup(
     });
 }
 
+size_t LRUEmbreeSceneCache::bytesToBuild(const void* pKey, std::span<const SceneObject* const> sceneObjects) const
+{
+    {
+        std::lock_guard l { m_builtScenesLock };
+        if (auto iter = m_builtScenes.find(pKey); iter != std::end(m_builtScenes))
+            return iter->second.cached ? 0 : iter->second.sizeBytes;
+    }
+
+    // Never built before: estimate the size of a compact Embree BVH from the number of primitives.
+    constexpr size_t estimatedBytesPerPrimitive = 48;
+    size_t numPrimitives = 0;
+    for (const auto* pSceneObject : sceneObjects)
+        numPrimitives += pSceneObject->pShape->numPrimitives();
+    return numPrimitives * estimatedBytesPerPrimitive;
+}
+
 std::shared_ptr<CachedEmbreeScene> LRUEmbreeSceneCache::createEmbreeScene(std::span<const SceneObject*> sceneObjects)
 {
     OPTICK_EVENT();
@@ -171,6 +190,10 @@ void LRUEmbreeSceneCache::evict()
             continue;
         }
 
+        {
+            std::lock_guard l { m_builtScenesLock };
+            m_builtScenes[iter->pKey].cached = false;
+        }
         m_lookUp.erase(iter->pKey);
         iter = m_scenes.erase(iter); // Make iter point to the next item (calling iter++ after erase will reference free'd memory)
 
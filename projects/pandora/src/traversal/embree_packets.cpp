@@ -0,0 +1,154 @@
+#include "pandora/traversal/embree_packets.h"
+#include <cassert>
+
+namespace pandora::detail {
+
+RTCRayHit intersectEmbreeRay(RTCScene scene, const Ray& ray)
+{
+    RTCRayHit embreeRayHit;
+    embreeRayHit.ray.org_x = ray.origin.x;
+    embreeRayHit.ray.org_y = ray.origin.y;
+    embreeRayHit.ray.org_z = ray.origin.z;
+    embreeRayHit.ray.dir_x = ray.direction.x;
+    embreeRayHit.ray.dir_y = ray.direction.y;
+    embreeRayHit.ray.dir_z = ray.direction.z;
+
+    embreeRayHit.ray.tnear = ray.tnear;
+    embreeRayHit.ray.tfar = ray.tfar;
+
+    embreeRayHit.ray.time = 0.0f;
+    embreeRayHit.ray.mask = 0xFFFFFFFF;
+    embreeRayHit.ray.id = 0;
+    embreeRayHit.ray.flags = 0;
+    embreeRayHit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+    for (int i = 0; i < RTC_MAX_INSTANCE_LEVEL_COUNT; i++)
+        embreeRayHit.hit.instID[i] = RTC_INVALID_GEOMETRY_ID;
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    rtcIntersect1(scene, &context, &embreeRayHit);
+    return embreeRayHit;
+}
+
+float occludedEmbreeRay(RTCScene scene, const Ray& ray)
+{
+    RTCRay embreeRay;
+    embreeRay.org_x = ray.origin.x;
+    embreeRay.org_y = ray.origin.y;
+    embreeRay.org_z = ray.origin.z;
+    embreeRay.dir_x = ray.direction.x;
+    embreeRay.dir_y = ray.direction.y;
+    embreeRay.dir_z = ray.direction.z;
+
+    embreeRay.tnear = ray.tnear;
+    embreeRay.tfar = ray.tfar;
+
+    embreeRay.time = 0.0f;
+    embreeRay.mask = 0xFFFFFFFF;
+    embreeRay.id = 0;
+    embreeRay.flags = 0;
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    rtcOccluded1(scene, &context, &embreeRay);
+    return embreeRay.tfar;
+}
+
+void intersectEmbreePacket(RTCScene scene, std::span<const Ray> rays, std::span<RTCRayHit> outHits)
+{
+    assert(rays.size() <= embreePacketSize && outHits.size() == rays.size());
+
+    // All rays in the batch entered the same batching point so they are expected to be (somewhat) coherent.
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    // Embree requires the valid mask to be aligned to the packet size
+    alignas(64) int valid[embreePacketSize];
+    RTCRayHit16 embreeRayHits;
+    for (size_t lane = 0; lane < embreePacketSize; lane++) {
+        if (lane >= rays.size()) {
+            valid[lane] = 0;
+            continue;
+        }
+
+        const Ray& ray = rays[lane];
+        valid[lane] = -1;
+        embreeRayHits.ray.org_x[lane] = ray.origin.x;
+        embreeRayHits.ray.org_y[lane] = ray.origin.y;
+        embreeRayHits.ray.org_z[lane] = ray.origin.z;
+        embreeRayHits.ray.dir_x[lane] = ray.direction.x;
+        embreeRayHits.ray.dir_y[lane] = ray.direction.y;
+        embreeRayHits.ray.dir_z[lane] = ray.direction.z;
+
+        embreeRayHits.ray.tnear[lane] = ray.tnear;
+        embreeRayHits.ray.tfar[lane] = ray.tfar;
+
+        embreeRayHits.ray.time[lane] = 0.0f;
+        embreeRayHits.ray.mask[lane] = 0xFFFFFFFF;
+        embreeRayHits.ray.id[lane] = static_cast<unsigned>(lane);
+        embreeRayHits.ray.flags[lane] = 0;
+        embreeRayHits.hit.geomID[lane] = RTC_INVALID_GEOMETRY_ID;
+        for (int i = 0; i < RTC_MAX_INSTANCE_LEVEL_COUNT; i++)
+            embreeRayHits.hit.instID[i][lane] = RTC_INVALID_GEOMETRY_ID;
+    }
+
+    rtcIntersect16(valid, scene, &context, &embreeRayHits);
+
+    // Extract the lanes so that the hits can be processed by the same code path as scalar rays.
+    for (size_t lane = 0; lane < rays.size(); lane++) {
+        RTCRayHit& embreeRayHit = outHits[lane];
+        embreeRayHit.ray.tfar = embreeRayHits.ray.tfar[lane];
+        embreeRayHit.hit.Ng_x = embreeRayHits.hit.Ng_x[lane];
+        embreeRayHit.hit.Ng_y = embreeRayHits.hit.Ng_y[lane];
+        embreeRayHit.hit.Ng_z = embreeRayHits.hit.Ng_z[lane];
+        embreeRayHit.hit.u = embreeRayHits.hit.u[lane];
+        embreeRayHit.hit.v = embreeRayHits.hit.v[lane];
+        embreeRayHit.hit.primID = embreeRayHits.hit.primID[lane];
+        embreeRayHit.hit.geomID = embreeRayHits.hit.geomID[lane];
+        for (int i = 0; i < RTC_MAX_INSTANCE_LEVEL_COUNT; i++)
+            embreeRayHit.hit.instID[i] = embreeRayHits.hit.instID[i][lane];
+    }
+}
+
+void occludedEmbreePacket(RTCScene scene, std::span<const Ray> rays, std::span<float> outTfars)
+{
+    assert(rays.size() <= embreePacketSize && outTfars.size() == rays.size());
+
+    RTCIntersectContext context;
+    rtcInitIntersectContext(&context);
+    context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+    // Embree requires the valid mask to be aligned to the packet size
+    alignas(64) int valid[embreePacketSize];
+    RTCRay16 embreeRays;
+    for (size_t lane = 0; lane < embreePacketSize; lane++) {
+        if (lane >= rays.size()) {
+            valid[lane] = 0;
+            continue;
+        }
+
+        const Ray& ray = rays[lane];
+        valid[lane] = -1;
+        embreeRays.org_x[lane] = ray.origin.x;
+        embreeRays.org_y[lane] = ray.origin.y;
+        embreeRays.org_z[lane] = ray.origin.z;
+        embreeRays.dir_x[lane] = ray.direction.x;
+        embreeRays.dir_y[lane] = ray.direction.y;
+        embreeRays.dir_z[lane] = ray.direction.z;
+
+        embreeRays.tnear[lane] = ray.tnear;
+        embreeRays.tfar[lane] = ray.tfar;
+
+        embreeRays.time[lane] = 0.0f;
+        embreeRays.mask[lane] = 0xFFFFFFFF;
+        embreeRays.id[lane] = static_cast<unsigned>(lane);
+        embreeRays.flags[lane] = 0;
+    }
+
+    rtcOccluded16(valid, scene, &context, &embreeRays);
+
+    for (size_t lane = 0; lane < rays.size(); lane++)
+        outTfars[lane] = embreeRays.tfar[lane];
+}
+
+}
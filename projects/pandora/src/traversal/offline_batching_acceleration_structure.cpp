@@ -26,9 +26,13 @@ OfflineBatchingAccelerationStructureBuilder::OfflineBatchingAccelerationStructur
     tasking::TaskGraph* pTaskGraph,
     unsigned primitivesPerBatchingPoint,
     size_t botLevelBVHCacheSize,
-    unsigned svdagRes)
+    unsigned svdagRes,
+    bool sortRays,
+    std::filesystem::path persistentBVHStoreFolder)
     : m_botLevelBVHCacheSize(botLevelBVHCacheSize)
     , m_svdagRes(svdagRes)
+    , m_sortRays(sortRays)
+    , m_persistentBVHStoreFolder(std::move(persistentBVHStoreFolder))
     , m_pGeometryCache(pCache)
     , m_pTaskGraph(pTaskGraph)
 {
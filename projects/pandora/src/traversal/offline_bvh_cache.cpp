@@ -77,7 +77,7 @@ bool OfflineBVHLeaf::intersectAny(Ray& ray) const
     }
 }
 
-CachedBVH::CachedBVH(WiVeBVH8Build8<OfflineBVHLeaf>&& bvh, const Bounds& bounds)
+CachedBVH::CachedBVH(OfflineBVH&& bvh, const Bounds& bounds)
     : Evictable(true)
     , m_bvh(std::move(bvh))
     , m_bounds(bounds)
@@ -102,6 +102,18 @@ bool CachedBVH::intersectAny(Ray& ray) const
     return m_bvh->intersectAny(ray);
 }
 
+void CachedBVH::intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const
+{
+    ALWAYS_ASSERT(m_bvh.has_value());
+    m_bvh->intersect(rays, surfaceInteractions);
+}
+
+void CachedBVH::intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const
+{
+    ALWAYS_ASSERT(m_bvh.has_value());
+    m_bvh->intersectAny(rays, hits);
+}
+
 size_t CachedBVH::sizeBytes() const
 {
     if (m_bvh.has_value()) {
@@ -135,13 +147,25 @@ void CachedBVH::doEvict()
     m_bvh.reset();
 }
 
+void CachedBVH::doSubmitLoad(tasking::Deserializer& deserializer)
+{
+    deserializer.submit(m_leafsSerializeAllocation);
+    deserializer.submit(m_bvhSerializeAllocation);
+}
+
+void CachedBVH::doCancelLoad(tasking::Deserializer& deserializer)
+{
+    deserializer.cancel(m_leafsSerializeAllocation);
+    deserializer.cancel(m_bvhSerializeAllocation);
+}
+
 void CachedBVH::doMakeResident(tasking::Deserializer& deserializer)
 {
     const void* pLeafsMem = deserializer.map(m_leafsSerializeAllocation);
     const OfflineBVHLeaf* pLeafs = static_cast<const OfflineBVHLeaf*>(pLeafsMem);
 
     const void* pBVHMem = deserializer.map(m_bvhSerializeAllocation);
-    WiVeBVH8Build8<OfflineBVHLeaf> bvh { pandora::serialization::GetWiVeBVH8(pBVHMem), std::span(pLeafs, m_numLeafs) };
+    OfflineBVH bvh { pandora::serialization::GetWiVeBVH8(pBVHMem), std::span(pLeafs, m_numLeafs) };
     m_bvh.emplace(std::move(bvh));
 
     g_stats.memory.botLevelLoaded += m_bvh->sizeBytes();
@@ -157,14 +181,27 @@ bool CachedBVHSubScene::intersectAny(Ray& ray) const
     return m_pBVH->intersectAny(ray);
 }
 
+void CachedBVHSubScene::intersect(std::span<Ray> rays, std::span<SurfaceInteraction> surfaceInteractions) const
+{
+    m_pBVH->intersect(rays, surfaceInteractions);
+}
+
+void CachedBVHSubScene::intersectAny(std::span<Ray> rays, std::span<uint32_t> hits) const
+{
+    m_pBVH->intersectAny(rays, hits);
+}
+
 CachedBVHSubScene::CachedBVHSubScene(tasking::CachedPtr<CachedBVH>&& pBVH, std::vector<tasking::CachedPtr<CachedBVH>>&& childBVHs)
     : m_pBVH(std::move(pBVH))
     , m_childBVHs(std::move(childBVHs))
 {
 }
 
-pandora::LRUBVHSceneCache::LRUBVHSceneCache(std::span<const SubScene*> subScenes, tasking::LRUCacheTS* pSceneCache, size_t maxSize)
+pandora::LRUBVHSceneCache::LRUBVHSceneCache(std::span<const SubScene*> subScenes, tasking::LRUCacheTS* pSceneCache, size_t maxSize, const std::filesystem::path& persistentBVHStoreFolder)
 {
+    if (!persistentBVHStoreFolder.empty())
+        m_persistentBVHStore.emplace(persistentBVHStoreFolder);
+
     //spdlog::warn("Using in-memory serializer for BVH cache");
     //auto pSerializer = std::make_unique<tasking::InMemorySerializer>();
     auto pSerializer = std::make_unique<tasking::SplitFileSerializer>("pandora_render_bvh", 512 * 1024 * 1024, mio_cache_control::cache_mode::no_buffering);
@@ -173,7 +210,7 @@ pandora::LRUBVHSceneCache::LRUBVHSceneCache(std::span<const SubScene*> subScenes
     CacheBuilder cacheBuilder = CacheBuilder(std::move(pSerializer));
 
     for (const SubScene* pSubScene : subScenes) {
-        //const CachedBVH* pBVH = createBVH(pSubScene, pSceneCache, &cacheBuilder);
+        createBVH(pSubScene, pSceneCache, &cacheBuilder);
 
         std::unordered_set<const SceneNode*> childNodes;
         std::function<void(const SceneNode*)> collectSceneNodesRecurse = [&](const SceneNode* pNode) {
@@ -195,6 +232,9 @@ pandora::LRUBVHSceneCache::LRUBVHSceneCache(std::span<const SubScene*> subScenes
         m_childBVHs[pSubScene] = std::move(childBVHs);
     }
 
+    if (m_persistentBVHStore)
+        spdlog::info("Loaded {} of {} bot level BVHs from the persistent BVH store", m_numPersistentBVHsLoaded, m_bvhSceneLUT.size());
+
     m_lruCache = cacheBuilder.build(maxSize);
 }
 
@@ -210,6 +250,8 @@ CachedBVHSubScene LRUBVHSceneCache::fromSubScene(const SubScene* pSubScene)
     ALWAYS_ASSERT(m_childBVHs.find(pSubScene) != std::end(m_childBVHs));
 
     const auto& childBVHs = m_childBVHs.find(pSubScene)->second;
+    for (CachedBVH* pChildBVH : childBVHs)
+        m_lruCache->prefetch(pChildBVH);
     std::vector<tasking::CachedPtr<CachedBVH>> cachedChildBVHs;
     std::transform(std::begin(childBVHs), std::end(childBVHs), std::back_inserter(cachedChildBVHs),
         [this](CachedBVH* pCachedBVH) {
@@ -219,6 +261,19 @@ CachedBVHSubScene LRUBVHSceneCache::fromSubScene(const SubScene* pSubScene)
     return CachedBVHSubScene(std::move(pCachedBVH), std::move(cachedChildBVHs));
 }
 
+size_t LRUBVHSceneCache::bytesToLoad(const SubScene* pSubScene) const
+{
+    auto bvhIter = m_bvhSceneLUT.find(static_cast<const void*>(pSubScene));
+    ALWAYS_ASSERT(bvhIter != std::end(m_bvhSceneLUT));
+    size_t bytes = m_lruCache->bytesToLoad(bvhIter->second.get());
+
+    auto childIter = m_childBVHs.find(pSubScene);
+    ALWAYS_ASSERT(childIter != std::end(m_childBVHs));
+    for (const CachedBVH* pChildBVH : childIter->second)
+        bytes += m_lruCache->bytesToLoad(pChildBVH);
+    return bytes;
+}
+
 CachedBVH* LRUBVHSceneCache::createBVH(const SceneNode* pSceneNode, tasking::LRUCacheTS* pGeomCache, tasking::CacheBuilder* pCacheBuilder)
 {
     std::vector<OfflineBVHLeaf> leafs;
@@ -255,7 +310,7 @@ CachedBVH* LRUBVHSceneCache::createBVH(const SceneNode* pSceneNode, tasking::LRU
     }
 
     // Construct BVH
-    WiVeBVH8Build8<OfflineBVHLeaf> bvh { leafs };
+    OfflineBVH bvh = buildOrLoadBVH(leafs);
 
     // Store Evictable wrapper class
     auto pCachedBVHOwner = std::make_unique<CachedBVH>(std::move(bvh), bounds);
@@ -306,7 +361,7 @@ CachedBVH* LRUBVHSceneCache::createBVH(const SubScene* pSubScene, tasking::LRUCa
     }
 
     // Construct BVH
-    WiVeBVH8Build8<OfflineBVHLeaf> bvh { leafs };
+    OfflineBVH bvh = buildOrLoadBVH(leafs);
 
     // Store Evictable wrapper class
     auto pCachedBVHOwner = std::make_unique<CachedBVH>(std::move(bvh), bounds);
@@ -321,4 +376,30 @@ CachedBVH* LRUBVHSceneCache::createBVH(const SubScene* pSubScene, tasking::LRUCa
     return pCachedBVH;
 }
 
-}
\ No newline at end of file
+OfflineBVH LRUBVHSceneCache::buildOrLoadBVH(std::span<OfflineBVHLeaf> leafs)
+{
+    if (!m_persistentBVHStore || leafs.empty())
+        return OfflineBVH { leafs };
+
+    std::vector<Bounds> leafBounds;
+    leafBounds.reserve(leafs.size());
+    std::transform(std::begin(leafs), std::end(leafs), std::back_inserter(leafBounds), [](const OfflineBVHLeaf& leaf) { return leaf.getBounds(); });
+    const auto key = PersistentBVHStore::computeKey(leafBounds);
+
+    // The leafs contain pointers so they are not stored; the leaf order (and thus the leaf indices stored in the BVH)
+    // is deterministic given the scene.
+    constexpr PersistentBVHStore::Format format { OfflineBVH::serializationVersion, OfflineBVH::branchingFactor, OfflineBVH::quantizedNodes };
+    if (auto optMappedBVH = m_persistentBVHStore->load(key, leafs.size(), format); optMappedBVH) {
+        m_numPersistentBVHsLoaded++;
+        return OfflineBVH { serialization::GetWiVeBVH8(optMappedBVH->data()), leafs };
+    }
+
+    OfflineBVH bvh { leafs };
+
+    flatbuffers::FlatBufferBuilder fbb;
+    fbb.Finish(bvh.serialize(fbb));
+    m_persistentBVHStore->store(key, std::as_bytes(std::span(fbb.GetBufferPointer(), fbb.GetSize())));
+    return bvh;
+}
+
+}
@@ -0,0 +1,94 @@
+#include "pandora/traversal/persistent_bvh_store.h"
+#include "pandora/config.h"
+#include "pandora/flatbuffers/wive_bvh8_generated.h"
+#include <boost/functional/hash.hpp>
+#include <fstream>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+#include <system_error>
+
+namespace pandora {
+
+PersistentBVHStore::PersistentBVHStore(std::filesystem::path folder)
+    : m_folder(std::move(folder))
+{
+    spdlog::info("Using persistent BVH store \"{}\"", m_folder.string());
+    std::filesystem::create_directories(m_folder);
+}
+
+PersistentBVHStore::Key PersistentBVHStore::computeKey(std::span<const Bounds> leafBounds)
+{
+    // Everything (besides the leaf bounds) that influences the serialized BVH
+    size_t seed = 0;
+    boost::hash_combine(seed, storeVersion);
+    boost::hash_combine(seed, ENABLE_WIVE_BVH16);
+    boost::hash_combine(seed, ENABLE_SAH_BVH8_BUILDER);
+    boost::hash_combine(seed, ENABLE_QUANTIZED_BVH_NODES);
+
+    boost::hash_combine(seed, leafBounds.size());
+    for (const Bounds& bounds : leafBounds) {
+        for (int axis = 0; axis < 3; axis++) {
+            boost::hash_combine(seed, bounds.min[axis]);
+            boost::hash_combine(seed, bounds.max[axis]);
+        }
+    }
+    return static_cast<Key>(seed);
+}
+
+std::optional<mio::mmap_source> PersistentBVHStore::load(Key key, size_t numLeafs, const Format& format) const
+{
+    const auto path = filePath(key);
+    if (!std::filesystem::exists(path))
+        return {};
+
+    std::error_code error;
+    mio::mmap_source mappedFile;
+    mappedFile.map(path.string(), error);
+    if (error) {
+        spdlog::warn("Failed to map persistent BVH \"{}\": {}", path.string(), error.message());
+        return {};
+    }
+
+    // Protect against truncated files (e.g. a run that crashed while writing) and hash collisions
+    flatbuffers::Verifier verifier { reinterpret_cast<const uint8_t*>(mappedFile.data()), mappedFile.size() };
+    if (!serialization::VerifyWiVeBVH8Buffer(verifier) || serialization::GetWiVeBVH8(mappedFile.data())->numLeafObjects() != numLeafs) {
+        spdlog::warn("Ignoring invalid persistent BVH \"{}\"", path.string());
+        return {};
+    }
+
+    // The BVH constructor asserts on the format so a BVH stored by a different build must be rejected here
+    const auto* pSerializedBVH = serialization::GetWiVeBVH8(mappedFile.data());
+    if (pSerializedBVH->version() != format.version || pSerializedBVH->branchingFactor() != format.branchingFactor || pSerializedBVH->quantizedNodes() != format.quantizedNodes) {
+        spdlog::warn("Ignoring persistent BVH \"{}\" with a different format", path.string());
+        return {};
+    }
+    return mappedFile;
+}
+
+void PersistentBVHStore::store(Key key, std::span<const std::byte> serializedBVH) const
+{
+    // Write to a temporary file first so that other runs never see a partially written BVH
+    const auto path = filePath(key);
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file { tmpPath, std::ios::binary | std::ios::trunc };
+        file.write(reinterpret_cast<const char*>(serializedBVH.data()), serializedBVH.size());
+        if (!file) {
+            spdlog::warn("Failed to write persistent BVH \"{}\"", tmpPath.string());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, path, error);
+    if (error)
+        spdlog::warn("Failed to store persistent BVH \"{}\": {}", path.string(), error.message());
+}
+
+std::filesystem::path PersistentBVHStore::filePath(Key key) const
+{
+    return m_folder / fmt::format("{:016x}.bvh", key);
+}
+
+}
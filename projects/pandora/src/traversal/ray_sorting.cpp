@@ -0,0 +1,32 @@
+#include "pandora/traversal/ray_sorting.h"
+#include <glm/glm.hpp>
+#include <libmorton/morton.h>
+#include <limits>
+
+namespace pandora::detail {
+
+uint32_t computeRaySortKey(const Ray& ray, const Bounds& batchingPointBounds)
+{
+    const uint32_t octant = (ray.direction.x > 0.0f ? 0b001 : 0u) | (ray.direction.y > 0.0f ? 0b010 : 0u) | (ray.direction.z > 0.0f ? 0b100 : 0u);
+
+    // Use the point at which the ray enters the bounds of the batching point as a proxy for the hit point.
+    // Rays that start inside the batching point use their origin.
+    float tmin, tmax;
+    glm::vec3 entryPoint = ray.origin;
+    if (batchingPointBounds.intersect(ray, tmin, tmax))
+        entryPoint = ray.origin + std::max(ray.tnear, tmin) * ray.direction;
+
+    constexpr uint32_t bitsPerAxis = 9;
+    constexpr float maxCoordinate = static_cast<float>((1u << bitsPerAxis) - 1);
+    const glm::vec3 extent = glm::max(batchingPointBounds.extent(), glm::vec3(std::numeric_limits<float>::min()));
+    const glm::vec3 relativePosition = glm::clamp((entryPoint - batchingPointBounds.min) / extent, 0.0f, 1.0f);
+    const glm::uvec3 quantizedPosition = glm::uvec3(relativePosition * maxCoordinate);
+    const uint32_t mortonCode = static_cast<uint32_t>(libmorton::morton3D_32_encode(
+        static_cast<uint_fast16_t>(quantizedPosition.x),
+        static_cast<uint_fast16_t>(quantizedPosition.y),
+        static_cast<uint_fast16_t>(quantizedPosition.z)));
+
+    return (octant << (3 * bitsPerAxis)) | mortonCode;
+}
+
+}
@@ -0,0 +1,162 @@
+#include "pandora/traversal/scene_bundle.h"
+#include "pandora/flatbuffers/scene_bundle_generated.h"
+#include "pandora/graphics_core/scene.h"
+#include "pandora/graphics_core/shape.h"
+#include "pandora/utility/enumerate.h"
+#include "pandora/utility/error_handling.h"
+#include <boost/functional/hash.hpp>
+#include <fstream>
+#include <mio/mmap.hpp>
+#include <spdlog/spdlog.h>
+#include <system_error>
+#include <unordered_map>
+
+namespace pandora {
+
+SceneBundle::SceneBundle(std::filesystem::path filePath)
+    : m_filePath(std::move(filePath))
+{
+    spdlog::info("Using scene bundle \"{}\"", m_filePath.string());
+}
+
+SceneBundle::Key SceneBundle::computeKey(const Scene& scene, const std::filesystem::path& sceneFile, unsigned primitivesPerBatchingPoint, unsigned svdagRes)
+{
+    // Everything that influences the batching points and their SVDAGs
+    size_t seed = 0;
+    boost::hash_combine(seed, bundleVersion);
+    boost::hash_combine(seed, primitivesPerBatchingPoint);
+    boost::hash_combine(seed, svdagRes);
+
+    // Editing the geometry does not necessarily change the bounds or primitive counts. Hashing the geometry itself would
+    // require loading all of it (which the bundle is meant to avoid) so use the scene file as a proxy instead.
+    if (!sceneFile.empty()) {
+        std::error_code error;
+        boost::hash_combine(seed, std::filesystem::absolute(sceneFile, error).string());
+        const auto lastWriteTime = std::filesystem::last_write_time(sceneFile, error);
+        if (error)
+            spdlog::warn("Failed to read the modification time of \"{}\"; changes to the scene are not detected by the scene bundle", sceneFile.string());
+        else
+            boost::hash_combine(seed, lastWriteTime.time_since_epoch().count());
+    }
+
+    boost::hash_combine(seed, scene.pRoot->objects.size());
+    for (const auto& [sceneObjectID, pSceneObject] : enumerate(scene.pRoot->objects)) {
+        if (!pSceneObject->pShape)
+            continue;
+
+        const Shape* pShape = pSceneObject->pShape.get();
+        const Bounds bounds = pShape->getBounds();
+        boost::hash_combine(seed, sceneObjectID);
+        boost::hash_combine(seed, pShape->numPrimitives());
+        for (int axis = 0; axis < 3; axis++) {
+            boost::hash_combine(seed, bounds.min[axis]);
+            boost::hash_combine(seed, bounds.max[axis]);
+        }
+    }
+    return static_cast<Key>(seed);
+}
+
+std::optional<SceneBundle::Contents> SceneBundle::load(Key key, const Scene& scene) const
+{
+    if (!std::filesystem::exists(m_filePath))
+        return {};
+
+    std::error_code error;
+    mio::mmap_source mappedFile;
+    mappedFile.map(m_filePath.string(), error);
+    if (error) {
+        spdlog::warn("Failed to map scene bundle \"{}\": {}", m_filePath.string(), error.message());
+        return {};
+    }
+
+    flatbuffers::Verifier verifier { reinterpret_cast<const uint8_t*>(mappedFile.data()), mappedFile.size() };
+    if (!serialization::VerifySceneBundleBuffer(verifier)) {
+        spdlog::warn("Ignoring invalid scene bundle \"{}\"", m_filePath.string());
+        return {};
+    }
+
+    const auto& sceneObjects = scene.pRoot->objects;
+    const auto* pSerializedBundle = serialization::GetSceneBundle(mappedFile.data());
+    if (pSerializedBundle->version() != bundleVersion || pSerializedBundle->key() != key || pSerializedBundle->numSceneObjects() != sceneObjects.size()) {
+        spdlog::info("Scene bundle \"{}\" was created for a different scene or different settings", m_filePath.string());
+        return {};
+    }
+
+    Contents contents;
+    for (const auto* pSerializedBatchingPoint : *pSerializedBundle->batchingPoints()) {
+        std::vector<const SceneObject*> sceneObjectGroup;
+        sceneObjectGroup.reserve(pSerializedBatchingPoint->sceneObjects()->size());
+        for (const uint32_t sceneObjectID : *pSerializedBatchingPoint->sceneObjects()) {
+            if (sceneObjectID >= sceneObjects.size() || !sceneObjects[sceneObjectID]->pShape) {
+                spdlog::warn("Ignoring scene bundle \"{}\" that refers to an invalid scene object", m_filePath.string());
+                return {};
+            }
+            sceneObjectGroup.push_back(sceneObjects[sceneObjectID].get());
+        }
+        contents.sceneObjectGroups.emplace_back(std::move(sceneObjectGroup));
+    }
+
+    if (const auto* pSerializedSVDAGs = pSerializedBundle->svdags()) {
+        auto optSVDAGs = SparseVoxelDAG::loadSerializedDAGs(pSerializedSVDAGs);
+        if (!optSVDAGs || optSVDAGs->size() != contents.sceneObjectGroups.size()) {
+            spdlog::warn("Ignoring scene bundle \"{}\" with invalid SVDAGs", m_filePath.string());
+            return {};
+        }
+        contents.svdags = std::move(*optSVDAGs);
+    }
+
+    spdlog::info("Loaded {} batching points from scene bundle", contents.sceneObjectGroups.size());
+    return contents;
+}
+
+void SceneBundle::store(Key key, const Scene& scene, std::span<const std::vector<const SceneObject*>> sceneObjectGroups, std::span<const SparseVoxelDAG* const> svdags) const
+{
+    const auto& sceneObjects = scene.pRoot->objects;
+    std::unordered_map<const SceneObject*, uint32_t> sceneObjectIDs;
+    for (const auto& [sceneObjectID, pSceneObject] : enumerate(sceneObjects))
+        sceneObjectIDs[pSceneObject.get()] = static_cast<uint32_t>(sceneObjectID);
+
+    flatbuffers::FlatBufferBuilder builder;
+    std::vector<flatbuffers::Offset<serialization::BatchingPointSceneObjects>> serializedBatchingPoints;
+    for (const auto& sceneObjectGroup : sceneObjectGroups) {
+        std::vector<uint32_t> sceneObjectGroupIDs;
+        sceneObjectGroupIDs.reserve(sceneObjectGroup.size());
+        for (const SceneObject* pSceneObject : sceneObjectGroup)
+            sceneObjectGroupIDs.push_back(sceneObjectIDs.at(pSceneObject));
+
+        serializedBatchingPoints.push_back(
+            serialization::CreateBatchingPointSceneObjects(builder, builder.CreateVector(sceneObjectGroupIDs)));
+    }
+    const auto serializedBatchingPointsVector = builder.CreateVector(serializedBatchingPoints);
+
+    flatbuffers::Offset<serialization::SparseVoxelDAGs> serializedSVDAGs;
+    if (!svdags.empty()) {
+        ALWAYS_ASSERT(svdags.size() == sceneObjectGroups.size());
+        serializedSVDAGs = SparseVoxelDAG::serializeDAGs(builder, svdags);
+    }
+
+    const auto serializedBundle = serialization::CreateSceneBundle(
+        builder, bundleVersion, key, static_cast<uint32_t>(sceneObjects.size()), serializedBatchingPointsVector, serializedSVDAGs);
+    builder.Finish(serializedBundle);
+
+    // Write to a temporary file first so that a crashing run never leaves behind a partially written bundle
+    auto tmpPath = m_filePath;
+    tmpPath += ".tmp";
+    {
+        std::ofstream file { tmpPath, std::ios::binary | std::ios::trunc };
+        file.write(reinterpret_cast<const char*>(builder.GetBufferPointer()), builder.GetSize());
+        if (!file) {
+            spdlog::warn("Failed to write scene bundle \"{}\"", tmpPath.string());
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, m_filePath, error);
+    if (error)
+        spdlog::warn("Failed to store scene bundle \"{}\": {}", m_filePath.string(), error.message());
+    else
+        spdlog::info("Stored {} batching points in scene bundle \"{}\"", sceneObjectGroups.size(), m_filePath.string());
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/interaction.h"
+#include "pandora/graphics_core/ray.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace pandora {
+
+// Axis aligned box that stores the hit point in the SurfaceInteraction
+struct TestBox {
+    Bounds bounds;
+
+    Bounds getBounds() const { return bounds; }
+
+    bool intersect(Ray& ray, SurfaceInteraction& si) const
+    {
+        float t;
+        if (!intersectSlabs(ray, t) || t >= ray.tfar)
+            return false;
+
+        ray.tfar = t;
+        si.position = ray.origin + t * ray.direction;
+        return true;
+    }
+    bool intersectAny(Ray& ray) const
+    {
+        float t;
+        return intersectSlabs(ray, t);
+    }
+
+private:
+    bool intersectSlabs(const Ray& ray, float& outT) const
+    {
+        float tmin = ray.tnear, tmax = ray.tfar;
+        for (int axis = 0; axis < 3; axis++) {
+            const float invDir = 1.0f / ray.direction[axis];
+            float tNear = (bounds.min[axis] - ray.origin[axis]) * invDir;
+            float tFar = (bounds.max[axis] - ray.origin[axis]) * invDir;
+            if (tNear > tFar)
+                std::swap(tNear, tFar);
+            tmin = std::max(tmin, tNear);
+            tmax = std::min(tmax, tFar);
+        }
+        outT = tmin;
+        return tmin <= tmax;
+    }
+};
+
+inline std::vector<TestBox> generateTestBoxes(unsigned numBoxes, bool clustered, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> positionDist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> sizeDist(0.01f, 0.5f);
+
+    std::vector<TestBox> boxes;
+    for (unsigned i = 0; i < numBoxes; i++) {
+        // Clustered scenes have all centroids at the same position which forces the SAH builder to fall back to
+        // splitting at the median.
+        const glm::vec3 center = clustered ? glm::vec3(0.5f) : glm::vec3(positionDist(rng), positionDist(rng), positionDist(rng));
+        const glm::vec3 extent = glm::vec3(sizeDist(rng));
+        boxes.push_back(TestBox { Bounds(center - extent, center + extent) });
+    }
+    return boxes;
+}
+
+inline std::vector<Ray> generateTestRays(unsigned numRays, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> positionDist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> directionDist(-0.5f, 0.5f);
+
+    std::vector<Ray> rays;
+    for (unsigned i = 0; i < numRays; i++) {
+        const glm::vec3 origin = glm::vec3(positionDist(rng), positionDist(rng), -15.0f);
+        const glm::vec3 direction = glm::normalize(glm::vec3(directionDist(rng), directionDist(rng), 1.0f));
+        rays.push_back(Ray(origin, direction));
+    }
+    return rays;
+}
+
+}
@@ -0,0 +1,109 @@
+#include "pandora/graphics_core/ray.h"
+#include "pandora/traversal/embree_packets.h"
+#include "gtest/gtest.h"
+#include <embree3/rtcore.h>
+#include <glm/glm.hpp>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace pandora;
+
+class EmbreePackets : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        m_device = rtcNewDevice(nullptr);
+        m_scene = rtcNewScene(m_device);
+
+        // Cloud of small random triangles
+        constexpr unsigned numTriangles = 2000;
+        std::mt19937 rng { 123 };
+        std::uniform_real_distribution<float> positionDist(-5.0f, 5.0f);
+        std::uniform_real_distribution<float> offsetDist(-0.5f, 0.5f);
+
+        RTCGeometry geometry = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_TRIANGLE);
+        auto* pVertices = reinterpret_cast<glm::vec3*>(rtcSetNewGeometryBuffer(
+            geometry, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(glm::vec3), 3 * numTriangles));
+        auto* pIndices = reinterpret_cast<glm::uvec3*>(rtcSetNewGeometryBuffer(
+            geometry, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, sizeof(glm::uvec3), numTriangles));
+        for (unsigned i = 0; i < numTriangles; i++) {
+            const glm::vec3 center { positionDist(rng), positionDist(rng), positionDist(rng) };
+            for (unsigned j = 0; j < 3; j++)
+                pVertices[3 * i + j] = center + glm::vec3(offsetDist(rng), offsetDist(rng), offsetDist(rng));
+            pIndices[i] = glm::uvec3(3 * i, 3 * i + 1, 3 * i + 2);
+        }
+        rtcCommitGeometry(geometry);
+        rtcAttachGeometry(m_scene, geometry);
+        rtcReleaseGeometry(geometry);
+        rtcCommitScene(m_scene);
+
+        // Rays through the triangle cloud, some of which miss it entirely
+        std::uniform_real_distribution<float> directionDist(-0.8f, 0.8f);
+        for (unsigned i = 0; i < 1000; i++) {
+            const glm::vec3 origin { positionDist(rng), positionDist(rng), -10.0f };
+            const glm::vec3 direction = glm::normalize(glm::vec3(directionDist(rng), directionDist(rng), 1.0f));
+            m_rays.push_back(Ray(origin, direction));
+        }
+    }
+
+    void TearDown() override
+    {
+        rtcReleaseScene(m_scene);
+        rtcReleaseDevice(m_device);
+    }
+
+    RTCDevice m_device;
+    RTCScene m_scene;
+    std::vector<Ray> m_rays;
+};
+
+TEST_F(EmbreePackets, IntersectMatchesSingleRay)
+{
+    int numHits = 0;
+    std::vector<RTCRayHit> packetHits(detail::embreePacketSize);
+    // Every packet size (1 to 16 active lanes) so that partially filled packets are covered
+    for (size_t start = 0, numActive = 1; start + numActive <= m_rays.size(); start += numActive, numActive = numActive % detail::embreePacketSize + 1) {
+        const std::span<const Ray> rays { m_rays.data() + start, numActive };
+        detail::intersectEmbreePacket(m_scene, rays, std::span(packetHits.data(), numActive));
+
+        for (size_t lane = 0; lane < numActive; lane++) {
+            const RTCRayHit scalarHit = detail::intersectEmbreeRay(m_scene, rays[lane]);
+            const RTCRayHit& packetHit = packetHits[lane];
+            ASSERT_EQ(packetHit.hit.geomID, scalarHit.hit.geomID);
+            if (scalarHit.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+                continue;
+
+            numHits++;
+            ASSERT_EQ(packetHit.hit.primID, scalarHit.hit.primID);
+            ASSERT_NEAR(packetHit.ray.tfar, scalarHit.ray.tfar, 1e-4f * scalarHit.ray.tfar);
+            ASSERT_NEAR(packetHit.hit.u, scalarHit.hit.u, 1e-4f);
+            ASSERT_NEAR(packetHit.hit.v, scalarHit.hit.v, 1e-4f);
+        }
+    }
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+}
+
+TEST_F(EmbreePackets, OccludedMatchesSingleRay)
+{
+    static constexpr float minInf = -std::numeric_limits<float>::infinity();
+
+    int numOccluded = 0, numUnoccluded = 0;
+    std::vector<float> packetTfars(detail::embreePacketSize);
+    for (size_t start = 0, numActive = 1; start + numActive <= m_rays.size(); start += numActive, numActive = numActive % detail::embreePacketSize + 1) {
+        const std::span<const Ray> rays { m_rays.data() + start, numActive };
+        detail::occludedEmbreePacket(m_scene, rays, std::span(packetTfars.data(), numActive));
+
+        for (size_t lane = 0; lane < numActive; lane++) {
+            const bool scalarOccluded = detail::occludedEmbreeRay(m_scene, rays[lane]) == minInf;
+            ASSERT_EQ(packetTfars[lane] == minInf, scalarOccluded);
+            if (scalarOccluded)
+                numOccluded++;
+            else
+                numUnoccluded++;
+        }
+    }
+    ASSERT_GT(numOccluded, 0);
+    ASSERT_GT(numUnoccluded, 0);
+}
@@ -0,0 +1,266 @@
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/interaction.h"
+#include "pandora/graphics_core/ray.h"
+#include "pandora/traversal/pauseable_bvh/pauseable_bvh4.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <span>
+#include <tuple>
+#include <vector>
+
+using namespace pandora;
+
+struct TestLeaf;
+
+struct PausedRay {
+    uint32_t rayID;
+    const TestLeaf* pLeaf;
+    PauseableBVHInsertHandle handle;
+};
+struct TraversalLog {
+    std::vector<std::vector<uint32_t>> visitedLeafs; // Leafs visited by each ray (in order)
+    std::vector<PausedRay> pausedRays;
+};
+struct TestRayState {
+    uint32_t rayID;
+    TraversalLog* pLog;
+};
+
+// Axis aligned box. Some of the leafs pause the ray (like a batching point would) instead of intersecting it.
+struct TestLeaf {
+    Bounds bounds;
+    uint32_t leafID;
+    bool pause;
+
+    Bounds getBounds() const { return bounds; }
+
+    std::optional<bool> intersect(Ray& ray, SurfaceInteraction& si, const TestRayState& state, PauseableBVHInsertHandle handle) const
+    {
+        state.pLog->visitedLeafs[state.rayID].push_back(leafID);
+        if (pause) {
+            state.pLog->pausedRays.push_back({ state.rayID, this, handle });
+            return {};
+        }
+        return intersectGeometry(ray, si);
+    }
+    std::optional<bool> intersectAny(Ray& ray, const TestRayState& state, PauseableBVHInsertHandle handle) const
+    {
+        SurfaceInteraction si;
+        return intersect(ray, si, state, handle);
+    }
+
+    bool intersectGeometry(Ray& ray, SurfaceInteraction& si) const
+    {
+        float tmin = ray.tnear, tmax = ray.tfar;
+        for (int axis = 0; axis < 3; axis++) {
+            const float invDir = 1.0f / ray.direction[axis];
+            float tNear = (bounds.min[axis] - ray.origin[axis]) * invDir;
+            float tFar = (bounds.max[axis] - ray.origin[axis]) * invDir;
+            if (tNear > tFar)
+                std::swap(tNear, tFar);
+            tmin = std::max(tmin, tNear);
+            tmax = std::min(tmax, tFar);
+        }
+        if (tmin > tmax || tmin >= ray.tfar)
+            return false;
+
+        ray.tfar = tmin;
+        si.position = ray.origin + tmin * ray.direction;
+        return true;
+    }
+};
+
+using TestBVH = PauseableBVH4<TestLeaf, TestRayState, TestRayState>;
+
+struct TraversalResult {
+    bool hit;
+    float tfar;
+    glm::vec3 position;
+    std::vector<uint32_t> visitedLeafs;
+};
+
+static std::vector<TestLeaf> generateLeafs(unsigned numLeafs, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> positionDist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> sizeDist(0.1f, 1.0f);
+
+    std::vector<TestLeaf> leafs;
+    for (unsigned i = 0; i < numLeafs; i++) {
+        const glm::vec3 center { positionDist(rng), positionDist(rng), positionDist(rng) };
+        const glm::vec3 extent = glm::vec3(sizeDist(rng));
+        leafs.push_back(TestLeaf { Bounds(center - extent, center + extent), i, i % 3 == 0 });
+    }
+    return leafs;
+}
+
+static std::vector<Ray> generateRays(unsigned numRays, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> positionDist(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> directionDist(-0.5f, 0.5f);
+
+    std::vector<Ray> rays;
+    for (unsigned i = 0; i < numRays; i++) {
+        // Some rays start inside the scene
+        const float z = (i % 4 == 0) ? positionDist(rng) : -15.0f;
+        const glm::vec3 origin { positionDist(rng), positionDist(rng), z };
+        const glm::vec3 direction = glm::normalize(glm::vec3(directionDist(rng), directionDist(rng), 1.0f));
+        rays.push_back(Ray(origin, direction));
+    }
+    return rays;
+}
+
+// Traces all rays through the BVH. Rays that are paused are intersected with the geometry of the leaf they were paused
+// at and then resumed, either one by one (intersect) or all at once (intersectBatch).
+static std::vector<TraversalResult> traceClosestHit(const TestBVH& bvh, std::span<const Ray> rays, bool batched)
+{
+    TraversalLog log;
+    log.visitedLeafs.resize(rays.size());
+    std::vector<Ray> tracedRays { std::begin(rays), std::end(rays) };
+    std::vector<SurfaceInteraction> surfaceInteractions(rays.size());
+    std::vector<bool> hits(rays.size(), false);
+
+    for (uint32_t rayID = 0; rayID < rays.size(); rayID++) {
+        const auto optHit = bvh.intersect(tracedRays[rayID], surfaceInteractions[rayID], TestRayState { rayID, &log });
+        if (optHit && *optHit)
+            hits[rayID] = true;
+    }
+
+    int numResumes = 0;
+    while (!log.pausedRays.empty()) {
+        std::vector<PausedRay> pausedRays;
+        std::swap(pausedRays, log.pausedRays);
+        for (const auto& [rayID, pLeaf, handle] : pausedRays) {
+            if (pLeaf->intersectGeometry(tracedRays[rayID], surfaceInteractions[rayID]))
+                hits[rayID] = true;
+        }
+
+        if (batched) {
+            std::vector<std::tuple<Ray, SurfaceInteraction, TestRayState, PauseableBVHInsertHandle>> items;
+            for (const auto& [rayID, pLeaf, handle] : pausedRays)
+                items.push_back({ tracedRays[rayID], surfaceInteractions[rayID], TestRayState { rayID, &log }, handle });
+
+            std::vector<std::optional<bool>> results(items.size());
+            bvh.intersectBatch(std::span(items), std::span(results), std::pmr::new_delete_resource());
+            for (size_t i = 0; i < items.size(); i++) {
+                const auto& [ray, si, state, handle] = items[i];
+                tracedRays[state.rayID] = ray;
+                surfaceInteractions[state.rayID] = si;
+                if (results[i] && *results[i])
+                    hits[state.rayID] = true;
+            }
+        } else {
+            for (const auto& [rayID, pLeaf, handle] : pausedRays) {
+                const auto optHit = bvh.intersect(tracedRays[rayID], surfaceInteractions[rayID], TestRayState { rayID, &log }, handle);
+                if (optHit && *optHit)
+                    hits[rayID] = true;
+            }
+        }
+        numResumes++;
+    }
+    EXPECT_GT(numResumes, 1);
+
+    std::vector<TraversalResult> results;
+    for (uint32_t rayID = 0; rayID < rays.size(); rayID++)
+        results.push_back({ hits[rayID], tracedRays[rayID].tfar, surfaceInteractions[rayID].position, log.visitedLeafs[rayID] });
+    return results;
+}
+
+static std::vector<TraversalResult> traceAnyHit(const TestBVH& bvh, std::span<const Ray> rays, bool batched)
+{
+    TraversalLog log;
+    log.visitedLeafs.resize(rays.size());
+    std::vector<Ray> tracedRays { std::begin(rays), std::end(rays) };
+    std::vector<bool> hits(rays.size(), false);
+
+    for (uint32_t rayID = 0; rayID < rays.size(); rayID++) {
+        const auto optHit = bvh.intersectAny(tracedRays[rayID], TestRayState { rayID, &log });
+        if (optHit && *optHit)
+            hits[rayID] = true;
+    }
+
+    while (!log.pausedRays.empty()) {
+        std::vector<PausedRay> pausedRays;
+        std::swap(pausedRays, log.pausedRays);
+
+        // Rays that hit the geometry of the leaf they were paused at are done
+        std::vector<PausedRay> resumedRays;
+        for (const auto& pausedRay : pausedRays) {
+            SurfaceInteraction si;
+            Ray ray = tracedRays[pausedRay.rayID];
+            if (pausedRay.pLeaf->intersectGeometry(ray, si))
+                hits[pausedRay.rayID] = true;
+            else
+                resumedRays.push_back(pausedRay);
+        }
+
+        if (batched) {
+            std::vector<std::tuple<Ray, TestRayState, PauseableBVHInsertHandle>> items;
+            for (const auto& [rayID, pLeaf, handle] : resumedRays)
+                items.push_back({ tracedRays[rayID], TestRayState { rayID, &log }, handle });
+
+            std::vector<std::optional<bool>> results(items.size());
+            bvh.intersectAnyBatch(std::span(items), std::span(results), std::pmr::new_delete_resource());
+            for (size_t i = 0; i < items.size(); i++) {
+                const auto& [ray, state, handle] = items[i];
+                tracedRays[state.rayID] = ray;
+                if (results[i] && *results[i])
+                    hits[state.rayID] = true;
+            }
+        } else {
+            for (const auto& [rayID, pLeaf, handle] : resumedRays) {
+                const auto optHit = bvh.intersectAny(tracedRays[rayID], TestRayState { rayID, &log }, handle);
+                if (optHit && *optHit)
+                    hits[rayID] = true;
+            }
+        }
+    }
+
+    std::vector<TraversalResult> results;
+    for (uint32_t rayID = 0; rayID < rays.size(); rayID++)
+        results.push_back({ hits[rayID], tracedRays[rayID].tfar, glm::vec3(0.0f), log.visitedLeafs[rayID] });
+    return results;
+}
+
+static void compareResults(std::span<const TraversalResult> reference, std::span<const TraversalResult> batched)
+{
+    ASSERT_EQ(reference.size(), batched.size());
+    int numHits = 0;
+    for (size_t rayID = 0; rayID < reference.size(); rayID++) {
+        ASSERT_EQ(reference[rayID].hit, batched[rayID].hit) << "Ray " << rayID;
+        ASSERT_EQ(reference[rayID].tfar, batched[rayID].tfar) << "Ray " << rayID;
+        ASSERT_EQ(reference[rayID].position, batched[rayID].position) << "Ray " << rayID;
+        ASSERT_EQ(reference[rayID].visitedLeafs, batched[rayID].visitedLeafs) << "Ray " << rayID;
+        if (reference[rayID].hit)
+            numHits++;
+    }
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+    ASSERT_LT(numHits, static_cast<int>(reference.size()));
+}
+
+TEST(PauseableBVH4, IntersectBatchSameAsSingleRay)
+{
+    std::vector<TestLeaf> leafs = generateLeafs(500, 123);
+    const TestBVH bvh { leafs };
+
+    const std::vector<Ray> rays = generateRays(2000, 456);
+    const auto reference = traceClosestHit(bvh, rays, false);
+    const auto batched = traceClosestHit(bvh, rays, true);
+    compareResults(reference, batched);
+}
+
+TEST(PauseableBVH4, IntersectAnyBatchSameAsSingleRay)
+{
+    std::vector<TestLeaf> leafs = generateLeafs(500, 789);
+    const TestBVH bvh { leafs };
+
+    const std::vector<Ray> rays = generateRays(2000, 1011);
+    const auto reference = traceAnyHit(bvh, rays, false);
+    const auto batched = traceAnyHit(bvh, rays, true);
+    compareResults(reference, batched);
+}
@@ -0,0 +1,139 @@
+#include "pandora/flatbuffers/wive_bvh8_generated.h"
+#include "pandora/traversal/bvh/wive_bvh8_build8.h"
+#include "pandora/traversal/persistent_bvh_store.h"
+#include "test_box.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+using namespace pandora;
+
+using TestBVH = WiVeBVH8Build8<TestBox>;
+
+class PersistentBVHStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        m_folder = std::filesystem::temp_directory_path() / "pandora_test_persistent_bvh_store";
+        std::filesystem::remove_all(m_folder);
+
+        m_boxes = generateTestBoxes(1000, false, 123);
+        std::vector<Bounds> leafBounds;
+        std::transform(std::begin(m_boxes), std::end(m_boxes), std::back_inserter(leafBounds), [](const TestBox& box) { return box.getBounds(); });
+        m_key = PersistentBVHStore::computeKey(leafBounds);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_folder);
+    }
+
+    static std::vector<std::byte> serializeBVH(const TestBVH& bvh)
+    {
+        flatbuffers::FlatBufferBuilder fbb;
+        fbb.Finish(bvh.serialize(fbb));
+        const auto bytes = std::as_bytes(std::span(fbb.GetBufferPointer(), fbb.GetSize()));
+        return { std::begin(bytes), std::end(bytes) };
+    }
+
+    std::filesystem::path m_folder;
+    std::vector<TestBox> m_boxes;
+    PersistentBVHStore::Key m_key;
+
+    static constexpr PersistentBVHStore::Format format { TestBVH::serializationVersion, TestBVH::branchingFactor, TestBVH::quantizedNodes };
+};
+
+TEST_F(PersistentBVHStoreTest, RoundTripSameHits)
+{
+    const PersistentBVHStore store { m_folder };
+    ASSERT_FALSE(store.load(m_key, m_boxes.size(), format).has_value());
+
+    std::vector<TestBox> buildBoxes = m_boxes;
+    const TestBVH bvh { buildBoxes };
+    store.store(m_key, serializeBVH(bvh));
+
+    // A new run constructs the BVH from the stored file and the (identical) leafs of the scene
+    const auto optMappedBVH = store.load(m_key, m_boxes.size(), format);
+    ASSERT_TRUE(optMappedBVH.has_value());
+    const TestBVH loadedBVH { serialization::GetWiVeBVH8(optMappedBVH->data()), m_boxes };
+
+    int numHits = 0;
+    for (const Ray& ray : generateTestRays(5000, 456)) {
+        Ray builtRay = ray, loadedRay = ray;
+        SurfaceInteraction builtSI, loadedSI;
+        const bool builtHit = bvh.intersect(builtRay, builtSI);
+        ASSERT_EQ(loadedBVH.intersect(loadedRay, loadedSI), builtHit);
+        if (builtHit) {
+            ASSERT_EQ(builtRay.tfar, loadedRay.tfar);
+            ASSERT_EQ(builtSI.position, loadedSI.position);
+            numHits++;
+        }
+
+        Ray builtAnyRay = ray, loadedAnyRay = ray;
+        ASSERT_EQ(bvh.intersectAny(builtAnyRay), loadedBVH.intersectAny(loadedAnyRay));
+    }
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+}
+
+TEST_F(PersistentBVHStoreTest, RejectsTruncatedFile)
+{
+    const PersistentBVHStore store { m_folder };
+    std::vector<TestBox> buildBoxes = m_boxes;
+    const std::vector<std::byte> serializedBVH = serializeBVH(TestBVH { buildBoxes });
+
+    // Simulate a run that crashed while writing the BVH
+    store.store(m_key, std::span(serializedBVH).first(serializedBVH.size() / 2));
+    ASSERT_FALSE(store.load(m_key, m_boxes.size(), format).has_value());
+
+    store.store(m_key, serializedBVH);
+    ASSERT_TRUE(store.load(m_key, m_boxes.size(), format).has_value());
+}
+
+TEST_F(PersistentBVHStoreTest, RejectsLeafCountMismatch)
+{
+    const PersistentBVHStore store { m_folder };
+    std::vector<TestBox> buildBoxes = m_boxes;
+    store.store(m_key, serializeBVH(TestBVH { buildBoxes }));
+
+    ASSERT_FALSE(store.load(m_key, m_boxes.size() + 1, format).has_value());
+    ASSERT_FALSE(store.load(m_key, m_boxes.size() - 1, format).has_value());
+    ASSERT_TRUE(store.load(m_key, m_boxes.size(), format).has_value());
+}
+
+TEST_F(PersistentBVHStoreTest, RejectsDifferentFormat)
+{
+    const PersistentBVHStore store { m_folder };
+    std::vector<TestBox> buildBoxes = m_boxes;
+    store.store(m_key, serializeBVH(TestBVH { buildBoxes }));
+
+    PersistentBVHStore::Format otherVersion = format;
+    otherVersion.version++;
+    ASSERT_FALSE(store.load(m_key, m_boxes.size(), otherVersion).has_value());
+
+    PersistentBVHStore::Format otherBranchingFactor = format;
+    otherBranchingFactor.branchingFactor = 16;
+    ASSERT_FALSE(store.load(m_key, m_boxes.size(), otherBranchingFactor).has_value());
+
+    PersistentBVHStore::Format otherNodeType = format;
+    otherNodeType.quantizedNodes = !otherNodeType.quantizedNodes;
+    ASSERT_FALSE(store.load(m_key, m_boxes.size(), otherNodeType).has_value());
+}
+
+TEST_F(PersistentBVHStoreTest, RenamesTemporaryFile)
+{
+    const PersistentBVHStore store { m_folder };
+    std::vector<TestBox> buildBoxes = m_boxes;
+    store.store(m_key, serializeBVH(TestBVH { buildBoxes }));
+
+    // Only the final file should remain
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(m_folder))
+        files.push_back(entry.path());
+    ASSERT_EQ(files.size(), 1u);
+    ASSERT_EQ(files[0].extension(), ".bvh");
+    ASSERT_TRUE(store.load(m_key, m_boxes.size(), format).has_value());
+}
@@ -0,0 +1,93 @@
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/ray.h"
+#include "pandora/traversal/ray_sorting.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <random>
+#include <span>
+#include <tuple>
+#include <vector>
+
+using namespace pandora;
+
+struct TestRayState {
+    uint32_t rayID;
+    uint64_t payload;
+};
+using TestRayItem = std::tuple<Ray, TestRayState>;
+
+TEST(RaySorting, SortRayBatch)
+{
+    const Bounds bounds { glm::vec3(-5.0f), glm::vec3(5.0f) };
+    std::mt19937 rng { 123 };
+    std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+    std::uniform_int_distribution<uint32_t> cellDist(0, 510);
+    std::uniform_int_distribution<uint32_t> octantDist(0, 7);
+
+    // Groups of rays that start in the same cell of the sort grid (inside the batching point) with the same direction
+    // octant, mixed with rays that start outside the batching point.
+    constexpr uint32_t raysPerGroup = 8;
+    std::vector<Ray> rays;
+    std::vector<uint32_t> groupIDs;
+    for (uint32_t group = 0; group < 50; group++) {
+        const glm::vec3 cell { cellDist(rng), cellDist(rng), cellDist(rng) };
+        const uint32_t octant = octantDist(rng);
+        const glm::vec3 octantSign { (octant & 0b001) ? 1.0f : -1.0f, (octant & 0b010) ? 1.0f : -1.0f, (octant & 0b100) ? 1.0f : -1.0f };
+        for (uint32_t i = 0; i < raysPerGroup; i++) {
+            const glm::vec3 positionInCell = cell + 0.25f + 0.5f * glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng));
+            const glm::vec3 origin = bounds.min + positionInCell / 511.0f * bounds.extent();
+            const glm::vec3 direction = octantSign * (0.1f + glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng)));
+            rays.push_back(Ray(origin, glm::normalize(direction)));
+            groupIDs.push_back(group);
+        }
+    }
+    for (uint32_t i = 0; i < 400; i++) {
+        const glm::vec3 origin = 3.0f * (glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng)) - 0.5f) * bounds.extent();
+        const glm::vec3 direction = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng)) - 0.5f;
+        rays.push_back(Ray(origin, glm::normalize(direction)));
+        groupIDs.push_back(std::numeric_limits<uint32_t>::max());
+    }
+    std::vector<uint32_t> permutation(rays.size());
+    std::iota(std::begin(permutation), std::end(permutation), 0);
+    std::shuffle(std::begin(permutation), std::end(permutation), rng);
+
+    std::vector<TestRayItem> items;
+    for (uint32_t rayID : permutation)
+        items.push_back({ rays[rayID], TestRayState { rayID, 0xABCD0000u + rayID } });
+    detail::sortRayBatch(std::span(items), bounds, std::pmr::new_delete_resource());
+
+    // The sorted batch is a permutation of the input in which every ray is still paired with its own state
+    ASSERT_EQ(items.size(), rays.size());
+    std::vector<bool> seen(rays.size(), false);
+    for (const auto& [ray, state] : items) {
+        ASSERT_LT(state.rayID, rays.size());
+        ASSERT_FALSE(seen[state.rayID]) << "Ray " << state.rayID << " is duplicated";
+        seen[state.rayID] = true;
+
+        ASSERT_EQ(state.payload, 0xABCD0000u + state.rayID);
+        ASSERT_EQ(ray.origin, rays[state.rayID].origin);
+        ASSERT_EQ(ray.direction, rays[state.rayID].direction);
+    }
+
+    // Sorted by key, so rays with the same key are adjacent
+    for (size_t i = 1; i < items.size(); i++)
+        ASSERT_LE(detail::computeRaySortKey(std::get<0>(items[i - 1]), bounds), detail::computeRaySortKey(std::get<0>(items[i]), bounds));
+
+    // Rays that start in the same cell and travel in the same octant share a key and end up next to each other
+    std::vector<std::vector<size_t>> groupPositions(50);
+    for (size_t i = 0; i < items.size(); i++) {
+        const uint32_t groupID = groupIDs[std::get<1>(items[i]).rayID];
+        if (groupID != std::numeric_limits<uint32_t>::max())
+            groupPositions[groupID].push_back(i);
+    }
+    for (const auto& positions : groupPositions) {
+        ASSERT_EQ(positions.size(), raysPerGroup);
+        const uint32_t groupKey = detail::computeRaySortKey(std::get<0>(items[positions[0]]), bounds);
+        for (size_t i = positions.front(); i <= positions.back(); i++)
+            ASSERT_EQ(detail::computeRaySortKey(std::get<0>(items[i]), bounds), groupKey);
+    }
+}
@@ -0,0 +1,144 @@
+#include "pandora/graphics_core/ray.h"
+#include "pandora/graphics_core/scene.h"
+#include "pandora/shapes/triangle.h"
+#include "pandora/svo/sparse_voxel_dag.h"
+#include "pandora/svo/voxel_grid.h"
+#include "pandora/traversal/scene_bundle.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <span>
+#include <vector>
+
+using namespace pandora;
+
+// Cloud of small random triangles
+static std::shared_ptr<TriangleShape> createTestMesh(glm::vec3 center, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> positionDist(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> offsetDist(-0.2f, 0.2f);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::uvec3> indices;
+    for (unsigned i = 0; i < 100; i++) {
+        const glm::vec3 triangleCenter = center + glm::vec3(positionDist(rng), positionDist(rng), positionDist(rng));
+        const unsigned firstVertex = static_cast<unsigned>(positions.size());
+        for (int j = 0; j < 3; j++)
+            positions.push_back(triangleCenter + glm::vec3(offsetDist(rng), offsetDist(rng), offsetDist(rng)));
+        indices.push_back(glm::uvec3(firstVertex, firstVertex + 1, firstVertex + 2));
+    }
+    return std::make_shared<TriangleShape>(std::move(indices), std::move(positions), std::vector<glm::vec3> {}, std::vector<glm::vec2> {});
+}
+
+static SparseVoxelDAG createSVDAG(const Shape& shape, int resolution)
+{
+    VoxelGrid grid { shape.getBounds(), resolution };
+    shape.voxelize(grid);
+    return SparseVoxelDAG { grid };
+}
+
+static std::vector<Ray> generateRays(const Bounds& bounds, unsigned numRays, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+    std::uniform_real_distribution<float> directionDist(-1.0f, 1.0f);
+
+    std::vector<Ray> rays;
+    for (unsigned i = 0; i < numRays; i++) {
+        const glm::vec3 offset = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng)) - 0.5f;
+        const glm::vec3 origin = bounds.center() + 2.0f * offset * bounds.extent();
+        const glm::vec3 direction = glm::normalize(glm::vec3(directionDist(rng), directionDist(rng), directionDist(rng)) + glm::vec3(0.01f));
+        rays.push_back(Ray(origin, direction));
+    }
+    return rays;
+}
+
+TEST(SparseVoxelDAG, SerializationRoundTrip)
+{
+    const auto pMesh1 = createTestMesh(glm::vec3(0.0f), 123);
+    const auto pMesh2 = createTestMesh(glm::vec3(1.0f, 2.0f, 3.0f), 456);
+    SparseVoxelDAG svdag1 = createSVDAG(*pMesh1, 32);
+    SparseVoxelDAG svdag2 = createSVDAG(*pMesh2, 64);
+
+    // Serialization requires the SVDAGs to share their nodes
+    std::vector<SparseVoxelDAG*> svdags { &svdag1, &svdag2 };
+    SparseVoxelDAG::compressDAGs(svdags);
+
+    flatbuffers::FlatBufferBuilder builder;
+    const std::vector<const SparseVoxelDAG*> constSVDAGs { &svdag1, &svdag2 };
+    builder.Finish(SparseVoxelDAG::serializeDAGs(builder, constSVDAGs));
+
+    auto optLoadedSVDAGs = [&]() {
+        // The loaded SVDAGs should not depend on the lifetime of the serialized data
+        const std::vector<uint8_t> buffer { builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize() };
+        return SparseVoxelDAG::loadSerializedDAGs(flatbuffers::GetRoot<serialization::SparseVoxelDAGs>(buffer.data()));
+    }();
+    ASSERT_TRUE(optLoadedSVDAGs.has_value());
+    ASSERT_EQ(optLoadedSVDAGs->size(), 2u);
+
+    int numHits = 0;
+    const std::array<const Shape*, 2> meshes { pMesh1.get(), pMesh2.get() };
+    for (size_t i = 0; i < svdags.size(); i++) {
+        const SparseVoxelDAG& original = *svdags[i];
+        const SparseVoxelDAG& loaded = (*optLoadedSVDAGs)[i];
+        for (const Ray& ray : generateRays(meshes[i]->getBounds(), 2000, static_cast<unsigned>(i))) {
+            const auto originalHit = original.intersectScalar(ray);
+            ASSERT_EQ(loaded.intersectScalar(ray), originalHit);
+            if (originalHit)
+                numHits++;
+        }
+    }
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+}
+
+class SceneBundleTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        m_folder = std::filesystem::temp_directory_path() / "pandora_test_scene_bundle";
+        std::filesystem::remove_all(m_folder);
+        std::filesystem::create_directories(m_folder);
+
+        m_sceneFile = m_folder / "scene.json";
+        std::ofstream { m_sceneFile } << "{}";
+
+        SceneBuilder sceneBuilder;
+        sceneBuilder.addSceneObjectToRoot(createTestMesh(glm::vec3(0.0f), 123), nullptr);
+        sceneBuilder.addSceneObjectToRoot(createTestMesh(glm::vec3(5.0f), 456), nullptr);
+        m_pScene = std::make_unique<Scene>(sceneBuilder.build());
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_folder);
+    }
+
+    std::filesystem::path m_folder;
+    std::filesystem::path m_sceneFile;
+    std::unique_ptr<Scene> m_pScene;
+};
+
+TEST_F(SceneBundleTest, MissAfterSceneFileChanged)
+{
+    const SceneBundle bundle { m_folder / "scene.bundle" };
+    const auto& sceneObjects = m_pScene->pRoot->objects;
+    const std::vector<std::vector<const SceneObject*>> sceneObjectGroups { { sceneObjects[0].get() }, { sceneObjects[1].get() } };
+
+    const auto key = SceneBundle::computeKey(*m_pScene, m_sceneFile, 1000, 32);
+    bundle.store(key, *m_pScene, sceneObjectGroups, {});
+    const auto optContents = bundle.load(key, *m_pScene);
+    ASSERT_TRUE(optContents.has_value());
+    ASSERT_EQ(optContents->sceneObjectGroups, sceneObjectGroups);
+
+    // Touching the scene file (e.g. after editing the geometry) invalidates the bundle
+    std::filesystem::last_write_time(m_sceneFile, std::filesystem::last_write_time(m_sceneFile) + std::chrono::hours(1));
+    const auto newKey = SceneBundle::computeKey(*m_pScene, m_sceneFile, 1000, 32);
+    ASSERT_NE(newKey, key);
+    ASSERT_FALSE(bundle.load(newKey, *m_pScene).has_value());
+}
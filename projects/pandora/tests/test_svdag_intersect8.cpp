@@ -0,0 +1,104 @@
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/ray.h"
+#include "pandora/shapes/triangle.h"
+#include "pandora/svo/sparse_voxel_dag.h"
+#include "pandora/svo/voxel_grid.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <span>
+#include <vector>
+
+using namespace pandora;
+
+// Closed mesh (octahedron) with a cloud of small triangles around it so that the SVDAG has both solid and sparse
+// regions.
+static TriangleShape createTestMesh()
+{
+    std::vector<glm::vec3> positions = {
+        glm::vec3(-1, 0, 0), glm::vec3(1, 0, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, 0, -1), glm::vec3(0, 0, 1)
+    };
+    std::vector<glm::uvec3> indices = {
+        glm::uvec3(0, 2, 4), glm::uvec3(0, 4, 3), glm::uvec3(0, 3, 5), glm::uvec3(0, 5, 2),
+        glm::uvec3(1, 4, 2), glm::uvec3(1, 3, 4), glm::uvec3(1, 5, 3), glm::uvec3(1, 2, 5)
+    };
+
+    std::mt19937 rng { 123 };
+    std::uniform_real_distribution<float> positionDist(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> offsetDist(-0.1f, 0.1f);
+    for (int i = 0; i < 200; i++) {
+        const glm::vec3 center { positionDist(rng), positionDist(rng), positionDist(rng) };
+        const unsigned firstVertex = static_cast<unsigned>(positions.size());
+        for (int j = 0; j < 3; j++)
+            positions.push_back(center + glm::vec3(offsetDist(rng), offsetDist(rng), offsetDist(rng)));
+        indices.push_back(glm::uvec3(firstVertex, firstVertex + 1, firstVertex + 2));
+    }
+
+    return TriangleShape(std::move(indices), std::move(positions), {}, {});
+}
+
+static std::vector<Ray> generateRays(const Bounds& bounds, unsigned numRays, unsigned seed)
+{
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> unitDist(0.0f, 1.0f);
+    std::uniform_real_distribution<float> directionDist(-1.0f, 1.0f);
+
+    const glm::vec3 extent = bounds.extent();
+    std::vector<Ray> rays;
+    for (unsigned i = 0; i < numRays; i++) {
+        // Half of the rays start inside the bounds of the SVDAG, the other half start outside of it
+        const float scale = (i % 2 == 0) ? 1.0f : 3.0f;
+        const glm::vec3 offset = glm::vec3(unitDist(rng), unitDist(rng), unitDist(rng)) - 0.5f;
+        const glm::vec3 origin = bounds.center() + scale * offset * extent;
+
+        glm::vec3 direction { directionDist(rng), directionDist(rng), directionDist(rng) };
+        // Include some axis aligned rays to test the handling of (near) zero direction components
+        if (i % 7 == 0)
+            direction.x = 0.0f;
+        if (i % 11 == 0)
+            direction.y = 0.0f;
+        if (glm::dot(direction, direction) == 0.0f)
+            direction.z = 1.0f;
+        rays.push_back(Ray(origin, glm::normalize(direction)));
+    }
+    return rays;
+}
+
+static void testSameHitsAsScalar(int resolution)
+{
+    const TriangleShape mesh = createTestMesh();
+    VoxelGrid grid { mesh.getBounds(), resolution };
+    mesh.voxelize(grid);
+    const SparseVoxelDAG svdag { grid };
+
+    const std::vector<Ray> rays = generateRays(grid.bounds(), 5000, resolution);
+
+    int numHits = 0, numMisses = 0;
+    // Every batch size (1 to 8 rays) so that partially filled batches are covered
+    for (size_t start = 0, count = 1; start + count <= rays.size(); start += count, count = count % 8 + 1) {
+        const std::span<const Ray> batch { rays.data() + start, count };
+        const uint32_t hitMask = svdag.intersect8(batch);
+        ASSERT_EQ(hitMask >> count, 0u) << "Inactive lanes should never report a hit";
+
+        for (size_t lane = 0; lane < count; lane++) {
+            const bool scalarHit = svdag.intersectScalar(batch[lane]).has_value();
+            ASSERT_EQ((hitMask >> lane) & 0b1, scalarHit ? 1u : 0u) << "Ray " << start + lane;
+            if (scalarHit)
+                numHits++;
+            else
+                numMisses++;
+        }
+    }
+
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+    ASSERT_GT(numMisses, 0);
+}
+
+TEST(SparseVoxelDAG, Intersect8SameAsScalar)
+{
+    testSameHitsAsScalar(16);
+    testSameHitsAsScalar(64);
+}
@@ -0,0 +1,106 @@
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/shapes/triangle_compression.h"
+#include "gtest/gtest.h"
+#include <glm/glm.hpp>
+#include <random>
+#include <vector>
+
+using namespace pandora;
+
+static void testRoundTrip(const Bounds& bounds, unsigned seed)
+{
+    constexpr uint32_t numVertices = 10000;
+    constexpr uint32_t numTriangles = 20000;
+
+    std::mt19937 rng { seed };
+    std::uniform_real_distribution<float> xDist(bounds.min.x, bounds.max.x);
+    std::uniform_real_distribution<float> yDist(bounds.min.y, bounds.max.y);
+    std::uniform_real_distribution<float> zDist(bounds.min.z, bounds.max.z);
+    std::normal_distribution<float> normalDist;
+    std::uniform_int_distribution<uint32_t> localIndexDist(0, 16);
+    std::uniform_int_distribution<uint32_t> globalIndexDist(0, numVertices - 1);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    for (uint32_t i = 0; i < numVertices; i++) {
+        positions.push_back(glm::vec3(xDist(rng), yDist(rng), zDist(rng)));
+        normals.push_back(glm::normalize(glm::vec3(normalDist(rng), normalDist(rng), normalDist(rng))));
+    }
+    // Also include the corners so that quantization at the edges of the bounds is covered.
+    positions[0] = bounds.min;
+    positions[1] = bounds.max;
+    normals[0] = glm::vec3(0, 0, -1);
+    normals[1] = glm::vec3(1, 0, 0);
+
+    // Mostly local indices (small deltas) with the occasional large jump in either direction.
+    std::vector<glm::uvec3> indices;
+    for (uint32_t i = 0; i < numTriangles; i++) {
+        const uint32_t base = (i % 64 == 0) ? globalIndexDist(rng) : (i / 2) % numVertices;
+        glm::uvec3 triangle;
+        for (int j = 0; j < 3; j++)
+            triangle[j] = (base + localIndexDist(rng)) % numVertices;
+        indices.push_back(triangle);
+    }
+
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(detail::compressTriangleMesh(builder, bounds, indices, positions, normals));
+    const auto* pCompressed = flatbuffers::GetRoot<serialization::CompressedTriangleMesh>(builder.GetBufferPointer());
+
+    std::vector<glm::uvec3> decodedIndices;
+    std::vector<glm::vec3> decodedPositions;
+    std::vector<glm::vec3> decodedNormals;
+    detail::decompressTriangleMesh(pCompressed, bounds, decodedIndices, decodedPositions, decodedNormals);
+
+    // Indices are stored losslessly.
+    ASSERT_EQ(decodedIndices.size(), indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        ASSERT_EQ(decodedIndices[i], indices[i]);
+
+    // Positions are quantized to 16 bits per axis relative to the bounds (rounded to the nearest step).
+    const glm::vec3 extent = bounds.extent();
+    const glm::vec3 maxPositionError = 0.5f * extent / 65535.0f + 1e-5f * glm::max(glm::abs(bounds.min), glm::abs(bounds.max));
+    ASSERT_EQ(decodedPositions.size(), positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            ASSERT_NEAR(decodedPositions[i][axis], positions[i][axis], maxPositionError[axis] + 1e-6f);
+            ASSERT_GE(decodedPositions[i][axis], bounds.min[axis]);
+            ASSERT_LE(decodedPositions[i][axis], bounds.max[axis]);
+        }
+    }
+
+    // 16-bit octahedral normals have an error of roughly 1e-4 (measured maximum is ~6.5e-5).
+    ASSERT_EQ(decodedNormals.size(), normals.size());
+    for (size_t i = 0; i < normals.size(); i++)
+        ASSERT_LT(glm::length(decodedNormals[i] - normals[i]), 2e-4f);
+}
+
+TEST(TriangleCompression, RoundTrip)
+{
+    testRoundTrip(Bounds(glm::vec3(-1.0f), glm::vec3(1.0f)), 123);
+    testRoundTrip(Bounds(glm::vec3(-250.0f, 10.0f, 3.0f), glm::vec3(1000.0f, 12.0f, 900.0f)), 456);
+}
+
+TEST(TriangleCompression, FlatMesh)
+{
+    // Zero extent along an axis should not produce NaNs.
+    testRoundTrip(Bounds(glm::vec3(-1.0f, 5.0f, -1.0f), glm::vec3(1.0f, 5.0f, 1.0f)), 789);
+}
+
+TEST(TriangleCompression, WithoutNormals)
+{
+    const Bounds bounds { glm::vec3(0.0f), glm::vec3(1.0f) };
+    const std::vector<glm::vec3> positions { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+    const std::vector<glm::uvec3> indices { glm::uvec3(0, 1, 2), glm::uvec3(2, 1, 0) };
+
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(detail::compressTriangleMesh(builder, bounds, indices, positions, {}));
+    const auto* pCompressed = flatbuffers::GetRoot<serialization::CompressedTriangleMesh>(builder.GetBufferPointer());
+
+    std::vector<glm::uvec3> decodedIndices;
+    std::vector<glm::vec3> decodedPositions;
+    std::vector<glm::vec3> decodedNormals;
+    detail::decompressTriangleMesh(pCompressed, bounds, decodedIndices, decodedPositions, decodedNormals);
+    ASSERT_EQ(decodedIndices, indices);
+    ASSERT_EQ(decodedPositions, positions);
+    ASSERT_TRUE(decodedNormals.empty());
+}
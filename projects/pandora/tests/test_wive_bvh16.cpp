@@ -0,0 +1,65 @@
+#include "pandora/traversal/bvh/wive_bvh16_build16.h"
+#include "pandora/traversal/bvh/wive_bvh8_build8.h"
+#include "test_box.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+using namespace pandora;
+
+#ifdef PANDORA_ISA_AVX512
+static void testSameHitsAsWiVeBVH8(unsigned numBoxes, unsigned seed)
+{
+    // Both BVHs take ownership of (and may reorder) the leaf objects so give each its own copy
+    const std::vector<TestBox> boxes = generateTestBoxes(numBoxes, false, seed);
+    std::vector<TestBox> boxes8 = boxes;
+    std::vector<TestBox> boxes16 = boxes;
+    const WiVeBVH8Build8<TestBox> bvh8 { boxes8 };
+    const WiVeBVH16Build16<TestBox> bvh16 { boxes16 };
+
+    int numHits = 0;
+    const std::vector<Ray> rays = generateTestRays(5000, seed + 1);
+    for (const Ray& ray : rays) {
+        Ray ray8 = ray, ray16 = ray;
+        SurfaceInteraction si8, si16;
+        const bool hit8 = bvh8.intersect(ray8, si8);
+        ASSERT_EQ(bvh16.intersect(ray16, si16), hit8);
+        if (hit8) {
+            ASSERT_EQ(ray8.tfar, ray16.tfar);
+            ASSERT_EQ(si8.position, si16.position);
+            numHits++;
+        }
+
+        Ray anyRay8 = ray, anyRay16 = ray;
+        const bool anyHit8 = bvh8.intersectAny(anyRay8);
+        ASSERT_EQ(bvh16.intersectAny(anyRay16), anyHit8);
+        ASSERT_EQ(anyHit8, hit8);
+    }
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+
+    // Stream traversal
+    std::vector<Ray> rays8 = rays, rays16 = rays;
+    std::vector<SurfaceInteraction> sis8(rays.size()), sis16(rays.size());
+    bvh8.intersect(std::span(rays8), std::span(sis8));
+    bvh16.intersect(std::span(rays16), std::span(sis16));
+    for (size_t i = 0; i < rays.size(); i++)
+        ASSERT_EQ(rays8[i].tfar, rays16[i].tfar);
+
+    std::vector<Ray> anyRays8 = rays, anyRays16 = rays;
+    std::vector<uint32_t> anyHits8(rays.size()), anyHits16(rays.size());
+    bvh8.intersectAny(std::span(anyRays8), std::span(anyHits8));
+    bvh16.intersectAny(std::span(anyRays16), std::span(anyHits16));
+    for (size_t i = 0; i < rays.size(); i++)
+        ASSERT_EQ(anyHits8[i] != 0, anyHits16[i] != 0);
+}
+
+TEST(WiVeBVH16, SameHitsAsWiVeBVH8)
+{
+    testSameHitsAsWiVeBVH8(1, 123);
+    testSameHitsAsWiVeBVH8(17, 456);
+    testSameHitsAsWiVeBVH8(5000, 789);
+    testSameHitsAsWiVeBVH8(60000, 1011);
+}
+#endif
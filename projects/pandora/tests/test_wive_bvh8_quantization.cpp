@@ -0,0 +1,95 @@
+#include "pandora/graphics_core/bounds.h"
+#include "pandora/graphics_core/interaction.h"
+#include "pandora/graphics_core/ray.h"
+#include "pandora/traversal/bvh/wive_bvh8.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <limits>
+#include <random>
+#include <span>
+
+using namespace pandora;
+
+struct TestLeaf {
+    Bounds bounds;
+
+    Bounds getBounds() const { return bounds; }
+    bool intersect(Ray&, SurfaceInteraction&) const { return false; }
+    bool intersectAny(Ray&) const { return false; }
+};
+
+// Exposes the (protected) quantization helpers of WiVeBVH8
+struct QuantizationTest : public WiVeBVH8<TestLeaf> {
+    using WiVeBVH8<TestLeaf>::quantizeChildBounds;
+    using WiVeBVH8<TestLeaf>::quantizationScale;
+};
+
+static void testConservative(std::span<const float, 8> childMin, std::span<const float, 8> childMax, unsigned numChildren)
+{
+    float origin;
+    uint8_t scaleExponent;
+    std::array<uint8_t, 8> qMin, qMax;
+    QuantizationTest::quantizeChildBounds(childMin, childMax, numChildren, origin, scaleExponent, qMin, qMax);
+
+    // Decode the same way as the traversal code does (q * scale + origin)
+    const float scale = QuantizationTest::quantizationScale(scaleExponent);
+    for (unsigned i = 0; i < numChildren; i++) {
+        const float decodedMin = static_cast<float>(qMin[i]) * scale + origin;
+        const float decodedMax = static_cast<float>(qMax[i]) * scale + origin;
+        ASSERT_LE(qMin[i], qMax[i]);
+        ASSERT_LE(decodedMin, childMin[i]) << "child " << i << " of " << numChildren;
+        ASSERT_GE(decodedMax, childMax[i]) << "child " << i << " of " << numChildren;
+    }
+}
+
+TEST(WiVeBVH8Quantization, ContainsRandomBounds)
+{
+    std::mt19937 rng { 12345 };
+    std::uniform_int_distribution<unsigned> numChildrenDist(1, 8);
+    std::uniform_int_distribution<int> exponentDist(-20, 20);
+    std::uniform_real_distribution<float> unitDist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> sizeDist(0.0f, 1.0f);
+
+    for (int iteration = 0; iteration < 100000; iteration++) {
+        // Nodes of very different sizes and distances from the origin
+        const float magnitude = std::ldexp(1.0f + sizeDist(rng), exponentDist(rng));
+        const float offset = std::ldexp(unitDist(rng), exponentDist(rng));
+        const unsigned numChildren = numChildrenDist(rng);
+
+        std::array<float, 8> childMin, childMax;
+        for (unsigned i = 0; i < numChildren; i++) {
+            childMin[i] = offset + magnitude * unitDist(rng);
+            childMax[i] = childMin[i] + magnitude * sizeDist(rng);
+        }
+        testConservative(childMin, childMax, numChildren);
+    }
+}
+
+TEST(WiVeBVH8Quantization, ContainsDegenerateBounds)
+{
+    // Flat children and a node without any extent
+    std::array<float, 8> childMin { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+    std::array<float, 8> childMax = childMin;
+    testConservative(childMin, childMax, 8);
+
+    childMin = { -3.0f, 0.5f, 0.5f, 2.0f, 0, 0, 0, 0 };
+    childMax = { -3.0f, 0.5f, 7.25f, 2.0f, 0, 0, 0, 0 };
+    testConservative(childMin, childMax, 4);
+}
+
+TEST(WiVeBVH8Quantization, ContainsExtremeBounds)
+{
+    // Very large coordinates, very small extents far from the origin and denormal sized extents
+    std::array<float, 8> childMin { -1e30f, 1e29f, 0, 0, 0, 0, 0, 0 };
+    std::array<float, 8> childMax { -1e29f, 1e30f, 0, 0, 0, 0, 0, 0 };
+    testConservative(childMin, childMax, 2);
+
+    childMin = { 1e6f, std::nextafter(1e6f, 2e6f), 0, 0, 0, 0, 0, 0 };
+    childMax = { std::nextafter(1e6f, 2e6f), std::nextafter(childMin[1], 2e6f), 0, 0, 0, 0, 0, 0 };
+    testConservative(childMin, childMax, 2);
+
+    const float tiny = std::numeric_limits<float>::denorm_min();
+    childMin = { 0.0f, tiny, 0, 0, 0, 0, 0, 0 };
+    childMax = { tiny, 4 * tiny, 0, 0, 0, 0, 0, 0 };
+    testConservative(childMin, childMax, 2);
+}
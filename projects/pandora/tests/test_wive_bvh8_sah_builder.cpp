@@ -0,0 +1,67 @@
+#include "pandora/traversal/bvh/wive_bvh8_build8.h"
+#include "pandora/traversal/bvh/wive_bvh8_build_sah.h"
+#include "test_box.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+using namespace pandora;
+
+static void testSameHits(unsigned numBoxes, bool clustered, unsigned seed)
+{
+    // Both builders take ownership of (and may reorder) the leaf objects so give each its own copy
+    const std::vector<TestBox> boxes = generateTestBoxes(numBoxes, clustered, seed);
+    std::vector<TestBox> embreeBoxes = boxes;
+    std::vector<TestBox> sahBoxes = boxes;
+    const WiVeBVH8Build8<TestBox> embreeBVH { embreeBoxes };
+    const WiVeBVH8BuildSAH<TestBox> sahBVH { sahBoxes };
+
+    const std::vector<Ray> rays = generateTestRays(5000, seed + 1);
+    for (const Ray& ray : rays) {
+        Ray embreeRay = ray, sahRay = ray;
+        SurfaceInteraction embreeSI, sahSI;
+        const bool embreeHit = embreeBVH.intersect(embreeRay, embreeSI);
+        const bool sahHit = sahBVH.intersect(sahRay, sahSI);
+        ASSERT_EQ(embreeHit, sahHit);
+        if (embreeHit) {
+            ASSERT_EQ(embreeRay.tfar, sahRay.tfar);
+            ASSERT_EQ(embreeSI.position, sahSI.position);
+        }
+
+        Ray embreeAnyRay = ray, sahAnyRay = ray;
+        const bool sahAnyHit = sahBVH.intersectAny(sahAnyRay);
+        ASSERT_EQ(embreeBVH.intersectAny(embreeAnyRay), sahAnyHit);
+        ASSERT_EQ(sahAnyHit, sahHit);
+    }
+
+    // Stream traversal
+    std::vector<Ray> embreeRays = rays, sahRays = rays;
+    std::vector<SurfaceInteraction> embreeSIs(rays.size()), sahSIs(rays.size());
+    embreeBVH.intersect(embreeRays, embreeSIs);
+    sahBVH.intersect(sahRays, sahSIs);
+    for (size_t i = 0; i < rays.size(); i++)
+        ASSERT_EQ(embreeRays[i].tfar, sahRays[i].tfar);
+
+    std::vector<Ray> embreeAnyRays = rays, sahAnyRays = rays;
+    std::vector<uint32_t> embreeAnyHits(rays.size()), sahAnyHits(rays.size());
+    embreeBVH.intersectAny(embreeAnyRays, embreeAnyHits);
+    sahBVH.intersectAny(sahAnyRays, sahAnyHits);
+    for (size_t i = 0; i < rays.size(); i++)
+        ASSERT_EQ(embreeAnyHits[i] != 0, sahAnyHits[i] != 0);
+}
+
+TEST(WiVeBVH8SAHBuilder, SameHitsAsEmbreeBuilder)
+{
+    testSameHits(1, false, 123);
+    testSameHits(3, false, 456);
+    testSameHits(5000, false, 789);
+    // Large enough to go through the parallel binning & partitioning code paths
+    testSameHits(60000, false, 1011);
+}
+
+TEST(WiVeBVH8SAHBuilder, SameHitsAsEmbreeBuilderClustered)
+{
+    testSameHits(37, true, 1213);
+    testSameHits(20000, true, 1415);
+}
@@ -0,0 +1,59 @@
+#include "pandora/traversal/bvh/wive_bvh8_build8.h"
+#include "test_box.h"
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+using namespace pandora;
+
+static void testStreamSameAsSingleRay(unsigned numBoxes, unsigned seed)
+{
+    std::vector<TestBox> boxes = generateTestBoxes(numBoxes, false, seed);
+    const WiVeBVH8Build8<TestBox> bvh { boxes };
+
+    const std::vector<Ray> rays = generateTestRays(5000, seed + 1);
+
+    // Reference results using single ray traversal
+    std::vector<Ray> singleRays = rays;
+    std::vector<SurfaceInteraction> singleSIs(rays.size());
+    std::vector<bool> singleHits, singleAnyHits;
+    for (size_t i = 0; i < rays.size(); i++) {
+        singleHits.push_back(bvh.intersect(singleRays[i], singleSIs[i]));
+
+        Ray anyRay = rays[i];
+        singleAnyHits.push_back(bvh.intersectAny(anyRay));
+    }
+
+    int numHits = 0;
+    // Streams of different sizes (a stream of a single ray takes a separate code path)
+    for (size_t start = 0, count = 1; start + count <= rays.size(); start += count, count = (count * 2) % 511) {
+        std::vector<Ray> streamRays { std::begin(rays) + start, std::begin(rays) + start + count };
+        std::vector<SurfaceInteraction> streamSIs(count);
+        bvh.intersect(std::span(streamRays), std::span(streamSIs));
+
+        std::vector<Ray> streamAnyRays { std::begin(rays) + start, std::begin(rays) + start + count };
+        std::vector<uint32_t> streamAnyHits(count);
+        bvh.intersectAny(std::span(streamAnyRays), std::span(streamAnyHits));
+
+        for (size_t i = 0; i < count; i++) {
+            const size_t rayID = start + i;
+            ASSERT_EQ(streamRays[i].tfar, singleRays[rayID].tfar) << "Ray " << rayID;
+            if (singleHits[rayID]) {
+                ASSERT_EQ(streamSIs[i].position, singleSIs[rayID].position) << "Ray " << rayID;
+                numHits++;
+            }
+            ASSERT_EQ(streamAnyHits[i] != 0, singleAnyHits[rayID]) << "Ray " << rayID;
+        }
+    }
+
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numHits, 0);
+}
+
+TEST(WiVeBVH8Stream, SameHitsAsSingleRay)
+{
+    testStreamSameAsSingleRay(3, 123);
+    testStreamSameAsSingleRay(1000, 456);
+    testStreamSameAsSingleRay(20000, 789);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "intrinsics.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <immintrin.h> // AVX512
+#include <iostream>
+
+// The 16-wide types are only hardware accelerated when compiling for AVX512 (PANDORA_ISA_AVX512).
+// Otherwise the (slow) scalar fallback is used so that code using them still compiles.
+#ifdef __AVX512F__
+constexpr static int SIMD16_WIDTH = 16;
+#else
+constexpr static int SIMD16_WIDTH = 1;
+#endif
+
+namespace simd {
+template <int S>
+class _mask16;
+
+template <typename T, int S>
+class _vec16_base;
+
+template <typename T, int S>
+class _vec16;
+
+#ifdef __AVX512F__
+#include "simd/simd16_avx512.ipp"
+#endif
+#include "simd/simd16_scalar.ipp"
+
+using mask16 = _mask16<SIMD16_WIDTH>;
+using vec16_f32 = _vec16<float, SIMD16_WIDTH>;
+using vec16_u32 = _vec16<uint32_t, SIMD16_WIDTH>;
+}
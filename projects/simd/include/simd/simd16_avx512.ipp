@@ -0,0 +1,367 @@
+template <typename T, int S>
+class _vec16;
+
+template <int S>
+class _mask16;
+
+// AVX512 has dedicated mask registers so unlike _mask8<8> there is no need to keep a vector representation around.
+template <>
+class _mask16<16> {
+public:
+    _mask16() = default;
+    explicit inline _mask16(__mmask16 value)
+        : m_value(value)
+    {
+    }
+    explicit inline _mask16(bool v)
+        : m_value(v ? 0xFFFF : 0x0)
+    {
+    }
+
+    inline _mask16 operator&&(const _mask16& other) const
+    {
+        return _mask16(static_cast<__mmask16>(m_value & other.m_value));
+    }
+
+    inline _mask16 operator||(const _mask16& other) const
+    {
+        return _mask16(static_cast<__mmask16>(m_value | other.m_value));
+    }
+
+    inline int count(unsigned validMask) const
+    {
+        return popcount32(m_value & validMask);
+    }
+
+    inline int count() const
+    {
+        return popcount32(m_value);
+    }
+
+    inline bool none() const
+    {
+        return m_value == 0;
+    }
+
+    inline bool any() const
+    {
+        return m_value != 0;
+    }
+
+    inline bool all() const
+    {
+        return m_value == 0xFFFF;
+    }
+
+    inline int bitMask() const
+    {
+        return m_value;
+    }
+
+private:
+    __mmask16 m_value;
+
+    template <typename T, int S>
+    friend class _vec16;
+
+    friend _vec16<uint32_t, 16> blend(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b, const _mask16<16>& mask);
+    friend _vec16<float, 16> blend(const _vec16<float, 16>& a, const _vec16<float, 16>& b, const _mask16<16>& mask);
+};
+
+template <>
+class alignas(64) _vec16<uint32_t, 16> {
+public:
+    friend class _vec16<float, 16>; // Make friend so it can access us in permute operations
+
+    _vec16() = default;
+    explicit inline _vec16(std::span<const uint32_t, 16> v)
+    {
+        load(v);
+    }
+    explicit inline _vec16(uint32_t value)
+        : m_value(_mm512_set1_epi32(value))
+    {
+    }
+    explicit inline _vec16(__m512i value)
+        : m_value(value)
+    {
+    }
+
+    inline void loadAligned(std::span<const uint32_t> v)
+    {
+        m_value = _mm512_load_si512(v.data());
+    }
+
+    inline void storeAligned(std::span<uint32_t> v) const
+    {
+        _mm512_store_si512(v.data(), m_value);
+    }
+
+    inline void load(std::span<const uint32_t> v)
+    {
+        m_value = _mm512_loadu_si512(v.data());
+    }
+
+    inline void store(std::span<uint32_t> v) const
+    {
+        _mm512_storeu_si512(v.data(), m_value);
+    }
+
+    inline void broadcast(uint32_t value)
+    {
+        m_value = _mm512_set1_epi32(value);
+    }
+
+    inline _vec16<uint32_t, 16> operator+(const _vec16<uint32_t, 16>& other) const
+    {
+        return _vec16(_mm512_add_epi32(m_value, other.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator-(const _vec16<uint32_t, 16>& other) const
+    {
+        return _vec16(_mm512_sub_epi32(m_value, other.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator*(const _vec16<uint32_t, 16>& other) const
+    {
+        return _vec16(_mm512_mullo_epi32(m_value, other.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator<<(const _vec16<uint32_t, 16>& amount) const
+    {
+        return _vec16(_mm512_sllv_epi32(m_value, amount.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator<<(uint32_t amount) const
+    {
+        // _mm512_slli_epi32 requires a compile time constant when not optimizing
+        return _vec16(_mm512_sll_epi32(m_value, _mm_cvtsi32_si128(static_cast<int>(amount))));
+    }
+
+    inline _vec16<uint32_t, 16> operator>>(const _vec16<uint32_t, 16>& amount) const
+    {
+        return _vec16(_mm512_srlv_epi32(m_value, amount.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator>>(uint32_t amount) const
+    {
+        return _vec16(_mm512_srl_epi32(m_value, _mm_cvtsi32_si128(static_cast<int>(amount))));
+    }
+
+    inline _vec16<uint32_t, 16> operator&(const _vec16<uint32_t, 16>& other) const
+    {
+        return _vec16(_mm512_and_si512(m_value, other.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator|(const _vec16<uint32_t, 16>& other) const
+    {
+        return _vec16(_mm512_or_si512(m_value, other.m_value));
+    }
+
+    inline _vec16<uint32_t, 16> operator^(const _vec16<uint32_t, 16>& other) const
+    {
+        return _vec16(_mm512_xor_si512(m_value, other.m_value));
+    }
+
+    inline _mask16<16> operator<(const _vec16<uint32_t, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_epu32_mask(m_value, other.m_value, _MM_CMPINT_LT));
+    }
+
+    inline _mask16<16> operator<=(const _vec16<uint32_t, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_epu32_mask(m_value, other.m_value, _MM_CMPINT_LE));
+    }
+
+    inline _mask16<16> operator>(const _vec16<uint32_t, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_epu32_mask(m_value, other.m_value, _MM_CMPINT_NLE));
+    }
+
+    inline _mask16<16> operator>=(const _vec16<uint32_t, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_epu32_mask(m_value, other.m_value, _MM_CMPINT_NLT));
+    }
+
+    inline _vec16<uint32_t, 16> permute(const _vec16<uint32_t, 16>& index) const
+    {
+        return _vec16(_mm512_permutexvar_epi32(index.m_value, m_value));
+    }
+
+    inline _vec16<uint32_t, 16> compress(const _mask16<16>& mask) const
+    {
+        // Native compress instruction (emulated with a lookup table + permute in the AVX2 implementation)
+        return _vec16(_mm512_maskz_compress_epi32(mask.m_value, m_value));
+    }
+
+    inline uint32_t horizontalMin() const
+    {
+        return _mm512_reduce_min_epu32(m_value);
+    }
+
+    inline uint32_t horizontalMax() const
+    {
+        return _mm512_reduce_max_epu32(m_value);
+    }
+
+    friend _vec16<uint32_t, 16> min(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b);
+    friend _vec16<uint32_t, 16> max(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b);
+    friend _vec16<uint32_t, 16> blend(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b, const _mask16<16>& mask);
+    friend _vec16<uint32_t, 16> floatBitsToInt(const _vec16<float, 16>& a);
+    friend _vec16<float, 16> intBitsToFloat(const _vec16<uint32_t, 16>& a);
+
+private:
+    __m512i m_value;
+};
+
+template <>
+class alignas(64) _vec16<float, 16> {
+public:
+    _vec16() = default;
+    explicit inline _vec16(std::span<const float, 16> v)
+    {
+        load(v);
+    }
+    explicit inline _vec16(float value)
+        : m_value(_mm512_set1_ps(value))
+    {
+    }
+    explicit inline _vec16(__m512 value)
+        : m_value(value)
+    {
+    }
+
+    inline void loadAligned(std::span<const float> v)
+    {
+        m_value = _mm512_load_ps(v.data());
+    }
+
+    inline void storeAligned(std::span<float> v) const
+    {
+        _mm512_store_ps(v.data(), m_value);
+    }
+
+    inline void load(std::span<const float> v)
+    {
+        m_value = _mm512_loadu_ps(v.data());
+    }
+
+    inline void store(std::span<float> v) const
+    {
+        _mm512_storeu_ps(v.data(), m_value);
+    }
+
+    inline void broadcast(float value)
+    {
+        m_value = _mm512_set1_ps(value);
+    }
+
+    inline _vec16<float, 16> operator+(const _vec16<float, 16>& other) const
+    {
+        return _vec16(_mm512_add_ps(m_value, other.m_value));
+    }
+
+    inline _vec16<float, 16> operator-(const _vec16<float, 16>& other) const
+    {
+        return _vec16(_mm512_sub_ps(m_value, other.m_value));
+    }
+
+    inline _vec16<float, 16> operator*(const _vec16<float, 16>& other) const
+    {
+        return _vec16(_mm512_mul_ps(m_value, other.m_value));
+    }
+
+    inline _vec16<float, 16> operator/(const _vec16<float, 16>& other) const
+    {
+        return _vec16(_mm512_div_ps(m_value, other.m_value));
+    }
+
+    inline _mask16<16> operator<(const _vec16<float, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_ps_mask(m_value, other.m_value, _CMP_LT_OQ));
+    }
+
+    inline _mask16<16> operator<=(const _vec16<float, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_ps_mask(m_value, other.m_value, _CMP_LE_OQ));
+    }
+
+    inline _mask16<16> operator>(const _vec16<float, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_ps_mask(m_value, other.m_value, _CMP_GT_OQ));
+    }
+
+    inline _mask16<16> operator>=(const _vec16<float, 16>& other) const
+    {
+        return _mask16<16>(_mm512_cmp_ps_mask(m_value, other.m_value, _CMP_GE_OQ));
+    }
+
+    inline _vec16<float, 16> permute(const _vec16<uint32_t, 16>& index) const
+    {
+        return _vec16(_mm512_permutexvar_ps(index.m_value, m_value));
+    }
+
+    inline _vec16<float, 16> compress(const _mask16<16>& mask) const
+    {
+        return _vec16(_mm512_maskz_compress_ps(mask.m_value, m_value));
+    }
+
+    inline float horizontalMin() const
+    {
+        return _mm512_reduce_min_ps(m_value);
+    }
+
+    inline float horizontalMax() const
+    {
+        return _mm512_reduce_max_ps(m_value);
+    }
+
+    friend _vec16<float, 16> min(const _vec16<float, 16>& a, const _vec16<float, 16>& b);
+    friend _vec16<float, 16> max(const _vec16<float, 16>& a, const _vec16<float, 16>& b);
+    friend _vec16<float, 16> blend(const _vec16<float, 16>& a, const _vec16<float, 16>& b, const _mask16<16>& mask);
+    friend _vec16<uint32_t, 16> floatBitsToInt(const _vec16<float, 16>& a);
+    friend _vec16<float, 16> intBitsToFloat(const _vec16<uint32_t, 16>& a);
+
+private:
+    __m512 m_value;
+};
+
+inline _vec16<uint32_t, 16> min(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b)
+{
+    return _vec16<uint32_t, 16>(_mm512_min_epu32(a.m_value, b.m_value));
+}
+
+inline _vec16<uint32_t, 16> max(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b)
+{
+    return _vec16<uint32_t, 16>(_mm512_max_epu32(a.m_value, b.m_value));
+}
+
+inline _vec16<float, 16> min(const _vec16<float, 16>& a, const _vec16<float, 16>& b)
+{
+    return _vec16<float, 16>(_mm512_min_ps(a.m_value, b.m_value));
+}
+
+inline _vec16<float, 16> max(const _vec16<float, 16>& a, const _vec16<float, 16>& b)
+{
+    return _vec16<float, 16>(_mm512_max_ps(a.m_value, b.m_value));
+}
+
+inline _vec16<uint32_t, 16> blend(const _vec16<uint32_t, 16>& a, const _vec16<uint32_t, 16>& b, const _mask16<16>& mask)
+{
+    return _vec16<uint32_t, 16>(_mm512_mask_blend_epi32(mask.m_value, a.m_value, b.m_value));
+}
+
+inline _vec16<float, 16> blend(const _vec16<float, 16>& a, const _vec16<float, 16>& b, const _mask16<16>& mask)
+{
+    return _vec16<float, 16>(_mm512_mask_blend_ps(mask.m_value, a.m_value, b.m_value));
+}
+
+inline _vec16<uint32_t, 16> floatBitsToInt(const _vec16<float, 16>& a)
+{
+    return _vec16<uint32_t, 16>(_mm512_castps_si512(a.m_value));
+}
+
+inline _vec16<float, 16> intBitsToFloat(const _vec16<uint32_t, 16>& a)
+{
+    return _vec16<float, 16>(_mm512_castsi512_ps(a.m_value));
+}
@@ -0,0 +1,357 @@
+template <typename T>
+_vec16<T, 1> min(const _vec16<T, 1>& a, const _vec16<T, 1>& b);
+
+template <typename T>
+_vec16<T, 1> max(const _vec16<T, 1>& a, const _vec16<T, 1>& b);
+
+template <typename T>
+_vec16<T, 1> blend(const _vec16<T, 1>& a, const _vec16<T, 1>& b, const _mask16<1>& mask);
+
+template <>
+class _mask16<1> {
+public:
+    _mask16() = default;
+    inline explicit _mask16(bool v)
+    {
+        std::fill(std::begin(m_values), std::end(m_values), v);
+    }
+
+    inline _mask16 operator&&(const _mask16& other) const
+    {
+        _mask16 result;
+        std::transform(
+            std::begin(m_values),
+            std::end(m_values),
+            std::begin(other.m_values),
+            std::begin(result.m_values),
+            std::logical_and<bool>());
+        return result;
+    }
+
+    inline _mask16 operator||(const _mask16& other) const
+    {
+        _mask16 result;
+        std::transform(
+            std::begin(m_values),
+            std::end(m_values),
+            std::begin(other.m_values),
+            std::begin(result.m_values),
+            std::logical_or<bool>());
+        return result;
+    }
+
+    inline int count(unsigned validMask) const
+    {
+        return popcount32(bitMask() & validMask);
+    }
+
+    inline int count() const
+    {
+        return static_cast<int>(std::count(std::begin(m_values), std::end(m_values), true));
+    }
+
+    inline bool none() const
+    {
+        return count() == 0;
+    }
+
+    inline bool any() const
+    {
+        return count() > 0;
+    }
+
+    inline bool all() const
+    {
+        return count() == 16;
+    }
+
+    inline int bitMask() const
+    {
+        int bitMask = 0;
+        for (int i = 0; i < 16; i++)
+            if (m_values[i])
+                bitMask |= (1 << i);
+        return bitMask;
+    }
+
+private:
+    std::array<bool, 16> m_values;
+
+    template <typename T>
+    friend _vec16<T, 1> blend(const _vec16<T, 1>& a, const _vec16<T, 1>& b, const _mask16<1>& mask);
+
+    template <typename T, int S>
+    friend class _vec16_base; // Not possible to friend only _vec16_base<T, 1>
+};
+
+// Same structure as _vec8_base<T, 1>: functions shared between the float & integer specializations live in the base class.
+template <typename T>
+class _vec16_base<T, 1> {
+public:
+    _vec16_base() = default;
+
+    inline explicit _vec16_base(std::span<const T, 16> v)
+    {
+        std::copy(std::begin(v), std::end(v), std::begin(m_values));
+    }
+
+    inline explicit _vec16_base(T value)
+    {
+        std::fill(std::begin(m_values), std::end(m_values), value);
+    }
+
+    inline T operator[](int i) const
+    {
+        return m_values[i];
+    }
+
+    inline void load(std::span<const T> v)
+    {
+        assert(v.size() >= 16);
+        std::copy(std::begin(v), std::begin(v) + 16, std::begin(m_values));
+    }
+
+    inline void store(std::span<T> v) const
+    {
+        assert(v.size() >= 16);
+        std::copy(std::begin(m_values), std::end(m_values), std::begin(v));
+    }
+
+    inline void loadAligned(std::span<const T> v)
+    {
+        load(v);
+    }
+
+    inline void storeAligned(std::span<T> v) const
+    {
+        store(v);
+    }
+
+    inline void broadcast(const T& v)
+    {
+        std::fill(std::begin(m_values), std::end(m_values), v);
+    }
+
+    inline _vec16<T, 1> operator+(const _vec16<T, 1>& other) const
+    {
+        _vec16<T, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] + other.m_values[i];
+        return result;
+    }
+
+    inline _vec16<T, 1> operator-(const _vec16<T, 1>& other) const
+    {
+        _vec16<T, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] - other.m_values[i];
+        return result;
+    }
+
+    inline _vec16<T, 1> operator*(const _vec16<T, 1>& other) const
+    {
+        _vec16<T, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] * other.m_values[i];
+        return result;
+    }
+
+    inline _mask16<1> operator<(const _vec16<T, 1>& other) const
+    {
+        _mask16<1> mask;
+        for (int i = 0; i < 16; i++)
+            mask.m_values[i] = (m_values[i] < other.m_values[i]);
+        return mask;
+    }
+
+    inline _mask16<1> operator<=(const _vec16<T, 1>& other) const
+    {
+        _mask16<1> mask;
+        for (int i = 0; i < 16; i++)
+            mask.m_values[i] = (m_values[i] <= other.m_values[i]);
+        return mask;
+    }
+
+    inline _mask16<1> operator>(const _vec16<T, 1>& other) const
+    {
+        _mask16<1> mask;
+        for (int i = 0; i < 16; i++)
+            mask.m_values[i] = (m_values[i] > other.m_values[i]);
+        return mask;
+    }
+
+    inline _mask16<1> operator>=(const _vec16<T, 1>& other) const
+    {
+        _mask16<1> mask;
+        for (int i = 0; i < 16; i++)
+            mask.m_values[i] = (m_values[i] >= other.m_values[i]);
+        return mask;
+    }
+
+    inline _vec16<T, 1> permute(const _vec16<uint32_t, 1>& index) const;
+
+    inline _vec16<T, 1> compress(const _mask16<1>& mask) const
+    {
+        _vec16<T, 1> result;
+        int j = 0;
+        for (int i = 0; i < 16; i++) {
+            if (mask.m_values[i])
+                result.m_values[j++] = m_values[i];
+        }
+        for (; j < 16; j++)
+            result.m_values[j] = 0;
+        return result;
+    }
+
+    inline T horizontalMin() const
+    {
+        return *std::min_element(std::begin(m_values), std::end(m_values));
+    }
+
+    inline T horizontalMax() const
+    {
+        return *std::max_element(std::begin(m_values), std::end(m_values));
+    }
+
+    friend _vec16<T, 1> min<T>(const _vec16<T, 1>& a, const _vec16<T, 1>& b);
+    friend _vec16<T, 1> max<T>(const _vec16<T, 1>& a, const _vec16<T, 1>& b);
+    friend _vec16<T, 1> blend<T>(const _vec16<T, 1>& a, const _vec16<T, 1>& b, const _mask16<1>& mask);
+
+protected:
+    std::array<T, 16> m_values;
+};
+
+template <>
+class _vec16<uint32_t, 1> : public _vec16_base<uint32_t, 1> {
+public:
+    // Inherit constructors
+    using _vec16_base<uint32_t, 1>::_vec16_base;
+    template <typename T, int S>
+    friend class _vec16_base; // Make friend so it can access us in permute operations
+
+    inline _vec16<uint32_t, 1> operator<<(const _vec16<uint32_t, 1>& amount) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] << amount.m_values[i];
+        return result;
+    }
+
+    inline _vec16<uint32_t, 1> operator<<(uint32_t amount) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] << amount;
+        return result;
+    }
+
+    inline _vec16<uint32_t, 1> operator>>(const _vec16<uint32_t, 1>& amount) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] >> amount.m_values[i];
+        return result;
+    }
+
+    inline _vec16<uint32_t, 1> operator>>(uint32_t amount) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] >> amount;
+        return result;
+    }
+
+    inline _vec16<uint32_t, 1> operator&(const _vec16<uint32_t, 1>& other) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] & other.m_values[i];
+        return result;
+    }
+
+    inline _vec16<uint32_t, 1> operator|(const _vec16<uint32_t, 1>& other) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] | other.m_values[i];
+        return result;
+    }
+
+    inline _vec16<uint32_t, 1> operator^(const _vec16<uint32_t, 1>& other) const
+    {
+        _vec16<uint32_t, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] ^ other.m_values[i];
+        return result;
+    }
+};
+
+template <>
+class _vec16<float, 1> : public _vec16_base<float, 1> {
+public:
+    // Inherit constructors
+    using _vec16_base<float, 1>::_vec16_base;
+
+    // Not in base class because we will not support it on integers
+    inline _vec16<float, 1> operator/(const _vec16<float, 1>& other) const
+    {
+        _vec16<float, 1> result;
+        for (int i = 0; i < 16; i++)
+            result.m_values[i] = m_values[i] / other.m_values[i];
+        return result;
+    }
+};
+
+template <typename T>
+inline _vec16<T, 1> _vec16_base<T, 1>::permute(const _vec16<uint32_t, 1>& index) const
+{
+    _vec16<T, 1> result;
+    for (int i = 0; i < 16; i++)
+        result.m_values[i] = m_values[index.m_values[i]];
+    return result;
+}
+
+template <typename T>
+inline _vec16<T, 1> min(const _vec16<T, 1>& a, const _vec16<T, 1>& b)
+{
+    _vec16<T, 1> result;
+    for (int i = 0; i < 16; i++)
+        result.m_values[i] = std::min(a.m_values[i], b.m_values[i]);
+    return result;
+}
+
+template <typename T>
+inline _vec16<T, 1> max(const _vec16<T, 1>& a, const _vec16<T, 1>& b)
+{
+    _vec16<T, 1> result;
+    for (int i = 0; i < 16; i++)
+        result.m_values[i] = std::max(a.m_values[i], b.m_values[i]);
+    return result;
+}
+
+template <typename T>
+inline _vec16<T, 1> blend(const _vec16<T, 1>& a, const _vec16<T, 1>& b, const _mask16<1>& mask)
+{
+    _vec16<T, 1> result;
+    for (int i = 0; i < 16; i++)
+        result.m_values[i] = mask.m_values[i] ? b.m_values[i] : a.m_values[i];
+    return result;
+}
+
+inline _vec16<uint32_t, 1> floatBitsToInt(const _vec16<float, 1>& a)
+{
+    std::array<float, 16> values;
+    a.store(values);
+    std::array<uint32_t, 16> result;
+    std::memcpy(result.data(), values.data(), sizeof(result));
+    return _vec16<uint32_t, 1>(result);
+}
+
+inline _vec16<float, 1> intBitsToFloat(const _vec16<uint32_t, 1>& a)
+{
+    std::array<uint32_t, 16> values;
+    a.store(values);
+    std::array<float, 16> result;
+    std::memcpy(result.data(), values.data(), sizeof(result));
+    return _vec16<float, 1>(result);
+}
@@ -218,6 +218,16 @@ public:
         return _vec8(_mm256_and_si256(m_value, other.m_value));
     }
 
+    inline _vec8<uint32_t, 8> operator|(const _vec8<uint32_t, 8>& other) const
+    {
+        return _vec8(_mm256_or_si256(m_value, other.m_value));
+    }
+
+    inline _vec8<uint32_t, 8> operator^(const _vec8<uint32_t, 8>& other) const
+    {
+        return _vec8(_mm256_xor_si256(m_value, other.m_value));
+    }
+
     inline _mask8<8> operator<(const _vec8<uint32_t, 8>& other) const
     {
         return _mask8<8>(_mm256_cmpgt_epi32(other.m_value, m_value));
@@ -284,6 +294,8 @@ public:
     friend _vec8<uint32_t, 8> min(const _vec8<uint32_t, 8>& a, const _vec8<uint32_t, 8>& b);
     friend _vec8<uint32_t, 8> max(const _vec8<uint32_t, 8>& a, const _vec8<uint32_t, 8>& b);
 	friend _vec8<uint32_t, 8> blend(const _vec8<uint32_t, 8>& a, const _vec8<uint32_t, 8>& b, const _mask8<8>& mask);
+    friend _vec8<uint32_t, 8> floatBitsToInt(const _vec8<float, 8>& a);
+    friend _vec8<float, 8> intBitsToFloat(const _vec8<uint32_t, 8>& a);
 
 private:
     __m256i m_value;
@@ -325,6 +337,13 @@ public:
         m_value = _mm256_loadu_ps(v.data());
     }
 
+    // Zero-extend 8 unsigned bytes and convert them to floats (used to decode quantized data)
+    inline void loadUint8(std::span<const uint8_t, 8> v)
+    {
+        const __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v.data()));
+        m_value = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+    }
+
     inline void store(std::span<float> v) const
     {
         _mm256_storeu_ps(v.data(), m_value);
@@ -417,6 +436,8 @@ public:
     friend _vec8<float, 8> min(const _vec8<float, 8>& a, const _vec8<float, 8>& b);
     friend _vec8<float, 8> max(const _vec8<float, 8>& a, const _vec8<float, 8>& b);
 	friend _vec8<float, 8> blend(const _vec8<float, 8>& a, const _vec8<float, 8>& b, const _mask8<8>& mask);
+    friend _vec8<uint32_t, 8> floatBitsToInt(const _vec8<float, 8>& a);
+    friend _vec8<float, 8> intBitsToFloat(const _vec8<uint32_t, 8>& a);
 
 private:
     __m256 m_value;
@@ -462,3 +483,13 @@ inline _vec8<float, 8> blend(const _vec8<float, 8>& a, const _vec8<float, 8>& b,
 	// Cant use _mm_blend_ps because it relies on a compile time constant mask
 	return _vec8<float, 8>(_mm256_blendv_ps(a.m_value, b.m_value, _mm256_castsi256_ps(mask.m_value)));
 }
+
+inline _vec8<uint32_t, 8> floatBitsToInt(const _vec8<float, 8>& a)
+{
+    return _vec8<uint32_t, 8>(_mm256_castps_si256(a.m_value));
+}
+
+inline _vec8<float, 8> intBitsToFloat(const _vec8<uint32_t, 8>& a)
+{
+    return _vec8<float, 8>(_mm256_castsi256_ps(a.m_value));
+}
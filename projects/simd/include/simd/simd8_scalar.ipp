@@ -330,6 +330,24 @@ public:
         return result;
     }
 
+    inline _vec8<uint32_t, 1> operator|(const _vec8<uint32_t, 1>& other) const
+    {
+        _vec8<uint32_t, 1> result;
+        for (int i = 0; i < 8; i++) {
+            result.m_values[i] = m_values[i] | other.m_values[i];
+        }
+        return result;
+    }
+
+    inline _vec8<uint32_t, 1> operator^(const _vec8<uint32_t, 1>& other) const
+    {
+        _vec8<uint32_t, 1> result;
+        for (int i = 0; i < 8; i++) {
+            result.m_values[i] = m_values[i] ^ other.m_values[i];
+        }
+        return result;
+    }
+
     inline _vec8<uint32_t, 1> permute(const _vec8<uint32_t, 1>& index) const
     {
         _vec8<uint32_t, 1> result;
@@ -346,6 +364,13 @@ public:
     // Inherit constructors
     using _vec8_base<float, 1>::_vec8_base;
 
+    // Zero-extend 8 unsigned bytes and convert them to floats (used to decode quantized data)
+    inline void loadUint8(std::span<const uint8_t, 8> v)
+    {
+        for (int i = 0; i < 8; i++)
+            m_values[i] = static_cast<float>(v[i]);
+    }
+
     // Not in base class because we will not support it on integers
     inline _vec8<float, 1> operator/(const _vec8<float, 1>& other) const
     {
@@ -392,3 +417,20 @@ inline _vec8<T, 1> blend(const _vec8<T, 1>& a, const _vec8<T, 1>& b, const _mask
 	return result;
 }
 
+inline _vec8<uint32_t, 1> floatBitsToInt(const _vec8<float, 1>& a)
+{
+	std::array<float, 8> values;
+	a.store(values);
+	std::array<uint32_t, 8> result;
+	std::memcpy(result.data(), values.data(), sizeof(result));
+	return _vec8<uint32_t, 1>(result);
+}
+
+inline _vec8<float, 1> intBitsToFloat(const _vec8<uint32_t, 1>& a)
+{
+	std::array<uint32_t, 8> values;
+	a.store(values);
+	std::array<float, 8> result;
+	std::memcpy(result.data(), values.data(), sizeof(result));
+	return _vec8<float, 1>(result);
+}
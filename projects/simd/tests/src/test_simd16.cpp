@@ -0,0 +1,126 @@
+#include "simd/simd16.h"
+#include <gtest/gtest.h>
+#include <numeric>
+
+using namespace simd;
+
+template <typename T, int S>
+void simd16Tests()
+{
+    std::array<T, 16> input;
+    std::iota(std::begin(input), std::end(input), T(4));
+
+    simd::_vec16<T, S> v1(2);
+    simd::_vec16<T, S> v2(input);
+
+    {
+        std::array<T, 16> values;
+        (v1 + v2).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], T(6 + i));
+
+        (v2 - v1).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], T(2 + i));
+
+        (v1 * v2).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], T(2 * (4 + i)));
+    }
+
+    {
+        std::array<T, 16> values;
+        simd::min(v1, v2).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], T(2));
+
+        simd::max(v1, v2).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], T(4 + i));
+
+        ASSERT_EQ(v2.horizontalMin(), T(4));
+        ASSERT_EQ(v2.horizontalMax(), T(19));
+    }
+
+    {
+        // Lanes 0-5 (4..9) are smaller than or equal to 9
+        const simd::_mask16<S> mask = v2 <= simd::_vec16<T, S>(9);
+        ASSERT_EQ(mask.count(), 6);
+        ASSERT_EQ(mask.bitMask(), 0b111111);
+        ASSERT_EQ(mask.count(0b1010), 2);
+        ASSERT_TRUE(mask.any());
+        ASSERT_FALSE(mask.all());
+        ASSERT_TRUE((v2 > simd::_vec16<T, S>(100)).none());
+
+        std::array<T, 16> values;
+        simd::blend(v1, v2, mask).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], i < 6 ? T(4 + i) : T(2));
+    }
+
+    {
+        std::array<uint32_t, 16> reverse;
+        for (int i = 0; i < 16; i++)
+            reverse[i] = 15 - i;
+
+        std::array<T, 16> values;
+        v2.permute(simd::_vec16<uint32_t, S>(reverse)).store(values);
+        for (int i = 0; i < 16; i++)
+            ASSERT_EQ(values[i], T(4 + 15 - i));
+
+        const simd::_mask16<S> mask = v2 >= simd::_vec16<T, S>(12); // Lanes 8-15
+        v2.compress(mask).store(values);
+        for (int i = 0; i < 8; i++)
+            ASSERT_EQ(values[i], T(12 + i));
+    }
+}
+
+template <int S>
+void simd16BitwiseTests()
+{
+    std::array<uint32_t, 16> input;
+    std::iota(std::begin(input), std::end(input), 0u);
+    simd::_vec16<uint32_t, S> v(input);
+
+    std::array<uint32_t, 16> values;
+    (v << 2).store(values);
+    for (uint32_t i = 0; i < 16; i++)
+        ASSERT_EQ(values[i], i << 2);
+
+    (v >> 1).store(values);
+    for (uint32_t i = 0; i < 16; i++)
+        ASSERT_EQ(values[i], i >> 1);
+
+    (v >> (v & simd::_vec16<uint32_t, S>(0b11))).store(values);
+    for (uint32_t i = 0; i < 16; i++)
+        ASSERT_EQ(values[i], i >> (i & 0b11));
+
+    (v | simd::_vec16<uint32_t, S>(0b1)).store(values);
+    for (uint32_t i = 0; i < 16; i++)
+        ASSERT_EQ(values[i], i | 0b1);
+
+    (v ^ simd::_vec16<uint32_t, S>(0xFFFFFFFF)).store(values);
+    for (uint32_t i = 0; i < 16; i++)
+        ASSERT_EQ(values[i], ~i);
+
+    std::array<uint32_t, 16> bits;
+    floatBitsToInt(simd::_vec16<float, S>(1.0f)).store(bits);
+    for (int i = 0; i < 16; i++)
+        ASSERT_EQ(bits[i], 0x3F800000u);
+}
+
+TEST(SIMD16, Scalar)
+{
+    simd16Tests<float, 1>();
+    simd16Tests<uint32_t, 1>();
+    simd16BitwiseTests<1>();
+}
+
+#ifdef __AVX512F__
+TEST(SIMD16, AVX512)
+{
+    simd16Tests<float, 16>();
+    simd16Tests<uint32_t, 16>();
+    simd16BitwiseTests<16>();
+}
+#endif
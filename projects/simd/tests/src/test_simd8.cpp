@@ -257,14 +257,69 @@ void simd8Tests()
 	}
 }
 
+template <int S>
+void simd8BitwiseTests()
+{
+    simd::_vec8<uint32_t, S> v1(0b0011, 0b0101, 0b1111, 0, 1, 2, 3, 0xFFFFFFFF);
+    simd::_vec8<uint32_t, S> v2(0b0101);
+
+    {
+        std::array<uint32_t, 8> values;
+        (v1 | v2).store(values);
+        ASSERT_EQ(values[0], 0b0111u);
+        ASSERT_EQ(values[1], 0b0101u);
+        ASSERT_EQ(values[2], 0b1111u);
+        ASSERT_EQ(values[3], 0b0101u);
+        ASSERT_EQ(values[7], 0xFFFFFFFFu);
+    }
+
+    {
+        std::array<uint32_t, 8> values;
+        (v1 ^ v2).store(values);
+        ASSERT_EQ(values[0], 0b0110u);
+        ASSERT_EQ(values[1], 0b0000u);
+        ASSERT_EQ(values[2], 0b1010u);
+        ASSERT_EQ(values[3], 0b0101u);
+        ASSERT_EQ(values[7], 0xFFFFFFFAu);
+    }
+
+    {
+        simd::_vec8<float, S> floats(1.0f, -2.0f, 0.5f, 0.0f, 3.0f, 1.5f, -0.25f, 1024.0f);
+        std::array<uint32_t, 8> bits;
+        floatBitsToInt(floats).store(bits);
+        ASSERT_EQ(bits[0], 0x3F800000u);
+        ASSERT_EQ(bits[1], 0xC0000000u);
+        ASSERT_EQ(bits[3], 0x0u);
+
+        std::array<float, 8> roundTrip;
+        intBitsToFloat(floatBitsToInt(floats)).store(roundTrip);
+        std::array<float, 8> expected;
+        floats.store(expected);
+        for (int i = 0; i < 8; i++)
+            ASSERT_FLOAT_EQ(roundTrip[i], expected[i]);
+    }
+
+    {
+        const std::array<uint8_t, 8> bytes { 0, 1, 2, 127, 128, 200, 254, 255 };
+        simd::_vec8<float, S> floats;
+        floats.loadUint8(bytes);
+        std::array<float, 8> values;
+        floats.store(values);
+        for (int i = 0; i < 8; i++)
+            ASSERT_FLOAT_EQ(values[i], static_cast<float>(bytes[i]));
+    }
+}
+
 TEST(SIMD8, Scalar)
 {
     simd8Tests<float, 1>();
     simd8Tests<uint32_t, 1>();
+    simd8BitwiseTests<1>();
 }
 
 TEST(SIMD8, AVX2)
 {
     simd8Tests<float, 8>();
     simd8Tests<uint32_t, 8>();
+    simd8BitwiseTests<8>();
 }
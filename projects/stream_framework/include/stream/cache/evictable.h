@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <limits>
 #include <stream/serialize/serializer.h>
 
 namespace tasking {
@@ -16,6 +18,10 @@ public:
 protected:
     virtual void doEvict() = 0;
     virtual void doMakeResident(Deserializer& deserializer) = 0;
+    // Submit (asynchronous) reads of the serialized data that doMakeResident will map.
+    virtual void doSubmitLoad(Deserializer&) {};
+    // Cancel the reads submitted by doSubmitLoad when the item will not be made resident.
+    virtual void doCancelLoad(Deserializer&) {};
 
 private:
     friend class LRUCache;
@@ -23,9 +29,14 @@ private:
     friend class DummyCache;
     void evict();
     void makeResident(Deserializer& deserializer);
+    void submitLoad(Deserializer& deserializer);
+    void cancelLoad(Deserializer& deserializer);
 
 private:
     bool m_isResident;
+
+    // Index of the item in the LRUCacheTS that manages it (avoids a hash map look up on every access)
+    uint32_t m_cacheSlot { std::numeric_limits<uint32_t>::max() };
 };
 
 }
\ No newline at end of file
@@ -9,11 +9,10 @@
 #include <cstddef>
 #include <filesystem>
 #include <span>
-#include <span>
 #include <list>
 #include <mutex>
 #include <optick.h>
-#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace tasking {
@@ -30,13 +29,20 @@ public:
     template <typename T>
     CachedPtr<T> makeResident(T* pEvictable);
 
+    // Start loading the item in the background (if it is not resident) so that a subsequent call to
+    // makeResident does not have to wait for the full I/O latency. Only effective with asynchronous deserializers.
+    void prefetch(Evictable* pEvictable);
+    // Number of bytes that have to be read to make the item resident (0 if it is resident or already being loaded).
+    // Based on the size of the item when it was last resident.
+    size_t bytesToLoad(const Evictable* pEvictable) const;
+
     void forceEvict(Evictable* pEvictable);
 
     size_t memoryUsage() const noexcept;
     size_t maxSize() const;
 
 private:
-    LRUCacheTS(std::unique_ptr<tasking::Deserializer>&& pDeserializer, std::span<Evictable*> items, size_t maxMemory);
+    LRUCacheTS(std::unique_ptr<tasking::Deserializer>&& pDeserializer, std::span<Evictable*> items, std::span<const size_t> residentSizes, size_t maxMemory);
 
     void evictMarked();
 
@@ -50,15 +56,23 @@ private:
         Unloaded,
         Loading,
         Loaded,
-        Evicting
+        Evicting, // Also used while cancelling a prefetch
+        Prefetching
     };
     struct ItemData {
         std::atomic_bool marked { true }; // Recently accessed?
         std::atomic<ItemState> state { ItemState::Unloaded };
+        std::atomic_bool loadSubmitted { false }; // Prefetched (reads submitted) but not made resident yet
         std::atomic_int refCount { 0 };
+        std::atomic_size_t residentSize { 0 }; // Memory used by loading the item (for scheduling)
     };
+
     std::unique_ptr<ItemData[]> m_pItemData;
-    std::unordered_map<Evictable*, uint32_t> m_itemDataIndices;
+    std::vector<Evictable*> m_items;
+
+    // CLOCK eviction: the hand points at the next item to consider for eviction and is only accessed while holding
+    // m_evictMutex. Threads that find another thread evicting do not wait for it.
+    uint32_t m_clockHand { 0 };
     std::mutex m_evictMutex;
 };
 
@@ -73,55 +87,54 @@ public:
 private:
     std::unique_ptr<tasking::Serializer> m_pSerializer;
     std::vector<Evictable*> m_items;
+    std::unordered_set<const Evictable*> m_registeredItems;
+    std::vector<size_t> m_residentSizes;
 };
 
 template <typename T>
 inline CachedPtr<T> LRUCacheTS::makeResident(T* pEvictable)
 {
-    auto& itemData = m_pItemData[m_itemDataIndices[pEvictable]];
+    assert(pEvictable->m_cacheSlot < m_items.size() && m_items[pEvictable->m_cacheSlot] == pEvictable);
+    auto& itemData = m_pItemData[pEvictable->m_cacheSlot];
     if (itemData.marked.load(std::memory_order_relaxed))
         itemData.marked.store(false);
 
     // Ensure that the item will not be deleted by immediately increasing the reference count.
     itemData.refCount.fetch_add(1, std::memory_order_relaxed);
 
-    // In case the state was changed to evicting then we need to wait for the other thread
-    // to finish evicting. This can only happen once: the evict function is a critical section
-    // so any subsequent call to evict will see that the ref count has been increased.
-    ItemState state;
-    do {
-        state = itemData.state.load(std::memory_order_acquire);
-    } while (state == ItemState::Evicting);
-
-    // We have increased the reference count so no thread may evict the data. However we still
-    // need to check whether it was loaded (or is being loaded) in a thread safe manner.
-    if (state == ItemState::Loaded) {
-        return CachedPtr<T>(pEvictable, &itemData.refCount, false);
-    }
+    // We have increased the reference count so no thread may start evicting or prefetching the item. However another
+    // thread may still be in the middle of doing so (or of loading the item). Wait for it to finish and retry until
+    // the item is resident. A failed Unloaded -> Loading exchange (another thread started loading, prefetching or
+    // cancelling a prefetch in the meantime) is retried with the new state.
+    ItemState state = itemData.state.load(std::memory_order_acquire);
+    while (state != ItemState::Loaded) {
+        if (state == ItemState::Unloaded) {
+            if (!itemData.state.compare_exchange_strong(state, ItemState::Loading, std::memory_order_acquire))
+                continue;
 
-    if (state == ItemState::Unloaded) {
-        if (itemData.state.compare_exchange_strong(state, ItemState::Loading, std::memory_order_acquire)) {
+            // Mapping completes the reads that were submitted by prefetch (if any)
+            itemData.loadSubmitted.store(false, std::memory_order_relaxed);
             const size_t sizeBefore = pEvictable->sizeBytes();
             pEvictable->makeResident(*m_pDeserializer);
             const size_t sizeAfter = pEvictable->sizeBytes();
             assert(sizeAfter >= sizeBefore);
             m_usedMemory.fetch_add(sizeAfter - sizeBefore, std::memory_order_relaxed);
+            itemData.residentSize.store(sizeAfter - sizeBefore, std::memory_order_relaxed);
 
             itemData.state.store(ItemState::Loaded, std::memory_order_release);
+            itemData.state.notify_all();
 
             if (m_usedMemory > m_maxMemory)
                 evictMarked();
-        } else {
-            // Other thread already started loading, we need to wait...
-            while (itemData.state.load(std::memory_order_acquire) != ItemState::Loaded)
-                continue;
+            break;
         }
-    } else {
-        // Other thread already started loading, we need to wait...
-        while (itemData.state.load(std::memory_order_acquire) != ItemState::Loaded)
-            continue;
+
+        // Loading, Prefetching or Evicting: wait for the other thread.
+        itemData.state.wait(state, std::memory_order_acquire);
+        state = itemData.state.load(std::memory_order_acquire);
     }
 
+    assert(pEvictable->isResident());
     return CachedPtr<T>(pEvictable, &itemData.refCount, false);
 }
 
@@ -0,0 +1,23 @@
+#pragma once
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+namespace tasking {
+
+// Same as the pandora ALWAYS_ASSERT: checked in release builds too.
+#define ALWAYS_ASSERT(...) __ALWAYS_ASSERT(__VA_ARGS__, __FILE__, __LINE__)
+inline void __ALWAYS_ASSERT(bool value, std::string_view errorMessage, std::string_view fileName, int line)
+{
+    if (!value) {
+        std::cout << fileName << ":" << line << " ==> " << errorMessage << std::endl;
+        throw std::runtime_error("");
+    }
+}
+
+inline void __ALWAYS_ASSERT(bool value, std::string_view fileName, int line)
+{
+    __ALWAYS_ASSERT(value, "", fileName, line);
+}
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace tasking {
+
+// Binary max-heap over the indices [0, numIndices) that supports changing the key of an index in O(log n).
+template <typename Key, typename Compare = std::less<Key>>
+class IndexedPriorityQueue {
+public:
+    void resize(size_t numIndices);
+
+    // Insert the index or change its key if it is already in the queue.
+    void update(uint32_t index, const Key& key);
+    void erase(uint32_t index);
+
+    bool contains(uint32_t index) const;
+    const Key& key(uint32_t index) const;
+
+    bool empty() const;
+    size_t size() const;
+    uint32_t top() const;
+
+private:
+    void siftUp(size_t position);
+    void siftDown(size_t position);
+    void swapNodes(size_t position1, size_t position2);
+    bool less(size_t position1, size_t position2) const;
+
+private:
+    static constexpr uint32_t notInHeap = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> m_heap;
+    std::vector<uint32_t> m_positions; // Position of each index in m_heap (or notInHeap)
+    std::vector<Key> m_keys;
+    Compare m_compare;
+};
+
+template <typename Key, typename Compare>
+inline void IndexedPriorityQueue<Key, Compare>::resize(size_t numIndices)
+{
+    assert(numIndices >= m_positions.size());
+    m_positions.resize(numIndices, notInHeap);
+    m_keys.resize(numIndices);
+}
+
+template <typename Key, typename Compare>
+inline void IndexedPriorityQueue<Key, Compare>::update(uint32_t index, const Key& key)
+{
+    assert(index < m_positions.size());
+    if (m_positions[index] == notInHeap) {
+        m_keys[index] = key;
+        m_positions[index] = static_cast<uint32_t>(m_heap.size());
+        m_heap.push_back(index);
+        siftUp(m_heap.size() - 1);
+    } else {
+        const bool increased = m_compare(m_keys[index], key);
+        m_keys[index] = key;
+        if (increased)
+            siftUp(m_positions[index]);
+        else
+            siftDown(m_positions[index]);
+    }
+}
+
+template <typename Key, typename Compare>
+inline void IndexedPriorityQueue<Key, Compare>::erase(uint32_t index)
+{
+    assert(index < m_positions.size());
+    const uint32_t position = m_positions[index];
+    if (position == notInHeap)
+        return;
+
+    swapNodes(position, m_heap.size() - 1);
+    m_heap.pop_back();
+    m_positions[index] = notInHeap;
+    if (position < m_heap.size()) {
+        siftUp(position);
+        siftDown(m_positions[m_heap[position]]);
+    }
+}
+
+template <typename Key, typename Compare>
+inline bool IndexedPriorityQueue<Key, Compare>::contains(uint32_t index) const
+{
+    return m_positions[index] != notInHeap;
+}
+
+template <typename Key, typename Compare>
+inline const Key& IndexedPriorityQueue<Key, Compare>::key(uint32_t index) const
+{
+    return m_keys[index];
+}
+
+template <typename Key, typename Compare>
+inline bool IndexedPriorityQueue<Key, Compare>::empty() const
+{
+    return m_heap.empty();
+}
+
+template <typename Key, typename Compare>
+inline size_t IndexedPriorityQueue<Key, Compare>::size() const
+{
+    return m_heap.size();
+}
+
+template <typename Key, typename Compare>
+inline uint32_t IndexedPriorityQueue<Key, Compare>::top() const
+{
+    assert(!m_heap.empty());
+    return m_heap[0];
+}
+
+template <typename Key, typename Compare>
+inline void IndexedPriorityQueue<Key, Compare>::siftUp(size_t position)
+{
+    while (position > 0) {
+        const size_t parent = (position - 1) / 2;
+        if (!less(parent, position))
+            break;
+        swapNodes(parent, position);
+        position = parent;
+    }
+}
+
+template <typename Key, typename Compare>
+inline void IndexedPriorityQueue<Key, Compare>::siftDown(size_t position)
+{
+    while (true) {
+        const size_t left = 2 * position + 1;
+        const size_t right = left + 1;
+        size_t largest = position;
+        if (left < m_heap.size() && less(largest, left))
+            largest = left;
+        if (right < m_heap.size() && less(largest, right))
+            largest = right;
+        if (largest == position)
+            break;
+        swapNodes(position, largest);
+        position = largest;
+    }
+}
+
+template <typename Key, typename Compare>
+inline void IndexedPriorityQueue<Key, Compare>::swapNodes(size_t position1, size_t position2)
+{
+    std::swap(m_heap[position1], m_heap[position2]);
+    m_positions[m_heap[position1]] = static_cast<uint32_t>(position1);
+    m_positions[m_heap[position2]] = static_cast<uint32_t>(position2);
+}
+
+template <typename Key, typename Compare>
+inline bool IndexedPriorityQueue<Key, Compare>::less(size_t position1, size_t position2) const
+{
+    return m_compare(m_keys[m_heap[position1]], m_keys[m_heap[position2]]);
+}
+
+}
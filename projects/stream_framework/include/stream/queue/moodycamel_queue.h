@@ -1,12 +1,54 @@
 #pragma once
 #include "moodycamel/concurrentqueue.h"
+#include <mutex>
+#include <optional>
 #include <span>
-#include <tbb/task_arena.h>
 #include <thread>
 #include <vector>
 
 namespace tasking {
 
+namespace detail {
+    // Small process-wide thread index (unlike tbb::this_task_arena::current_thread_index() it is unique across arenas).
+    // Indices of threads that have exited are reused so that the index stays bounded by the number of live threads.
+    class QueueThreadIndex {
+    public:
+        QueueThreadIndex()
+        {
+            std::lock_guard l { s_mutex };
+            if (s_freeIndices.empty()) {
+                index = s_numIndices++;
+            } else {
+                index = s_freeIndices.back();
+                s_freeIndices.pop_back();
+            }
+        }
+        ~QueueThreadIndex()
+        {
+            std::lock_guard l { s_mutex };
+            s_freeIndices.push_back(index);
+        }
+
+        int index;
+
+    private:
+        static inline std::mutex s_mutex;
+        static inline std::vector<int> s_freeIndices;
+        static inline int s_numIndices { 0 };
+    };
+
+    inline int queueThreadIndex()
+    {
+        thread_local const QueueThreadIndex threadIdx;
+        return threadIdx.index;
+    }
+}
+
+// Producer/consumer tokens are stored per thread so that each thread reuses its own sub-queue instead of going through
+// the implicit producer hash table on every push. A token is created lazily by the thread that owns its slot and a slot
+// is owned by at most one live thread, so it is never accessed concurrently (a thread that reuses the index of a
+// thread that exited simply continues with its token). Threads that do not fit in the token table fall back to the
+// token-less calls.
 template <typename T>
 class MoodyCamelQueue : public moodycamel::ConcurrentQueue<T> {
 public:
@@ -19,50 +61,47 @@ public:
 
     MoodyCamelQueue()
         : moodycamel::ConcurrentQueue<T>()
+        , m_producerTokens(maxTokens())
+        , m_consumerTokens(maxTokens())
     {
-        /*std::generate_n(
-            std::back_inserter(m_producerTokens),
-            std::thread::hardware_concurrency(),
-            [&]() {
-                return moodycamel::ProducerToken(*this);
-            });
-        std::generate_n(
-            std::back_inserter(m_consumerTokens),
-            std::thread::hardware_concurrency(),
-            [&]() {
-                return moodycamel::ConsumerToken(*this);
-            });*/
     }
 
     inline void push(T&& item)
     {
-        /*auto threadIdx = tbb::this_task_arena::current_thread_index();
-        auto& token = m_producerTokens[threadIdx];
-        this->enqueue(token, std::move(item));*/
-        this->enqueue(std::move(item));
+        if (auto* pToken = producerToken())
+            this->enqueue(*pToken, std::move(item));
+        else
+            this->enqueue(std::move(item));
     }
     inline void push(const T& item)
     {
-        /*auto threadIdx = tbb::this_task_arena::current_thread_index();
-        auto& token = m_producerTokens[threadIdx];
-        this->enqueue(token, item);*/
-        this->enqueue(item);
+        if (auto* pToken = producerToken())
+            this->enqueue(*pToken, item);
+        else
+            this->enqueue(item);
+    }
+    inline void push_bulk(std::span<const T> items)
+    {
+        if (auto* pToken = producerToken())
+            this->enqueue_bulk(*pToken, items.data(), items.size());
+        else
+            this->enqueue_bulk(items.data(), items.size());
     }
 
     inline bool try_pop(T& item)
     {
-        /*auto threadIdx = tbb::this_task_arena::current_thread_index();
-        auto& token = m_consumerTokens[threadIdx];
-        return this->try_dequeue(token, item);*/
-        return this->try_dequeue(item);
+        if (auto* pToken = consumerToken())
+            return this->try_dequeue(*pToken, item);
+        else
+            return this->try_dequeue(item);
     }
 
     inline size_t try_pop_bulk(std::span<T> items)
     {
-        /*auto threadIdx = tbb::this_task_arena::current_thread_index();
-        auto& token = m_consumerTokens[threadIdx];
-        return this->try_dequeue_bulk(token, items.data(), items.size());*/
-        return this->try_dequeue_bulk(items.data(), items.size());
+        if (auto* pToken = consumerToken())
+            return this->try_dequeue_bulk(*pToken, items.data(), items.size());
+        else
+            return this->try_dequeue_bulk(items.data(), items.size());
     }
 
     inline size_t unsafe_size() const
@@ -76,8 +115,38 @@ public:
     }
 
 private:
-    std::vector<moodycamel::ProducerToken> m_producerTokens;
-    std::vector<moodycamel::ConsumerToken> m_consumerTokens;
+    static size_t maxTokens()
+    {
+        // Leave some room for threads that are not TBB workers (main thread, file I/O threads, ...).
+        return 2 * std::thread::hardware_concurrency();
+    }
+
+    inline moodycamel::ProducerToken* producerToken()
+    {
+        const int threadIdx = detail::queueThreadIndex();
+        if (threadIdx >= static_cast<int>(m_producerTokens.size()))
+            return nullptr;
+
+        auto& optToken = m_producerTokens[threadIdx];
+        if (!optToken)
+            optToken.emplace(*this);
+        return &optToken.value();
+    }
+    inline moodycamel::ConsumerToken* consumerToken()
+    {
+        const int threadIdx = detail::queueThreadIndex();
+        if (threadIdx >= static_cast<int>(m_consumerTokens.size()))
+            return nullptr;
+
+        auto& optToken = m_consumerTokens[threadIdx];
+        if (!optToken)
+            optToken.emplace(*this);
+        return &optToken.value();
+    }
+
+private:
+    std::vector<std::optional<moodycamel::ProducerToken>> m_producerTokens;
+    std::vector<std::optional<moodycamel::ConsumerToken>> m_consumerTokens;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+namespace tasking {
+
+// Decides in which order the TaskGraph executes its tasks: the task with the highest priority is executed next.
+// Priorities are recomputed whenever items are added to a task or after it has executed. Loading or evicting static
+// data does not trigger a recompute, so priorities that depend on bytesToLoad may be stale; the TaskGraph recomputes
+// them when the task reaches the top of the queue, before executing it.
+class SchedulingPolicy {
+public:
+    struct TaskInfo {
+        size_t queuedItems;
+        size_t queuedBytes;
+        const std::function<size_t()>* pLoadCost { nullptr };
+
+        // Bytes that have to be loaded before the task can execute (0 when resident or unknown, see
+        // TaskGraph::setStaticDataLoadCost). May be expensive so it is only evaluated on request.
+        size_t bytesToLoad() const;
+    };
+
+    virtual ~SchedulingPolicy() = default;
+    virtual double priority(const TaskInfo& task) const = 0;
+};
+
+// Execute the task with the most work first.
+class LargestQueuePolicy : public SchedulingPolicy {
+public:
+    double priority(const TaskInfo& task) const final;
+};
+
+// Like LargestQueuePolicy but the queue size of tasks for which all static data is already resident is multiplied
+// by residentWeight, so that we only evict data when there is sufficiently more work elsewhere.
+class PreferResidentPolicy : public SchedulingPolicy {
+public:
+    PreferResidentPolicy(double residentWeight = 8.0);
+
+    double priority(const TaskInfo& task) const final;
+
+private:
+    const double m_residentWeight;
+};
+
+// Estimate the throughput (items per second) of executing a task now, including the time to load its static data.
+class CostModelPolicy : public SchedulingPolicy {
+public:
+    CostModelPolicy(double itemsPerSecond = 10.0 * 1000 * 1000, double bytesPerSecond = 1000.0 * 1000 * 1000);
+
+    double priority(const TaskInfo& task) const final;
+
+private:
+    const double m_secondsPerItem;
+    const double m_secondsPerByte;
+};
+
+}
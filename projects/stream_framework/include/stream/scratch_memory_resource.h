@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace tasking {
+
+// Stack-like memory resource for temporary allocations (e.g. kernel scratch memory). Memory is handed out linearly
+// from a buffer that is reused; allocations that do not fit are forwarded to the upstream resource and the buffer grows
+// to the high water mark the next time it is completely rewound. Deallocation is a no-op: all memory that was allocated
+// after a marker is released at once by rewind(marker), which allows nested users (marker/rewind pairs).
+// Not thread safe; use one instance per thread.
+class ScratchMemoryResource : public std::pmr::memory_resource {
+public:
+    ScratchMemoryResource(size_t initialSize = 64 * 1024, std::pmr::memory_resource* pUpstream = std::pmr::new_delete_resource());
+    ScratchMemoryResource(const ScratchMemoryResource&) = delete;
+    ~ScratchMemoryResource() override;
+
+    struct Marker {
+        size_t offset;
+        size_t numOverflowAllocations;
+    };
+    Marker mark() const;
+    void rewind(Marker marker);
+
+    size_t capacity() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pMemory, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    std::pmr::memory_resource* m_pUpstream;
+
+    std::unique_ptr<std::byte[]> m_buffer;
+    size_t m_capacity;
+    size_t m_offset { 0 };
+
+    struct OverflowAllocation {
+        void* pMemory;
+        size_t size;
+        size_t alignment;
+    };
+    std::vector<OverflowAllocation> m_overflowAllocations;
+    size_t m_overflowBytes { 0 };
+    size_t m_highWaterMark { 0 };
+};
+
+}
@@ -9,6 +9,7 @@
 #include <string_view>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
 #include <tbb/enumerable_thread_specific.h>
 
 namespace tasking {
@@ -23,10 +24,22 @@ public:
 private:
     friend class SplitFileSerializer;
     SplitFileDeserializer(std::filesystem::path tempFolder, uint32_t numFiles, mio_cache_control::cache_mode fileCacheMode);
+    // Persistent mode: every file is mapped exactly once for the lifetime of the deserializer. The offsets
+    // contain the start of each allocation in a file (sorted) followed by the number of bytes used in that file.
+    SplitFileDeserializer(std::filesystem::path tempFolder, std::vector<std::vector<size_t>>&& allocationOffsets, mio_cache_control::cache_mode fileCacheMode);
 
 private:
     std::filesystem::path m_tempFolder;
     mio_cache_control::cache_mode m_fileCacheMode;
+    const bool m_persistentMapping; // Selected by the constructor that was used
+
+    // Persistent mode. These are immutable after construction so map/unmap do not need to take a lock.
+    struct PersistentFile {
+        mio_cache_control::mmap_source file;
+        std::vector<size_t> allocationOffsets;
+    };
+    std::vector<PersistentFile> m_persistentFiles; // Indexed by fileID - 1
+    std::vector<std::pair<const char*, uint32_t>> m_persistentFileStarts; // Sorted by address
 
     std::mutex m_mutex;
     /*struct MappedFile {
@@ -37,12 +50,20 @@ private:
     std::unordered_map<const void*, mio_cache_control::mmap_source> m_openFiles;
 };
 
+// How the deserializer created by SplitFileSerializer reads the data back in.
+enum class FileReadBackend {
+    MapPerAllocation, // Memory map each allocation separately
+    PersistentMapping, // Map every file once and use madvise hints on map/unmap
+    IoUring // Read into pooled buffers using io_uring (Linux only, falls back to PersistentMapping elsewhere)
+};
+
 class SplitFileSerializer : public Serializer {
 public:
     SplitFileSerializer(
         std::string_view folderName,
         size_t batchSize,
-        mio_cache_control::cache_mode fileCacheMode = mio_cache_control::cache_mode::random_access);
+        mio_cache_control::cache_mode fileCacheMode = mio_cache_control::cache_mode::random_access,
+        FileReadBackend readBackend = FileReadBackend::MapPerAllocation);
     SplitFileSerializer(SplitFileSerializer&&) = default;
     SplitFileSerializer& operator=(SplitFileSerializer&&) = default;
     ~SplitFileSerializer();
@@ -57,6 +78,7 @@ private:
 
 private:
     friend class SplitFileDeserializer;
+    friend class UringFileDeserializer;
     struct FileAllocation {
         size_t offsetInFile;
         size_t allocationSize;
@@ -66,8 +88,12 @@ private:
 
     std::filesystem::path m_tempFolder;
     mio_cache_control::cache_mode m_fileCacheMode;
+    FileReadBackend m_readBackend;
     std::deque<mio_cache_control::mmap_sink> m_openFiles;
 
+    // Start offsets of all allocations per file (only tracked when using persistent mappings).
+    std::vector<std::vector<size_t>> m_allocationOffsets;
+
     size_t m_batchSize;
     size_t m_currentOffset { 0 };
     uint32_t m_currentFileID { 0 };
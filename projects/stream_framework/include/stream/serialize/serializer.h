@@ -14,6 +14,12 @@ public:
 
     virtual const void* map(const Allocation& allocation) = 0;
     virtual void unmap(const void*) = 0;
+
+    // Hint that the allocation will be mapped soon. Asynchronous backends start reading it in the background
+    // and the following call to map completes the request (blocking until the data has arrived).
+    virtual void submit(const Allocation&) {};
+    // Release a submitted allocation that will not be mapped after all (e.g. it was evicted before it was used).
+    virtual void cancel(const Allocation&) {};
 };
 
 class Serializer {
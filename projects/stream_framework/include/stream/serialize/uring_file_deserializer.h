@@ -0,0 +1,63 @@
+#pragma once
+#include "stream/serialize/serializer.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace tasking {
+
+// Reads allocations of a SplitFileSerializer into pooled (aligned) buffers using io_uring. Unlike the memory mapped
+// deserializer, which page faults on access (a queue depth of one per thread), reads can be submitted ahead of time
+// so that many of them are in flight at once. Falls back to synchronous reads if io_uring is not available.
+// Only supported on Linux.
+class UringFileDeserializer : public Deserializer {
+public:
+    ~UringFileDeserializer();
+
+    const void* map(const Allocation& allocation) final;
+    void unmap(const void* pMemory) final;
+
+    void submit(const Allocation& allocation) final;
+    void cancel(const Allocation& allocation) final;
+
+private:
+    friend class SplitFileSerializer;
+    UringFileDeserializer(std::filesystem::path tempFolder, uint32_t numFiles, bool directIO, unsigned queueDepth = 256);
+
+    struct Ring;
+    struct Request;
+    std::unique_ptr<Request> createRequest(const Allocation& allocation);
+    bool submitRequest(Request* pRequest);
+    void waitForCompletion(Request* pRequest);
+    void readSynchronously(Request* pRequest);
+    size_t reapCompletions();
+
+    std::byte* allocateBuffer(uint32_t sizeClass);
+    void freeBuffer(std::byte* pBuffer, uint32_t sizeClass);
+
+private:
+    std::filesystem::path m_tempFolder;
+    std::vector<int> m_fileDescriptors; // Indexed by fileID - 1
+
+    std::unique_ptr<Ring> m_pRing;
+    unsigned m_queueDepth;
+    std::atomic_uint32_t m_numInFlight { 0 };
+    std::mutex m_submitMutex;
+    std::mutex m_completionMutex;
+
+    // Requests that were submitted but not yet mapped, keyed by file ID and offset.
+    std::mutex m_requestsMutex;
+    std::unordered_map<uint64_t, std::unique_ptr<Request>> m_requests;
+
+    // Free buffers per (power of two) size class.
+    std::mutex m_bufferPoolMutex;
+    std::array<std::vector<std::byte*>, 64> m_freeBuffers;
+    size_t m_pooledBytes { 0 };
+};
+
+}
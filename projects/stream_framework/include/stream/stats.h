@@ -23,6 +23,7 @@ struct StreamStats : public metrics::Stats {
         std::string taskName;
         size_t itemsFlushed { 0 };
         metrics::Stopwatch<std::chrono::nanoseconds> staticDataLoadTime;
+        bool staticDataPrefetched { false };
         metrics::Stopwatch<std::chrono::nanoseconds> processingTime;
 
         GeneralStats genStats;
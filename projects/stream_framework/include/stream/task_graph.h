@@ -1,11 +1,22 @@
 #pragma once
+#include "stream/indexed_priority_queue.h"
 #include "stream/queue/moodycamel_queue.h"
 #include "stream/queue/tbb_queue.h"
+#include "stream/scheduling_policy.h"
+#include "stream/scratch_memory_resource.h"
+#include "stream/serialize/serializer.h"
 #include "stream/stats.h"
 #include <EASTL/fixed_vector.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <future>
+#include <limits>
 #include <span>
+#include <memory>
 #include <memory_resource>
+#include <tbb/enumerable_thread_specific.h>
 #include <tbb/task_arena.h>
 #define __TBB_ALLOW_MUTABLE_FUNCTORS 1
 #include <tbb/task_group.h>
@@ -13,12 +24,28 @@
 #include <fmt/format.h>
 #include <optick.h>
 #include <optick_tbb.h>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 
 namespace tasking {
 
+namespace detail {
+    // Types that can be written to disk and read back (by copying the bytes) within the same process.
+    template <typename T>
+    struct is_spillable : std::is_trivially_copyable<T> {
+    };
+    template <typename... Ts>
+    struct is_spillable<std::tuple<Ts...>> : std::conjunction<is_spillable<Ts>...> {
+    };
+    template <typename T1, typename T2>
+    struct is_spillable<std::pair<T1, T2>> : std::conjunction<is_spillable<T1>, is_spillable<T2>> {
+    };
+}
+
 template <typename T>
 struct TaskHandle {
     uint32_t index;
@@ -26,8 +53,12 @@ struct TaskHandle {
 
 class TaskGraph {
 public:
-    TaskGraph(unsigned numSchedulers = 1);
+    // numPrefetchTasks: number of tasks (predicted to execute next) for which the static data is loaded in the
+    //  background while other tasks are executing. Prefetching is disabled when set to 0.
+    TaskGraph(unsigned numSchedulers = 1, unsigned numPrefetchTasks = 0);
 
+    // Kernels receive a per-thread scratch memory resource; all memory allocated from it is released when the kernel
+    //  returns (deallocate is a no-op).
     // Kernel signature: void(std::span<const T>, std::pmr::memory_resource*>
     template <typename T, typename Kernel>
     TaskHandle<T> addTask(std::string_view name, Kernel&& kernel);
@@ -42,15 +73,103 @@ public:
     template <typename T>
     void enqueue(TaskHandle<T> task, std::span<const T> items);
 
+    // Policy that decides which task is executed next (LargestQueuePolicy by default).
+    void setSchedulingPolicy(std::unique_ptr<SchedulingPolicy> pPolicy);
+    // Returns the number of bytes that still have to be loaded from disk before the static data of the task is
+    //  resident. Used by scheduling policies to prefer tasks for which the data is already in memory.
+    template <typename T>
+    void setStaticDataLoadCost(TaskHandle<T> task, std::function<size_t()> bytesToLoad);
+
     size_t approxMemoryUsage() const;
     size_t approxQueuedItems() const;
 
-    // Number of scheduler tasks that may be spawned at once. Loading can only happen from one thread (to prevent
-    //  race conditions in cache) but using multiple schedulers allow for loading / traversal in parallel.
+    // Limit the memory used by queued items. Producers of new work (e.g. camera rays) should check overMemoryBudget()
+    //  and defer their work while it returns true. The deferred work callback is invoked by the scheduler once the
+    //  queues have been drained below the budget and should return whether it produced any new work.
+    // The budget is not enforced when enqueueing: tasks that are executing may always enqueue their follow-up work.
+    // Should be set before any items are enqueued.
+    void setMemoryBudget(size_t maxQueuedBytes);
+    void setDeferredWorkCallback(std::function<bool()> callback);
+    bool overMemoryBudget() const;
+
+    // Write queued items to disk (in chunks of spillChunkBytes) while the queues use more than maxInMemoryBytes. The
+    //  spilled items of a task are streamed back in when the task executes. The serializer factory is called for each
+    //  batch of spilled items of a task and should return a new serializer (e.g. a SplitFileSerializer with a
+    //  unique folder name). Only item types that are trivially copyable (or tuples thereof) are spilled.
+    // Should be set before any items are enqueued.
+    using SerializerFactory = std::function<std::unique_ptr<Serializer>()>;
+    void enableSpilling(size_t maxInMemoryBytes, SerializerFactory serializerFactory, size_t spillChunkBytes = 16 * 1024 * 1024);
+    size_t approxSpilledItems() const;
+
+    // Execute every task in a task arena that is bound to a single NUMA node. Tasks with static data are pinned to the
+    //  node that executed them first so that their static data (allocated on first touch by the loading thread) stays
+    //  local to the threads that access it. Returns the number of NUMA nodes; nothing changes when there is only a
+    //  single node (or when TBB was built without hwloc support). Only the static data is kept node-local: prefetched
+    //  static data is loaded outside of the NUMA arenas, and the memory of the task queues is first touched by the
+    //  producing threads (which may run on any node), not by the consumer.
+    // Should be called before run().
+    unsigned enableNumaAwareness();
+
+    // Flush:      a task is executed by forking its queue over its share of the threads and joining at the end. Up to
+    //             numSchedulers (see constructor) different tasks execute concurrently and a task never executes
+    //             concurrently with itself.
+    // Continuous: every thread picks a task, processes batches until the task's queue runs dry and then moves on to
+    //             the next task. Multiple threads work on the same task when it has enough items and its static data
+    //             is shared between them. There are no joins, so the tail of a task does not leave threads idle.
+    //             NUMA arenas are not used in this mode.
+    enum class ExecutionMode {
+        Flush,
+        Continuous
+    };
+    // Should be set before run() (default: Flush).
+    void setExecutionMode(ExecutionMode executionMode);
+
+    // Execute tasks until all queues are empty and no deferred work remains.
     void run();
 
 private:
+    class TaskBase;
+
     bool allQueuesEmpty() const;
+    bool resumeDeferredWork();
+    void addQueuedBytes(size_t numBytes);
+    void removeQueuedBytes(size_t numBytes);
+
+    void registerTask(std::unique_ptr<TaskBase>&& pTask);
+    // Schedule the priority of the task to be recomputed because the size of its queue changed.
+    void markDirty(uint32_t taskIdx);
+    void markAllDirty();
+    void notifySchedulers();
+    // Sleep until m_schedulingEvents differs from schedulingEvents (or a short timeout expires).
+    void waitForSchedulingEvent(uint32_t schedulingEvents);
+    void runFlushes();
+    void runContinuous();
+
+    struct SelectedTask {
+        uint32_t taskIdx;
+        unsigned numConcurrentTasks; // Number of tasks among which the threads of the arena are divided
+        bool firstWorker; // No other thread was working on the task
+    };
+    // Returns the task with the highest priority that can take another worker (or nothing if there is none) and
+    //  registers the calling thread as one of its workers.
+    std::optional<SelectedTask> selectTask();
+    double computePriority(uint32_t taskIdx, size_t queueSize) const;
+    void finishTask(uint32_t taskIdx);
+    // In flush mode a task takes a single worker; in continuous mode each worker should have at least
+    //  minItemsPerWorker items to process.
+    bool acceptsWorker(uint32_t taskIdx, size_t queueSize) const;
+
+    // Start loading the static data of the tasks that are expected to be executed after pCurrentTask.
+    void prefetchStaticData(uint32_t currentTaskIdx);
+    // Returns the static data of pTask if it was prefetched; ownership is transferred to the caller. If the background
+    //  load has not started yet then the static data is loaded by the calling thread.
+    std::optional<void*> takePrefetchedStaticData(const TaskBase* pTask);
+    void releasePrefetchedStaticData();
+
+    // Returns the NUMA node on which the task should be executed and marks it as active on that node. The second value
+    //  is the number of tasks that are active on that node (including this one), among which its threads are divided.
+    std::pair<int, unsigned> acquireNumaNode(uint32_t taskIdx);
+    void releaseNumaNode(int numaNode);
 
 private:
     class TaskBase {
@@ -59,7 +178,31 @@ private:
 
         virtual size_t approxQueueSize() const = 0;
         virtual size_t approxQueueSizeBytes() const = 0;
-        virtual void execute(TaskGraph* pTaskGraph) = 0;
+        virtual size_t approxSpilledItems() const = 0;
+        virtual void execute(TaskGraph* pTaskGraph, unsigned numConcurrentTasks) = 0;
+        // Process batches on the calling thread until the queue is empty (may run on multiple threads at once).
+        virtual void drain(TaskGraph* pTaskGraph) = 0;
+
+        virtual bool hasStaticData() const = 0;
+        virtual void* loadStaticData(std::pmr::memory_resource* pMemoryResource) const = 0;
+        virtual void destroyStaticData(std::pmr::memory_resource* pMemoryResource, void* pStaticData) const = 0;
+    };
+    struct SpilledChunk {
+        Allocation allocation;
+        size_t numItems;
+    };
+    // Static data of a task that is shared by the threads that drain it concurrently.
+    struct SharedStaticData {
+        std::mutex mutex;
+        void* pStaticData { nullptr };
+        std::pmr::memory_resource* pMemoryResource { nullptr };
+        unsigned numUsers { 0 };
+    };
+    struct SpillState {
+        std::mutex mutex;
+        std::unique_ptr<Serializer> pSerializer;
+        std::vector<SpilledChunk> chunks;
+        std::atomic_size_t numItems { 0 };
     };
     template <typename T>
     class alignas(64) Task : public TaskBase {
@@ -77,30 +220,120 @@ private:
 
         size_t approxQueueSize() const override;
         size_t approxQueueSizeBytes() const override;
-        void execute(TaskGraph* pTaskGraph) override;
+        size_t approxSpilledItems() const override;
+        void execute(TaskGraph* pTaskGraph, unsigned numConcurrentTasks) override;
+        void drain(TaskGraph* pTaskGraph) override;
+
+        // Move a chunk of the queued items to disk (if the queue is large enough and no other thread is spilling).
+        void spill(TaskGraph* pTaskGraph);
+
+        bool hasStaticData() const override;
+        void* loadStaticData(std::pmr::memory_resource* pMemoryResource) const override;
+        void destroyStaticData(std::pmr::memory_resource* pMemoryResource, void* pStaticData) const override;
 
     private:
         using TypeErasedKernel = std::function<void(std::span<T>, const void*, std::pmr::memory_resource*)>;
         using TypeErasedStaticDataLoader = std::function<void*(std::pmr::memory_resource*)>;
         using TypeErasedStaticDataDestructor = std::function<void(std::pmr::memory_resource*, void*)>;
 
-        Task(std::string_view name, TypeErasedKernel&& kernel, TypeErasedStaticDataLoader&& staticData, TypeErasedStaticDataDestructor&& TypeErasedStaticDataDestructor);
+        Task(std::string_view name, TypeErasedKernel&& kernel, TypeErasedStaticDataLoader&& staticData, TypeErasedStaticDataDestructor&& TypeErasedStaticDataDestructor, bool hasStaticData);
+
+        // Items that were spilled to disk before the task started executing.
+        struct SpilledItems {
+            std::unique_ptr<Serializer> pSerializer;
+            std::unique_ptr<Deserializer> pDeserializer;
+            std::vector<SpilledChunk> chunks;
+        };
+        SpilledItems takeSpilledItems();
+
+        const void* acquireSharedStaticData(TaskGraph* pTaskGraph);
+        void releaseSharedStaticData();
+
+        static constexpr size_t maxBatchSize = 512;
 
     private:
         const std::string m_name;
+        const bool m_hasStaticData;
 
         const TypeErasedKernel m_kernel;
         const TypeErasedStaticDataLoader m_staticDataLoader;
         const TypeErasedStaticDataDestructor m_staticDataDestructor;
         MoodyCamelQueue<T> m_workQueue;
+        std::unique_ptr<SpillState> m_pSpillState;
+        std::unique_ptr<SharedStaticData> m_pSharedStaticData;
     };
 
     tbb::task_arena m_taskArena;
     bool m_inTaskArena { false };
 
+    // One arena per NUMA node (empty when NUMA awareness is disabled). Guarded by m_schedulingMutex.
+    std::vector<std::unique_ptr<tbb::task_arena>> m_numaArenas;
+    std::vector<int> m_taskNumaNodes; // Node to which the task is pinned (-1 if not pinned)
+    std::vector<unsigned> m_numaNodePinnedTasks;
+    std::vector<unsigned> m_numaNodeActiveTasks;
+
     std::vector<std::unique_ptr<TaskBase>> m_tasks;
     std::mutex m_staticDataMutex; // Run only one at a time because the cache implementation is not thread safe
     const unsigned m_numSchedulers;
+
+    // Tasks are kept in a priority queue that is updated lazily: enqueue only marks a task as dirty and the priority
+    // is recomputed by the scheduler, so selecting a task does not require visiting all tasks.
+    std::unique_ptr<SchedulingPolicy> m_pSchedulingPolicy;
+    std::vector<std::function<size_t()>> m_staticDataLoadCosts;
+    std::deque<std::atomic_bool> m_taskDirty;
+    std::mutex m_dirtyTasksMutex;
+    std::vector<uint32_t> m_dirtyTasks;
+    std::mutex m_schedulingMutex;
+    IndexedPriorityQueue<std::pair<double, size_t>> m_taskPriorities; // (priority, queue size)
+    ExecutionMode m_executionMode { ExecutionMode::Flush };
+    static constexpr size_t minItemsPerWorker = 64;
+    std::vector<unsigned> m_taskNumWorkers;
+    unsigned m_numExecutingTasks { 0 };
+
+    // Incremented (and idle schedulers are notified) whenever a task may have become selectable: when a task is marked
+    //  dirty or finishes. Idle schedulers sleep on m_idleCondition instead of spinning.
+    std::atomic_uint32_t m_schedulingEvents { 0 };
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCondition;
+    // Held while resuming deferred work or deciding that a continuous run has finished (see runContinuous).
+    std::mutex m_terminationMutex;
+
+    // Items that have been enqueued but for which the kernel has not returned yet. The graph has finished when this
+    //  reaches zero (a kernel enqueues its follow-up items before the items it processed are subtracted).
+    std::atomic_size_t m_numInFlightItems { 0 };
+
+    // Queued bytes are only tracked when a memory budget or spilling is enabled (to prevent contention on the counter).
+    bool m_trackQueuedBytes { false };
+    size_t m_memoryBudget { std::numeric_limits<size_t>::max() };
+    std::atomic_size_t m_queuedBytes { 0 };
+    std::function<bool()> m_deferredWorkCallback;
+
+    size_t m_spillThreshold { std::numeric_limits<size_t>::max() };
+    size_t m_spillChunkBytes { 0 };
+    SerializerFactory m_spillSerializerFactory;
+
+    // Static data that is loaded (or being loaded) in the background. Prefetched static data is always allocated
+    // from std::pmr::new_delete_resource() because it outlives the execution of the task that started the load.
+    // The load runs as a task in the task arena; whichever thread calls run() first performs the load.
+    struct StaticDataLoad {
+        const TaskBase* pTask;
+        std::atomic_flag started;
+        std::promise<void*> promise;
+        std::future<void*> staticData;
+
+        StaticDataLoad(const TaskBase* pTask);
+        void run();
+    };
+    struct PrefetchedStaticData {
+        const TaskBase* pTask;
+        std::shared_ptr<StaticDataLoad> pLoad;
+    };
+    std::mutex m_prefetchMutex;
+    std::vector<PrefetchedStaticData> m_prefetchedStaticData;
+    const unsigned m_numPrefetchTasks;
+
+    // Memory that kernels may use for temporary allocations; it is reset after every batch.
+    tbb::enumerable_thread_specific<ScratchMemoryResource> m_scratchMemory;
 };
 
 template <typename T, typename Kernel>
@@ -109,7 +342,7 @@ inline TaskHandle<T> TaskGraph::addTask(std::string_view name, Kernel&& kernel)
     uint32_t taskIdx = static_cast<uint32_t>(m_tasks.size());
 
     std::unique_ptr<TaskBase> pTask = std::make_unique<Task<T>>(Task<T>::initialize(name, std::move(kernel)));
-    m_tasks.push_back(std::move(pTask));
+    registerTask(std::move(pTask));
 
     return TaskHandle<T> { taskIdx };
 }
@@ -122,7 +355,7 @@ inline TaskHandle<T> TaskGraph::addTask(std::string_view name, StaticDataLoader&
 
     std::unique_ptr<TaskBase> pTask = std::make_unique<Task<T>>(
         Task<T>::template initialize<StaticData>(name, std::move(kernel), std::move(staticDataLoader)));
-    m_tasks.push_back(std::move(pTask));
+    registerTask(std::move(pTask));
 
     return TaskHandle<T> { taskIdx };
 }
@@ -132,6 +365,8 @@ inline void TaskGraph::enqueue(TaskHandle<T> taskHandle, const T& item)
 {
     Task<T>* pTask = reinterpret_cast<Task<T>*>(m_tasks[taskHandle.index].get());
 
+    m_numInFlightItems.fetch_add(1, std::memory_order_relaxed);
+    addQueuedBytes(sizeof(T));
     if (m_inTaskArena) {
         pTask->enqueue(item);
     } else {
@@ -139,6 +374,9 @@ inline void TaskGraph::enqueue(TaskHandle<T> taskHandle, const T& item)
             pTask->enqueue(item);
         });
     }
+    if (m_queuedBytes.load(std::memory_order_relaxed) > m_spillThreshold)
+        pTask->spill(this);
+    markDirty(taskHandle.index);
 }
 
 template <typename T>
@@ -146,6 +384,8 @@ inline void TaskGraph::enqueue(TaskHandle<T> taskHandle, std::span<const T> item
 {
     Task<T>* pTask = reinterpret_cast<Task<T>*>(m_tasks[taskHandle.index].get());
 
+    m_numInFlightItems.fetch_add(items.size(), std::memory_order_relaxed);
+    addQueuedBytes(items.size() * sizeof(T));
     if (m_inTaskArena) {
         pTask->enqueue(items);
     } else {
@@ -153,6 +393,16 @@ inline void TaskGraph::enqueue(TaskHandle<T> taskHandle, std::span<const T> item
             pTask->enqueue(items);
         });
     }
+    if (m_queuedBytes.load(std::memory_order_relaxed) > m_spillThreshold)
+        pTask->spill(this);
+    markDirty(taskHandle.index);
+}
+
+template <typename T>
+inline void TaskGraph::setStaticDataLoadCost(TaskHandle<T> taskHandle, std::function<size_t()> bytesToLoad)
+{
+    std::lock_guard l { m_schedulingMutex };
+    m_staticDataLoadCosts[taskHandle.index] = std::move(bytesToLoad);
 }
 
 template <typename T>
@@ -165,7 +415,8 @@ inline TaskGraph::Task<T> TaskGraph::Task<T>::initialize(std::string_view name,
             kernel(dynamicData, pMemory);
         },
         [](std::pmr::memory_resource*) { return nullptr; },
-        [](std::pmr::memory_resource* pMemoryResource, void*) {});
+        [](std::pmr::memory_resource* pMemoryResource, void*) {},
+        false);
 }
 
 template <typename T>
@@ -187,7 +438,8 @@ inline TaskGraph::Task<T> TaskGraph::Task<T>::initialize(std::string_view name,
             StaticData* pStaticData = reinterpret_cast<StaticData*>(pMem);
             pStaticData->~StaticData();
             pMemoryResource->deallocate(pMem, sizeof(StaticData), std::alignment_of_v<StaticData>);
-        });
+        },
+        true);
 }
 
 template <typename T>
@@ -195,11 +447,15 @@ inline TaskGraph::Task<T>::Task(
     std::string_view name,
     TaskGraph::Task<T>::TypeErasedKernel&& kernel,
     TaskGraph::Task<T>::TypeErasedStaticDataLoader&& staticDataLoader,
-    TaskGraph::Task<T>::TypeErasedStaticDataDestructor&& staticDataDestructor)
+    TaskGraph::Task<T>::TypeErasedStaticDataDestructor&& staticDataDestructor,
+    bool hasStaticData)
     : m_name(name)
+    , m_hasStaticData(hasStaticData)
     , m_kernel(std::move(kernel))
     , m_staticDataLoader(std::move(staticDataLoader))
     , m_staticDataDestructor(std::move(staticDataDestructor))
+    , m_pSpillState(std::make_unique<SpillState>())
+    , m_pSharedStaticData(std::make_unique<SharedStaticData>())
 {
 }
 
@@ -212,14 +468,19 @@ inline void TaskGraph::Task<T>::enqueue(const T& item)
 template <typename T>
 inline void TaskGraph::Task<T>::enqueue(std::span<const T> items)
 {
-    for (const auto& item : items)
-        m_workQueue.push(item);
+    m_workQueue.push_bulk(items);
 }
 
 template <typename T>
 inline size_t TaskGraph::Task<T>::approxQueueSize() const
 {
-    return m_workQueue.unsafe_size();
+    return m_workQueue.unsafe_size() + m_pSpillState->numItems.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+inline size_t TaskGraph::Task<T>::approxSpilledItems() const
+{
+    return m_pSpillState->numItems.load(std::memory_order_relaxed);
 }
 
 template <typename T>
@@ -230,19 +491,83 @@ inline size_t TaskGraph::Task<T>::approxQueueSizeBytes() const
 }
 
 template <typename T>
-inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph)
+inline void TaskGraph::Task<T>::spill(TaskGraph* pTaskGraph)
+{
+    if constexpr (detail::is_spillable<T>::value) {
+        const size_t chunkSize = pTaskGraph->m_spillChunkBytes / sizeof(T);
+        if (chunkSize == 0 || m_workQueue.unsafe_size() < chunkSize)
+            return;
+
+        std::unique_lock l { m_pSpillState->mutex, std::try_to_lock };
+        if (!l.owns_lock())
+            return;
+
+        OPTICK_EVENT("spill");
+        if (!m_pSpillState->pSerializer)
+            m_pSpillState->pSerializer = pTaskGraph->m_spillSerializerFactory();
+
+        // Pop the items straight into the (memory mapped) allocation so that they are written sequentially.
+        auto [allocation, pMemory] = m_pSpillState->pSerializer->allocateAndMap(chunkSize * sizeof(T));
+        T* pItems = static_cast<T*>(pMemory);
+        std::uninitialized_default_construct_n(pItems, chunkSize);
+        const size_t numItems = m_workQueue.try_pop_bulk(std::span(pItems, chunkSize));
+        m_pSpillState->pSerializer->unmapPreviousAllocations();
+
+        m_pSpillState->chunks.push_back({ allocation, numItems });
+        m_pSpillState->numItems.fetch_add(numItems, std::memory_order_relaxed);
+        pTaskGraph->removeQueuedBytes(numItems * sizeof(T));
+    }
+}
+
+template <typename T>
+inline typename TaskGraph::Task<T>::SpilledItems TaskGraph::Task<T>::takeSpilledItems()
+{
+    std::lock_guard l { m_pSpillState->mutex };
+    SpilledItems spilledItems;
+    if (m_pSpillState->chunks.empty())
+        return spilledItems;
+
+    // Items that are spilled while this task executes go to a new serializer.
+    spilledItems.pSerializer = std::move(m_pSpillState->pSerializer);
+    spilledItems.pDeserializer = spilledItems.pSerializer->createDeserializer();
+    spilledItems.chunks = std::move(m_pSpillState->chunks);
+    m_pSpillState->chunks.clear();
+    return spilledItems;
+}
+
+template <typename T>
+inline bool TaskGraph::Task<T>::hasStaticData() const
+{
+    return m_hasStaticData;
+}
+
+template <typename T>
+inline void* TaskGraph::Task<T>::loadStaticData(std::pmr::memory_resource* pMemoryResource) const
+{
+    return m_staticDataLoader(pMemoryResource);
+}
+
+template <typename T>
+inline void TaskGraph::Task<T>::destroyStaticData(std::pmr::memory_resource* pMemoryResource, void* pStaticData) const
+{
+    m_staticDataDestructor(pMemoryResource, pStaticData);
+}
+
+template <typename T>
+inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph, unsigned numConcurrentTasks)
 {
     StreamStats::FlushInfo flushStats;
     flushStats.taskName = m_name;
     flushStats.genStats = StreamStats::GeneralStats { pTaskGraph->approxQueuedItems(), pTaskGraph->approxMemoryUsage() };
     flushStats.startTime = std::chrono::high_resolution_clock::now();
 
-    //std::pmr::memory_resource* pMemory = std::pmr::new_delete_resource();
-    std::array<std::byte, 1024> buffer;
-    std::pmr::monotonic_buffer_resource memoryResource { reinterpret_cast<void*>(buffer.data()), buffer.size() };
-    std::pmr::memory_resource* pMemory = &memoryResource;
+    // Static data lives in the scratch memory of this thread until the task has finished executing.
+    ScratchMemoryResource& scratchMemory = pTaskGraph->m_scratchMemory.local();
+    const ScratchMemoryResource::Marker staticDataMarker = scratchMemory.mark();
+    std::pmr::memory_resource* pMemory = &scratchMemory;
 
     void* pStaticData;
+    std::pmr::memory_resource* pStaticDataMemory = pMemory;
     {
         //std::lock_guard l { pTaskGraph->m_staticDataMutex };
 
@@ -250,8 +575,15 @@ inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph)
         OPTICK_EVENT_DYNAMIC(taskName.c_str());
         auto stopWatch = flushStats.staticDataLoadTime.getScopedStopwatch();
 
-        // Allocate and construct static data
-        pStaticData = m_staticDataLoader(pMemory);
+        if (auto optPrefetchedStaticData = pTaskGraph->takePrefetchedStaticData(this); optPrefetchedStaticData) {
+            // Static data was (or is being) loaded in the background
+            pStaticData = *optPrefetchedStaticData;
+            pStaticDataMemory = std::pmr::new_delete_resource();
+            flushStats.staticDataPrefetched = true;
+        } else {
+            // Allocate and construct static data
+            pStaticData = m_staticDataLoader(pMemory);
+        }
     }
 
     {
@@ -260,25 +592,58 @@ inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph)
 
         std::atomic_size_t itemsFlushed { 0 };
 
+        // Items that were spilled to disk are streamed back in and processed before the in-memory queue.
+        SpilledItems spilledItems = takeSpilledItems();
+        size_t numSpilledItems = 0;
+        for (const auto& chunk : spilledItems.chunks)
+            numSpilledItems += chunk.numItems;
+        std::atomic_size_t nextChunk { 0 };
+
         // Queues with little items should be popped using smaller batches to improve parallelism.
-        static constexpr size_t maxBatchSize = 512;
-        const size_t approxSize = m_workQueue.unsafe_size();
-        const size_t fairShareBatchSize = std::clamp(approxSize / std::thread::hardware_concurrency(), static_cast<size_t>(8), static_cast<size_t>(512));
+        const size_t approxSize = m_workQueue.unsafe_size() + numSpilledItems;
+        // Only use our share of the threads of the current arena (which may be bound to a single NUMA node).
+        const unsigned arenaConcurrency = std::max(static_cast<unsigned>(tbb::this_task_arena::max_concurrency()) / numConcurrentTasks, 1u);
+        const size_t fairShareBatchSize = std::clamp(approxSize / arenaConcurrency, static_cast<size_t>(8), static_cast<size_t>(512));
+
+        const unsigned numThreads = std::min(arenaConcurrency, static_cast<unsigned>((approxSize - 1) / fairShareBatchSize + 1));
+        // Start reading the first chunk of every thread (for asynchronous deserializers).
+        for (size_t chunkIdx = 0; chunkIdx < std::min(spilledItems.chunks.size(), static_cast<size_t>(numThreads)); chunkIdx++)
+            spilledItems.pDeserializer->submit(spilledItems.chunks[chunkIdx].allocation);
 
-        const unsigned numThreads = std::min(std::thread::hardware_concurrency(), static_cast<unsigned>((approxSize - 1) / fairShareBatchSize + 1));
         tbb::task_group tg;
         for (unsigned i = 0; i < numThreads; i++) {
-            tg.run([this, pStaticData, &itemsFlushed, &taskName, fairShareBatchSize]() {
+            tg.run([this, pTaskGraph, pStaticData, &spilledItems, &nextChunk, &itemsFlushed, &taskName, fairShareBatchSize, numThreads]() {
                 Optick::tryRegisterThreadWithOptick();
                 OPTICK_EVENT_DYNAMIC(taskName.c_str());
 
                 size_t itemsFlushedLocal = 0;
                 eastl::fixed_vector<T, maxBatchSize, false> workBatch;
+                ScratchMemoryResource& scratchMemory = pTaskGraph->m_scratchMemory.local();
                 auto executeKernel = [&]() {
-                    m_kernel(std::span(workBatch.data(), workBatch.data() + workBatch.size()), pStaticData, std::pmr::new_delete_resource());
+                    const ScratchMemoryResource::Marker marker = scratchMemory.mark();
+                    m_kernel(std::span(workBatch.data(), workBatch.data() + workBatch.size()), pStaticData, &scratchMemory);
+                    scratchMemory.rewind(marker);
                     itemsFlushedLocal += workBatch.size();
+                    pTaskGraph->m_numInFlightItems.fetch_sub(workBatch.size(), std::memory_order_release);
                 };
 
+                for (size_t chunkIdx = nextChunk.fetch_add(1); chunkIdx < spilledItems.chunks.size(); chunkIdx = nextChunk.fetch_add(1)) {
+                    if (chunkIdx + numThreads < spilledItems.chunks.size())
+                        spilledItems.pDeserializer->submit(spilledItems.chunks[chunkIdx + numThreads].allocation);
+
+                    const auto& chunk = spilledItems.chunks[chunkIdx];
+                    const void* pMemory = spilledItems.pDeserializer->map(chunk.allocation);
+                    const T* pItems = static_cast<const T*>(pMemory);
+                    for (size_t j = 0; j < chunk.numItems; j += fairShareBatchSize) {
+                        const size_t numItems = std::min(fairShareBatchSize, chunk.numItems - j);
+                        workBatch.assign(pItems + j, pItems + j + numItems);
+                        executeKernel();
+                        workBatch.clear();
+                    }
+                    spilledItems.pDeserializer->unmap(pMemory);
+                    m_pSpillState->numItems.fetch_sub(chunk.numItems, std::memory_order_relaxed);
+                }
+
                 while (m_workQueue.unsafe_size() > 0) {
                     while (true) {
                         workBatch.resize(fairShareBatchSize);
@@ -287,6 +652,7 @@ inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph)
                         if (numItems == 0)
                             break;
 
+                        pTaskGraph->removeQueuedBytes(numItems * sizeof(T));
                         executeKernel();
                         workBatch.clear();
                     }
@@ -307,7 +673,8 @@ inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph)
         const std::string taskName = fmt::format("{}::staticDataDestruct", m_name);
         OPTICK_EVENT_DYNAMIC(taskName.c_str());
         // Call destructor on static data and free memory
-        m_staticDataDestructor(pMemory, pStaticData);
+        m_staticDataDestructor(pStaticDataMemory, pStaticData);
+        scratchMemory.rewind(staticDataMarker);
     }
 
     /*auto& stats = StreamStats::getSingleton();
@@ -317,4 +684,87 @@ inline void TaskGraph::Task<T>::execute(TaskGraph* pTaskGraph)
     }*/
 }
 
+template <typename T>
+inline void TaskGraph::Task<T>::drain(TaskGraph* pTaskGraph)
+{
+    const std::string taskName = fmt::format("{}::drain", m_name);
+    OPTICK_EVENT_DYNAMIC(taskName.c_str());
+
+    const void* pStaticData = acquireSharedStaticData(pTaskGraph);
+
+    eastl::fixed_vector<T, maxBatchSize, false> workBatch;
+    ScratchMemoryResource& scratchMemory = pTaskGraph->m_scratchMemory.local();
+    auto executeKernel = [&]() {
+        const ScratchMemoryResource::Marker marker = scratchMemory.mark();
+        m_kernel(std::span(workBatch.data(), workBatch.data() + workBatch.size()), pStaticData, &scratchMemory);
+        scratchMemory.rewind(marker);
+        pTaskGraph->m_numInFlightItems.fetch_sub(workBatch.size(), std::memory_order_release);
+        workBatch.clear();
+    };
+
+    // Spilled items are streamed back in by the thread that takes them.
+    SpilledItems spilledItems = takeSpilledItems();
+    if (!spilledItems.chunks.empty())
+        spilledItems.pDeserializer->submit(spilledItems.chunks[0].allocation);
+    for (size_t chunkIdx = 0; chunkIdx < spilledItems.chunks.size(); chunkIdx++) {
+        if (chunkIdx + 1 < spilledItems.chunks.size())
+            spilledItems.pDeserializer->submit(spilledItems.chunks[chunkIdx + 1].allocation);
+
+        const auto& chunk = spilledItems.chunks[chunkIdx];
+        const void* pMemory = spilledItems.pDeserializer->map(chunk.allocation);
+        const T* pItems = static_cast<const T*>(pMemory);
+        for (size_t j = 0; j < chunk.numItems; j += maxBatchSize) {
+            const size_t numItems = std::min(maxBatchSize, chunk.numItems - j);
+            workBatch.assign(pItems + j, pItems + j + numItems);
+            executeKernel();
+        }
+        spilledItems.pDeserializer->unmap(pMemory);
+        m_pSpillState->numItems.fetch_sub(chunk.numItems, std::memory_order_relaxed);
+    }
+
+    const size_t concurrency = static_cast<size_t>(tbb::this_task_arena::max_concurrency());
+    while (true) {
+        // Use smaller batches when few items are left so that the remaining work is spread over the other workers.
+        const size_t batchSize = std::clamp(m_workQueue.unsafe_size() / concurrency, static_cast<size_t>(8), maxBatchSize);
+        workBatch.resize(batchSize);
+        const size_t numItems = m_workQueue.try_pop_bulk(workBatch);
+        workBatch.resize(numItems);
+        if (numItems == 0)
+            break;
+
+        pTaskGraph->removeQueuedBytes(numItems * sizeof(T));
+        executeKernel();
+    }
+
+    releaseSharedStaticData();
+}
+
+template <typename T>
+inline const void* TaskGraph::Task<T>::acquireSharedStaticData(TaskGraph* pTaskGraph)
+{
+    std::lock_guard l { m_pSharedStaticData->mutex };
+    if (m_pSharedStaticData->numUsers++ == 0) {
+        const std::string taskName = fmt::format("{}::staticDataLoad", m_name);
+        OPTICK_EVENT_DYNAMIC(taskName.c_str());
+
+        // The static data outlives the stack of the thread that loads it.
+        m_pSharedStaticData->pMemoryResource = std::pmr::new_delete_resource();
+        if (auto optPrefetchedStaticData = pTaskGraph->takePrefetchedStaticData(this); optPrefetchedStaticData)
+            m_pSharedStaticData->pStaticData = *optPrefetchedStaticData;
+        else
+            m_pSharedStaticData->pStaticData = m_staticDataLoader(m_pSharedStaticData->pMemoryResource);
+    }
+    return m_pSharedStaticData->pStaticData;
+}
+
+template <typename T>
+inline void TaskGraph::Task<T>::releaseSharedStaticData()
+{
+    std::lock_guard l { m_pSharedStaticData->mutex };
+    if (--m_pSharedStaticData->numUsers == 0) {
+        m_staticDataDestructor(m_pSharedStaticData->pMemoryResource, m_pSharedStaticData->pStaticData);
+        m_pSharedStaticData->pStaticData = nullptr;
+    }
+}
+
 }
\ No newline at end of file
@@ -13,6 +13,16 @@ void Evictable::makeResident(Deserializer& deserializer)
     m_isResident = true;
 }
 
+void Evictable::submitLoad(Deserializer& deserializer)
+{
+    doSubmitLoad(deserializer);
+}
+
+void Evictable::cancelLoad(Deserializer& deserializer)
+{
+    doCancelLoad(deserializer);
+}
+
 void Evictable::evict()
 {
     doEvict();
@@ -1,17 +1,20 @@
 #include "stream/cache/lru_cache_ts.h"
 #include "enumerate.h"
+#include "stream/error_handling.h"
 #include <cassert>
 #include <spdlog/spdlog.h>
 
 namespace tasking {
 
-LRUCacheTS::LRUCacheTS(std::unique_ptr<tasking::Deserializer>&& pDeserializer, std::span<Evictable*> items, size_t maxMemory)
+LRUCacheTS::LRUCacheTS(std::unique_ptr<tasking::Deserializer>&& pDeserializer, std::span<Evictable*> items, std::span<const size_t> residentSizes, size_t maxMemory)
     : m_pDeserializer(std::move(pDeserializer))
     , m_maxMemory(maxMemory)
 {
     m_pItemData = std::make_unique<ItemData[]>(items.size());
+    m_items.assign(std::begin(items), std::end(items));
     for (uint32_t i = 0; i < items.size(); i++) {
-        m_itemDataIndices[items[i]] = i;
+        items[i]->m_cacheSlot = i;
+        m_pItemData[i].residentSize = residentSizes[i];
         if (items[i]->isResident())
             m_pItemData[i].state = ItemState::Loaded;
         m_usedMemory.fetch_add(items[i]->sizeBytes(), std::memory_order::memory_order_relaxed);
@@ -25,7 +28,8 @@ LRUCacheTS::LRUCacheTS(LRUCacheTS&& other) noexcept
     m_usedMemory.store(other.m_usedMemory.load());
 
     m_pItemData = std::move(other.m_pItemData);
-    m_itemDataIndices = std::move(other.m_itemDataIndices);
+    m_items = std::move(other.m_items);
+    m_clockHand = other.m_clockHand;
 }
 
 LRUCacheTS& LRUCacheTS::operator=(LRUCacheTS&& other) noexcept
@@ -35,16 +39,19 @@ LRUCacheTS& LRUCacheTS::operator=(LRUCacheTS&& other) noexcept
     m_usedMemory.store(other.m_usedMemory.load());
 
     m_pItemData = std::move(other.m_pItemData);
-    m_itemDataIndices = std::move(other.m_itemDataIndices);
+    m_items = std::move(other.m_items);
+    m_clockHand = other.m_clockHand;
     return *this;
 }
 
 LRUCacheTS::~LRUCacheTS()
 {
     spdlog::info("~LRUCacheTS(): memory usage = {} bytes", m_usedMemory.load());
-    for (auto& [pItem, _] : m_itemDataIndices) {
+    for (auto [i, pItem] : enumerate(m_items)) {
         if (pItem->isResident())
             pItem->evict();
+        else if (m_pItemData[i].loadSubmitted.load())
+            pItem->cancelLoad(*m_pDeserializer);
     }
 }
 
@@ -58,31 +65,73 @@ size_t LRUCacheTS::maxSize() const
     return m_maxMemory;
 }
 
+void LRUCacheTS::prefetch(Evictable* pEvictable)
+{
+    assert(pEvictable->m_cacheSlot < m_items.size() && m_items[pEvictable->m_cacheSlot] == pEvictable);
+    auto& itemData = m_pItemData[pEvictable->m_cacheSlot];
+    if (itemData.loadSubmitted.load(std::memory_order_relaxed) || itemData.refCount.load() != 0)
+        return;
+
+    // Block makeResident while submitting so that it does not map the item before its reads have been submitted
+    // (which would leave the submitted reads orphaned). Same protocol as eviction: back off if the item was accessed.
+    ItemState state = ItemState::Unloaded;
+    if (!itemData.state.compare_exchange_strong(state, ItemState::Prefetching))
+        return;
+    if (itemData.refCount.load() == 0) {
+        pEvictable->submitLoad(*m_pDeserializer);
+        itemData.loadSubmitted.store(true, std::memory_order_relaxed);
+        itemData.marked.store(false, std::memory_order_relaxed);
+    }
+    itemData.state.store(ItemState::Unloaded, std::memory_order_release);
+    itemData.state.notify_all();
+}
+
+size_t LRUCacheTS::bytesToLoad(const Evictable* pEvictable) const
+{
+    assert(pEvictable->m_cacheSlot < m_items.size() && m_items[pEvictable->m_cacheSlot] == pEvictable);
+    const auto& itemData = m_pItemData[pEvictable->m_cacheSlot];
+    if (itemData.state.load(std::memory_order_relaxed) == ItemState::Unloaded)
+        return itemData.residentSize.load(std::memory_order_relaxed);
+    else
+        return 0;
+}
+
 void LRUCacheTS::forceEvict(Evictable* pEvictable)
 {
     assert(pEvictable->isResident());
 
-    auto& itemData = m_pItemData[m_itemDataIndices[pEvictable]];
+    auto& itemData = m_pItemData[pEvictable->m_cacheSlot];
 
     m_usedMemory -= pEvictable->sizeBytes();
     pEvictable->evict();
     m_usedMemory += pEvictable->sizeBytes();
     itemData.state = ItemState::Unloaded;
+    itemData.state.notify_all();
 }
 
 void LRUCacheTS::evictMarked()
 {
-    spdlog::debug("Evicting items from LRUCacheTS");
-
-    std::lock_guard l { m_evictMutex };
+    // Only a single thread evicts at any time. Other threads continue without waiting; the memory will be freed
+    // by the thread that is currently evicting.
+    std::unique_lock l { m_evictMutex, std::try_to_lock };
+    if (!l.owns_lock())
+        return;
     if (m_usedMemory.load(std::memory_order_relaxed) < m_maxMemory)
         return;
 
-    // Evict marked items.
-    int64_t freedMem { 0 };
-    for (auto& [pItem, itemDataIndex] : m_itemDataIndices) {
+    spdlog::debug("Evicting items from LRUCacheTS");
+
+    // CLOCK sweep: evict marked items (not touched since the hand last passed them) and mark all other items. The
+    // sweep stops as soon as enough memory has been freed. Two full rotations guarantee that every unused item has
+    // been considered after it was marked.
+    const uint32_t numItems = static_cast<uint32_t>(m_items.size());
+    for (uint32_t i = 0; i < 2 * numItems && m_usedMemory.load(std::memory_order_relaxed) > m_maxMemory; i++) {
+        const uint32_t itemIndex = m_clockHand;
+        m_clockHand = (m_clockHand + 1 == numItems ? 0 : m_clockHand + 1);
+
         // NOTE: no other thread will try to load / use the item since the memory limit has been exceeded.
-        auto& itemData = m_pItemData[itemDataIndex];
+        Evictable* pItem = m_items[itemIndex];
+        auto& itemData = m_pItemData[itemIndex];
         const bool marked = itemData.marked.load(std::memory_order_relaxed);
         const ItemState state = itemData.state.load(std::memory_order_acquire);
 
@@ -100,23 +149,33 @@ void LRUCacheTS::evictMarked()
             // because that thread could also try to evict, which means it needs to wait for us (only a single
             // thread may evict at any time) and we need to wait for it to release the object => deadlock.
             if (itemData.refCount.load() != 0) {
-                itemData.state.store(ItemState::Loaded, std::memory_order_acquire);
+                itemData.state.store(ItemState::Loaded, std::memory_order_release);
+                itemData.state.notify_all();
                 continue;
             }
 
-            freedMem += pItem->sizeBytes();
+            const size_t sizeBefore = pItem->sizeBytes();
             pItem->evict();
-            freedMem -= pItem->sizeBytes();
+            const size_t sizeAfter = pItem->sizeBytes();
+            m_usedMemory.fetch_sub(sizeBefore - sizeAfter, std::memory_order_relaxed);
 
             itemData.state.store(ItemState::Unloaded, std::memory_order_release);
+            itemData.state.notify_all();
+        } else if (marked && state == ItemState::Unloaded && itemData.loadSubmitted.load(std::memory_order_relaxed)) {
+            // Prefetched but not used since: release the buffers of the submitted reads.
+            ItemState expected = ItemState::Unloaded;
+            if (itemData.refCount.load() == 0 && itemData.state.compare_exchange_strong(expected, ItemState::Evicting)) {
+                if (itemData.refCount.load() == 0 && itemData.loadSubmitted.exchange(false))
+                    pItem->cancelLoad(*m_pDeserializer);
+                itemData.state.store(ItemState::Unloaded, std::memory_order_release);
+                itemData.state.notify_all();
+            }
         }
 
         itemData.marked.store(true, std::memory_order_relaxed);
     }
 
-    auto newMemoryUsage = m_usedMemory.fetch_sub(freedMem, std::memory_order_relaxed) - freedMem;
-
-    if (newMemoryUsage > m_maxMemory)
+    if (m_usedMemory.load(std::memory_order_relaxed) > m_maxMemory)
         spdlog::warn("LRUCacheTS: memory usage exceeded limit after eviction");
 }
 
@@ -127,17 +186,23 @@ LRUCacheTS::Builder::Builder(std::unique_ptr<Serializer>&& pSerializer)
 
 void LRUCacheTS::Builder::registerCacheable(Evictable* pItem, bool evict)
 {
+    // An Evictable stores a single cache slot so it can only occupy one slot of the cache. It may still be registered
+    // with another (old) cache, whose slot is overwritten when the new cache is built.
+    const bool inserted = m_registeredItems.insert(pItem).second;
+    ALWAYS_ASSERT(inserted, "Evictable belongs to one cache slot but was registered with LRUCacheTS::Builder twice");
     m_items.push_back(pItem);
 
     pItem->serialize(*m_pSerializer);
 
+    const size_t sizeBefore = pItem->sizeBytes();
     if (pItem->isResident())
         pItem->evict();
+    m_residentSizes.push_back(sizeBefore - pItem->sizeBytes());
 }
 
 LRUCacheTS LRUCacheTS::Builder::build(size_t maxMemory)
 {
-    return LRUCacheTS(m_pSerializer->createDeserializer(), m_items, maxMemory);
+    return LRUCacheTS(m_pSerializer->createDeserializer(), m_items, m_residentSizes, maxMemory);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "stream/scheduling_policy.h"
+#include <algorithm>
+
+namespace tasking {
+
+size_t SchedulingPolicy::TaskInfo::bytesToLoad() const
+{
+    if (pLoadCost && *pLoadCost)
+        return (*pLoadCost)();
+    else
+        return 0;
+}
+
+double LargestQueuePolicy::priority(const TaskInfo& task) const
+{
+    return static_cast<double>(task.queuedItems);
+}
+
+PreferResidentPolicy::PreferResidentPolicy(double residentWeight)
+    : m_residentWeight(residentWeight)
+{
+}
+
+double PreferResidentPolicy::priority(const TaskInfo& task) const
+{
+    const double queueSize = static_cast<double>(task.queuedItems);
+    if (task.bytesToLoad() == 0)
+        return m_residentWeight * queueSize;
+    else
+        return queueSize;
+}
+
+CostModelPolicy::CostModelPolicy(double itemsPerSecond, double bytesPerSecond)
+    : m_secondsPerItem(1.0 / itemsPerSecond)
+    , m_secondsPerByte(1.0 / bytesPerSecond)
+{
+}
+
+double CostModelPolicy::priority(const TaskInfo& task) const
+{
+    const double items = static_cast<double>(task.queuedItems);
+    const double bytes = static_cast<double>(task.bytesToLoad());
+    const double seconds = items * m_secondsPerItem + bytes * m_secondsPerByte;
+    return items / std::max(seconds, 1e-12);
+}
+
+}
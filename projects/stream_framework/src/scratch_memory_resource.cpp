@@ -0,0 +1,79 @@
+#include "stream/scratch_memory_resource.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace tasking {
+
+ScratchMemoryResource::ScratchMemoryResource(size_t initialSize, std::pmr::memory_resource* pUpstream)
+    : m_pUpstream(pUpstream)
+    , m_buffer(std::make_unique<std::byte[]>(initialSize))
+    , m_capacity(initialSize)
+{
+}
+
+ScratchMemoryResource::~ScratchMemoryResource()
+{
+    rewind(Marker { 0, 0 });
+}
+
+ScratchMemoryResource::Marker ScratchMemoryResource::mark() const
+{
+    return Marker { m_offset, m_overflowAllocations.size() };
+}
+
+void ScratchMemoryResource::rewind(Marker marker)
+{
+    assert(marker.offset <= m_offset && marker.numOverflowAllocations <= m_overflowAllocations.size());
+
+    while (m_overflowAllocations.size() > marker.numOverflowAllocations) {
+        const auto& allocation = m_overflowAllocations.back();
+        m_pUpstream->deallocate(allocation.pMemory, allocation.size, allocation.alignment);
+        m_overflowBytes -= allocation.size + allocation.alignment;
+        m_overflowAllocations.pop_back();
+    }
+    m_offset = marker.offset;
+
+    // Grow the buffer (when nothing is using it) so that the overflow allocations are not needed next time.
+    if (m_offset == 0 && m_highWaterMark > m_capacity) {
+        m_capacity = m_highWaterMark + m_highWaterMark / 2;
+        m_buffer = std::make_unique<std::byte[]>(m_capacity);
+    }
+}
+
+size_t ScratchMemoryResource::capacity() const
+{
+    return m_capacity;
+}
+
+void* ScratchMemoryResource::do_allocate(size_t bytes, size_t alignment)
+{
+    const uintptr_t base = reinterpret_cast<uintptr_t>(m_buffer.get());
+    const uintptr_t alignedAddress = (base + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    const size_t alignedOffset = static_cast<size_t>(alignedAddress - base);
+
+    void* pMemory;
+    if (alignedOffset + bytes <= m_capacity) {
+        m_offset = alignedOffset + bytes;
+        pMemory = reinterpret_cast<void*>(alignedAddress);
+    } else {
+        pMemory = m_pUpstream->allocate(bytes, alignment);
+        m_overflowAllocations.push_back({ pMemory, bytes, alignment });
+        m_overflowBytes += bytes + alignment; // Include padding that may be needed when it is moved into the buffer
+    }
+
+    m_highWaterMark = std::max(m_highWaterMark, m_offset + m_overflowBytes);
+    return pMemory;
+}
+
+void ScratchMemoryResource::do_deallocate(void*, size_t, size_t)
+{
+    // Memory is released by rewind()
+}
+
+bool ScratchMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+}
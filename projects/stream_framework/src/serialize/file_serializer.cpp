@@ -1,11 +1,39 @@
 #include "stream/serialize/file_serializer.h"
+#include "stream/serialize/uring_file_deserializer.h"
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <spdlog/spdlog.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 namespace tasking {
-SplitFileSerializer::SplitFileSerializer(std::string_view folderName, size_t batchSize, mio_cache_control::cache_mode fileCacheMode)
+
+// Hint the OS about the pages covering [pMemory, pMemory + size) of a persistent mapping.
+static void adviseRange(const void* pMemory, size_t size, bool willNeed)
+{
+#ifndef _WIN32
+    const uintptr_t pageSize = mio_cache_control::page_size();
+    const uintptr_t address = reinterpret_cast<uintptr_t>(pMemory);
+    if (willNeed) {
+        // Round outwards so that every page touched by the allocation is read ahead.
+        const uintptr_t start = address / pageSize * pageSize;
+        madvise(reinterpret_cast<void*>(start), address + size - start, MADV_WILLNEED);
+    } else {
+        // Round inwards so that we do not drop pages shared with neighbouring allocations.
+        const uintptr_t start = (address + pageSize - 1) / pageSize * pageSize;
+        const uintptr_t end = (address + size) / pageSize * pageSize;
+        if (end > start)
+            madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+    }
+#endif
+}
+
+SplitFileSerializer::SplitFileSerializer(std::string_view folderName, size_t batchSize, mio_cache_control::cache_mode fileCacheMode, FileReadBackend readBackend)
     : m_tempFolder(std::filesystem::temp_directory_path() / folderName)
     , m_fileCacheMode(fileCacheMode)
+    , m_readBackend(readBackend)
     , m_batchSize(batchSize)
 {
     if (std::filesystem::exists(m_tempFolder)) {
@@ -30,6 +58,9 @@ std::pair<Allocation, void*> SplitFileSerializer::allocateAndMap(size_t numBytes
     m_currentOffset += numBytes;
     void* pMemory = reinterpret_cast<void*>(m_currentFile.data() + offset);
 
+    if (m_readBackend != FileReadBackend::MapPerAllocation)
+        m_allocationOffsets.back().push_back(offset);
+
     FileAllocation fileAllocation { offset, numBytes, m_currentFileID };
     Allocation allocation;
     std::memcpy(&allocation, &fileAllocation, sizeof(FileAllocation));
@@ -46,12 +77,28 @@ std::unique_ptr<Deserializer> SplitFileSerializer::createDeserializer()
 {
     // Cannot use make_unique with private constructors
     m_currentFile.unmap();
-    return std::unique_ptr<SplitFileDeserializer>(new SplitFileDeserializer(m_tempFolder, m_currentFileID, m_fileCacheMode));
+    if (m_readBackend == FileReadBackend::IoUring) {
+#ifdef __linux__
+        const bool directIO = (m_fileCacheMode & mio_cache_control::cache_mode::no_buffering) == mio_cache_control::cache_mode::no_buffering;
+        return std::unique_ptr<UringFileDeserializer>(new UringFileDeserializer(m_tempFolder, m_currentFileID, directIO));
+#else
+        spdlog::warn("io_uring is only supported on Linux, falling back to persistent file mappings");
+#endif
+    }
+    if (m_readBackend != FileReadBackend::MapPerAllocation) {
+        auto allocationOffsets = m_allocationOffsets;
+        if (!allocationOffsets.empty())
+            allocationOffsets.back().push_back(m_currentOffset);
+        return std::unique_ptr<SplitFileDeserializer>(new SplitFileDeserializer(m_tempFolder, std::move(allocationOffsets), m_fileCacheMode));
+    } else {
+        return std::unique_ptr<SplitFileDeserializer>(new SplitFileDeserializer(m_tempFolder, m_currentFileID, m_fileCacheMode));
+    }
 }
 
 SplitFileDeserializer::SplitFileDeserializer(std::filesystem::path tempFolder, uint32_t maxFileID, mio_cache_control::cache_mode fileCacheMode)
     : m_tempFolder(tempFolder)
     , m_fileCacheMode(fileCacheMode)
+    , m_persistentMapping(false)
 {
     /*for (uint32_t fileID = 1; fileID <= maxFileID; fileID++) {
         const auto fileName = std::to_string(fileID) + ".bin";
@@ -61,11 +108,27 @@ SplitFileDeserializer::SplitFileDeserializer(std::filesystem::path tempFolder, u
     }*/
 }
 
+SplitFileDeserializer::SplitFileDeserializer(std::filesystem::path tempFolder, std::vector<std::vector<size_t>>&& allocationOffsets, mio_cache_control::cache_mode fileCacheMode)
+    : m_tempFolder(tempFolder)
+    , m_fileCacheMode(fileCacheMode)
+    , m_persistentMapping(true)
+{
+    for (uint32_t fileIdx = 0; fileIdx < allocationOffsets.size(); fileIdx++) {
+        const auto fileName = std::to_string(fileIdx + 1) + ".bin";
+        const auto filePath = m_tempFolder / fileName;
+        auto mappedFile = mio_cache_control::mmap_source(filePath.string(), m_fileCacheMode);
+        m_persistentFileStarts.push_back({ mappedFile.data(), fileIdx });
+        m_persistentFiles.push_back({ std::move(mappedFile), std::move(allocationOffsets[fileIdx]) });
+    }
+    std::sort(std::begin(m_persistentFileStarts), std::end(m_persistentFileStarts));
+}
+
 SplitFileDeserializer::~SplitFileDeserializer()
 {
     std::scoped_lock l { m_mutex };
 
     m_openFiles.clear();
+    m_persistentFiles.clear();
     std::filesystem::remove_all(m_tempFolder);
 }
 
@@ -74,6 +137,13 @@ const void* SplitFileDeserializer::map(const Allocation& allocation)
     SplitFileSerializer::FileAllocation fileAllocation;
     std::memcpy(&fileAllocation, &allocation, sizeof(decltype(fileAllocation)));
 
+    if (m_persistentMapping) {
+        const auto& mappedFile = m_persistentFiles[fileAllocation.fileID - 1].file;
+        const char* pResult = mappedFile.data() + fileAllocation.offsetInFile;
+        adviseRange(pResult, fileAllocation.allocationSize, true);
+        return pResult;
+    }
+
     const auto fileName = std::to_string(fileAllocation.fileID) + ".bin";
     const auto filePath = m_tempFolder / fileName;
 
@@ -100,6 +170,24 @@ const void* SplitFileDeserializer::map(const Allocation& allocation)
 
 void SplitFileDeserializer::unmap(const void* pMemory)
 {
+    if (m_persistentMapping) {
+        // Find the file containing the pointer, and then the allocation to figure out its size.
+        const char* pChar = reinterpret_cast<const char*>(pMemory);
+        auto fileIter = std::upper_bound(std::begin(m_persistentFileStarts), std::end(m_persistentFileStarts), pChar,
+            [](const char* pChar, const std::pair<const char*, uint32_t>& fileStart) { return pChar < fileStart.first; });
+        if (fileIter != std::begin(m_persistentFileStarts)) {
+            const auto& [mappedFile, allocationOffsets] = m_persistentFiles[std::prev(fileIter)->second];
+            const size_t offset = pChar - mappedFile.data();
+            auto offsetIter = std::upper_bound(std::begin(allocationOffsets), std::end(allocationOffsets), offset);
+            if (offset < mappedFile.size() && offsetIter != std::begin(allocationOffsets) && offsetIter != std::end(allocationOffsets) && *std::prev(offsetIter) == offset) {
+                adviseRange(pChar, *offsetIter - offset, false);
+                return;
+            }
+        }
+        spdlog::error("SplitFileDeserializer trying to unmap a file that was not mapped");
+        return;
+    }
+
     std::scoped_lock l { m_mutex };
 
     if (auto iter = m_openFiles.find(pMemory); iter != std::end(m_openFiles)) {
@@ -122,6 +210,13 @@ void SplitFileSerializer::openNewFile(size_t minSize)
     if (m_currentFile.is_open() && m_currentFile.is_mapped())
         m_openFiles.push_back(std::move(m_currentFile));
 
+    if (m_readBackend != FileReadBackend::MapPerAllocation) {
+        // Last entry stores the number of bytes used so the deserializer knows the size of the final allocation.
+        if (!m_allocationOffsets.empty())
+            m_allocationOffsets.back().push_back(m_currentOffset);
+        m_allocationOffsets.emplace_back();
+    }
+
     const std::filesystem::path fileName = std::to_string(++m_currentFileID) + ".bin";
     const auto filePath = m_tempFolder / fileName;
 
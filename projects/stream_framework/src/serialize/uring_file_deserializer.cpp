@@ -0,0 +1,404 @@
+#include "stream/serialize/uring_file_deserializer.h"
+#include "stream/serialize/file_serializer.h"
+#ifdef __linux__
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace tasking {
+
+// Alignment of file offsets, read sizes and buffers (required when using O_DIRECT).
+static constexpr size_t s_ioAlignment = 4096;
+// Maximum amount of memory kept around in the buffer pool.
+static constexpr size_t s_maxPooledBytes = 256 * 1024 * 1024;
+
+// Stored right in front of the pointer returned by map() so that unmap() can find the buffer.
+struct BufferHeader {
+    std::byte* pBuffer;
+    uint32_t sizeClass;
+};
+
+struct UringFileDeserializer::Request {
+    int fileDescriptor;
+    size_t alignedOffset;
+    size_t readSize; // Multiple of s_ioAlignment
+    size_t bytesNeeded; // Bytes from alignedOffset up to the end of the allocation
+
+    uint32_t sizeClass;
+    std::byte* pBuffer; // First s_ioAlignment bytes are reserved for the header
+
+    int result { 0 }; // Bytes read or -errno
+    std::atomic_bool done { false };
+};
+
+// We talk to the kernel directly (instead of through liburing) to not introduce another dependency.
+static int ioUringSetup(unsigned entries, io_uring_params* pParams)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, pParams));
+}
+
+static int ioUringEnter(int ringFD, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFD, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+struct UringFileDeserializer::Ring {
+    int ringFD { -1 };
+    io_uring_params params;
+
+    void* pSubmissionRing { MAP_FAILED };
+    size_t submissionRingSize { 0 };
+    void* pCompletionRing { MAP_FAILED };
+    size_t completionRingSize { 0 };
+    io_uring_sqe* pSubmissionEntries { static_cast<io_uring_sqe*>(MAP_FAILED) };
+
+    unsigned* pSqHead;
+    unsigned* pSqTail;
+    unsigned* pSqMask;
+    unsigned* pSqEntries;
+    unsigned* pSqArray;
+    unsigned* pCqHead;
+    unsigned* pCqTail;
+    unsigned* pCqMask;
+    io_uring_cqe* pCompletionEntries;
+
+    ~Ring()
+    {
+        if (pSubmissionEntries != MAP_FAILED)
+            munmap(pSubmissionEntries, params.sq_entries * sizeof(io_uring_sqe));
+        if (pCompletionRing != MAP_FAILED && pCompletionRing != pSubmissionRing)
+            munmap(pCompletionRing, completionRingSize);
+        if (pSubmissionRing != MAP_FAILED)
+            munmap(pSubmissionRing, submissionRingSize);
+        if (ringFD >= 0)
+            close(ringFD);
+    }
+
+    static std::unique_ptr<Ring> create(unsigned entries)
+    {
+        auto pRing = std::make_unique<Ring>();
+        std::memset(&pRing->params, 0, sizeof(io_uring_params));
+        pRing->ringFD = ioUringSetup(entries, &pRing->params);
+        if (pRing->ringFD < 0)
+            return nullptr;
+
+        const auto& params = pRing->params;
+        pRing->submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        pRing->completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap)
+            pRing->submissionRingSize = pRing->completionRingSize = std::max(pRing->submissionRingSize, pRing->completionRingSize);
+
+        pRing->pSubmissionRing = mmap(nullptr, pRing->submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->ringFD, IORING_OFF_SQ_RING);
+        if (pRing->pSubmissionRing == MAP_FAILED)
+            return nullptr;
+        if (singleMap) {
+            pRing->pCompletionRing = pRing->pSubmissionRing;
+        } else {
+            pRing->pCompletionRing = mmap(nullptr, pRing->completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->ringFD, IORING_OFF_CQ_RING);
+            if (pRing->pCompletionRing == MAP_FAILED)
+                return nullptr;
+        }
+        pRing->pSubmissionEntries = static_cast<io_uring_sqe*>(mmap(
+            nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->ringFD, IORING_OFF_SQES));
+        if (pRing->pSubmissionEntries == MAP_FAILED)
+            return nullptr;
+
+        auto* pSq = static_cast<std::byte*>(pRing->pSubmissionRing);
+        pRing->pSqHead = reinterpret_cast<unsigned*>(pSq + params.sq_off.head);
+        pRing->pSqTail = reinterpret_cast<unsigned*>(pSq + params.sq_off.tail);
+        pRing->pSqMask = reinterpret_cast<unsigned*>(pSq + params.sq_off.ring_mask);
+        pRing->pSqEntries = reinterpret_cast<unsigned*>(pSq + params.sq_off.ring_entries);
+        pRing->pSqArray = reinterpret_cast<unsigned*>(pSq + params.sq_off.array);
+        auto* pCq = static_cast<std::byte*>(pRing->pCompletionRing);
+        pRing->pCqHead = reinterpret_cast<unsigned*>(pCq + params.cq_off.head);
+        pRing->pCqTail = reinterpret_cast<unsigned*>(pCq + params.cq_off.tail);
+        pRing->pCqMask = reinterpret_cast<unsigned*>(pCq + params.cq_off.ring_mask);
+        pRing->pCompletionEntries = reinterpret_cast<io_uring_cqe*>(pCq + params.cq_off.cqes);
+        return pRing;
+    }
+
+    // Number of submission queue entries that have been published but not yet consumed by the kernel.
+    unsigned numPendingSubmissions() const
+    {
+        return std::atomic_ref(*pSqTail).load(std::memory_order_acquire) - std::atomic_ref(*pSqHead).load(std::memory_order_acquire);
+    }
+};
+
+UringFileDeserializer::UringFileDeserializer(std::filesystem::path tempFolder, uint32_t numFiles, bool directIO, unsigned queueDepth)
+    : m_tempFolder(tempFolder)
+    , m_queueDepth(queueDepth)
+{
+    for (uint32_t fileID = 1; fileID <= numFiles; fileID++) {
+        const auto fileName = std::to_string(fileID) + ".bin";
+        const auto filePath = m_tempFolder / fileName;
+
+        int fileDescriptor = open(filePath.c_str(), O_RDONLY | (directIO ? O_DIRECT : 0));
+        if (fileDescriptor < 0 && directIO && errno == EINVAL) {
+            // File system does not support O_DIRECT (e.g. tmpfs)
+            spdlog::warn("UringFileDeserializer: O_DIRECT not supported for \"{}\", using buffered reads", filePath.string());
+            directIO = false;
+            fileDescriptor = open(filePath.c_str(), O_RDONLY);
+        }
+        if (fileDescriptor < 0)
+            spdlog::error("UringFileDeserializer failed to open \"{}\": {}", filePath.string(), std::strerror(errno));
+        m_fileDescriptors.push_back(fileDescriptor);
+    }
+
+    m_pRing = Ring::create(queueDepth);
+    if (!m_pRing)
+        spdlog::warn("UringFileDeserializer: io_uring is not available ({}), falling back to synchronous reads", std::strerror(errno));
+}
+
+UringFileDeserializer::~UringFileDeserializer()
+{
+    // The kernel may still be writing into the buffers of requests that were submitted but never mapped.
+    for (auto& [key, pRequest] : m_requests) {
+        waitForCompletion(pRequest.get());
+        std::free(pRequest->pBuffer);
+    }
+    m_requests.clear();
+    m_pRing.reset();
+
+    for (auto& freeBuffers : m_freeBuffers) {
+        for (std::byte* pBuffer : freeBuffers)
+            std::free(pBuffer);
+    }
+
+    for (int fileDescriptor : m_fileDescriptors) {
+        if (fileDescriptor >= 0)
+            close(fileDescriptor);
+    }
+    std::filesystem::remove_all(m_tempFolder);
+}
+
+static uint64_t requestKey(uint32_t fileID, size_t offsetInFile)
+{
+    assert(offsetInFile < (1llu << 40));
+    return (uint64_t(fileID) << 40) | offsetInFile;
+}
+
+const void* UringFileDeserializer::map(const Allocation& allocation)
+{
+    SplitFileSerializer::FileAllocation fileAllocation;
+    std::memcpy(&fileAllocation, &allocation, sizeof(decltype(fileAllocation)));
+
+    // Complete a previously submitted request or read synchronously if there is none.
+    std::unique_ptr<Request> pRequest;
+    {
+        std::scoped_lock l { m_requestsMutex };
+        if (auto iter = m_requests.find(requestKey(fileAllocation.fileID, fileAllocation.offsetInFile)); iter != std::end(m_requests)) {
+            pRequest = std::move(iter->second);
+            m_requests.erase(iter);
+        }
+    }
+    if (pRequest) {
+        waitForCompletion(pRequest.get());
+    } else {
+        pRequest = createRequest(allocation);
+        readSynchronously(pRequest.get());
+    }
+
+    if (pRequest->result < static_cast<int>(pRequest->bytesNeeded)) {
+        if (pRequest->result < 0)
+            spdlog::warn("UringFileDeserializer asynchronous read failed: {}", std::strerror(-pRequest->result));
+        readSynchronously(pRequest.get());
+        if (pRequest->result < static_cast<int>(pRequest->bytesNeeded))
+            spdlog::error("UringFileDeserializer failed to read allocation from file {}", fileAllocation.fileID);
+    }
+
+    std::byte* pResult = pRequest->pBuffer + s_ioAlignment + (fileAllocation.offsetInFile - pRequest->alignedOffset);
+    const BufferHeader header { pRequest->pBuffer, pRequest->sizeClass };
+    std::memcpy(pResult - sizeof(BufferHeader), &header, sizeof(BufferHeader));
+    return pResult;
+}
+
+void UringFileDeserializer::unmap(const void* pMemory)
+{
+    BufferHeader header;
+    std::memcpy(&header, static_cast<const std::byte*>(pMemory) - sizeof(BufferHeader), sizeof(BufferHeader));
+    freeBuffer(header.pBuffer, header.sizeClass);
+}
+
+void UringFileDeserializer::submit(const Allocation& allocation)
+{
+    // Submitting is only a hint; map() will read the data itself if the queue is full.
+    if (!m_pRing || m_numInFlight.load(std::memory_order_relaxed) >= m_queueDepth)
+        return;
+
+    SplitFileSerializer::FileAllocation fileAllocation;
+    std::memcpy(&fileAllocation, &allocation, sizeof(decltype(fileAllocation)));
+
+    // Only publish the request once it has been submitted to the kernel: map() waits for the completion of any request
+    // that it finds. The lock is held while submitting so that map() never misses a request that is being submitted.
+    std::scoped_lock l { m_requestsMutex };
+    const uint64_t key = requestKey(fileAllocation.fileID, fileAllocation.offsetInFile);
+    if (m_requests.find(key) != std::end(m_requests))
+        return;
+
+    auto pRequest = createRequest(allocation);
+    if (submitRequest(pRequest.get()))
+        m_requests.emplace(key, std::move(pRequest));
+    else
+        freeBuffer(pRequest->pBuffer, pRequest->sizeClass);
+}
+
+void UringFileDeserializer::cancel(const Allocation& allocation)
+{
+    SplitFileSerializer::FileAllocation fileAllocation;
+    std::memcpy(&fileAllocation, &allocation, sizeof(decltype(fileAllocation)));
+
+    std::unique_ptr<Request> pRequest;
+    {
+        std::scoped_lock l { m_requestsMutex };
+        if (auto iter = m_requests.find(requestKey(fileAllocation.fileID, fileAllocation.offsetInFile)); iter != std::end(m_requests)) {
+            pRequest = std::move(iter->second);
+            m_requests.erase(iter);
+        }
+    }
+
+    // The kernel may still be writing into the buffer so it can only be reused once the read has completed.
+    if (pRequest) {
+        waitForCompletion(pRequest.get());
+        freeBuffer(pRequest->pBuffer, pRequest->sizeClass);
+    }
+}
+
+std::unique_ptr<UringFileDeserializer::Request> UringFileDeserializer::createRequest(const Allocation& allocation)
+{
+    SplitFileSerializer::FileAllocation fileAllocation;
+    std::memcpy(&fileAllocation, &allocation, sizeof(decltype(fileAllocation)));
+
+    auto pRequest = std::make_unique<Request>();
+    pRequest->fileDescriptor = m_fileDescriptors[fileAllocation.fileID - 1];
+    pRequest->alignedOffset = fileAllocation.offsetInFile / s_ioAlignment * s_ioAlignment;
+    pRequest->bytesNeeded = fileAllocation.offsetInFile + fileAllocation.allocationSize - pRequest->alignedOffset;
+    pRequest->readSize = (pRequest->bytesNeeded + s_ioAlignment - 1) / s_ioAlignment * s_ioAlignment;
+    pRequest->sizeClass = static_cast<uint32_t>(std::bit_width(s_ioAlignment + pRequest->readSize - 1));
+    pRequest->pBuffer = allocateBuffer(pRequest->sizeClass);
+    return pRequest;
+}
+
+bool UringFileDeserializer::submitRequest(Request* pRequest)
+{
+    std::scoped_lock l { m_submitMutex };
+
+    Ring& ring = *m_pRing;
+    const unsigned tail = *ring.pSqTail;
+    if (tail - std::atomic_ref(*ring.pSqHead).load(std::memory_order_acquire) >= *ring.pSqEntries)
+        return false;
+
+    const unsigned index = tail & *ring.pSqMask;
+    io_uring_sqe& submissionEntry = ring.pSubmissionEntries[index];
+    std::memset(&submissionEntry, 0, sizeof(io_uring_sqe));
+    submissionEntry.opcode = IORING_OP_READ;
+    submissionEntry.fd = pRequest->fileDescriptor;
+    submissionEntry.addr = reinterpret_cast<uint64_t>(pRequest->pBuffer + s_ioAlignment);
+    submissionEntry.len = static_cast<uint32_t>(pRequest->readSize);
+    submissionEntry.off = pRequest->alignedOffset;
+    submissionEntry.user_data = reinterpret_cast<uint64_t>(pRequest);
+    ring.pSqArray[index] = index;
+    std::atomic_ref(*ring.pSqTail).store(tail + 1, std::memory_order_release);
+    m_numInFlight.fetch_add(1, std::memory_order_relaxed);
+
+    // Once published the entry belongs to the kernel. If entering fails it is picked up by the next call to
+    // io_uring_enter (which always submits all pending entries).
+    int ret;
+    do {
+        ret = ioUringEnter(ring.ringFD, ring.numPendingSubmissions(), 0, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        spdlog::error("UringFileDeserializer io_uring_enter failed: {}", std::strerror(errno));
+    return true;
+}
+
+void UringFileDeserializer::waitForCompletion(Request* pRequest)
+{
+    while (!pRequest->done.load(std::memory_order_acquire)) {
+        // Only one thread waits for the kernel at a time; it reaps the completions of all other waiting threads.
+        std::scoped_lock l { m_completionMutex };
+        if (pRequest->done.load(std::memory_order_acquire))
+            break;
+        if (reapCompletions() == 0) {
+            const int ret = ioUringEnter(m_pRing->ringFD, m_pRing->numPendingSubmissions(), 1, IORING_ENTER_GETEVENTS);
+            if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                spdlog::error("UringFileDeserializer io_uring_enter failed: {}", std::strerror(errno));
+            reapCompletions();
+        }
+    }
+}
+
+void UringFileDeserializer::readSynchronously(Request* pRequest)
+{
+    size_t bytesRead = 0;
+    while (bytesRead < pRequest->bytesNeeded) {
+        const ssize_t ret = pread(pRequest->fileDescriptor, pRequest->pBuffer + s_ioAlignment + bytesRead, pRequest->readSize - bytesRead, pRequest->alignedOffset + bytesRead);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        bytesRead += static_cast<size_t>(ret);
+    }
+    pRequest->result = static_cast<int>(bytesRead);
+    pRequest->done.store(true, std::memory_order_release);
+}
+
+size_t UringFileDeserializer::reapCompletions()
+{
+    Ring& ring = *m_pRing;
+    unsigned head = *ring.pCqHead;
+    const unsigned tail = std::atomic_ref(*ring.pCqTail).load(std::memory_order_acquire);
+
+    size_t numCompleted = 0;
+    for (; head != tail; head++, numCompleted++) {
+        const io_uring_cqe& completionEntry = ring.pCompletionEntries[head & *ring.pCqMask];
+        auto* pRequest = reinterpret_cast<Request*>(completionEntry.user_data);
+        pRequest->result = completionEntry.res;
+        pRequest->done.store(true, std::memory_order_release);
+    }
+    std::atomic_ref(*ring.pCqHead).store(head, std::memory_order_release);
+    m_numInFlight.fetch_sub(static_cast<uint32_t>(numCompleted), std::memory_order_relaxed);
+    return numCompleted;
+}
+
+std::byte* UringFileDeserializer::allocateBuffer(uint32_t sizeClass)
+{
+    {
+        std::scoped_lock l { m_bufferPoolMutex };
+        auto& freeBuffers = m_freeBuffers[sizeClass];
+        if (!freeBuffers.empty()) {
+            std::byte* pBuffer = freeBuffers.back();
+            freeBuffers.pop_back();
+            m_pooledBytes -= size_t(1) << sizeClass;
+            return pBuffer;
+        }
+    }
+    return static_cast<std::byte*>(std::aligned_alloc(s_ioAlignment, size_t(1) << sizeClass));
+}
+
+void UringFileDeserializer::freeBuffer(std::byte* pBuffer, uint32_t sizeClass)
+{
+    {
+        std::scoped_lock l { m_bufferPoolMutex };
+        const size_t bufferSize = size_t(1) << sizeClass;
+        if (m_pooledBytes + bufferSize <= s_maxPooledBytes) {
+            m_freeBuffers[sizeClass].push_back(pBuffer);
+            m_pooledBytes += bufferSize;
+            return;
+        }
+    }
+    std::free(pBuffer);
+}
+
+}
+
+#endif
@@ -43,6 +43,7 @@ nlohmann::json StreamStats::toJSON(const FlushInfo& flushInfo)
     ret["task_name"] = flushInfo.taskName;
     ret["items_flushed"] = flushInfo.itemsFlushed;
     ret["static_data_load_time"] = flushInfo.staticDataLoadTime;
+    ret["static_data_prefetched"] = flushInfo.staticDataPrefetched;
     ret["processing_time"] = flushInfo.processingTime;
     return ret;
 }
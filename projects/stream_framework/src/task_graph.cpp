@@ -4,13 +4,17 @@
 #include <mutex>
 #include <optick.h>
 #include <optick_tbb.h>
+#include <spdlog/spdlog.h>
+#include <tbb/info.h>
 #include <thread>
 
 namespace tasking {
 
-TaskGraph::TaskGraph(unsigned numSchedulers)
+TaskGraph::TaskGraph(unsigned numSchedulers, unsigned numPrefetchTasks)
     : m_taskArena(static_cast<int>(std::thread::hardware_concurrency()))
     , m_numSchedulers(numSchedulers)
+    , m_pSchedulingPolicy(std::make_unique<LargestQueuePolicy>())
+    , m_numPrefetchTasks(numPrefetchTasks)
 {
     auto& stats = StreamStats::getSingleton();
     (void)stats;
@@ -20,39 +24,467 @@ void TaskGraph::run()
 {
     m_inTaskArena = true;
     m_taskArena.execute([&] {
-        tbb::task_group tg;
-        std::function<void()> schedule = [&]() {
-            Optick::tryRegisterThreadWithOptick();
+        if (m_executionMode == ExecutionMode::Continuous)
+            runContinuous();
+        else
+            runFlushes();
+    });
+    m_inTaskArena = false;
+
+    releasePrefetchedStaticData();
+}
+
+void TaskGraph::setExecutionMode(ExecutionMode executionMode)
+{
+    assert(!m_inTaskArena);
+    m_executionMode = executionMode;
+}
+
+void TaskGraph::runFlushes()
+{
+    tbb::task_group tg;
+    std::function<void()> schedule = [&]() {
+        Optick::tryRegisterThreadWithOptick();
+
+        // Read before selecting a task so that events that happen during selection are not missed.
+        const uint32_t schedulingEvents = m_schedulingEvents.load(std::memory_order_acquire);
+        std::optional<SelectedTask> optSelectedTask;
+        {
+            OPTICK_EVENT("Task Selection");
+            optSelectedTask = selectTask();
+        }
+        if (!optSelectedTask) {
+            // All work is done when there are no items left in flight. Otherwise the remaining items are being
+            // processed by the other schedulers, which may produce new work for tasks that are not executing.
+            if (m_numInFlightItems.load(std::memory_order_acquire) == 0)
+                return;
+
+            // Sleep until new work is enqueued or another task finishes (which also happens when the last in-flight
+            // items are processed).
+            waitForSchedulingEvent(schedulingEvents);
+            tg.run(schedule);
+            return;
+        }
+        const auto [taskIdx, numConcurrentTasks, firstWorker] = *optSelectedTask;
+        TaskBase* pTask = m_tasks[taskIdx].get();
+
+        if (m_numPrefetchTasks > 0)
+            prefetchStaticData(taskIdx);
+
+        if (m_numaArenas.empty()) {
+            pTask->execute(this, numConcurrentTasks);
+        } else {
+            // Divide the threads of the node among the tasks executing on that node.
+            const auto [numaNode, numNodeTasks] = acquireNumaNode(taskIdx);
+            m_numaArenas[numaNode]->execute([&, numNodeTasks = numNodeTasks]() { pTask->execute(this, numNodeTasks); });
+            releaseNumaNode(numaNode);
+        }
+        finishTask(taskIdx);
+        if (m_deferredWorkCallback && !overMemoryBudget())
+            resumeDeferredWork();
+        tg.run(schedule);
+    };
+
+    while (m_numInFlightItems.load(std::memory_order_acquire) > 0 || resumeDeferredWork()) {
+        // Queue sizes are approximate so a task may have been left out of the priority queue.
+        markAllDirty();
+        for (unsigned i = 0; i < m_numSchedulers; i++) {
+            tg.run(schedule);
+        }
+        tg.wait();
+    }
+}
+
+void TaskGraph::runContinuous()
+{
+    // Every thread runs its own scheduling loop: it picks the task with the highest priority that can take another
+    // worker and processes batches of that task until its queue runs dry. There is no join at the end of a flush so
+    // threads that run out of work immediately move on to another task.
+    // The worker loops only return once all work is done. Kernels, static data loaders and the deferred work callback
+    // are therefore isolated: otherwise a thread that waits for a nested parallel_for could pick up another worker loop
+    // and never return to the work it was processing.
+    //
+    // A worker that runs out of work may not simply exit when no items are in flight: another worker may still resume
+    // deferred work. Termination is therefore decided under m_terminationMutex, which is also held while resuming
+    // deferred work: the graph is finished when no worker is busy, no items are in flight and the deferred work
+    // callback does not produce any new work.
+    std::atomic_bool done { false };
+    std::atomic_int numBusyWorkers { 0 };
+
+    auto tryResumeDeferredWork = [&]() {
+        std::unique_lock l { m_terminationMutex, std::try_to_lock };
+        if (!l.owns_lock())
+            return false; // Another worker is resuming deferred work (or checking for termination)
+        return tbb::this_task_arena::isolate([&]() { return resumeDeferredWork(); });
+    };
+    auto checkTermination = [&]() {
+        std::lock_guard l { m_terminationMutex };
+        // Read the number of busy workers before the number of in-flight items: a worker enqueues its follow-up work
+        //  before it stops being busy.
+        if (numBusyWorkers.load() > 0 || m_numInFlightItems.load() > 0)
+            return;
+        if (tbb::this_task_arena::isolate([&]() { return resumeDeferredWork(); }))
+            return;
+
+        done.store(true);
+        notifySchedulers();
+    };
 
-            TaskBase* pTask { nullptr };
+    auto worker = [&]() {
+        Optick::tryRegisterThreadWithOptick();
+
+        while (!done.load()) {
+            // Read before selecting a task so that events that happen during selection are not missed.
+            const uint32_t schedulingEvents = m_schedulingEvents.load(std::memory_order_acquire);
+            std::optional<SelectedTask> optSelectedTask;
             {
                 OPTICK_EVENT("Task Selection");
-                auto bestTaskIter = std::max_element(
-                    std::begin(m_tasks),
-                    std::end(m_tasks),
-                    [](const auto& lhs, const auto& rhs) {
-                        return lhs->approxQueueSize() < rhs->approxQueueSize();
-                    });
-                assert(bestTaskIter != std::end(m_tasks));
-
-                // TODO: cannot assume this when we allow multiple tasks to execute in parallel (need better stop condition)!
-                pTask = bestTaskIter->get();
+                optSelectedTask = selectTask();
             }
-            if (pTask->approxQueueSize() == 0)
-                return;
+            if (!optSelectedTask) {
+                if (m_numInFlightItems.load(std::memory_order_acquire) == 0)
+                    checkTermination();
+                if (!done.load())
+                    waitForSchedulingEvent(schedulingEvents);
+                continue;
+            }
+            numBusyWorkers.fetch_add(1);
 
-            pTask->execute(this);
-            tg.run(schedule);
+            const auto [taskIdx, numConcurrentTasks, firstWorker] = *optSelectedTask;
+            TaskBase* pTask = m_tasks[taskIdx].get();
+
+            if (m_numPrefetchTasks > 0 && firstWorker)
+                prefetchStaticData(taskIdx);
+
+            tbb::this_task_arena::isolate([&]() { pTask->drain(this); });
+            finishTask(taskIdx);
+            if (m_deferredWorkCallback && !overMemoryBudget())
+                tryResumeDeferredWork();
+
+            numBusyWorkers.fetch_sub(1);
+        }
+    };
+
+    tbb::task_group tg;
+    while (m_numInFlightItems.load(std::memory_order_acquire) > 0 || resumeDeferredWork()) {
+        done.store(false);
+        markAllDirty();
+        const int numWorkers = tbb::this_task_arena::max_concurrency();
+        for (int i = 0; i < numWorkers; i++)
+            tg.run(worker);
+        tg.wait();
+    }
+}
+
+void TaskGraph::setSchedulingPolicy(std::unique_ptr<SchedulingPolicy> pPolicy)
+{
+    {
+        std::lock_guard l { m_schedulingMutex };
+        m_pSchedulingPolicy = std::move(pPolicy);
+    }
+    markAllDirty();
+}
+
+void TaskGraph::registerTask(std::unique_ptr<TaskBase>&& pTask)
+{
+    std::lock_guard l { m_schedulingMutex };
+    m_tasks.push_back(std::move(pTask));
+    m_staticDataLoadCosts.emplace_back();
+    m_taskDirty.emplace_back(false);
+    m_taskPriorities.resize(m_tasks.size());
+    m_taskNumWorkers.push_back(0);
+    m_taskNumaNodes.push_back(-1);
+}
+
+unsigned TaskGraph::enableNumaAwareness()
+{
+    assert(!m_inTaskArena);
+
+    const std::vector<tbb::numa_node_id> numaNodes = tbb::info::numa_nodes();
+    if (numaNodes.size() <= 1)
+        return 1;
+
+    std::lock_guard l { m_schedulingMutex };
+    m_numaArenas.clear();
+    for (tbb::numa_node_id numaNode : numaNodes)
+        m_numaArenas.push_back(std::make_unique<tbb::task_arena>(tbb::task_arena::constraints { numaNode }));
+    m_numaNodePinnedTasks.assign(numaNodes.size(), 0);
+    m_numaNodeActiveTasks.assign(numaNodes.size(), 0);
+    std::fill(std::begin(m_taskNumaNodes), std::end(m_taskNumaNodes), -1);
+
+    spdlog::info("TaskGraph executes tasks on {} NUMA nodes", numaNodes.size());
+    return static_cast<unsigned>(numaNodes.size());
+}
+
+std::pair<int, unsigned> TaskGraph::acquireNumaNode(uint32_t taskIdx)
+{
+    std::lock_guard l { m_schedulingMutex };
+
+    int numaNode = m_taskNumaNodes[taskIdx];
+    if (numaNode == -1) {
+        // Spread the static data evenly over the nodes; other tasks go to the node that is least busy.
+        const bool pin = m_tasks[taskIdx]->hasStaticData();
+        auto nodeLoad = [&](int node) {
+            if (pin)
+                return std::pair { m_numaNodePinnedTasks[node], m_numaNodeActiveTasks[node] };
+            else
+                return std::pair { m_numaNodeActiveTasks[node], m_numaNodePinnedTasks[node] };
         };
 
-        while (!allQueuesEmpty()) {
-            for (unsigned i = 0; i < m_numSchedulers; i++) {
-                tg.run(schedule);
-            }
-            tg.wait();
+        numaNode = 0;
+        for (int node = 1; node < static_cast<int>(m_numaArenas.size()); node++) {
+            if (nodeLoad(node) < nodeLoad(numaNode))
+                numaNode = node;
         }
+
+        if (pin) {
+            m_taskNumaNodes[taskIdx] = numaNode;
+            m_numaNodePinnedTasks[numaNode]++;
+        }
+    }
+
+    const unsigned numNodeTasks = ++m_numaNodeActiveTasks[numaNode];
+    return { numaNode, numNodeTasks };
+}
+
+void TaskGraph::releaseNumaNode(int numaNode)
+{
+    std::lock_guard l { m_schedulingMutex };
+    m_numaNodeActiveTasks[numaNode]--;
+}
+
+void TaskGraph::markDirty(uint32_t taskIdx)
+{
+    // Only the first enqueue after the scheduler has processed the task needs to take the lock.
+    if (m_taskDirty[taskIdx].load(std::memory_order_relaxed) || m_taskDirty[taskIdx].exchange(true))
+        return;
+
+    {
+        std::lock_guard l { m_dirtyTasksMutex };
+        m_dirtyTasks.push_back(taskIdx);
+    }
+    notifySchedulers();
+}
+
+void TaskGraph::markAllDirty()
+{
+    for (uint32_t taskIdx = 0; taskIdx < static_cast<uint32_t>(m_tasks.size()); taskIdx++)
+        markDirty(taskIdx);
+}
+
+void TaskGraph::notifySchedulers()
+{
+    m_schedulingEvents.fetch_add(1, std::memory_order_release);
+    m_idleCondition.notify_all();
+}
+
+void TaskGraph::waitForSchedulingEvent(uint32_t schedulingEvents)
+{
+    OPTICK_EVENT();
+
+    // The wait is bounded because a scheduler may run nested inside the wait of a kernel (TBB work stealing), in
+    //  which case it has to return for that kernel to finish. Notifications do not take m_idleMutex so a wake-up can
+    //  be missed, which only delays the scheduler until the timeout.
+    std::unique_lock l { m_idleMutex };
+    m_idleCondition.wait_for(l, std::chrono::milliseconds(1), [&]() {
+        return m_schedulingEvents.load(std::memory_order_acquire) != schedulingEvents;
     });
-    m_inTaskArena = false;
+}
+
+std::optional<TaskGraph::SelectedTask> TaskGraph::selectTask()
+{
+    std::lock_guard l { m_schedulingMutex };
+
+    std::vector<uint32_t> dirtyTasks;
+    {
+        std::lock_guard l2 { m_dirtyTasksMutex };
+        std::swap(dirtyTasks, m_dirtyTasks);
+    }
+
+    for (uint32_t taskIdx : dirtyTasks) {
+        // Clear the flag before reading the queue size so that concurrent enqueues will mark the task again.
+        m_taskDirty[taskIdx].store(false);
+
+        const auto& pTask = m_tasks[taskIdx];
+        const size_t queueSize = pTask->approxQueueSize();
+        // The priority of a task that cannot take more workers is recomputed when one of its workers finishes.
+        if (queueSize == 0 || !acceptsWorker(taskIdx, queueSize)) {
+            m_taskPriorities.erase(taskIdx);
+            continue;
+        }
+
+        m_taskPriorities.update(taskIdx, { computePriority(taskIdx, queueSize), queueSize });
+    }
+
+    if (m_taskPriorities.empty())
+        return {};
+
+    // Loading or evicting static data changes the priority of tasks (see SchedulingPolicy::TaskInfo::bytesToLoad)
+    //  without marking them dirty. Recompute the priority of the top task if it depends on its static data and pick
+    //  the new top if the priority dropped (a recomputed task that is back on top keeps its priority, ending the loop).
+    uint32_t taskIdx = m_taskPriorities.top();
+    for (size_t i = 0; i < m_tasks.size() && m_staticDataLoadCosts[taskIdx]; i++) {
+        const auto [stalePriority, queueSize] = m_taskPriorities.key(taskIdx);
+        const double priority = computePriority(taskIdx, queueSize);
+        m_taskPriorities.update(taskIdx, { priority, queueSize });
+        if (priority >= stalePriority)
+            break;
+        taskIdx = m_taskPriorities.top();
+    }
+
+    const bool firstWorker = (m_taskNumWorkers[taskIdx]++ == 0);
+    if (firstWorker)
+        m_numExecutingTasks++;
+    if (!acceptsWorker(taskIdx, m_taskPriorities.key(taskIdx).second))
+        m_taskPriorities.erase(taskIdx);
+
+    // Divide the threads among the tasks that are executing (or that other schedulers are expected to pick up).
+    const size_t numRunnableTasks = m_numExecutingTasks + m_taskPriorities.size();
+    const unsigned numConcurrentTasks = static_cast<unsigned>(std::min(static_cast<size_t>(m_numSchedulers), numRunnableTasks));
+    return SelectedTask { taskIdx, std::max(numConcurrentTasks, 1u), firstWorker };
+}
+
+double TaskGraph::computePriority(uint32_t taskIdx, size_t queueSize) const
+{
+    const SchedulingPolicy::TaskInfo taskInfo {
+        queueSize,
+        m_tasks[taskIdx]->approxQueueSizeBytes(),
+        m_staticDataLoadCosts[taskIdx] ? &m_staticDataLoadCosts[taskIdx] : nullptr
+    };
+    return m_pSchedulingPolicy->priority(taskInfo);
+}
+
+void TaskGraph::finishTask(uint32_t taskIdx)
+{
+    {
+        std::lock_guard l { m_schedulingMutex };
+        if (--m_taskNumWorkers[taskIdx] == 0)
+            m_numExecutingTasks--;
+    }
+    markDirty(taskIdx);
+    // The task may have processed the last in-flight items (markDirty does not notify if the task was already dirty).
+    notifySchedulers();
+}
+
+bool TaskGraph::acceptsWorker(uint32_t taskIdx, size_t queueSize) const
+{
+    if (m_executionMode == ExecutionMode::Flush)
+        return m_taskNumWorkers[taskIdx] == 0;
+    else
+        return queueSize > m_taskNumWorkers[taskIdx] * minItemsPerWorker;
+}
+
+void TaskGraph::prefetchStaticData(uint32_t currentTaskIdx)
+{
+    OPTICK_EVENT();
+
+    // Predict that the tasks with the highest priority will be executed after the current task
+    std::vector<std::pair<double, const TaskBase*>> prioritizedCandidates;
+    {
+        std::lock_guard l { m_schedulingMutex };
+        for (uint32_t taskIdx = 0; taskIdx < static_cast<uint32_t>(m_tasks.size()); taskIdx++) {
+            if (taskIdx != currentTaskIdx && m_tasks[taskIdx]->hasStaticData() && m_taskPriorities.contains(taskIdx))
+                prioritizedCandidates.push_back({ m_taskPriorities.key(taskIdx).first, m_tasks[taskIdx].get() });
+        }
+    }
+    const size_t numCandidates = std::min(prioritizedCandidates.size(), static_cast<size_t>(m_numPrefetchTasks));
+    std::partial_sort(std::begin(prioritizedCandidates), std::begin(prioritizedCandidates) + numCandidates, std::end(prioritizedCandidates),
+        [](const auto& lhs, const auto& rhs) {
+            return lhs.first > rhs.first;
+        });
+    std::vector<const TaskBase*> candidates;
+    for (size_t i = 0; i < numCandidates; i++)
+        candidates.push_back(prioritizedCandidates[i].second);
+
+    std::vector<PrefetchedStaticData> releasedStaticData;
+    {
+        std::lock_guard l { m_prefetchMutex };
+
+        // Release static data of tasks that are no longer expected to execute soon (if it has finished loading). Only
+        //  check for completion under the lock; the static data is destroyed after releasing it.
+        for (auto iter = std::begin(m_prefetchedStaticData); iter != std::end(m_prefetchedStaticData);) {
+            const bool isCandidate = std::find(std::begin(candidates), std::end(candidates), iter->pTask) != std::end(candidates);
+            if (!isCandidate && iter->pLoad->staticData.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                releasedStaticData.push_back(std::move(*iter));
+                iter = m_prefetchedStaticData.erase(iter);
+            } else {
+                iter++;
+            }
+        }
+
+        for (const TaskBase* pTask : candidates) {
+            if (m_prefetchedStaticData.size() >= m_numPrefetchTasks)
+                break;
+
+            const bool alreadyPrefetched = std::any_of(std::begin(m_prefetchedStaticData), std::end(m_prefetchedStaticData),
+                [&](const PrefetchedStaticData& prefetchedStaticData) { return prefetchedStaticData.pTask == pTask; });
+            if (alreadyPrefetched)
+                continue;
+
+            // Load as a task in the arena (so that the loader runs on a worker thread which can use nested parallelism).
+            auto pLoad = std::make_shared<StaticDataLoad>(pTask);
+            m_taskArena.enqueue([pLoad]() {
+                Optick::tryRegisterThreadWithOptick();
+                pLoad->run();
+            });
+            m_prefetchedStaticData.push_back({ pTask, std::move(pLoad) });
+        }
+    }
+
+    for (auto& [pTask, pLoad] : releasedStaticData)
+        pTask->destroyStaticData(std::pmr::new_delete_resource(), pLoad->staticData.get());
+}
+
+std::optional<void*> TaskGraph::takePrefetchedStaticData(const TaskBase* pTask)
+{
+    std::shared_ptr<StaticDataLoad> pLoad;
+    {
+        std::lock_guard l { m_prefetchMutex };
+        auto iter = std::find_if(std::begin(m_prefetchedStaticData), std::end(m_prefetchedStaticData),
+            [&](const PrefetchedStaticData& prefetchedStaticData) { return prefetchedStaticData.pTask == pTask; });
+        if (iter == std::end(m_prefetchedStaticData))
+            return {};
+
+        pLoad = std::move(iter->pLoad);
+        m_prefetchedStaticData.erase(iter);
+    }
+
+    // Load the static data ourselves if no worker has picked up the load yet; waiting for it could deadlock when all
+    // worker threads are waiting for static data.
+    pLoad->run();
+    return pLoad->staticData.get();
+}
+
+void TaskGraph::releasePrefetchedStaticData()
+{
+    std::vector<PrefetchedStaticData> releasedStaticData;
+    {
+        std::lock_guard l { m_prefetchMutex };
+        std::swap(releasedStaticData, m_prefetchedStaticData);
+    }
+
+    for (auto& [pTask, pLoad] : releasedStaticData) {
+        pLoad->run();
+        pTask->destroyStaticData(std::pmr::new_delete_resource(), pLoad->staticData.get());
+    }
+}
+
+TaskGraph::StaticDataLoad::StaticDataLoad(const TaskBase* pTask)
+    : pTask(pTask)
+    , staticData(promise.get_future())
+{
+}
+
+void TaskGraph::StaticDataLoad::run()
+{
+    if (started.test_and_set())
+        return;
+
+    try {
+        promise.set_value(pTask->loadStaticData(std::pmr::new_delete_resource()));
+    } catch (...) {
+        promise.set_exception(std::current_exception());
+    }
 }
 
 size_t TaskGraph::approxMemoryUsage() const
@@ -73,6 +505,64 @@ size_t TaskGraph::approxQueuedItems() const
     return queuedItems;
 }
 
+void TaskGraph::setMemoryBudget(size_t maxQueuedBytes)
+{
+    assert(!m_inTaskArena && allQueuesEmpty());
+    m_trackQueuedBytes = true;
+    m_memoryBudget = maxQueuedBytes;
+    m_queuedBytes.store(0);
+}
+
+void TaskGraph::setDeferredWorkCallback(std::function<bool()> callback)
+{
+    assert(!m_inTaskArena);
+    m_deferredWorkCallback = std::move(callback);
+}
+
+bool TaskGraph::overMemoryBudget() const
+{
+    return m_queuedBytes.load(std::memory_order_relaxed) > m_memoryBudget;
+}
+
+bool TaskGraph::resumeDeferredWork()
+{
+    if (m_deferredWorkCallback)
+        return m_deferredWorkCallback();
+    else
+        return false;
+}
+
+void TaskGraph::enableSpilling(size_t maxInMemoryBytes, SerializerFactory serializerFactory, size_t spillChunkBytes)
+{
+    assert(!m_inTaskArena && allQueuesEmpty());
+    m_trackQueuedBytes = true;
+    m_queuedBytes.store(0);
+    m_spillThreshold = maxInMemoryBytes;
+    m_spillChunkBytes = spillChunkBytes;
+    m_spillSerializerFactory = std::move(serializerFactory);
+}
+
+size_t TaskGraph::approxSpilledItems() const
+{
+    size_t spilledItems = 0;
+    for (const auto& pTask : m_tasks) {
+        spilledItems += pTask->approxSpilledItems();
+    }
+    return spilledItems;
+}
+
+void TaskGraph::addQueuedBytes(size_t numBytes)
+{
+    if (m_trackQueuedBytes)
+        m_queuedBytes.fetch_add(numBytes, std::memory_order_relaxed);
+}
+
+void TaskGraph::removeQueuedBytes(size_t numBytes)
+{
+    if (m_trackQueuedBytes)
+        m_queuedBytes.fetch_sub(numBytes, std::memory_order_relaxed);
+}
+
 bool TaskGraph::allQueuesEmpty() const
 {
     for (const auto& pTask : m_tasks) {
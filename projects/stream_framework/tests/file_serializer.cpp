@@ -50,3 +50,87 @@ TEST(SplitFileSerializer, WriteNoUnmap)
         ASSERT_EQ(*pInt, i);
     }
 }
+
+TEST(SplitFileSerializer, PersistentMappings)
+{
+    std::vector<tasking::Allocation> allocations;
+
+    std::unique_ptr<tasking::Deserializer> pDeserializer;
+    {
+        // Allocations are larger than a page and spread over multiple files.
+        constexpr size_t numInts = 3000;
+        tasking::SplitFileSerializer serializer { "TEST_PersistentMappings", 4 * numInts * sizeof(int), mio_cache_control::cache_mode::random_access, tasking::FileReadBackend::PersistentMapping };
+        for (int i = 0; i < 16; i++) {
+            auto [allocation, pMemory] = serializer.allocateAndMap(numInts * sizeof(int));
+            int* pInts = reinterpret_cast<int*>(pMemory);
+            for (size_t j = 0; j < numInts; j++)
+                pInts[j] = i + static_cast<int>(j);
+            serializer.unmapPreviousAllocations();
+
+            allocations.push_back(allocation);
+        }
+
+        pDeserializer = serializer.createDeserializer();
+    }
+
+    // Map every allocation twice to check that unmapping (MADV_DONTNEED) does not lose any data.
+    for (int k = 0; k < 2; k++) {
+        for (int i = 15; i >= 0; i--) {
+            const int* pInts = reinterpret_cast<const int*>(pDeserializer->map(allocations[i]));
+            ASSERT_EQ(pInts[0], i);
+            ASSERT_EQ(pInts[2999], i + 2999);
+            pDeserializer->unmap(pInts);
+        }
+    }
+}
+
+#ifdef __linux__
+TEST(SplitFileSerializer, IoUring)
+{
+    std::vector<tasking::Allocation> allocations;
+
+    std::unique_ptr<tasking::Deserializer> pDeserializer;
+    {
+        // Allocation sizes that are not a multiple of the block size so that reads start at unaligned offsets.
+        constexpr size_t numInts = 1001;
+        tasking::SplitFileSerializer serializer { "TEST_IoUring", 4 * numInts * sizeof(int), mio_cache_control::cache_mode::no_buffering, tasking::FileReadBackend::IoUring };
+        for (int i = 0; i < 16; i++) {
+            auto [allocation, pMemory] = serializer.allocateAndMap(numInts * sizeof(int));
+            int* pInts = reinterpret_cast<int*>(pMemory);
+            for (size_t j = 0; j < numInts; j++)
+                pInts[j] = i + static_cast<int>(j);
+            serializer.unmapPreviousAllocations();
+
+            allocations.push_back(allocation);
+        }
+
+        pDeserializer = serializer.createDeserializer();
+    }
+
+    // Submit half of the allocations ahead of time (and one of them twice), the others are read on demand.
+    for (int i = 0; i < 16; i += 2)
+        pDeserializer->submit(allocations[i]);
+    pDeserializer->submit(allocations[0]);
+
+    for (int i = 0; i < 16; i++) {
+        const int* pInts = reinterpret_cast<const int*>(pDeserializer->map(allocations[i]));
+        ASSERT_EQ(pInts[0], i);
+        ASSERT_EQ(pInts[1000], i + 1000);
+        pDeserializer->unmap(pInts);
+    }
+
+    // Cancelled requests release their buffer; mapping the allocation afterwards reads it again.
+    pDeserializer->submit(allocations[5]);
+    pDeserializer->cancel(allocations[5]);
+    pDeserializer->cancel(allocations[7]); // Never submitted
+    {
+        const int* pInts = reinterpret_cast<const int*>(pDeserializer->map(allocations[5]));
+        ASSERT_EQ(pInts[0], 5);
+        ASSERT_EQ(pInts[1000], 5 + 1000);
+        pDeserializer->unmap(pInts);
+    }
+
+    // Submitted but never mapped; the deserializer should clean it up.
+    pDeserializer->submit(allocations[3]);
+}
+#endif
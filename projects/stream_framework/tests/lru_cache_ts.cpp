@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 #include <random>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <tbb/parallel_for.h>
 #include <thread>
 #include <vector>
@@ -166,6 +167,106 @@ TEST(LRUCacheTS, EvictionHoldItems)
     }
 }
 
+// The cache fits numResident of the (non-resident after registration) items.
+static tasking::LRUCacheTS createClockTestCache(std::vector<DummyDataTS>& data, size_t numResident)
+{
+    tasking::LRUCacheTS::Builder builder { std::make_unique<tasking::InMemorySerializer>() };
+    for (auto& d : data)
+        builder.registerCacheable(&d);
+    return builder.build(data.size() * sizeof(DummyDataTS) + numResident * 1000);
+}
+
+static std::vector<int> residentItems(std::span<const DummyDataTS> data)
+{
+    std::vector<int> out;
+    for (int i = 0; i < static_cast<int>(data.size()); i++) {
+        if (data[i].isResident())
+            out.push_back(i);
+    }
+    return out;
+}
+
+TEST(LRUCacheTS, ClockEvictionOrder)
+{
+    std::vector<DummyDataTS> data;
+    for (int i = 0; i < 8; i++)
+        data.push_back(DummyDataTS(i));
+    auto cache = createClockTestCache(data, 4);
+
+    for (int i = 0; i < 4; i++)
+        cache.makeResident(&data[i]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 0, 1, 2, 3 }));
+
+    // The first sweep marks all items, after which they are evicted in the order that the clock hand passes them.
+    cache.makeResident(&data[4]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 1, 2, 3, 4 }));
+    cache.makeResident(&data[5]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 2, 3, 4, 5 }));
+    cache.makeResident(&data[6]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 3, 4, 5, 6 }));
+    ASSERT_LE(cache.memoryUsage(), cache.maxSize());
+}
+
+TEST(LRUCacheTS, ClockEvictionSecondChance)
+{
+    std::vector<DummyDataTS> data;
+    for (int i = 0; i < 8; i++)
+        data.push_back(DummyDataTS(i));
+    auto cache = createClockTestCache(data, 4);
+
+    for (int i = 0; i < 5; i++)
+        cache.makeResident(&data[i]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 1, 2, 3, 4 }));
+
+    // Accessing item 1 clears its mark (reference bit) so the hand skips it once.
+    ASSERT_EQ(cache.makeResident(&data[1])->value, 1);
+    cache.makeResident(&data[5]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 1, 3, 4, 5 }));
+    cache.makeResident(&data[6]);
+    cache.makeResident(&data[7]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 1, 5, 6, 7 }));
+
+    // Item 1 was marked again when the hand passed it and was not accessed since.
+    cache.makeResident(&data[0]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 0, 5, 6, 7 }));
+}
+
+TEST(LRUCacheTS, ClockEvictionSkipsPinnedItems)
+{
+    std::vector<DummyDataTS> data;
+    for (int i = 0; i < 8; i++)
+        data.push_back(DummyDataTS(i));
+    auto cache = createClockTestCache(data, 4);
+
+    std::vector<tasking::CachedPtr<DummyDataTS>> pinnedItems;
+    for (int i = 0; i < 4; i++)
+        pinnedItems.push_back(cache.makeResident(&data[i]));
+
+    // Nothing can be evicted: the cache goes over budget rather than evicting pinned items.
+    cache.makeResident(&data[4]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 0, 1, 2, 3, 4 }));
+    ASSERT_GT(cache.memoryUsage(), cache.maxSize());
+
+    // Only the unpinned item is evicted.
+    cache.makeResident(&data[5]);
+    ASSERT_EQ(residentItems(data), std::vector<int>({ 0, 1, 2, 3, 5 }));
+    for (int i = 0; i < 4; i++)
+        ASSERT_EQ(pinnedItems[i]->value, i);
+
+    pinnedItems.clear();
+    cache.makeResident(&data[6]);
+    ASSERT_TRUE(data[6].isResident());
+    ASSERT_LE(cache.memoryUsage(), cache.maxSize());
+}
+
+TEST(LRUCacheTS, RegisterTwiceThrows)
+{
+    DummyDataTS item { 0 };
+    tasking::LRUCacheTS::Builder builder { std::make_unique<tasking::InMemorySerializer>() };
+    builder.registerCacheable(&item);
+    ASSERT_THROW(builder.registerCacheable(&item), std::runtime_error);
+}
+
 TEST(LRUCacheTS, MultithreadedSum)
 {
     const int numItems = 100000;
@@ -239,3 +340,65 @@ TEST(LRUCacheTS, MultithreadedAccess)
     for (int answer : answers)
         ASSERT_EQ(answer, refSum);
 }
+
+struct PrefetchDummyDataTS : public DummyDataTS {
+    std::atomic_int* pNumSubmitted;
+
+    PrefetchDummyDataTS(int v, std::atomic_int* pNumSubmitted)
+        : DummyDataTS(v)
+        , pNumSubmitted(pNumSubmitted)
+    {
+    }
+
+    void doSubmitLoad(tasking::Deserializer&) override
+    {
+        // Widen the window in which the item is in the Prefetching state
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        pNumSubmitted->fetch_add(1);
+    }
+};
+
+TEST(LRUCacheTS, MultithreadedPrefetchAndAccess)
+{
+    const int numItems = 16;
+
+    std::atomic_int numSubmitted = 0;
+    std::vector<PrefetchDummyDataTS> data;
+    for (int i = 0; i < numItems; i++)
+        data.push_back(PrefetchDummyDataTS(i, &numSubmitted));
+
+    tasking::LRUCacheTS::Builder builder { std::make_unique<tasking::InMemorySerializer>() };
+    for (auto& d : data)
+        builder.registerCacheable(&d, true);
+
+    // Only a few items fit into memory so that evictMarked is constantly evicting items and cancelling prefetches.
+    const size_t maxMemory = 4 * 1100;
+    auto cache = builder.build(maxMemory);
+
+    // Every thread prefetches and accesses the same (small) set of items so that prefetch, makeResident and
+    // eviction race on the state of the same item.
+    static constexpr size_t numThreads = 4;
+    std::atomic_int numFailures = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rng { static_cast<unsigned>(t) };
+            std::uniform_int_distribution<int> itemDist(0, numItems - 1);
+            for (int i = 0; i < 5000; i++) {
+                cache.prefetch(&data[itemDist(rng)]);
+
+                const int itemIndex = itemDist(rng);
+                auto pOwner = cache.makeResident(&data[itemIndex]);
+                if (!pOwner->isResident() || pOwner->value != itemIndex)
+                    numFailures.fetch_add(1);
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    ASSERT_EQ(numFailures.load(), 0);
+    // Make sure that the test does not pass trivially
+    ASSERT_GT(numSubmitted.load(), 0);
+}
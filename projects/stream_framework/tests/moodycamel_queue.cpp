@@ -4,6 +4,7 @@
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_for.h>
 #include <tbb/task_group.h>
+#include <thread>
 #include <vector>
 
 struct Data {
@@ -32,6 +33,61 @@ TEST(MoodyCamelQueue, SingleThreaded)
         ASSERT_TRUE(visited[i]);
 }
 
+TEST(MoodyCamelQueue, SingleThreadedBulk)
+{
+    tasking::MoodyCamelQueue<Data> queue {};
+
+    constexpr int numItems = 10000;
+    std::vector<Data> items;
+    for (int i = 0; i < numItems; i++)
+        items.push_back(Data { i });
+    queue.push_bulk(items);
+
+    std::vector<bool> visited;
+    visited.resize(numItems);
+    std::fill(std::begin(visited), std::end(visited), false);
+
+    std::vector<Data> outItems(256);
+    while (size_t numPopped = queue.try_pop_bulk(outItems)) {
+        for (size_t i = 0; i < numPopped; i++)
+            visited[outItems[i].i] = true;
+    }
+
+    for (int i = 0; i < numItems; i++)
+        ASSERT_TRUE(visited[i]);
+}
+
+TEST(MoodyCamelQueue, ThreadIndicesAreReused)
+{
+    // Threads that come and go (e.g. file I/O threads) should not exhaust the per-thread token table
+    const int mainThreadIdx = tasking::detail::queueThreadIndex();
+    std::vector<int> indices;
+    for (int i = 0; i < 100; i++) {
+        std::thread thread([&]() {
+            indices.push_back(tasking::detail::queueThreadIndex());
+        });
+        thread.join();
+    }
+    for (int idx : indices) {
+        ASSERT_NE(idx, mainThreadIdx);
+        ASSERT_EQ(idx, indices[0]);
+    }
+
+    // Two live threads never share an index
+    std::atomic_int otherIdx { -1 };
+    std::atomic_bool done { false };
+    std::thread thread([&]() {
+        otherIdx = tasking::detail::queueThreadIndex();
+        while (!done)
+            std::this_thread::yield();
+    });
+    while (otherIdx == -1)
+        std::this_thread::yield();
+    ASSERT_NE(otherIdx.load(), mainThreadIdx);
+    done = true;
+    thread.join();
+}
+
 TEST(MoodyCamelQueue, MultiProducerSingleConsumer)
 {
     constexpr int numItems = 20000;
@@ -0,0 +1,52 @@
+#include "stream/scratch_memory_resource.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory_resource>
+#include <vector>
+
+TEST(ScratchMemoryResource, Alignment)
+{
+    tasking::ScratchMemoryResource memoryResource { 1024 };
+
+    for (size_t alignment : { 1, 2, 4, 8, 16, 32, 64 }) {
+        void* pMemory = memoryResource.allocate(3, alignment);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(pMemory) % alignment, 0);
+    }
+}
+
+TEST(ScratchMemoryResource, Rewind)
+{
+    tasking::ScratchMemoryResource memoryResource { 1024 };
+
+    const auto marker = memoryResource.mark();
+    void* pFirst = memoryResource.allocate(16, 16);
+    {
+        // Nested user
+        const auto nestedMarker = memoryResource.mark();
+        void* pSecond = memoryResource.allocate(16, 16);
+        ASSERT_NE(pFirst, pSecond);
+        memoryResource.rewind(nestedMarker);
+        ASSERT_EQ(memoryResource.allocate(16, 16), pSecond);
+    }
+    memoryResource.rewind(marker);
+    ASSERT_EQ(memoryResource.allocate(16, 16), pFirst);
+}
+
+TEST(ScratchMemoryResource, Grow)
+{
+    tasking::ScratchMemoryResource memoryResource { 1024 };
+
+    for (int i = 0; i < 2; i++) {
+        const auto marker = memoryResource.mark();
+        std::pmr::vector<int> data { &memoryResource };
+        for (int j = 0; j < 10000; j++)
+            data.push_back(j);
+        for (int j = 0; j < 10000; j++)
+            ASSERT_EQ(data[j], j);
+        data = {};
+        memoryResource.rewind(marker);
+    }
+
+    // Buffer should have grown to fit all allocations made by the vector
+    ASSERT_GE(memoryResource.capacity(), 10000 * sizeof(int));
+}
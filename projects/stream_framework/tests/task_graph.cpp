@@ -1,7 +1,11 @@
 #include "stream/task_graph.h"
 #include "stream/cache/lru_cache.h"
 #include "stream/serialize/dummy_serializer.h"
+#include "stream/serialize/file_serializer.h"
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
 #include <gtest/gtest.h>
 #include <random>
 #include <tuple>
@@ -114,6 +118,58 @@ TEST(TaskGraph, StaticData)
         ASSERT_EQ(output[i], i + 2);
 }
 
+TEST(TaskGraph, PrefetchStaticData)
+{
+    constexpr int range = 1024;
+    constexpr int numTasks = 8;
+
+    std::atomic_int numLoads { 0 };
+    std::atomic_int numAlive { 0 };
+    struct StaticData {
+        int adder;
+        std::shared_ptr<void> lifetimeToken;
+    };
+
+    std::vector<int> output;
+    output.resize(range, 0);
+
+    tasking::TaskGraph g { 1, 2 };
+    std::vector<tasking::TaskHandle<int>> tasks;
+    for (int t = 0; t < numTasks; t++) {
+        tasks.push_back(g.addTask<int, StaticData>(
+            "task",
+            [&, t]() {
+                numLoads++;
+                numAlive++;
+                return StaticData { t, std::shared_ptr<void>(nullptr, [&](void*) { numAlive--; }) };
+            },
+            [&, t](std::span<const int> numbers, const StaticData* pStaticData, std::pmr::memory_resource* pMemoryResource) {
+                for (const int number : numbers) {
+                    output[number] += pStaticData->adder;
+                    if (t + 1 < numTasks)
+                        g.enqueue(tasks[t + 1], number);
+                }
+            }));
+    }
+
+    // Fill multiple queues so that there are tasks to prefetch
+    for (int i = 0; i < range; i++)
+        g.enqueue(tasks[i % numTasks], i);
+
+    g.run();
+
+    for (int i = 0; i < range; i++) {
+        int expected = 0;
+        for (int t = i % numTasks; t < numTasks; t++)
+            expected += t;
+        ASSERT_EQ(output[i], expected);
+    }
+
+    // All static data (including data that was prefetched but not used) should have been released
+    ASSERT_GT(numLoads.load(), 0);
+    ASSERT_EQ(numAlive.load(), 0);
+}
+
 TEST(TaskGraph, CachedStaticData)
 {
     constexpr size_t range = 1024;
@@ -196,3 +252,370 @@ TEST(TaskGraph, CachedStaticData)
     for (int i = 0; i < range; i++)
         ASSERT_EQ(output[i], 123 + i);
 }
+
+TEST(TaskGraph, SchedulingPolicy)
+{
+    // Task A has more work but its static data is not resident so the cost model should execute task B first.
+    auto runTasks = [](std::unique_ptr<tasking::SchedulingPolicy> pPolicy) {
+        std::vector<char> order;
+        tasking::TaskGraph g;
+        g.setSchedulingPolicy(std::move(pPolicy));
+        auto taskA = g.addTask<int>(
+            "A", [&](std::span<const int>, std::pmr::memory_resource*) {
+                if (order.empty() || order.back() != 'A')
+                    order.push_back('A');
+            });
+        auto taskB = g.addTask<int>(
+            "B", [&](std::span<const int>, std::pmr::memory_resource*) {
+                if (order.empty() || order.back() != 'B')
+                    order.push_back('B');
+            });
+        g.setStaticDataLoadCost(taskA, []() -> size_t { return 1024 * 1024 * 1024; });
+        g.setStaticDataLoadCost(taskB, []() -> size_t { return 0; });
+
+        for (int i = 0; i < 8; i++)
+            g.enqueue(taskA, i);
+        for (int i = 0; i < 4; i++)
+            g.enqueue(taskB, i);
+        g.run();
+        return order;
+    };
+
+    ASSERT_EQ(runTasks(std::make_unique<tasking::LargestQueuePolicy>()), std::vector<char>({ 'A', 'B' }));
+    ASSERT_EQ(runTasks(std::make_unique<tasking::PreferResidentPolicy>()), std::vector<char>({ 'B', 'A' }));
+    ASSERT_EQ(runTasks(std::make_unique<tasking::CostModelPolicy>()), std::vector<char>({ 'B', 'A' }));
+}
+
+TEST(TaskGraph, SchedulingPolicyStaleLoadCost)
+{
+    // Task C evicts the static data of task A while A is waiting in the priority queue. A's priority (computed while
+    // its data was resident) is then stale and should be recomputed, so that B executes before A.
+    std::vector<char> order;
+    size_t bytesToLoadA = 0;
+    tasking::TaskGraph g;
+    g.setSchedulingPolicy(std::make_unique<tasking::PreferResidentPolicy>());
+    auto taskA = g.addTask<int>(
+        "A", [&](std::span<const int>, std::pmr::memory_resource*) {
+            if (order.empty() || order.back() != 'A')
+                order.push_back('A');
+        });
+    auto taskB = g.addTask<int>(
+        "B", [&](std::span<const int>, std::pmr::memory_resource*) {
+            if (order.empty() || order.back() != 'B')
+                order.push_back('B');
+        });
+    auto taskC = g.addTask<int>(
+        "C", [&](std::span<const int>, std::pmr::memory_resource*) {
+            if (order.empty() || order.back() != 'C')
+                order.push_back('C');
+            bytesToLoadA = 1024 * 1024 * 1024;
+        });
+    g.setStaticDataLoadCost(taskA, [&]() { return bytesToLoadA; });
+    g.setStaticDataLoadCost(taskB, []() -> size_t { return 0; });
+    g.setStaticDataLoadCost(taskC, []() -> size_t { return 0; });
+
+    for (int i = 0; i < 8; i++)
+        g.enqueue(taskA, i);
+    for (int i = 0; i < 4; i++)
+        g.enqueue(taskB, i);
+    for (int i = 0; i < 16; i++)
+        g.enqueue(taskC, i);
+    g.run();
+
+    ASSERT_EQ(order, std::vector<char>({ 'C', 'B', 'A' }));
+}
+
+TEST(TaskGraph, IndexedPriorityQueue)
+{
+    std::mt19937 rng { 12345 };
+    std::uniform_int_distribution<int> keyDistribution { 0, 1000 };
+    std::uniform_int_distribution<uint32_t> indexDistribution { 0, 63 };
+
+    tasking::IndexedPriorityQueue<int> queue;
+    queue.resize(64);
+    std::vector<std::optional<int>> reference(64);
+    for (int i = 0; i < 10000; i++) {
+        const uint32_t index = indexDistribution(rng);
+        if (i % 3 == 0) {
+            queue.erase(index);
+            reference[index].reset();
+        } else {
+            const int key = keyDistribution(rng);
+            queue.update(index, key);
+            reference[index] = key;
+        }
+
+        const size_t referenceSize = std::count_if(std::begin(reference), std::end(reference), [](const auto& optKey) { return optKey.has_value(); });
+        ASSERT_EQ(queue.size(), referenceSize);
+        if (referenceSize > 0) {
+            const int maxKey = **std::max_element(std::begin(reference), std::end(reference));
+            ASSERT_EQ(queue.key(queue.top()), maxKey);
+        }
+    }
+}
+
+TEST(TaskGraph, MemoryBudget)
+{
+    constexpr int numItems = 100000;
+    constexpr int itemsPerSpawn = 64;
+    constexpr size_t memoryBudget = 1024 * sizeof(int);
+
+    std::atomic_int numProcessed { 0 };
+    std::atomic_int numSpawned { 0 };
+    std::atomic_size_t maxQueuedItems { 0 };
+
+    tasking::TaskGraph g;
+    g.setMemoryBudget(memoryBudget);
+    auto task = g.addTask<int>(
+        "task",
+        [&](std::span<const int> numbers, std::pmr::memory_resource* pMemoryResource) {
+            numProcessed.fetch_add(static_cast<int>(numbers.size()));
+        });
+
+    // Producer that only spawns new items while the queued items fit in the budget
+    auto spawn = [&]() {
+        bool spawned = false;
+        while (!g.overMemoryBudget()) {
+            const int start = numSpawned.fetch_add(itemsPerSpawn);
+            if (start >= numItems)
+                break;
+            for (int i = start; i < std::min(start + itemsPerSpawn, numItems); i++)
+                g.enqueue(task, i);
+            spawned = true;
+
+            size_t queuedItems = g.approxQueuedItems();
+            size_t prevMax = maxQueuedItems.load();
+            while (queuedItems > prevMax && !maxQueuedItems.compare_exchange_weak(prevMax, queuedItems))
+                ;
+        }
+        return spawned;
+    };
+    g.setDeferredWorkCallback(spawn);
+    spawn();
+    g.run();
+
+    ASSERT_EQ(numProcessed.load(), numItems);
+    ASSERT_LE(maxQueuedItems.load() * sizeof(int), memoryBudget + itemsPerSpawn * sizeof(int));
+}
+
+TEST(TaskGraph, SpillToDisk)
+{
+    constexpr int numItems = 100000;
+    constexpr size_t chunkSize = 1024;
+
+    std::vector<int> output;
+    output.resize(numItems, 0);
+
+    tasking::TaskGraph g;
+    int numSerializers = 0;
+    g.enableSpilling(
+        4 * chunkSize * sizeof(int),
+        [&]() {
+            const std::string folderName = fmt::format("stream_test_spill_{}", numSerializers++);
+            return std::make_unique<tasking::SplitFileSerializer>(folderName, 64 * chunkSize * sizeof(int));
+        },
+        chunkSize * sizeof(int));
+    auto task = g.addTask<int>(
+        "task",
+        [&](std::span<const int> numbers, std::pmr::memory_resource* pMemoryResource) {
+            for (const int number : numbers)
+                output[number]++;
+        });
+
+    for (int i = 0; i < numItems; i++)
+        g.enqueue(task, i);
+    ASSERT_GT(g.approxSpilledItems(), 0);
+    ASSERT_EQ(g.approxQueuedItems(), numItems);
+
+    g.run();
+
+    ASSERT_EQ(g.approxSpilledItems(), 0);
+    for (int i = 0; i < numItems; i++)
+        ASSERT_EQ(output[i], 1);
+}
+
+TEST(TaskGraph, NumaAwareness)
+{
+    constexpr int range = 1024;
+    constexpr int numTasks = 4;
+
+    struct StaticData {
+        int adder;
+    };
+
+    std::vector<int> output;
+    output.resize(range, 0);
+
+    tasking::TaskGraph g { 2 };
+    ASSERT_GE(g.enableNumaAwareness(), 1u);
+
+    auto finalTask = g.addTask<int>(
+        "final",
+        [&](std::span<const int> numbers, std::pmr::memory_resource* pMemoryResource) {
+            for (const int number : numbers)
+                output[number] += 1;
+        });
+    std::vector<tasking::TaskHandle<int>> tasks;
+    for (int t = 0; t < numTasks; t++) {
+        tasks.push_back(g.addTask<int, StaticData>(
+            fmt::format("task{}", t),
+            [=]() {
+                return StaticData { t };
+            },
+            [&, t](std::span<const int> numbers, const StaticData* pStaticData, std::pmr::memory_resource* pMemoryResource) {
+                for (const int number : numbers) {
+                    output[number] += pStaticData->adder;
+                    g.enqueue(finalTask, number);
+                }
+            }));
+    }
+
+    for (int i = 0; i < range; i++)
+        g.enqueue(tasks[i % numTasks], i);
+
+    g.run();
+
+    for (int i = 0; i < range; i++)
+        ASSERT_EQ(output[i], i % numTasks + 1);
+}
+
+TEST(TaskGraph, ConcurrentTasks)
+{
+    constexpr int range = 4096;
+    constexpr int numTasks = 8;
+    constexpr int numHops = 4;
+
+    struct StaticData {
+        std::shared_ptr<void> lifetimeToken;
+    };
+
+    std::vector<std::atomic_int> numHopsPerItem(range);
+    std::vector<std::atomic_int> numExecuting(numTasks);
+    std::atomic_bool executedConcurrentlyWithItself { false };
+
+    tasking::TaskGraph g { 4 };
+    std::vector<tasking::TaskHandle<std::pair<int, int>>> tasks;
+    for (int t = 0; t < numTasks; t++) {
+        tasks.push_back(g.addTask<std::pair<int, int>, StaticData>(
+            fmt::format("task{}", t),
+            [&, t]() {
+                // Static data is loaded once per execution so this detects the same task executing twice at once.
+                if (numExecuting[t].fetch_add(1) != 0)
+                    executedConcurrentlyWithItself.store(true);
+                return StaticData { std::shared_ptr<void>(nullptr, [&, t](void*) { numExecuting[t].fetch_sub(1); }) };
+            },
+            [&, t](std::span<const std::pair<int, int>> items, const StaticData*, std::pmr::memory_resource*) {
+                for (const auto& [item, hop] : items) {
+                    numHopsPerItem[item].fetch_add(1);
+                    if (hop + 1 < numHops)
+                        g.enqueue(tasks[(t + item) % numTasks], std::pair { item, hop + 1 });
+                }
+            }));
+    }
+
+    for (int i = 0; i < range; i++)
+        g.enqueue(tasks[i % numTasks], std::pair { i, 0 });
+
+    g.run();
+
+    ASSERT_FALSE(executedConcurrentlyWithItself.load());
+    ASSERT_EQ(g.approxQueuedItems(), 0);
+    for (int i = 0; i < range; i++)
+        ASSERT_EQ(numHopsPerItem[i].load(), numHops);
+}
+
+TEST(TaskGraph, ContinuousExecution)
+{
+    constexpr int range = 16 * 1024;
+    constexpr int numTasks = 8;
+    constexpr int numHops = 4;
+
+    struct StaticData {
+        int taskIdx;
+        std::shared_ptr<void> lifetimeToken;
+    };
+
+    std::vector<std::atomic_int> numHopsPerItem(range);
+    std::atomic_int numAlive { 0 };
+    std::atomic_bool wrongStaticData { false };
+
+    tasking::TaskGraph g;
+    g.setExecutionMode(tasking::TaskGraph::ExecutionMode::Continuous);
+    std::vector<tasking::TaskHandle<std::pair<int, int>>> tasks;
+    for (int t = 0; t < numTasks; t++) {
+        tasks.push_back(g.addTask<std::pair<int, int>, StaticData>(
+            fmt::format("task{}", t),
+            [&, t]() {
+                numAlive.fetch_add(1);
+                return StaticData { t, std::shared_ptr<void>(nullptr, [&](void*) { numAlive.fetch_sub(1); }) };
+            },
+            [&, t](std::span<const std::pair<int, int>> items, const StaticData* pStaticData, std::pmr::memory_resource*) {
+                if (pStaticData->taskIdx != t)
+                    wrongStaticData.store(true);
+                for (const auto& [item, hop] : items) {
+                    numHopsPerItem[item].fetch_add(1);
+                    if (hop + 1 < numHops)
+                        g.enqueue(tasks[(t + item) % numTasks], std::pair { item, hop + 1 });
+                }
+            }));
+    }
+
+    for (int i = 0; i < range; i++)
+        g.enqueue(tasks[i % numTasks], std::pair { i, 0 });
+
+    g.run();
+
+    ASSERT_FALSE(wrongStaticData.load());
+    ASSERT_EQ(numAlive.load(), 0);
+    ASSERT_EQ(g.approxQueuedItems(), 0);
+    for (int i = 0; i < range; i++)
+        ASSERT_EQ(numHopsPerItem[i].load(), numHops);
+}
+
+TEST(TaskGraph, ContinuousExecutionDeferredWork)
+{
+    constexpr int numItems = 64 * 1024;
+    constexpr int itemsPerSpawn = 256;
+    constexpr size_t memoryBudget = 4 * itemsPerSpawn * sizeof(int);
+
+    std::atomic_int numProcessed { 0 };
+    std::atomic_int numSpawned { 0 };
+    std::atomic_int numInCallback { 0 };
+    std::atomic_bool callbackRanConcurrently { false };
+
+    tasking::TaskGraph g;
+    g.setExecutionMode(tasking::TaskGraph::ExecutionMode::Continuous);
+    g.setMemoryBudget(memoryBudget);
+    auto task = g.addTask<int>(
+        "task",
+        [&](std::span<const int> numbers, std::pmr::memory_resource* pMemoryResource) {
+            numProcessed.fetch_add(static_cast<int>(numbers.size()));
+        });
+
+    // Work only becomes available through the deferred work callback; the graph should not finish before all of it
+    // has been produced and processed.
+    auto spawn = [&]() {
+        if (numInCallback.fetch_add(1) != 0)
+            callbackRanConcurrently.store(true);
+
+        bool spawned = false;
+        while (!g.overMemoryBudget()) {
+            const int start = numSpawned.fetch_add(itemsPerSpawn);
+            if (start >= numItems)
+                break;
+            for (int i = start; i < std::min(start + itemsPerSpawn, numItems); i++)
+                g.enqueue(task, i);
+            spawned = true;
+        }
+
+        numInCallback.fetch_sub(1);
+        return spawned;
+    };
+    g.setDeferredWorkCallback(spawn);
+    spawn();
+    g.run();
+
+    ASSERT_FALSE(callbackRanConcurrently.load());
+    ASSERT_EQ(numProcessed.load(), numItems);
+    ASSERT_EQ(g.approxQueuedItems(), 0);
+}
@@ -66,11 +66,22 @@ int main(int argc, char** argv)
 		("integrator", po::value<std::string>()->default_value("direct"), "integrator (normal, direct or path)")
 		("spp", po::value<int>()->default_value(1), "samples per pixel")
 		("concurrency", po::value<unsigned>()->default_value(500*1000), "Number of paths traced concurrently")
+		("raymem", po::value<size_t>()->default_value(0), "Memory budget for queued rays (MB); new paths are deferred when exceeded (0 = unlimited)")
+		("rayspill", po::value<size_t>()->default_value(0), "Spill queued rays to disk when they use more than this amount of memory (MB, 0 = disabled)")
 		("schedulers", po::value<unsigned>()->default_value(2), "Number of scheduler tasks spawned concurrently")
+		("prefetch", po::value<unsigned>()->default_value(0), "Number of tasks for which the static data (geometry/BVH) is loaded in the background ahead of time")
+		("execution", po::value<std::string>()->default_value("flush"), "Task execution mode (flush or continuous)")
+		("numa", po::value<bool>()->default_value(false), "Execute tasks in one task arena per NUMA node and pin batching points to a node")
+		("policy", po::value<std::string>()->default_value("largest"), "Task scheduling policy (largest, resident or cost)")
 		("geomcache", po::value<size_t>()->default_value(100 * 1000), "Geometry cache size (MB)")
 		("bvhcache", po::value<size_t>()->default_value(100 * 1000), "Bot level BVH cache size (MB)")
 		("primgroup", po::value<unsigned>()->default_value(1000 * 1000), "Number of primitives per batching point")
 		("svdagres", po::value<unsigned>()->default_value(128), "Resolution of the voxel grid used to create the SVDAG")
+		("sortrays", po::value<bool>()->default_value(false), "Sort the rays of each batch by direction and entry point before bot level traversal")
+		("iouring", po::value<bool>()->default_value(false), "Read geometry from disk using io_uring (Linux only) instead of memory mapping")
+		("scenebundle", po::value<std::string>()->default_value(""), "File in which the batching points and SVDAGs are stored for faster startup of later runs (empty = disabled)")
+		("accel", po::value<std::string>()->default_value("batching"), "Acceleration structure (batching, offline or embree)")
+		("bvhstore", po::value<std::string>()->default_value(""), "Folder in which the bot level BVHs of the offline acceleration structure are kept across runs (empty = disabled)")
 		("help", "show all arguments");
     // clang-format on
 
@@ -98,13 +109,24 @@ int main(int argc, char** argv)
     const unsigned cameraID = vm["cameraid"].as<unsigned>();
     int spp = vm["spp"].as<int>();
     const unsigned concurrency = vm["concurrency"].as<unsigned>();
+    const size_t rayMemoryBudgetMB = vm["raymem"].as<size_t>();
+    const size_t raySpillThresholdMB = vm["rayspill"].as<size_t>();
     const unsigned schedulers = vm["schedulers"].as<unsigned>();
+    const unsigned prefetchTasks = vm["prefetch"].as<unsigned>();
+    const std::string schedulingPolicy = vm["policy"].as<std::string>();
+    const std::string executionMode = vm["execution"].as<std::string>();
+    const bool numaAware = vm["numa"].as<bool>();
     const size_t geomCacheSizeMB = vm["geomcache"].as<size_t>();
     const size_t bvhCacheSizeMB = vm["bvhcache"].as<size_t>();
     const size_t geomCacheSize = geomCacheSizeMB * 1000000;
     const size_t bvhCacheSize = bvhCacheSizeMB * 1000000;
     const unsigned primitivesPerBatchingPoint = vm["primgroup"].as<unsigned>();
     const unsigned svdagRes = vm["svdagres"].as<unsigned>();
+    const bool sortRays = vm["sortrays"].as<bool>();
+    const bool ioUring = vm["iouring"].as<bool>();
+    const std::filesystem::path sceneBundleFile = vm["scenebundle"].as<std::string>();
+    const std::string accelType = vm["accel"].as<std::string>();
+    const std::filesystem::path bvhStoreFolder = vm["bvhstore"].as<std::string>();
 
     std::cout << "Rendering with the following settings:\n";
     std::cout << "  file:           " << vm["file"].as<std::string>() << "\n";
@@ -114,11 +136,22 @@ int main(int argc, char** argv)
     std::cout << "  integrator:     " << vm["integrator"].as<std::string>() << "\n";
     std::cout << "  spp:            " << spp << std::endl;
     std::cout << "  concurrency:    " << concurrency << "\n";
+    std::cout << "  ray memory:     " << rayMemoryBudgetMB << "MB\n";
+    std::cout << "  ray spill:      " << raySpillThresholdMB << "MB\n";
     std::cout << "  schedulers:     " << schedulers << "\n";
+    std::cout << "  prefetch:       " << prefetchTasks << " tasks\n";
+    std::cout << "  policy:         " << schedulingPolicy << "\n";
+    std::cout << "  execution:      " << executionMode << "\n";
+    std::cout << "  numa:           " << (numaAware ? "true" : "false") << "\n";
     std::cout << "  geom cache:     " << geomCacheSizeMB << "MB\n";
     std::cout << "  bot bvh cache:  " << bvhCacheSizeMB << "MB\n";
     std::cout << "  batching point: " << primitivesPerBatchingPoint << " primitives\n";
     std::cout << "  svdag res:      " << svdagRes << "\n";
+    std::cout << "  sort rays:      " << (sortRays ? "true" : "false") << "\n";
+    std::cout << "  io_uring:       " << (ioUring ? "true" : "false") << "\n";
+    std::cout << "  scene bundle:   " << sceneBundleFile.string() << "\n";
+    std::cout << "  accel:          " << accelType << "\n";
+    std::cout << "  bvh store:      " << bvhStoreFolder.string() << "\n";
     std::cout << std::flush;
 
     g_stats.config.sceneFile = vm["file"].as<std::string>();
@@ -128,12 +161,28 @@ int main(int argc, char** argv)
     g_stats.config.integrator = vm["integrator"].as<std::string>();
     g_stats.config.spp = spp;
     g_stats.config.concurrency = concurrency;
+    g_stats.config.rayMemoryBudget = rayMemoryBudgetMB * 1000000;
+    g_stats.config.raySpillThreshold = raySpillThresholdMB * 1000000;
     g_stats.config.schedulers = schedulers;
+    g_stats.config.prefetchTasks = prefetchTasks;
+    g_stats.config.schedulingPolicy = schedulingPolicy;
+    g_stats.config.executionMode = executionMode;
 
     g_stats.config.geomCacheSize = geomCacheSize;
     g_stats.config.bvhCacheSize = bvhCacheSize;
     g_stats.config.primGroupSize = primitivesPerBatchingPoint;
     g_stats.config.svdagRes = svdagRes;
+    g_stats.config.sortRays = sortRays;
+    g_stats.config.ioUring = ioUring;
+
+    if (accelType != "batching" && accelType != "offline" && accelType != "embree") {
+        spdlog::error("Unknown acceleration structure {}", accelType);
+        exit(1);
+    }
+    if (!sceneBundleFile.empty() && accelType != "batching")
+        spdlog::warn("The scene bundle is only used by the batching acceleration structure");
+    if (!bvhStoreFolder.empty() && accelType != "offline")
+        spdlog::warn("The BVH store is only used by the offline acceleration structure");
 
     spdlog::info("Loading scene");
     // WARNING: This cache is not used during rendering when using the batched acceleration structure.
@@ -164,19 +213,47 @@ int main(int argc, char** argv)
     // Store geometry loaded data before we start splitting the large shapes as part of pre-process.
     g_stats.asyncTriggerSnapshot();
 
-    tasking::TaskGraph taskGraph { schedulers };
+    tasking::TaskGraph taskGraph { schedulers, prefetchTasks };
+    if (schedulingPolicy == "resident") {
+        taskGraph.setSchedulingPolicy(std::make_unique<tasking::PreferResidentPolicy>());
+    } else if (schedulingPolicy == "cost") {
+        taskGraph.setSchedulingPolicy(std::make_unique<tasking::CostModelPolicy>());
+    } else if (schedulingPolicy != "largest") {
+        spdlog::error("Unknown scheduling policy {}", schedulingPolicy);
+        exit(1);
+    }
+    if (executionMode == "continuous") {
+        taskGraph.setExecutionMode(tasking::TaskGraph::ExecutionMode::Continuous);
+    } else if (executionMode != "flush") {
+        spdlog::error("Unknown execution mode {}", executionMode);
+        exit(1);
+    }
+    if (numaAware)
+        g_stats.config.numaNodes = taskGraph.enableNumaAwareness();
+    if (rayMemoryBudgetMB > 0)
+        taskGraph.setMemoryBudget(rayMemoryBudgetMB * 1000000);
+    if (raySpillThresholdMB > 0) {
+        // Every batch of spilled rays of a task is written to its own temporary folder.
+        auto pNumSpillFolders = std::make_shared<std::atomic_int>(0);
+        taskGraph.enableSpilling(raySpillThresholdMB * 1000000, [=]() {
+            const std::string folderName = fmt::format("pandora_ray_spill_{}", pNumSpillFolders->fetch_add(1));
+            return std::make_unique<tasking::SplitFileSerializer>(
+                folderName, 256 * 1024 * 1024, mio_cache_control::cache_mode::sequential);
+        });
+    }
 
-    //using AccelBuilder = EmbreeAccelerationStructureBuilder;
-    using AccelBuilder = BatchingAccelerationStructureBuilder;
-    //using AccelBuilder = OfflineBatchingAccelerationStructureBuilder;
-    if constexpr (std::is_same_v<AccelBuilder, BatchingAccelerationStructureBuilder> || std::is_same_v<AccelBuilder, OfflineBatchingAccelerationStructureBuilder>) {
+    if (accelType == "batching" || accelType == "offline") {
         spdlog::info("Preprocessing scene");
         auto pSerializer = std::make_unique<tasking::SplitFileSerializer>(
-            "pandora_render_geom", 512 * 1024 * 1024, mio_cache_control::cache_mode::no_buffering);
+            "pandora_render_geom", 512 * 1024 * 1024, mio_cache_control::cache_mode::no_buffering,
+            ioUring ? tasking::FileReadBackend::IoUring : tasking::FileReadBackend::PersistentMapping);
         //auto pSerializer = std::make_unique<tasking::InMemorySerializer>();
 
         cacheBuilder = tasking::LRUCacheTS::Builder { std::move(pSerializer) };
-        AccelBuilder::preprocessScene(*renderConfig.pScene, geometryCache, cacheBuilder, primitivesPerBatchingPoint);
+        if (accelType == "offline")
+            OfflineBatchingAccelerationStructureBuilder::preprocessScene(*renderConfig.pScene, geometryCache, cacheBuilder, primitivesPerBatchingPoint);
+        else
+            BatchingAccelerationStructureBuilder::preprocessScene(*renderConfig.pScene, geometryCache, cacheBuilder, primitivesPerBatchingPoint);
         auto newCache = cacheBuilder.build(geomCacheSizeMB * 1000000);
         geometryCache = std::move(newCache);
     }
@@ -185,7 +262,7 @@ int main(int argc, char** argv)
     g_stats.memory.geometryEvicted = 0;
     g_stats.memory.geometryLoaded = 0;
 
-    if constexpr (std::is_same_v<AccelBuilder, EmbreeAccelerationStructureBuilder>) {
+    if (accelType == "embree") {
         std::function<void(const std::shared_ptr<SceneNode>&)> makeShapeResident = [&](const std::shared_ptr<SceneNode>& pSceneNode) {
             for (const auto& pSceneObject : pSceneNode->objects) {
                 geometryCache.makeResident(pSceneObject->pShape.get());
@@ -198,46 +275,55 @@ int main(int argc, char** argv)
         makeShapeResident(renderConfig.pScene->pRoot);
     }
 
-    spdlog::info("Building acceleration structure");
-    //AccelBuilder accelBuilder { *renderConfig.pScene, &taskGraph };
-    AccelBuilder accelBuilder { renderConfig.pScene.get(), &geometryCache, &taskGraph, primitivesPerBatchingPoint, bvhCacheSize, svdagRes };
     Sensor sensor { renderConfig.resolution };
-
-    try {
-        auto integratorType = vm["integrator"].as<std::string>();
-
-        auto render = [&](auto& integrator) {
-            spdlog::info("Building acceleration structure");
-            auto accel = accelBuilder.build(integrator.hitTaskHandle(), integrator.missTaskHandle(), integrator.anyHitTaskHandle(), integrator.anyMissTaskHandle());
-
-            // Offline BVH generates BVHs and evicts them immediately after construction. Clear stats so that final stats
-            // show only BVH traffic during rendering.
-            g_stats.asyncTriggerSnapshot();
-            g_stats.memory.botLevelEvicted = 0;
-            g_stats.memory.botLevelLoaded = 0;
-
-            spdlog::info("Starting render");
-            auto stopWatch = g_stats.timings.totalRenderTime.getScopedStopwatch();
-            integrator.render(concurrency, *renderConfig.camera, sensor, *renderConfig.pScene, accel);
-        };
-
-        if (integratorType == "direct") {
-            DirectLightingIntegrator integrator(&taskGraph, &geometryCache, 8, spp, LightStrategy::UniformSampleOne);
-            render(integrator);
-        } else if (integratorType == "path") {
-            PathIntegrator integrator { &taskGraph, &geometryCache, 8, spp, LightStrategy::UniformSampleOne };
-            render(integrator);
-
-        } else if (integratorType == "normal") {
-            if (spp != 1)
-                spdlog::warn("Normal visualization does not support multi-sampling, setting spp to 1!");
-            spp = g_stats.config.spp = 1;
-
-            NormalDebugIntegrator integrator { &taskGraph };
-            render(integrator);
+    auto renderWithAccel = [&](auto& accelBuilder) {
+        try {
+            auto integratorType = vm["integrator"].as<std::string>();
+
+            auto render = [&](auto& integrator) {
+                spdlog::info("Building acceleration structure");
+                auto accel = accelBuilder.build(integrator.hitTaskHandle(), integrator.missTaskHandle(), integrator.anyHitTaskHandle(), integrator.anyMissTaskHandle());
+
+                // Offline BVH generates BVHs and evicts them immediately after construction. Clear stats so that final stats
+                // show only BVH traffic during rendering.
+                g_stats.asyncTriggerSnapshot();
+                g_stats.memory.botLevelEvicted = 0;
+                g_stats.memory.botLevelLoaded = 0;
+
+                spdlog::info("Starting render");
+                auto stopWatch = g_stats.timings.totalRenderTime.getScopedStopwatch();
+                integrator.render(concurrency, *renderConfig.camera, sensor, *renderConfig.pScene, accel);
+            };
+
+            if (integratorType == "direct") {
+                DirectLightingIntegrator integrator(&taskGraph, &geometryCache, 8, spp, LightStrategy::UniformSampleOne);
+                render(integrator);
+            } else if (integratorType == "path") {
+                PathIntegrator integrator { &taskGraph, &geometryCache, 8, spp, LightStrategy::UniformSampleOne };
+                render(integrator);
+
+            } else if (integratorType == "normal") {
+                if (spp != 1)
+                    spdlog::warn("Normal visualization does not support multi-sampling, setting spp to 1!");
+                spp = g_stats.config.spp = 1;
+
+                NormalDebugIntegrator integrator { &taskGraph };
+                render(integrator);
+            }
+        } catch (const std::exception& e) {
+            std::cout << "Render error: " << e.what() << std::endl;
         }
-    } catch (const std::exception& e) {
-        std::cout << "Render error: " << e.what() << std::endl;
+    };
+
+    if (accelType == "offline") {
+        OfflineBatchingAccelerationStructureBuilder accelBuilder { renderConfig.pScene.get(), &geometryCache, &taskGraph, primitivesPerBatchingPoint, bvhCacheSize, svdagRes, sortRays, bvhStoreFolder };
+        renderWithAccel(accelBuilder);
+    } else if (accelType == "embree") {
+        EmbreeAccelerationStructureBuilder accelBuilder { *renderConfig.pScene, &taskGraph };
+        renderWithAccel(accelBuilder);
+    } else {
+        BatchingAccelerationStructureBuilder accelBuilder { renderConfig.pScene.get(), &geometryCache, &taskGraph, primitivesPerBatchingPoint, bvhCacheSize, svdagRes, sortRays, sceneBundleFile, vm["file"].as<std::string>() };
+        renderWithAccel(accelBuilder);
     }
 
     spdlog::info("Writing output to {}.jpg/exr", vm["out"].as<std::string>());